@@ -0,0 +1,292 @@
+#include "ECSRegistry.hpp"
+#include "physicsSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Headless physics benchmark, only links PhysicsSystem + ECSRegistry + ScratchArena so it runs without a window or GPU.
+// usage: physicsBench [pile|pyramid|rain|mixed|all] [bodies] [frames] [--json]
+// every scene is generated from a fixed seed and stepped at a fixed dt, so the checksum only changes when the simulation does
+
+struct BenchConfig
+{
+  std::string scene = "all";
+  int bodies = 500;
+  int frames = 600;
+  bool json = false;
+};
+
+struct BenchResult
+{
+  std::string scene;
+  int bodies;
+  int frames;
+  double totalMs;
+  PhysicsStats stats;
+  uint64_t checksum;
+};
+
+// xorshift instead of <random> distributions so every standard library generates the same scene
+struct BenchRandom
+{
+  uint32_t state;
+
+  BenchRandom(uint32_t seed) : state(seed)
+  {
+  }
+
+  float next()
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state & 0xFFFFFF) / float(0x1000000);
+  }
+
+  float range(float min, float max)
+  {
+    return min + (max - min) * next();
+  }
+};
+
+static Entity addBox(ECSRegistry &registry, const std::string &name, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale, bool isStatic)
+{
+  Entity e = registry.createEntity(name);
+
+  TransformComponent &transform = registry.transforms[e];
+  transform.position = position;
+  transform.rotationZYX = rotation;
+  transform.scale = scale;
+
+  BoxColliderComponent &collider = registry.boxColliders[e];
+  collider.updateWorldAABB(position, rotation, scale);
+  collider.transformVersion = transform.version;
+  collider.autoUpdate = true;
+
+  RigidBodyComponent &rigidBody = registry.rigidBodies[e];
+  rigidBody.isStatic = isStatic;
+  return e;
+}
+
+static void addFloor(ECSRegistry &registry, float halfSize)
+{
+  addBox(registry, "floor", glm::vec3(0, -0.5f, 0), glm::vec3(0), glm::vec3(halfSize * 2, 1, halfSize * 2), true);
+}
+
+static void buildPile(ECSRegistry &registry, int bodies)
+{
+  BenchRandom random(1234);
+  int side = std::max(1, static_cast<int>(std::cbrt(static_cast<float>(bodies))));
+  addFloor(registry, side * 2.0f);
+  for (int i = 0; i < bodies; i++)
+  {
+    int x = i % side;
+    int z = (i / side) % side;
+    int y = i / (side * side);
+    glm::vec3 jitter(random.range(-0.2f, 0.2f), 0, random.range(-0.2f, 0.2f));
+    addBox(registry, "box_" + std::to_string(i), glm::vec3(x * 1.1f, 0.6f + y * 1.1f, z * 1.1f) + jitter, glm::vec3(0), glm::vec3(1), false);
+  }
+}
+
+static void buildPyramids(ECSRegistry &registry, int bodies)
+{
+  const int baseWidth = 10;
+  const int perPyramid = baseWidth * (baseWidth + 1) / 2;
+  int pyramids = std::max(1, (bodies + perPyramid - 1) / perPyramid);
+  addFloor(registry, pyramids * 8.0f);
+
+  int placed = 0;
+  for (int p = 0; p < pyramids && placed < bodies; p++)
+  {
+    float offsetZ = (p - pyramids / 2) * 4.0f;
+    for (int row = 0; row < baseWidth && placed < bodies; row++)
+    {
+      for (int col = 0; col < baseWidth - row && placed < bodies; col++)
+      {
+        float x = (col - (baseWidth - row) * 0.5f) * 1.05f;
+        addBox(registry, "pyramid_" + std::to_string(placed), glm::vec3(x, 0.5f + row * 1.0f, offsetZ), glm::vec3(0), glm::vec3(1), false);
+        placed++;
+      }
+    }
+  }
+}
+
+static void buildRain(ECSRegistry &registry, int bodies)
+{
+  BenchRandom random(5678);
+  float area = std::max(5.0f, std::sqrt(static_cast<float>(bodies)) * 1.5f);
+  addFloor(registry, area);
+  for (int i = 0; i < bodies; i++)
+  {
+    glm::vec3 position(random.range(-area, area), random.range(5.0f, 5.0f + bodies * 0.05f), random.range(-area, area));
+    glm::vec3 rotation(random.range(0, 90), random.range(0, 90), random.range(0, 90));
+    addBox(registry, "rain_" + std::to_string(i), position, rotation, glm::vec3(1), false);
+  }
+}
+
+static void buildMixed(ECSRegistry &registry, int bodies)
+{
+  BenchRandom random(9012);
+  float area = std::max(5.0f, std::sqrt(static_cast<float>(bodies)) * 2.0f);
+  addFloor(registry, area);
+  for (int i = 0; i < bodies; i++)
+  {
+    bool isStatic = random.next() < 0.3f;
+    glm::vec3 position(random.range(-area, area), isStatic ? random.range(0.5f, 3.0f) : random.range(4.0f, 20.0f), random.range(-area, area));
+    glm::vec3 rotation = isStatic ? glm::vec3(0) : glm::vec3(random.range(0, 45), random.range(0, 45), 0);
+    glm::vec3 scale(random.range(0.5f, 2.0f), random.range(0.5f, 2.0f), random.range(0.5f, 2.0f));
+    addBox(registry, "mixed_" + std::to_string(i), position, rotation, scale, isStatic);
+  }
+}
+
+static void hashBytes(uint64_t &hash, const void *data, size_t size)
+{
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+}
+
+// FNV-1a over positions and velocities in entity order
+static uint64_t stateChecksum(ECSRegistry &registry)
+{
+  std::vector<Entity> entities;
+  entities.reserve(registry.transforms.size());
+  for (auto &[e, _] : registry.transforms)
+    entities.push_back(e);
+  std::sort(entities.begin(), entities.end());
+
+  uint64_t hash = 14695981039346656037ULL;
+  for (Entity e : entities)
+  {
+    const TransformComponent &transform = registry.transforms.at(e);
+    hashBytes(hash, &e, sizeof(e));
+    hashBytes(hash, &transform.position, sizeof(transform.position));
+    hashBytes(hash, &transform.rotationZYX, sizeof(transform.rotationZYX));
+
+    auto rigidBody = registry.rigidBodies.find(e);
+    if (rigidBody != registry.rigidBodies.end())
+      hashBytes(hash, &rigidBody->second.velocity, sizeof(rigidBody->second.velocity));
+  }
+  return hash;
+}
+
+static BenchResult runScene(const std::string &scene, int bodies, int frames)
+{
+  ECSRegistry registry;
+  PhysicsSystem physics(registry);
+  ScratchArena scratch;
+
+  if (scene == "pile")
+    buildPile(registry, bodies);
+  else if (scene == "pyramid")
+    buildPyramids(registry, bodies);
+  else if (scene == "rain")
+    buildRain(registry, bodies);
+  else
+    buildMixed(registry, bodies);
+
+  const float deltaTime = 1.0f / 60.0f;
+  physics.resetStats();
+
+  // same order as Engine::run, colliders get refit before the physics step
+  auto start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < frames; frame++)
+  {
+    scratch.reset();
+    physics.refitBoxColliders(scratch);
+    physics.update(deltaTime, scratch);
+  }
+  double totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  return {scene, bodies, frames, totalMs, physics.stats, stateChecksum(registry)};
+}
+
+static void printCSV(const std::vector<BenchResult> &results)
+{
+  std::cout << "scene,bodies,frames,totalMs,msPerFrame,integrateMs,refitMs,narrowPhaseMs,pairSweepMs,collidersRefit,pairsTested,aabbOverlaps,satCalls,satEarlyOuts,contacts,checksum\n";
+  for (const BenchResult &r : results)
+  {
+    std::cout << r.scene << "," << r.bodies << "," << r.frames << ","
+              << std::fixed << std::setprecision(3) << r.totalMs << "," << r.totalMs / r.frames << ","
+              << r.stats.integrateMs << "," << r.stats.refitMs << "," << r.stats.narrowPhaseMs << "," << r.stats.pairSweepMs << ","
+              << r.stats.collidersRefit << "," << r.stats.pairsTested << "," << r.stats.aabbOverlaps << ","
+              << r.stats.satCalls << "," << r.stats.satEarlyOuts << "," << r.stats.contacts << ","
+              << std::hex << std::setw(16) << std::setfill('0') << r.checksum << std::dec << std::setfill(' ') << "\n";
+  }
+}
+
+static void printJSON(const std::vector<BenchResult> &results)
+{
+  std::cout << "[\n";
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const BenchResult &r = results[i];
+    std::ostringstream checksum;
+    checksum << std::hex << std::setw(16) << std::setfill('0') << r.checksum;
+
+    std::cout << std::fixed << std::setprecision(3)
+              << "  {\"scene\": \"" << r.scene << "\", \"bodies\": " << r.bodies << ", \"frames\": " << r.frames
+              << ", \"totalMs\": " << r.totalMs << ", \"msPerFrame\": " << r.totalMs / r.frames
+              << ", \"integrateMs\": " << r.stats.integrateMs << ", \"refitMs\": " << r.stats.refitMs
+              << ", \"narrowPhaseMs\": " << r.stats.narrowPhaseMs << ", \"pairSweepMs\": " << r.stats.pairSweepMs
+              << ", \"collidersRefit\": " << r.stats.collidersRefit << ", \"pairsTested\": " << r.stats.pairsTested
+              << ", \"aabbOverlaps\": " << r.stats.aabbOverlaps << ", \"satCalls\": " << r.stats.satCalls
+              << ", \"satEarlyOuts\": " << r.stats.satEarlyOuts << ", \"contacts\": " << r.stats.contacts
+              << ", \"checksum\": \"" << checksum.str() << "\"}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  std::cout << "]\n";
+}
+
+int main(int argc, char **argv)
+{
+  BenchConfig config;
+  int positional = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--json") == 0)
+    {
+      config.json = true;
+      continue;
+    }
+
+    if (positional == 0)
+      config.scene = argv[i];
+    else if (positional == 1)
+      config.bodies = std::max(1, std::atoi(argv[i]));
+    else if (positional == 2)
+      config.frames = std::max(1, std::atoi(argv[i]));
+    positional++;
+  }
+
+  std::vector<std::string> scenes;
+  if (config.scene == "all")
+    scenes = {"pile", "pyramid", "rain", "mixed"};
+  else if (config.scene == "pile" || config.scene == "pyramid" || config.scene == "rain" || config.scene == "mixed")
+    scenes = {config.scene};
+  else
+  {
+    std::cerr << "Unknown scene: " << config.scene << " (expected pile, pyramid, rain, mixed or all)" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<BenchResult> results;
+  for (const std::string &scene : scenes)
+    results.push_back(runScene(scene, config.bodies, config.frames));
+
+  if (config.json)
+    printJSON(results);
+  else
+    printCSV(results);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+#include "worldBatch.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Steps many small independent worlds on a WorldBatch and reports aggregate throughput.
+// usage: worldBatchBench [worlds] [bodies per world] [frames] [threads] [--json]
+// threads defaults to 0, one worker per hardware thread
+
+struct BenchConfig
+{
+  int worlds = 1000;
+  int bodies = 32;
+  int frames = 600;
+  int threads = 0;
+  bool json = false;
+};
+
+// xorshift so every world gets a different but reproducible layout
+static float nextRandom(uint32_t &state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return (state & 0xFFFFFF) / float(0x1000000);
+}
+
+static void buildWorld(World &world, int bodies, uint32_t seed)
+{
+  Entity floor = world.createEmptyGameObject("floor");
+  world.registry.transforms[floor].position = glm::vec3(0, -0.5f, 0);
+  world.registry.transforms[floor].scale = glm::vec3(20, 1, 20);
+  world.addBoxColliderComponent(floor);
+  world.addRigidBodyComponent(floor);
+  world.registry.rigidBodies[floor].isStatic = true;
+
+  uint32_t state = seed * 2654435761u + 1;
+  for (int i = 0; i < bodies; i++)
+  {
+    Entity e = world.createEmptyGameObject("box_" + std::to_string(i));
+    TransformComponent &transform = world.registry.transforms[e];
+    transform.position = glm::vec3(nextRandom(state) * 10 - 5, 1 + nextRandom(state) * 10, nextRandom(state) * 10 - 5);
+    transform.rotationZYX = glm::vec3(nextRandom(state) * 45, nextRandom(state) * 45, 0);
+    world.addBoxColliderComponent(e);
+    world.addRigidBodyComponent(e);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  BenchConfig config;
+  int positional = 0;
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--json") == 0)
+    {
+      config.json = true;
+      continue;
+    }
+
+    int value = std::max(0, std::atoi(argv[i]));
+    if (positional == 0)
+      config.worlds = std::max(1, value);
+    else if (positional == 1)
+      config.bodies = value;
+    else if (positional == 2)
+      config.frames = std::max(1, value);
+    else if (positional == 3)
+      config.threads = value;
+    positional++;
+  }
+
+  WorldBatch batch(config.threads);
+  for (int i = 0; i < config.worlds; i++)
+    buildWorld(batch.addWorld(), config.bodies, i);
+
+  const float deltaTime = 1.0f / 60.0f;
+  batch.resetStats();
+  for (int frame = 0; frame < config.frames; frame++)
+    batch.step(deltaTime);
+
+  const WorldBatchStats &stats = batch.stats;
+  if (config.json)
+  {
+    std::cout << std::fixed << std::setprecision(3)
+              << "{\"worlds\": " << config.worlds << ", \"bodies\": " << config.bodies << ", \"frames\": " << config.frames
+              << ", \"threads\": " << batch.threadCount() << ", \"worldSteps\": " << stats.worldSteps
+              << ", \"wallSeconds\": " << stats.wallSeconds << ", \"stepsPerSecond\": " << stats.stepsPerSecond() << "}\n";
+  }
+  else
+  {
+    std::cout << "worlds,bodies,frames,threads,worldSteps,wallSeconds,stepsPerSecond\n"
+              << config.worlds << "," << config.bodies << "," << config.frames << "," << batch.threadCount() << ","
+              << stats.worldSteps << "," << std::fixed << std::setprecision(3) << stats.wallSeconds << "," << stats.stepsPerSecond() << "\n";
+  }
+
+  return EXIT_SUCCESS;
+}
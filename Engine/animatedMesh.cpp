@@ -7,6 +7,7 @@
 #include <tiny_obj_loader.h>
 #include <glm/gtc/quaternion.hpp>
 #include <noImage.hpp>
+#include <algorithm>
 
 AnimatedMesh::AnimatedMesh(Renderer &renderer, int *nextRenderingId, MaterialData newMaterial, const std::vector<AnimatedVertex> &vertices, const std::vector<uint32_t> &indices) : vertices(vertices), indices(indices), material(newMaterial), textureManager(renderer.bufferManager, renderer)
 {
@@ -23,52 +24,11 @@ void AnimatedMesh::initGraphics(Renderer &renderer, std::string texturePath)
 
   renderer.bufferManager.createAnimatedVertexBuffer(vertices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
 
-  renderer.bufferManager.createIndexBuffer(indices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
-
-  renderer.bufferManager.createUniformBuffers(renderer.MAX_FRAMES_IN_FLIGHT, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, 1);
+  uint64_t indexTicket = renderer.bufferManager.createIndexBuffer(indices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice);
+  uploadTicket = std::max(textureManager.uploadTicket, indexTicket);
 
   TextureMaps textureMaps(textureManager.albedoImageView, textureManager.albedoSampler, textureManager.normalImageView, textureManager.normalSampler, textureManager.heightImageView, textureManager.heightSampler, textureManager.roughnessImageView, textureManager.roughnessSampler, textureManager.metallicImageView, textureManager.metallicSampler, textureManager.aoImageView, textureManager.aoSampler, textureManager.emissiveImageView, textureManager.emissiveSampler);
-  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, 1, textureMaps);
-  renderer.bufferManager.createAnimationUniformBuffers(renderer.MAX_FRAMES_IN_FLIGHT, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, 1, id);
-
-  renderer.descriptorManager.addAnimDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, 1, id);
-}
-
-void AnimatedMesh::draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, glm::mat4 view, glm::mat4 projectionMatrix, std::array<glm::mat4, 100> &finalBoneMatrices, VkCommandBuffer commandBuffer, int colorStageID)
-{
-
-  VkBuffer vertexBuffersArray[] = {renderer->bufferManager.vertexBuffers[id]};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersArray, offsets);
-
-  vkCmdBindIndexBuffer(commandBuffer, renderer->bufferManager.indexBuffers[id], 0, VK_INDEX_TYPE_UINT32);
-
-  if (colorStageID == -1)
-  {
-    VkDescriptorSet descriptorSets[] = {
-        renderer->descriptorManager.descriptorSets[currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT],
-        renderer->descriptorManager.animDescriptorSets.at(id * renderer->MAX_FRAMES_IN_FLIGHT + currentFrame)};
-
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.animPipelineLayout, 0, 2, descriptorSets, 0, nullptr);
-
-    renderer->bufferManager.updateUniformBuffer(currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT, transformation, view, projectionMatrix);
-
-    renderer->bufferManager.updateAnimationUniformBuffer(id * renderer->MAX_FRAMES_IN_FLIGHT + currentFrame, finalBoneMatrices);
-
-    vkCmdPushConstants(
-        commandBuffer,
-        renderer->pipelineManager.animPipelineLayout,
-        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        0,
-        sizeof(MaterialData),
-        &material);
-  }
-  else
-  {
-    return; // no support for color id picking yet
-  }
-
-  vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, id, textureMaps);
 }
 
 void AnimatedMesh::cleanup(VkDevice device, Renderer &renderer)
@@ -87,13 +47,6 @@ void AnimatedMesh::cleanup(VkDevice device, Renderer &renderer)
     renderer.bufferManager.indexBuffers[id] = VK_NULL_HANDLE;
   }
 
-  for (int i = 0; i < renderer.MAX_FRAMES_IN_FLIGHT; i++)
-  {
-    vkDestroyBuffer(device, renderer.bufferManager.uniformBuffers[id * renderer.MAX_FRAMES_IN_FLIGHT + i], nullptr);
-
-    renderer.bufferManager.uniformBuffers[id * renderer.MAX_FRAMES_IN_FLIGHT + i] = VK_NULL_HANDLE;
-  }
-
   uint32_t descriptorSetCount = renderer.MAX_FRAMES_IN_FLIGHT;
   uint32_t startIndex = id * renderer.MAX_FRAMES_IN_FLIGHT;
   if (renderer.descriptorManager.descriptorSets.size() >= startIndex + descriptorSetCount)
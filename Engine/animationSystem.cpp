@@ -0,0 +1,105 @@
+#include "animationSystem.hpp"
+#include "ECSRegistry.hpp"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <cmath>
+
+glm::mat4 AnimationSystem::getLocalTransform(SkeletonComponent &skeleton, int nodeIndex)
+{
+
+  glm::mat4 translation = glm::mat4(1.0f);
+  glm::mat4 rotation = glm::mat4(1.0f);
+  glm::mat4 scale = glm::mat4(1.0f);
+
+  translation = glm::translate(translation, glm::vec3(skeleton.nodeTransforms[nodeIndex].translation[0], skeleton.nodeTransforms[nodeIndex].translation[1], skeleton.nodeTransforms[nodeIndex].translation[2]));
+
+  glm::quat q = glm::quat(skeleton.nodeTransforms[nodeIndex].rotation[0], skeleton.nodeTransforms[nodeIndex].rotation[1], skeleton.nodeTransforms[nodeIndex].rotation[2], skeleton.nodeTransforms[nodeIndex].rotation[3]);
+  rotation = glm::mat4_cast(q);
+
+  scale = glm::scale(scale, glm::vec3(skeleton.nodeTransforms[nodeIndex].scale[0], skeleton.nodeTransforms[nodeIndex].scale[1], skeleton.nodeTransforms[nodeIndex].scale[2]));
+
+  return translation * rotation * scale;
+}
+
+glm::mat4 AnimationSystem::getGlobalTransform(int nodeIndex, SkeletonComponent &skeleton, glm::mat4 startMatrix)
+{
+  glm::mat4 transform = startMatrix;
+
+  while (nodeIndex >= 0)
+  {
+    transform = getLocalTransform(skeleton, nodeIndex) * transform;
+
+    auto it = skeleton.nodeToParent.find(nodeIndex);
+    if (it == skeleton.nodeToParent.end())
+      break;
+    nodeIndex = it->second;
+  }
+
+  return transform;
+}
+
+void AnimationSystem::update(float deltaTime)
+{
+  for (auto &[e, animations] : registry.animationComponents)
+  {
+    auto skeletonIt = registry.animationSkeletons.find(e);
+    if (skeletonIt == registry.animationSkeletons.end() || animations.animations.empty())
+      continue;
+
+    SkeletonComponent &skeleton = skeletonIt->second;
+    int animationIndex = animations.currentAnimationIndex >= 0 ? animations.currentAnimationIndex : 0;
+    Animation &animation = animations.animations.at(animationIndex);
+
+    animations.currentTime += deltaTime;
+    if (animation.duration > 0)
+      animations.currentTime = std::fmod(animations.currentTime, animation.duration);
+    float currentTime = animations.currentTime;
+
+    for (auto &channel : animation.channels)
+    {
+      AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
+      int frameIndex = 0;
+      for (size_t i = 0; i < sampler.inputTimes.size(); ++i)
+      {
+        if (sampler.inputTimes[i] > currentTime)
+          break;
+        frameIndex = i;
+      }
+
+      if (channel.path == "translation")
+      {
+        skeleton.nodeTransforms[channel.nodeIndex].translation = glm::vec3(sampler.outputValues[frameIndex]);
+        skeleton.computeFinalBoneMatrices = true;
+      }
+      else if (channel.path == "rotation")
+      {
+        skeleton.nodeTransforms[channel.nodeIndex].rotation = glm::vec4(sampler.outputValues[frameIndex][3], sampler.outputValues[frameIndex][0], sampler.outputValues[frameIndex][1], sampler.outputValues[frameIndex][2]);
+        skeleton.computeFinalBoneMatrices = true;
+      }
+      else if (channel.path == "scale")
+      {
+        skeleton.nodeTransforms[channel.nodeIndex].scale = glm::vec3(sampler.outputValues[frameIndex]);
+        skeleton.computeFinalBoneMatrices = true;
+      }
+    }
+  }
+
+  for (auto &[e, skeleton] : registry.animationSkeletons)
+  {
+    if (!skeleton.computeFinalBoneMatrices)
+      continue;
+
+    skeleton.computeFinalBoneMatrices = false;
+    skeleton.finalBoneMatrices = {};
+
+    const tinygltf::Skin &skin = skeleton.model->skins[skeleton.node->skin];
+    for (int i = 0; i < skin.joints.size(); i++)
+    {
+      int jointNodeIndex = skin.joints[i];
+
+      glm::mat4 jointGlobalTransform = getGlobalTransform(jointNodeIndex, skeleton);
+      glm::mat4 inverseBind = skeleton.inverseBindMats[i];
+      skeleton.finalBoneMatrices[i] = jointGlobalTransform * inverseBind;
+    }
+  }
+}
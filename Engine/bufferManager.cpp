@@ -1,7 +1,11 @@
 #include "bufferManager.hpp"
 #include "utils.h"
+#include "mesh.hpp"
 #include <stdexcept>
 #include <chrono>
+#include <algorithm>
+#include <iostream>
+#include <cstring>
 
 void BufferManager::createComputeUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevice device, VkPhysicalDevice physicalDevice, int count)
 {
@@ -15,23 +19,23 @@ void BufferManager::createComputeUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevi
   {
     createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, computeUniformBuffers[i], computeUniformBuffersMemory[i], device, physicalDevice);
 
-    vkMapMemory(device, computeUniformBuffersMemory[i], 0, bufferSize, 0, &computeUniformBuffersMapped[i]);
+    computeUniformBuffersMapped[i] = computeUniformBuffersMemory[i].mapped;
   }
 }
 
-void BufferManager::createUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevice device, VkPhysicalDevice physicalDevice, int count)
+void BufferManager::createGlobalUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevice device, VkPhysicalDevice physicalDevice)
 {
-  VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+  VkDeviceSize bufferSize = sizeof(GlobalUniformBufferObject);
 
-  uniformBuffers.resize(uniformBuffers.size() + MAX_FRAMES_IN_FLIGHT * count);
-  uniformBuffersMemory.resize(uniformBuffersMemory.size() + MAX_FRAMES_IN_FLIGHT * count);
-  uniformBuffersMapped.resize(uniformBuffersMapped.size() + MAX_FRAMES_IN_FLIGHT * count);
+  globalUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
+  globalUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
+  globalUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
-  for (size_t i = uniformBuffers.size() - MAX_FRAMES_IN_FLIGHT * count; i < uniformBuffers.size(); i++)
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
   {
-    createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i], device, physicalDevice);
+    createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, globalUniformBuffers[i], globalUniformBuffersMemory[i], device, physicalDevice);
 
-    vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+    globalUniformBuffersMapped[i] = globalUniformBuffersMemory[i].mapped;
   }
 }
 
@@ -47,62 +51,103 @@ void BufferManager::createLightsUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevic
   {
     createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, lightsUBO[i], lightsUBOMemory[i], device, physicalDevice);
 
-    vkMapMemory(device, lightsUBOMemory[i], 0, bufferSize, 0, &lightsUBOMapped[i]);
+    lightsUBOMapped[i] = lightsUBOMemory[i].mapped;
   }
 }
 
-void BufferManager::createAnimationUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevice device, VkPhysicalDevice physicalDevice, int count, int startingId)
+VkDeviceSize BufferManager::alignUniformSize(VkDeviceSize size) const
 {
-  VkDeviceSize bufferSize = sizeof(AnimatedUniformBufferObject);
+  return (size + uniformAlignment - 1) & ~(uniformAlignment - 1);
+}
 
-  for (size_t i = 0; i < count; i++)
+bool BufferManager::reserveFrameUniforms(int frame, VkDeviceSize size, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  if (frameUniformBuffers.size() <= frame)
   {
-    for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
-    {
-      int id = (startingId + i) * MAX_FRAMES_IN_FLIGHT + frame;
+    // dynamic offsets have to be multiples of this
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uniformAlignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+
+    frameUniformBuffers.resize(frame + 1, VK_NULL_HANDLE);
+    frameUniformBuffersMemory.resize(frame + 1);
+    frameUniformBuffersMapped.resize(frame + 1, nullptr);
+    frameUniformCapacities.resize(frame + 1, 0);
+    frameUniformHeads.resize(frame + 1, 0);
+  }
 
-      VkBuffer buffer;
-      VkDeviceMemory memory;
-      void *mapped;
+  // the bone binding covers a whole AnimatedUniformBufferObject past any offset, even in an empty frame
+  size = std::max<VkDeviceSize>(size, sizeof(AnimatedUniformBufferObject));
+  if (size <= frameUniformCapacities[frame])
+    return false;
 
-      createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, memory, device, physicalDevice);
+  if (frameUniformBuffers[frame] != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(device, frameUniformBuffers[frame], nullptr);
+    MemoryAllocator::get().free(frameUniformBuffersMemory[frame], device);
+  }
 
-      vkMapMemory(device, memory, 0, bufferSize, 0, &mapped);
+  VkDeviceSize capacity = std::max(size, frameUniformCapacities[frame] * 2);
 
-      animatedUniformBuffers[id] = buffer;
-      animatedUniformBuffersMemory[id] = memory;
-      animatedUniformBuffersMapped[id] = mapped;
-    }
+  createBuffer(capacity, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, frameUniformBuffers[frame], frameUniformBuffersMemory[frame], device, physicalDevice);
+  frameUniformBuffersMapped[frame] = frameUniformBuffersMemory[frame].mapped;
+  frameUniformCapacities[frame] = capacity;
+  return true;
+}
+
+void BufferManager::resetFrameUniforms(int frame)
+{
+  frameUniformHeads[frame] = 0;
+}
+
+uint32_t BufferManager::pushFrameUniforms(int frame, const void *data, VkDeviceSize size, VkDeviceSize bindingRange)
+{
+  VkDeviceSize offset = frameUniformHeads[frame];
+  if (offset + std::max(size, bindingRange) > frameUniformCapacities[frame])
+  {
+    // the buffer can't grow while the frame is being recorded, reserveFrameUniforms has to be called with enough room first
+    std::cerr << "frame uniform buffer is full!" << std::endl;
+    return 0;
   }
+
+  memcpy(static_cast<char *>(frameUniformBuffersMapped[frame]) + offset, data, size);
+  frameUniformHeads[frame] = offset + alignUniformSize(size);
+  return static_cast<uint32_t>(offset);
 }
 
-void BufferManager::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory, VkDevice device, VkPhysicalDevice physicalDevice)
+uint32_t BufferManager::pushObjectUniforms(int frame, const glm::mat4 &model, UniformCamera camera)
+{
+  ObjectUniformBufferObject ubo{};
+  ubo.model = model;
+  ubo.camera = camera;
+  return pushFrameUniforms(frame, &ubo, sizeof(ubo), sizeof(ubo));
+}
+
+uint32_t BufferManager::pushBoneUniforms(int frame, const std::array<glm::mat4, 100> &boneMatrices)
+{
+  return pushFrameUniforms(frame, boneMatrices.data(), sizeof(glm::mat4) * boneMatrices.size(), sizeof(AnimatedUniformBufferObject));
+}
+
+void BufferManager::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, MemoryAllocation &bufferMemory, VkDevice device, VkPhysicalDevice physicalDevice, const std::vector<uint32_t> &queueFamilies)
 {
   VkBufferCreateInfo bufferInfo{};
   bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   bufferInfo.size = size;
   bufferInfo.usage = usage;
   bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+  if (queueFamilies.size() > 1)
   {
-    throw std::runtime_error("failed to create buffer!");
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+    bufferInfo.pQueueFamilyIndices = queueFamilies.data();
   }
 
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, physicalDevice);
-
-  if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
   {
-    throw std::runtime_error("failed to allocate buffer memory!");
+    throw std::runtime_error("failed to create buffer!");
   }
 
-  vkBindBufferMemory(device, buffer, bufferMemory, 0);
+  MemoryAllocator::get().allocateBuffer(buffer, properties, bufferMemory, device, physicalDevice);
 }
 
 void BufferManager::createShaderStorageBuffer(const std::vector<Particle> &particles, int MAX_FRAMES_IN_FLIGHT, int targetBuffer, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue)
@@ -113,18 +158,16 @@ void BufferManager::createShaderStorageBuffer(const std::vector<Particle> &parti
   if (shaderStorageBuffers.size() <= MAX_FRAMES_IN_FLIGHT * (targetBuffer + 1))
   {
     shaderStorageBuffers.resize(MAX_FRAMES_IN_FLIGHT * (targetBuffer + 1), VK_NULL_HANDLE);
-    shaderStorageBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT * (targetBuffer + 1), VK_NULL_HANDLE);
+    shaderStorageBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT * (targetBuffer + 1));
   }
 
   VkDeviceSize bufferSize = sizeof(particles[0]) * particles.size();
   VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
+  MemoryAllocation stagingBufferMemory;
   createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
 
-  void *data;
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+  void *data = stagingBufferMemory.mapped;
   memcpy(data, particles.data(), (size_t)bufferSize);
-  vkUnmapMemory(device, stagingBufferMemory);
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
   {
     createBuffer(bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shaderStorageBuffers[MAX_FRAMES_IN_FLIGHT * targetBuffer + i], shaderStorageBuffersMemory[MAX_FRAMES_IN_FLIGHT * targetBuffer + i], device, physicalDevice);
@@ -132,33 +175,21 @@ void BufferManager::createShaderStorageBuffer(const std::vector<Particle> &parti
     copyBuffer(stagingBuffer, shaderStorageBuffers[MAX_FRAMES_IN_FLIGHT * targetBuffer + i], bufferSize, device, commandPool, graphicsQueue);
   }
   vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+  MemoryAllocator::get().free(stagingBufferMemory, device);
 }
 
-void BufferManager::createIndexBuffer(const std::vector<uint32_t> &inputIndices, int targetBuffer, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue)
+uint64_t BufferManager::createIndexBuffer(const std::vector<uint32_t> &inputIndices, int targetBuffer, VkDevice device, VkPhysicalDevice physicalDevice)
 {
   if (indexBuffers.size() <= targetBuffer)
   {
     indexBuffers.resize(targetBuffer + 1, VK_NULL_HANDLE);
-    indexBufferMemory.resize(targetBuffer + 1, VK_NULL_HANDLE);
+    indexBufferMemory.resize(targetBuffer + 1);
   }
 
   VkDeviceSize bufferSize = sizeof(inputIndices[0]) * inputIndices.size();
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
+  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffers[targetBuffer], indexBufferMemory[targetBuffer], device, physicalDevice, uploadManager.sharedFamilies());
 
-  void *data;
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, inputIndices.data(), (size_t)bufferSize);
-  vkUnmapMemory(device, stagingBufferMemory);
-
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffers[targetBuffer], indexBufferMemory[targetBuffer], device, physicalDevice);
-
-  copyBuffer(stagingBuffer, indexBuffers[targetBuffer], bufferSize, device, commandPool, graphicsQueue);
-
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+  return uploadManager.uploadBuffer(indexBuffers[targetBuffer], 0, inputIndices.data(), bufferSize);
 }
 
 void BufferManager::createVertexBuffer(const std::vector<Vertex> &verts, int targetBuffer, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue)
@@ -172,20 +203,18 @@ void BufferManager::createVertexBuffer(const std::vector<Vertex> &verts, int tar
   if (vertexBuffers.size() <= targetBuffer)
   {
     vertexBuffers.resize(targetBuffer + 1, VK_NULL_HANDLE);
-    vertexBufferMemory.resize(targetBuffer + 1, VK_NULL_HANDLE);
+    vertexBufferMemory.resize(targetBuffer + 1);
     vertexBufferSizes.resize(targetBuffer + 1, 0);
   }
 
   if (vertexBuffers[targetBuffer] != VK_NULL_HANDLE)
   {
     VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    MemoryAllocation stagingBufferMemory;
     createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
 
-    void *data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+    void *data = stagingBufferMemory.mapped;
     memcpy(data, verts.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
 
     if (bufferSize > vertexBufferSizes[targetBuffer])
     {
@@ -194,10 +223,7 @@ void BufferManager::createVertexBuffer(const std::vector<Vertex> &verts, int tar
         vkQueueWaitIdle(graphicsQueue);
         vkDestroyBuffer(device, vertexBuffers[targetBuffer], nullptr);
       }
-      if (vertexBufferMemory[targetBuffer] != VK_NULL_HANDLE)
-      {
-        vkFreeMemory(device, vertexBufferMemory[targetBuffer], nullptr);
-      }
+      MemoryAllocator::get().free(vertexBufferMemory[targetBuffer], device);
 
       createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexBuffers[targetBuffer], vertexBufferMemory[targetBuffer], device, physicalDevice);
 
@@ -207,27 +233,185 @@ void BufferManager::createVertexBuffer(const std::vector<Vertex> &verts, int tar
     copyBuffer(stagingBuffer, vertexBuffers[targetBuffer], bufferSize, device, commandPool, graphicsQueue);
 
     vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    MemoryAllocator::get().free(stagingBufferMemory, device);
 
     return;
   }
 
   vertexBufferSizes[targetBuffer] = bufferSize;
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
+  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexBuffers[targetBuffer], vertexBufferMemory[targetBuffer], device, physicalDevice);
 
-  void *data;
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, verts.data(), (size_t)bufferSize);
-  vkUnmapMemory(device, stagingBufferMemory);
+  // host visible already and no frame reads a new buffer yet, nothing to stage or submit
+  memcpy(vertexBufferMemory[targetBuffer].mapped, verts.data(), (size_t)bufferSize);
+}
 
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexBuffers[targetBuffer], vertexBufferMemory[targetBuffer], device, physicalDevice);
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t size)
+{
+  // FNV-1a
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
 
-  copyBuffer(stagingBuffer, vertexBuffers[targetBuffer], bufferSize, device, commandPool, graphicsQueue);
+int BufferManager::acquireGeometry(const std::vector<Vertex> &verts, const std::vector<uint32_t> &inputIndices, VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue)
+{
+  if (verts.empty() || inputIndices.empty())
+    return -1;
+
+  size_t vertexCount = verts.size();
+  size_t indexCount = inputIndices.size();
+  uint64_t hash = 14695981039346656037ULL;
+  hash = hashBytes(hash, &vertexCount, sizeof(vertexCount));
+  hash = hashBytes(hash, &indexCount, sizeof(indexCount));
+  hash = hashBytes(hash, verts.data(), sizeof(Vertex) * vertexCount);
+  hash = hashBytes(hash, inputIndices.data(), sizeof(uint32_t) * indexCount);
+
+  auto it = geometryLookup.find(hash);
+  if (it != geometryLookup.end())
+  {
+    SharedGeometry &shared = sharedGeometry[it->second];
+    if (shared.vertices.size() == vertexCount && shared.indices.size() == indexCount &&
+        memcmp(shared.vertices.data(), verts.data(), sizeof(Vertex) * vertexCount) == 0 &&
+        memcmp(shared.indices.data(), inputIndices.data(), sizeof(uint32_t) * indexCount) == 0)
+    {
+      shared.users++;
+      return it->second;
+    }
+  }
 
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+  int slot = geometryArena.allocate(verts, inputIndices, uploadManager, device, physicalDevice, graphicsQueue);
+
+  if (it == geometryLookup.end())
+    geometryLookup.emplace(hash, slot);
+  sharedGeometry[slot] = {hash, 1, verts, inputIndices};
+  return slot;
+}
+
+void BufferManager::releaseGeometry(int slot)
+{
+  auto sharedIt = sharedGeometry.find(slot);
+  if (sharedIt == sharedGeometry.end())
+    return;
+
+  if (--sharedIt->second.users > 0)
+    return;
+
+  auto it = geometryLookup.find(sharedIt->second.hash);
+  if (it != geometryLookup.end() && it->second == slot)
+    geometryLookup.erase(it);
+  sharedGeometry.erase(sharedIt);
+  geometryArena.free(slot);
+}
+
+bool BufferManager::reserveInstanceBuffer(int frame, size_t count, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  if (instanceBuffers.size() <= frame)
+  {
+    instanceBuffers.resize(frame + 1, VK_NULL_HANDLE);
+    instanceBuffersMemory.resize(frame + 1);
+    instanceBuffersMapped.resize(frame + 1, nullptr);
+    instanceCapacities.resize(frame + 1, 0);
+  }
+
+  if (count <= instanceCapacities[frame])
+    return false;
+
+  if (instanceBuffers[frame] != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(device, instanceBuffers[frame], nullptr);
+    MemoryAllocator::get().free(instanceBuffersMemory[frame], device);
+  }
+
+  size_t capacity = std::max(count, instanceCapacities[frame] * 2);
+  VkDeviceSize size = sizeof(InstanceData) * capacity;
+
+  createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffers[frame], instanceBuffersMemory[frame], device, physicalDevice);
+  instanceBuffersMapped[frame] = instanceBuffersMemory[frame].mapped;
+  instanceCapacities[frame] = capacity;
+  return true;
+}
+
+bool BufferManager::reserveMappedBuffer(MappedBuffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  if (size <= buffer.capacity)
+    return false;
+
+  destroyMappedBuffer(buffer, device);
+
+  VkDeviceSize capacity = std::max(size, buffer.capacity * 2);
+  createBuffer(capacity, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer.buffer, buffer.memory, device, physicalDevice);
+  buffer.mapped = buffer.memory.mapped;
+  buffer.capacity = capacity;
+  // draw counts are read back and visibility flags are read before the GPU first writes them
+  memset(buffer.mapped, 0, capacity);
+  return true;
+}
+
+void BufferManager::destroyMappedBuffer(MappedBuffer &buffer, VkDevice device)
+{
+  if (buffer.buffer == VK_NULL_HANDLE)
+    return;
+
+  vkDestroyBuffer(device, buffer.buffer, nullptr);
+  MemoryAllocator::get().free(buffer.memory, device);
+  buffer.buffer = VK_NULL_HANDLE;
+  buffer.mapped = nullptr;
+  buffer.capacity = 0;
+}
+
+bool BufferManager::reserveGpuCullBuffers(int frame, size_t instanceCount, size_t batchCount, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  if (gpuCullBuffers.size() <= frame)
+    gpuCullBuffers.resize(frame + 1);
+
+  // never zero sized, the descriptors need a buffer even when nothing is culled on the GPU
+  instanceCount = std::max<size_t>(instanceCount, 1);
+  batchCount = std::max<size_t>(batchCount, 1);
+
+  GpuCullBuffers &buffers = gpuCullBuffers[frame];
+  bool grown = reserveMappedBuffer(buffers.instances, sizeof(CullInstanceData) * instanceCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, device, physicalDevice);
+  grown |= reserveMappedBuffer(buffers.batches, sizeof(GpuBatchData) * batchCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, device, physicalDevice);
+  grown |= reserveMappedBuffer(buffers.commands, 2 * sizeof(VkDrawIndexedIndirectCommand) * batchCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, device, physicalDevice);
+  grown |= reserveMappedBuffer(buffers.drawCount, (2 + batchCount) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, device, physicalDevice);
+  return grown;
+}
+
+bool BufferManager::reserveCullVisibility(size_t slotCount, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  // new flags start out cleared, those meshes are tested against the pyramid before they are drawn
+  return reserveMappedBuffer(cullVisibility, sizeof(uint32_t) * std::max<size_t>(slotCount, 1), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, device, physicalDevice);
+}
+
+bool BufferManager::reserveMaterialBuffer(int frame, size_t count, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  if (materialBuffers.size() <= frame)
+  {
+    materialBuffers.resize(frame + 1, VK_NULL_HANDLE);
+    materialBuffersMemory.resize(frame + 1);
+    materialBuffersMapped.resize(frame + 1, nullptr);
+    materialCapacities.resize(frame + 1, 0);
+  }
+
+  if (count <= materialCapacities[frame])
+    return false;
+
+  if (materialBuffers[frame] != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(device, materialBuffers[frame], nullptr);
+    MemoryAllocator::get().free(materialBuffersMemory[frame], device);
+  }
+
+  size_t capacity = std::max(count, materialCapacities[frame] * 2);
+  VkDeviceSize size = sizeof(BindlessMaterial) * capacity;
+
+  createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, materialBuffers[frame], materialBuffersMemory[frame], device, physicalDevice);
+  materialBuffersMapped[frame] = materialBuffersMemory[frame].mapped;
+  materialCapacities[frame] = capacity;
+  return true;
 }
 
 void BufferManager::createAnimatedVertexBuffer(const std::vector<AnimatedVertex> &verts, int targetBuffer, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue)
@@ -241,20 +425,18 @@ void BufferManager::createAnimatedVertexBuffer(const std::vector<AnimatedVertex>
   if (vertexBuffers.size() <= targetBuffer)
   {
     vertexBuffers.resize(targetBuffer + 1, VK_NULL_HANDLE);
-    vertexBufferMemory.resize(targetBuffer + 1, VK_NULL_HANDLE);
+    vertexBufferMemory.resize(targetBuffer + 1);
     vertexBufferSizes.resize(targetBuffer + 1, 0);
   }
 
   if (vertexBuffers[targetBuffer] != VK_NULL_HANDLE)
   {
     VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
+    MemoryAllocation stagingBufferMemory;
     createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
 
-    void *data;
-    vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
+    void *data = stagingBufferMemory.mapped;
     memcpy(data, verts.data(), (size_t)bufferSize);
-    vkUnmapMemory(device, stagingBufferMemory);
 
     if (bufferSize > vertexBufferSizes[targetBuffer])
     {
@@ -263,10 +445,7 @@ void BufferManager::createAnimatedVertexBuffer(const std::vector<AnimatedVertex>
         vkQueueWaitIdle(graphicsQueue);
         vkDestroyBuffer(device, vertexBuffers[targetBuffer], nullptr);
       }
-      if (vertexBufferMemory[targetBuffer] != VK_NULL_HANDLE)
-      {
-        vkFreeMemory(device, vertexBufferMemory[targetBuffer], nullptr);
-      }
+      MemoryAllocator::get().free(vertexBufferMemory[targetBuffer], device);
 
       createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexBuffers[targetBuffer], vertexBufferMemory[targetBuffer], device, physicalDevice);
 
@@ -276,27 +455,16 @@ void BufferManager::createAnimatedVertexBuffer(const std::vector<AnimatedVertex>
     copyBuffer(stagingBuffer, vertexBuffers[targetBuffer], bufferSize, device, commandPool, graphicsQueue);
 
     vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingBufferMemory, nullptr);
+    MemoryAllocator::get().free(stagingBufferMemory, device);
 
     return;
   }
 
   vertexBufferSizes[targetBuffer] = bufferSize;
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
-
-  void *data;
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-  memcpy(data, verts.data(), (size_t)bufferSize);
-  vkUnmapMemory(device, stagingBufferMemory);
-
   createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, vertexBuffers[targetBuffer], vertexBufferMemory[targetBuffer], device, physicalDevice);
 
-  copyBuffer(stagingBuffer, vertexBuffers[targetBuffer], bufferSize, device, commandPool, graphicsQueue);
-
-  vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+  // host visible already and no frame reads a new buffer yet, nothing to stage or submit
+  memcpy(vertexBufferMemory[targetBuffer].mapped, verts.data(), (size_t)bufferSize);
 }
 
 void BufferManager::freeVertexBuffer(int index, VkDevice device, VkQueue graphicsQueue)
@@ -312,10 +480,7 @@ void BufferManager::freeVertexBuffer(int index, VkDevice device, VkQueue graphic
     vkDestroyBuffer(device, vertexBuffers[index], nullptr);
   }
 
-  if (vertexBufferMemory[index] != VK_NULL_HANDLE)
-  {
-    vkFreeMemory(device, vertexBufferMemory[index], nullptr);
-  }
+  MemoryAllocator::get().free(vertexBufferMemory[index], device);
 
   vertexBuffers.erase(vertexBuffers.begin() + index);
   vertexBufferMemory.erase(vertexBufferMemory.begin() + index);
@@ -334,10 +499,7 @@ void BufferManager::freeIndexBuffer(int index, VkDevice device, VkQueue graphics
     vkDestroyBuffer(device, indexBuffers[index], nullptr);
   }
 
-  if (indexBufferMemory[index] != VK_NULL_HANDLE)
-  {
-    vkFreeMemory(device, indexBufferMemory[index], nullptr);
-  }
+  MemoryAllocator::get().free(indexBufferMemory[index], device);
 
   indexBuffers.erase(indexBuffers.begin() + index);
   indexBufferMemory.erase(indexBufferMemory.begin() + index);
@@ -356,14 +518,57 @@ void BufferManager::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceS
 
 void BufferManager::cleanup(VkDevice device)
 {
-  for (auto &uniformBuffer : uniformBuffers)
+  uploadManager.cleanup(device);
+  geometryArena.cleanup(device);
+  geometryLookup.clear();
+  sharedGeometry.clear();
+
+  for (size_t i = 0; i < instanceBuffers.size(); i++)
+  {
+    if (instanceBuffers[i] == VK_NULL_HANDLE)
+      continue;
+
+    vkDestroyBuffer(device, instanceBuffers[i], nullptr);
+    MemoryAllocator::get().free(instanceBuffersMemory[i], device);
+    instanceBuffers[i] = VK_NULL_HANDLE;
+    instanceCapacities[i] = 0;
+  }
+
+  for (GpuCullBuffers &buffers : gpuCullBuffers)
   {
-    vkDestroyBuffer(device, uniformBuffer, nullptr);
+    destroyMappedBuffer(buffers.instances, device);
+    destroyMappedBuffer(buffers.batches, device);
+    destroyMappedBuffer(buffers.commands, device);
+    destroyMappedBuffer(buffers.drawCount, device);
   }
+  destroyMappedBuffer(cullVisibility, device);
 
-  for (auto &uniformBufferMemory : uniformBuffersMemory)
+  for (size_t i = 0; i < materialBuffers.size(); i++)
   {
-    vkFreeMemory(device, uniformBufferMemory, nullptr);
+    if (materialBuffers[i] == VK_NULL_HANDLE)
+      continue;
+
+    vkDestroyBuffer(device, materialBuffers[i], nullptr);
+    MemoryAllocator::get().free(materialBuffersMemory[i], device);
+    materialBuffers[i] = VK_NULL_HANDLE;
+    materialCapacities[i] = 0;
+  }
+
+  for (size_t i = 0; i < globalUniformBuffers.size(); i++)
+  {
+    vkDestroyBuffer(device, globalUniformBuffers[i], nullptr);
+    MemoryAllocator::get().free(globalUniformBuffersMemory[i], device);
+  }
+
+  for (size_t i = 0; i < frameUniformBuffers.size(); i++)
+  {
+    if (frameUniformBuffers[i] == VK_NULL_HANDLE)
+      continue;
+
+    vkDestroyBuffer(device, frameUniformBuffers[i], nullptr);
+    MemoryAllocator::get().free(frameUniformBuffersMemory[i], device);
+    frameUniformBuffers[i] = VK_NULL_HANDLE;
+    frameUniformCapacities[i] = 0;
   }
 
   for (auto &indexBuffer : indexBuffers)
@@ -375,13 +580,7 @@ void BufferManager::cleanup(VkDevice device)
     }
   }
   for (auto &indexBufferMem : indexBufferMemory)
-  {
-    if (indexBufferMem != VK_NULL_HANDLE)
-    {
-      vkFreeMemory(device, indexBufferMem, nullptr);
-      indexBufferMem = VK_NULL_HANDLE;
-    }
-  }
+    MemoryAllocator::get().free(indexBufferMem, device);
 
   for (auto &vertexBuffer : vertexBuffers)
   {
@@ -392,27 +591,12 @@ void BufferManager::cleanup(VkDevice device)
     }
   }
   for (auto &vertexBufferMem : vertexBufferMemory)
-  {
-    if (vertexBufferMem != VK_NULL_HANDLE)
-    {
-      vkFreeMemory(device, vertexBufferMem, nullptr);
-      vertexBufferMem = VK_NULL_HANDLE;
-    }
-  }
+    MemoryAllocator::get().free(vertexBufferMem, device);
 }
 
-void BufferManager::updateUniformBuffer(uint32_t currentImage, glm::mat4 transformation, glm::mat4 view, glm::mat4 proj)
+void BufferManager::updateGlobalUniformBuffer(uint32_t currentImage, const GlobalUniformBufferObject &globals)
 {
-  UniformBufferObject ubo{};
-
-  ubo.model = transformation;
-  ubo.view = view;
-
-  ubo.proj = proj;
-
-  ubo.proj[1][1] *= -1;
-
-  memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+  memcpy(globalUniformBuffersMapped[currentImage], &globals, sizeof(globals));
 }
 
 void BufferManager::updateLightsUniformBuffer(uint32_t currentImage, const std::vector<Light> &lights, const glm::vec3 &cameraPos)
@@ -432,15 +616,6 @@ void BufferManager::updateLightsUniformBuffer(uint32_t currentImage, const std::
   memcpy(lightsUBOMapped[currentImage], &lightsUbo, sizeof(lightsUbo));
 }
 
-void BufferManager::updateAnimationUniformBuffer(uint32_t currentImage, std::array<glm::mat4, 100> &boneMatrices)
-{
-  AnimatedUniformBufferObject ubo{};
-
-  std::copy(boneMatrices.begin(), boneMatrices.end(), std::begin(ubo.boneMatrices));
-
-  memcpy(animatedUniformBuffersMapped.at(currentImage), &ubo, sizeof(ubo));
-}
-
 void BufferManager::updateComputeUniformBuffer(uint32_t currentImage, float deltaTime)
 {
   ComputeUniformBufferObject ubo{};
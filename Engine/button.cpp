@@ -23,13 +23,13 @@ void Button::initGraphics(Renderer &renderer, std::string texture)
   textureManager.createTextureImages(texture, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
   textureManager.createTextureImageView(renderer.deviceManager.device);
   textureManager.createTextureSampler(renderer.deviceManager.device, renderer.deviceManager.physicalDevice);
+  // UI elements don't check upload tickets when drawn
+  renderer.bufferManager.uploadManager.wait(textureManager.uploadTicket);
 
   renderer.bufferManager.createVertexBuffer(vertices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
 
-  renderer.bufferManager.createUniformBuffers(renderer.MAX_FRAMES_IN_FLIGHT, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, 1);
-
   TextureMaps textureMaps(textureManager.albedoImageView, textureManager.albedoSampler, textureManager.normalImageView, textureManager.normalSampler, textureManager.heightImageView, textureManager.heightSampler, textureManager.roughnessImageView, textureManager.roughnessSampler, textureManager.metallicImageView, textureManager.metallicSampler, textureManager.aoImageView, textureManager.aoSampler, textureManager.emissiveImageView, textureManager.emissiveSampler);
-  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, 1, textureMaps);
+  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, id, textureMaps);
 }
 
 void Button::initGraphics(Renderer &renderer)
@@ -37,16 +37,16 @@ void Button::initGraphics(Renderer &renderer)
   textureManager.createTextureImages(NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
   textureManager.createTextureImageView(renderer.deviceManager.device);
   textureManager.createTextureSampler(renderer.deviceManager.device, renderer.deviceManager.physicalDevice);
+  // UI elements don't check upload tickets when drawn
+  renderer.bufferManager.uploadManager.wait(textureManager.uploadTicket);
 
   renderer.bufferManager.createVertexBuffer(vertices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
 
-  renderer.bufferManager.createUniformBuffers(renderer.MAX_FRAMES_IN_FLIGHT, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, 1);
-
   TextureMaps textureMaps(textureManager.albedoImageView, textureManager.albedoSampler, textureManager.normalImageView, textureManager.normalSampler, textureManager.heightImageView, textureManager.heightSampler, textureManager.roughnessImageView, textureManager.roughnessSampler, textureManager.metallicImageView, textureManager.metallicSampler, textureManager.aoImageView, textureManager.aoSampler, textureManager.emissiveImageView, textureManager.emissiveSampler);
-  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, 1, textureMaps);
+  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, id, textureMaps);
 }
 
-void Button::draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, glm::mat4 view, glm::mat4 projectionMatrix, VkCommandBuffer commandBuffer)
+void Button::draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, VkCommandBuffer commandBuffer)
 {
   if (hide)
     return;
@@ -57,9 +57,9 @@ void Button::draw(Renderer *renderer, int currentFrame, glm::mat4 transformation
   VkDeviceSize offsets[] = {0};
   vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersArray, offsets);
 
-  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.pipelineLayout, 0, 1, &renderer->descriptorManager.descriptorSets[currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT], 0, nullptr);
-
-  renderer->bufferManager.updateUniformBuffer(currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT, newTransformation, view, projectionMatrix);
+  uint32_t dynamicOffset = renderer->bufferManager.pushObjectUniforms(currentFrame, newTransformation, CameraScreen);
+  VkDescriptorSet descriptorSets[] = {renderer->descriptorManager.descriptorSets[currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT], renderer->descriptorManager.frameDescriptorSets[currentFrame]};
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.pipelineLayout, 0, 2, descriptorSets, 1, &dynamicOffset);
 
   MaterialData materialData;
   materialData.albedoColor = currentColor;
@@ -69,7 +69,7 @@ void Button::draw(Renderer *renderer, int currentFrame, glm::mat4 transformation
 
   vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
 
-  buttonText->draw(renderer, currentFrame, transformation, view, projectionMatrix, commandBuffer);
+  buttonText->draw(renderer, currentFrame, transformation, commandBuffer);
 }
 
 void Button::updateState(float mouseX, float mouseY, bool mousePressed, ImVec2 sceneMin, ImVec2 sceneMax, float screenW, float screenH)
@@ -175,12 +175,6 @@ void Button::cleanup(VkDevice device, Renderer &renderer)
     renderer.bufferManager.vertexBuffers[id] = VK_NULL_HANDLE;
   }
 
-  for (int i = 0; i < renderer.MAX_FRAMES_IN_FLIGHT; i++)
-  {
-    vkDestroyBuffer(device, renderer.bufferManager.uniformBuffers[id * renderer.MAX_FRAMES_IN_FLIGHT + i], nullptr);
-    renderer.bufferManager.uniformBuffers[id * renderer.MAX_FRAMES_IN_FLIGHT + i] = VK_NULL_HANDLE;
-  }
-
   uint32_t descriptorSetCount = renderer.MAX_FRAMES_IN_FLIGHT;
   uint32_t startIndex = id * renderer.MAX_FRAMES_IN_FLIGHT;
   if (renderer.descriptorManager.descriptorSets.size() >= startIndex + descriptorSetCount)
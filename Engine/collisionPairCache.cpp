@@ -0,0 +1,107 @@
+#include "collisionPairCache.hpp"
+#include <algorithm>
+
+size_t CollisionPairCache::hash(uint64_t key)
+{
+  // splitmix64 finalizer, entity ids are sequential so they need mixing before masking
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  key ^= key >> 31;
+  return static_cast<size_t>(key);
+}
+
+CollisionPair *CollisionPairCache::find(Entity a, Entity b)
+{
+  uint64_t key = makeKey(a, b);
+  size_t mask = entries.size() - 1;
+
+  for (size_t i = hash(key) & mask;; i = (i + 1) & mask)
+  {
+    CollisionPair &slot = entries[i];
+    if (slot.slotState == CollisionPair::Empty)
+      return nullptr;
+    if (slot.slotState == CollisionPair::Occupied && slot.key == key)
+      return &slot;
+  }
+}
+
+CollisionPair &CollisionPairCache::findOrInsert(Entity a, Entity b)
+{
+  if ((count + removedCount + 1) * 10 > entries.size() * 7)
+    grow();
+
+  uint64_t key = makeKey(a, b);
+  size_t mask = entries.size() - 1;
+  CollisionPair *firstRemoved = nullptr;
+
+  for (size_t i = hash(key) & mask;; i = (i + 1) & mask)
+  {
+    CollisionPair &slot = entries[i];
+    if (slot.slotState == CollisionPair::Occupied && slot.key == key)
+      return slot;
+
+    if (slot.slotState == CollisionPair::Removed && firstRemoved == nullptr)
+      firstRemoved = &slot;
+
+    if (slot.slotState == CollisionPair::Empty)
+    {
+      CollisionPair *target = &slot;
+      if (firstRemoved != nullptr)
+      {
+        target = firstRemoved;
+        removedCount--;
+      }
+
+      *target = CollisionPair();
+      target->key = key;
+      target->slotState = CollisionPair::Occupied;
+      target->entityA = std::min(a, b);
+      target->entityB = std::max(a, b);
+      count++;
+      return *target;
+    }
+  }
+}
+
+void CollisionPairCache::erase(CollisionPair &pair)
+{
+  if (pair.slotState != CollisionPair::Occupied)
+    return;
+
+  pair.slotState = CollisionPair::Removed;
+  count--;
+  removedCount++;
+}
+
+void CollisionPairCache::clear()
+{
+  std::fill(entries.begin(), entries.end(), CollisionPair());
+  count = 0;
+  removedCount = 0;
+}
+
+void CollisionPairCache::grow()
+{
+  // rehashing also drops tombstones, so only double when the live pairs actually need the room
+  size_t newSize = entries.size();
+  while ((count + 1) * 2 > newSize)
+    newSize *= 2;
+
+  std::vector<CollisionPair> oldEntries = std::move(entries);
+  entries.assign(newSize, CollisionPair());
+  removedCount = 0;
+
+  size_t mask = newSize - 1;
+  for (const CollisionPair &pair : oldEntries)
+  {
+    if (pair.slotState != CollisionPair::Occupied)
+      continue;
+
+    size_t i = hash(pair.key) & mask;
+    while (entries[i].slotState != CollisionPair::Empty)
+      i = (i + 1) & mask;
+    entries[i] = pair;
+  }
+}
@@ -0,0 +1,278 @@
+#include "commandRecorder.hpp"
+#include "renderCommands.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+CommandRecorder::~CommandRecorder()
+{
+  stopWorkers();
+}
+
+void CommandRecorder::stopWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quitting = true;
+  }
+  workReady.notify_all();
+
+  for (std::thread &worker : workers)
+    worker.join();
+  workers.clear();
+}
+
+void CommandRecorder::init(VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, PFN_vkCmdSetPrimitiveTopology setPrimitiveTopology, PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable)
+{
+  this->device = device;
+
+  // the calling thread records too, so it takes one of the hardware threads
+  uint32_t workerCount = std::min(MAX_WORKERS, std::max(1u, std::thread::hardware_concurrency()) - 1);
+  contexts.resize(workerCount + 1);
+  for (ThreadContext &context : contexts)
+  {
+    // command pools are externally synchronized, every thread records from its own
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+
+    context.pools.resize(framesInFlight);
+    context.buffers.resize(framesInFlight);
+    for (VkCommandPool &pool : context.pools)
+    {
+      if (vkCreateCommandPool(device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+      {
+        throw std::runtime_error("failed to create secondary command pool!");
+      }
+    }
+    context.state.init(device, setPrimitiveTopology, setDepthWriteEnable);
+  }
+
+  workers.reserve(workerCount);
+  for (size_t i = 0; i < workerCount; i++)
+    workers.emplace_back(&CommandRecorder::workerLoop, this, i);
+}
+
+void CommandRecorder::beginFrame(VkDevice device, uint32_t frame)
+{
+  this->frame = frame;
+  // a whole pool is reset at once, the buffers in it are begun again instead of being freed
+  for (ThreadContext &context : contexts)
+  {
+    vkResetCommandPool(device, context.pools[frame], 0);
+    context.used = 0;
+    context.stats = CommandStateStats();
+  }
+  stats = CommandStateStats();
+}
+
+VkCommandBuffer CommandRecorder::acquireSecondary(ThreadContext &context)
+{
+  std::vector<VkCommandBuffer> &buffers = context.buffers[frame];
+  if (context.used < buffers.size())
+    return buffers[context.used++];
+
+  VkCommandBufferAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocInfo.commandPool = context.pools[frame];
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+  allocInfo.commandBufferCount = 1;
+
+  VkCommandBuffer commandBuffer;
+  if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to allocate secondary command buffer!");
+  }
+  buffers.push_back(commandBuffer);
+  context.used++;
+  return commandBuffer;
+}
+
+VkCommandBuffer CommandRecorder::beginSecondary(ThreadContext &context)
+{
+  VkCommandBuffer commandBuffer = acquireSecondary(context);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  beginInfo.pInheritanceInfo = jobInheritance;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to begin recording secondary command buffer!");
+  }
+
+  // nothing is inherited from the primary, every secondary binds its state again
+  context.state.begin(commandBuffer);
+  return commandBuffer;
+}
+
+void CommandRecorder::endSecondary(ThreadContext &context, VkCommandBuffer commandBuffer)
+{
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to record secondary command buffer!");
+  }
+  context.stats.add(context.state.stats);
+}
+
+void CommandRecorder::recordJob(ThreadContext &context, Job &job)
+{
+  job.commandBuffer = beginSecondary(context);
+  executeDrawPackets(jobRenderer, context.state, *jobList, jobStage, static_cast<int>(frame), job.first, job.last);
+  endSecondary(context, job.commandBuffer);
+}
+
+void CommandRecorder::drainJobs(ThreadContext &context)
+{
+  while (true)
+  {
+    size_t index = nextJob.fetch_add(1, std::memory_order_relaxed);
+    if (index >= jobs.size())
+      break;
+    if (jobs[index].parallel)
+      recordJob(context, jobs[index]);
+  }
+}
+
+void CommandRecorder::buildJobs(const DrawPacketList &list, RenderStage renderStage)
+{
+  jobs.clear();
+
+  uint32_t count = static_cast<uint32_t>(list.packets.size());
+  uint32_t gpuFirst = list.firstGpuBatch;
+  uint32_t gpuLast = list.firstGpuBatch + list.gpuBatchCount;
+
+  // the GPU batches are one indirect draw per shader permutation and one job, the remaining mesh packets are spread evenly over every thread
+  uint32_t meshPackets = 0;
+  for (const DrawPacket &packet : list.packets)
+    meshPackets += packet.pipeline() == PipelineMesh;
+  meshPackets -= list.gpuBatchCount;
+  uint32_t threadCount = static_cast<uint32_t>(contexts.size());
+  uint32_t chunk = std::max(MIN_PACKETS_PER_JOB, (meshPackets + threadCount - 1) / threadCount);
+
+  uint32_t first = 0;
+  while (first < count)
+  {
+    if (first == gpuFirst && gpuFirst < gpuLast)
+    {
+      jobs.push_back({gpuFirst, gpuLast, true, VK_NULL_HANDLE});
+      first = gpuLast;
+      continue;
+    }
+
+    // a run of packets that are either all static meshes or none, stopping where the GPU batches start
+    bool mesh = list.packets[first].pipeline() == PipelineMesh;
+    uint32_t last = first + 1;
+    while (last < count && (list.packets[last].pipeline() == PipelineMesh) == mesh && !(last == gpuFirst && gpuFirst < gpuLast))
+      last++;
+
+    if (!mesh)
+    {
+      // the ColorID stage only draws meshes
+      if (renderStage != ColorID)
+        jobs.push_back({first, last, false, VK_NULL_HANDLE});
+    }
+    else
+    {
+      for (uint32_t start = first; start < last; start += chunk)
+        jobs.push_back({start, std::min(start + chunk, last), true, VK_NULL_HANDLE});
+    }
+    first = last;
+  }
+}
+
+void CommandRecorder::record(Renderer *renderer, const DrawPacketList &list, RenderStage renderStage, VkCommandBuffer primary, const VkCommandBufferInheritanceInfo &inheritance,
+                             const std::function<void(CommandStateCache &)> &tail)
+{
+  buildJobs(list, renderStage);
+  jobRenderer = renderer;
+  jobList = &list;
+  jobStage = renderStage;
+  jobInheritance = &inheritance;
+  nextJob.store(0, std::memory_order_relaxed);
+
+  size_t parallelJobs = std::count_if(jobs.begin(), jobs.end(), [](const Job &job)
+                                      { return job.parallel; });
+  bool wakeWorkers = parallelJobs > 1 && !workers.empty();
+  if (wakeWorkers)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      activeWorkers = workers.size();
+      generation++;
+    }
+    workReady.notify_all();
+  }
+
+  // the calling thread records the packets that write shared frame buffers while the workers start on the meshes, then helps out
+  ThreadContext &context = contexts[0];
+  for (Job &job : jobs)
+    if (!job.parallel)
+      recordJob(context, job);
+  drainJobs(context);
+
+  if (wakeWorkers)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    workDone.wait(lock, [this]
+                  { return activeWorkers == 0; });
+  }
+
+  std::vector<VkCommandBuffer> secondaries;
+  secondaries.reserve(jobs.size() + 1);
+  for (const Job &job : jobs)
+    secondaries.push_back(job.commandBuffer);
+
+  if (tail)
+  {
+    VkCommandBuffer commandBuffer = beginSecondary(context);
+    tail(context.state);
+    endSecondary(context, commandBuffer);
+    secondaries.push_back(commandBuffer);
+  }
+
+  if (!secondaries.empty())
+    vkCmdExecuteCommands(primary, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+
+  stats = CommandStateStats();
+  for (const ThreadContext &threadContext : contexts)
+    stats.add(threadContext.stats);
+}
+
+void CommandRecorder::cleanup(VkDevice device)
+{
+  stopWorkers();
+
+  // destroying a pool frees the buffers allocated from it
+  for (ThreadContext &context : contexts)
+    for (VkCommandPool pool : context.pools)
+      vkDestroyCommandPool(device, pool, nullptr);
+  contexts.clear();
+}
+
+void CommandRecorder::workerLoop(size_t workerIndex)
+{
+  ThreadContext &context = contexts[workerIndex + 1];
+  uint64_t seenGeneration = 0;
+
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      workReady.wait(lock, [&]
+                     { return quitting || generation != seenGeneration; });
+      if (quitting)
+        return;
+      seenGeneration = generation;
+    }
+
+    drainJobs(context);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--activeWorkers == 0)
+        workDone.notify_one();
+    }
+  }
+}
@@ -0,0 +1,220 @@
+#include "commandStateCache.hpp"
+#include <iostream>
+#include <cstring>
+
+void CommandStateStats::add(const CommandStateStats &other)
+{
+  for (int kind = 0; kind < StateKindCount; kind++)
+  {
+    issued[kind] += other.issued[kind];
+    skipped[kind] += other.skipped[kind];
+  }
+}
+
+uint64_t CommandStateStats::totalIssued() const
+{
+  uint64_t total = 0;
+  for (uint64_t count : issued)
+    total += count;
+  return total;
+}
+
+uint64_t CommandStateStats::totalSkipped() const
+{
+  uint64_t total = 0;
+  for (uint64_t count : skipped)
+    total += count;
+  return total;
+}
+
+const char *CommandStateStats::kindName(CommandStateKind kind)
+{
+  switch (kind)
+  {
+  case StatePipeline:
+    return "Pipeline";
+  case StateDescriptorSets:
+    return "Descriptor Sets";
+  case StateVertexBuffer:
+    return "Vertex Buffer";
+  case StateIndexBuffer:
+    return "Index Buffer";
+  case StateTopology:
+    return "Topology";
+  case StateDepthWrite:
+    return "Depth Write";
+  case StateViewport:
+    return "Viewport";
+  case StateScissor:
+    return "Scissor";
+  default:
+    return "Unknown";
+  }
+}
+
+void CommandStateCache::init(VkDevice device, PFN_vkCmdSetPrimitiveTopology setPrimitiveTopology, PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable)
+{
+  cmdSetPrimitiveTopology = setPrimitiveTopology;
+  if (!cmdSetPrimitiveTopology)
+  {
+    cmdSetPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveTopologyEXT");
+    if (!cmdSetPrimitiveTopology)
+      std::cerr << "vkCmdSetPrimitiveTopology is not available and failed to load vkCmdSetPrimitiveTopologyEXT!" << std::endl;
+  }
+
+  cmdSetDepthWriteEnable = setDepthWriteEnable;
+  if (!cmdSetDepthWriteEnable)
+    std::cerr << "vkCmdSetDepthWriteEnableEXT is not available!" << std::endl;
+}
+
+void CommandStateCache::begin(VkCommandBuffer commandBuffer)
+{
+  this->commandBuffer = commandBuffer;
+  stats = CommandStateStats();
+  invalidate();
+}
+
+void CommandStateCache::invalidate()
+{
+  pipeline = VK_NULL_HANDLE;
+  topologyValid = false;
+  depthWriteValid = false;
+  viewportValid = false;
+  scissorValid = false;
+  invalidateBindings();
+}
+
+void CommandStateCache::invalidateBindings()
+{
+  descriptorLayout = VK_NULL_HANDLE;
+  descriptorSets.fill(VK_NULL_HANDLE);
+  dynamicSetCount = 0;
+  dynamicOffsetCount = 0;
+  vertexBuffers.fill(VK_NULL_HANDLE);
+  vertexOffsets.fill(0);
+  indexBuffer = VK_NULL_HANDLE;
+}
+
+void CommandStateCache::bindPipeline(VkPipeline newPipeline)
+{
+  if (skip(StatePipeline, pipeline == newPipeline))
+    return;
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, newPipeline);
+  pipeline = newPipeline;
+}
+
+void CommandStateCache::bindDescriptorSets(VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet *sets, uint32_t offsetCount, const uint32_t *offsets)
+{
+  bool redundant = layout == descriptorLayout && firstSet + setCount <= MAX_DESCRIPTOR_SETS;
+  for (uint32_t i = 0; redundant && i < setCount; i++)
+    redundant = descriptorSets[firstSet + i] == sets[i];
+
+  if (redundant && offsetCount > 0)
+  {
+    redundant = firstSet == dynamicFirstSet && setCount == dynamicSetCount && offsetCount == dynamicOffsetCount;
+    for (uint32_t i = 0; redundant && i < offsetCount; i++)
+      redundant = dynamicOffsets[i] == offsets[i];
+  }
+
+  if (skip(StateDescriptorSets, redundant))
+    return;
+
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, firstSet, setCount, sets, offsetCount, offsets);
+
+  // sets after the ones just bound might have been disturbed by a different layout, so forget them
+  if (layout != descriptorLayout)
+  {
+    descriptorSets.fill(VK_NULL_HANDLE);
+    dynamicSetCount = 0;
+    dynamicOffsetCount = 0;
+  }
+  descriptorLayout = layout;
+  for (uint32_t i = 0; i < setCount && firstSet + i < MAX_DESCRIPTOR_SETS; i++)
+    descriptorSets[firstSet + i] = sets[i];
+
+  if (offsetCount > 0)
+  {
+    // offsets that can't be remembered leave nothing to compare against, so the next call is issued
+    bool tracked = offsetCount <= MAX_DYNAMIC_OFFSETS;
+    dynamicFirstSet = firstSet;
+    dynamicSetCount = tracked ? setCount : 0;
+    dynamicOffsetCount = tracked ? offsetCount : 0;
+    for (uint32_t i = 0; tracked && i < offsetCount; i++)
+      dynamicOffsets[i] = offsets[i];
+  }
+}
+
+void CommandStateCache::bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset)
+{
+  bool tracked = binding < MAX_VERTEX_BINDINGS;
+  if (skip(StateVertexBuffer, tracked && vertexBuffers[binding] == buffer && vertexOffsets[binding] == offset))
+    return;
+
+  vkCmdBindVertexBuffers(commandBuffer, binding, 1, &buffer, &offset);
+  if (tracked)
+  {
+    vertexBuffers[binding] = buffer;
+    vertexOffsets[binding] = offset;
+  }
+}
+
+void CommandStateCache::bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset, VkIndexType type)
+{
+  if (skip(StateIndexBuffer, indexBuffer == buffer && indexOffset == offset && indexType == type))
+    return;
+
+  vkCmdBindIndexBuffer(commandBuffer, buffer, offset, type);
+  indexBuffer = buffer;
+  indexOffset = offset;
+  indexType = type;
+}
+
+void CommandStateCache::setPrimitiveTopology(VkPrimitiveTopology newTopology)
+{
+  if (skip(StateTopology, topologyValid && topology == newTopology) || !cmdSetPrimitiveTopology)
+    return;
+
+  cmdSetPrimitiveTopology(commandBuffer, newTopology);
+  topology = newTopology;
+  topologyValid = true;
+}
+
+void CommandStateCache::setDepthWriteEnable(bool enable)
+{
+  if (skip(StateDepthWrite, depthWriteValid && depthWrite == enable) || !cmdSetDepthWriteEnable)
+    return;
+
+  cmdSetDepthWriteEnable(commandBuffer, enable ? VK_TRUE : VK_FALSE);
+  depthWrite = enable;
+  depthWriteValid = true;
+}
+
+void CommandStateCache::setViewportScissor(VkExtent2D extent)
+{
+  VkViewport newViewport{};
+  newViewport.x = 0.0f;
+  newViewport.y = 0.0f;
+  newViewport.width = static_cast<float>(extent.width);
+  newViewport.height = static_cast<float>(extent.height);
+  newViewport.minDepth = 0.0f;
+  newViewport.maxDepth = 1.0f;
+
+  if (!skip(StateViewport, viewportValid && memcmp(&viewport, &newViewport, sizeof(VkViewport)) == 0))
+  {
+    vkCmdSetViewport(commandBuffer, 0, 1, &newViewport);
+    viewport = newViewport;
+    viewportValid = true;
+  }
+
+  VkRect2D newScissor{};
+  newScissor.offset = {0, 0};
+  newScissor.extent = extent;
+
+  if (!skip(StateScissor, scissorValid && scissor.extent.width == extent.width && scissor.extent.height == extent.height))
+  {
+    vkCmdSetScissor(commandBuffer, 0, 1, &newScissor);
+    scissor = newScissor;
+    scissorValid = true;
+  }
+}
@@ -1,72 +1,91 @@
 #include "debugDrawer.hpp"
 #include "renderer.hpp"
 #include <glm/glm.hpp>
-#include "mesh.hpp"
-#include <noImage.hpp>
+#include <cstring>
 
-void VulkanDebugDrawer::drawDebugLines(VkCommandBuffer commandBuffer, const std::vector<Vertex> &lines, glm::mat4 viewMatrix, glm::mat4 projectionMatrix, int currentFrame)
+VulkanDebugDrawer::VulkanDebugDrawer(Renderer &renderer, bool debug) : debugMode(debug ? 1 : 0), renderer(renderer)
 {
-  if (debugMode == 0)
-    return;
+  instanceBuffers.resize(renderer.MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+  instanceBuffersMemory.resize(renderer.MAX_FRAMES_IN_FLIGHT);
+  instanceBuffersMapped.resize(renderer.MAX_FRAMES_IN_FLIGHT, nullptr);
+  instanceCapacities.resize(renderer.MAX_FRAMES_IN_FLIGHT, 0);
 
-  if (lines.empty())
-    return;
+  for (int i = 0; i < renderer.MAX_FRAMES_IN_FLIGHT; i++)
+  {
+    reserveInstances(i, 1024);
+  }
+}
 
-  std::vector<Vertex> transformedLines;
+void VulkanDebugDrawer::reserveInstances(int frame, size_t count)
+{
+  if (count <= instanceCapacities[frame])
+    return;
 
-  for (int i = 0; i < lines.size(); i += 2)
+  VkDevice device = renderer.deviceManager.device;
+  if (instanceBuffers[frame] != VK_NULL_HANDLE)
   {
-    glm::vec3 fromVulkan = glm::vec3(-lines[i].pos.x, lines[i].pos.y, lines[i].pos.z);
-    glm::vec3 toVulkan = glm::vec3(-lines[i + 1].pos.x, lines[i + 1].pos.y, lines[i + 1].pos.z);
+    vkDestroyBuffer(device, instanceBuffers[frame], nullptr);
+    MemoryAllocator::get().free(instanceBuffersMemory[frame], device);
+  }
 
-    fromVulkan.x = -fromVulkan.x;
-    toVulkan.x = -toVulkan.x;
+  size_t capacity = std::max(count, instanceCapacities[frame] * 2);
+  VkDeviceSize size = sizeof(DebugInstance) * capacity;
 
-    fromVulkan = glm::vec3(viewMatrix * glm::vec4(fromVulkan, 1.0f));
-    toVulkan = glm::vec3(viewMatrix * glm::vec4(toVulkan, 1.0f));
+  renderer.bufferManager.createBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, instanceBuffers[frame], instanceBuffersMemory[frame], device, renderer.deviceManager.physicalDevice);
+  instanceBuffersMapped[frame] = instanceBuffersMemory[frame].mapped;
+  instanceCapacities[frame] = capacity;
+}
 
-    fromVulkan = glm::vec3(projectionMatrix * glm::vec4(fromVulkan, 1.0f));
-    toVulkan = glm::vec3(projectionMatrix * glm::vec4(toVulkan, 1.0f));
+void VulkanDebugDrawer::drawDebugGeometry(VkCommandBuffer commandBuffer, glm::mat4 viewMatrix, glm::mat4 projectionMatrix, int currentFrame)
+{
+  if (debugMode == 0)
+    return;
 
-    transformedLines.push_back(Vertex{fromVulkan, lines[i].color});
-    transformedLines.push_back(Vertex{toVulkan, lines[i + 1].color});
-  }
+  size_t total = lines.size() + boxes.size() + spheres.size();
+  if (total == 0)
+    return;
 
-  // renderer.bufferManager.freeVertexBuffer(buffersIndex, renderer.deviceManager.device);
-  renderer.bufferManager.createVertexBuffer(lines, buffersIndex, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
+  // lines, boxes then spheres back to back, each shape is one instanced draw over its range
+  reserveInstances(currentFrame, total);
+  DebugInstance *mapped = static_cast<DebugInstance *>(instanceBuffersMapped[currentFrame]);
+  memcpy(mapped, lines.data(), lines.size() * sizeof(DebugInstance));
+  memcpy(mapped + lines.size(), boxes.data(), boxes.size() * sizeof(DebugInstance));
+  memcpy(mapped + lines.size() + boxes.size(), spheres.data(), spheres.size() * sizeof(DebugInstance));
 
-  VkBuffer vertexBuffersArray[] = {renderer.bufferManager.vertexBuffers[buffersIndex]};
+  VkBuffer vertexBuffersArray[] = {instanceBuffers[currentFrame]};
   VkDeviceSize offsets[] = {0};
   vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersArray, offsets);
 
-  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer.pipelineManager.pipelineLayout, 0, 1, &renderer.descriptorManager.descriptorSets[currentFrame + buffersIndex * renderer.MAX_FRAMES_IN_FLIGHT], 0, nullptr);
+  projectionMatrix[1][1] *= -1;
 
-  renderer.bufferManager.updateUniformBuffer(currentFrame + buffersIndex * renderer.MAX_FRAMES_IN_FLIGHT, glm::mat4(1), viewMatrix, projectionMatrix);
+  DebugPushConstants pushConstants;
+  pushConstants.viewProj = projectionMatrix * viewMatrix;
 
-  MaterialData materialData;
-  materialData.albedoColor = glm::vec3(0);
-  materialData.hasAlbedoMap = false;
-  materialData.isParticle = false;
+  auto drawShape = [&](DebugShape shape, uint32_t vertexCount, size_t instanceCount, size_t firstInstance)
+  {
+    if (instanceCount == 0)
+      return;
 
-  vkCmdPushConstants(
-      commandBuffer,
-      renderer.pipelineManager.pipelineLayout,
-      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-      0,
-      sizeof(MaterialData),
-      &materialData);
+    pushConstants.shape = shape;
+    vkCmdPushConstants(commandBuffer, renderer.pipelineManager.debugPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DebugPushConstants), &pushConstants);
+    vkCmdDraw(commandBuffer, vertexCount, static_cast<uint32_t>(instanceCount), 0, static_cast<uint32_t>(firstInstance));
+  };
 
-  vkCmdDraw(commandBuffer, transformedLines.size(), 1, 0, 0);
+  drawShape(DebugLine, DEBUG_LINE_VERTICES, lines.size(), 0);
+  drawShape(DebugBox, DEBUG_BOX_VERTICES, boxes.size(), lines.size());
+  drawShape(DebugSphere, DEBUG_SPHERE_VERTICES, spheres.size(), lines.size() + boxes.size());
 }
-VulkanDebugDrawer::VulkanDebugDrawer(Renderer &renderer, int &buffersIndex, bool debug) : debugMode(debug ? 1 : 0), renderer(renderer), buffersIndex(buffersIndex), textureManager(renderer.bufferManager, renderer)
-{
-  textureManager.createTextureImages(NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
-  textureManager.createTextureImageView(renderer.deviceManager.device);
-  textureManager.createTextureSampler(renderer.deviceManager.device, renderer.deviceManager.physicalDevice);
 
-  renderer.bufferManager.createUniformBuffers(renderer.MAX_FRAMES_IN_FLIGHT, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, 1);
+void VulkanDebugDrawer::cleanup(VkDevice device)
+{
+  for (size_t i = 0; i < instanceBuffers.size(); i++)
+  {
+    if (instanceBuffers[i] == VK_NULL_HANDLE)
+      continue;
 
-  TextureMaps textureMaps(textureManager.albedoImageView, textureManager.albedoSampler, textureManager.normalImageView, textureManager.normalSampler, textureManager.heightImageView, textureManager.heightSampler, textureManager.roughnessImageView, textureManager.roughnessSampler, textureManager.metallicImageView, textureManager.metallicSampler, textureManager.aoImageView, textureManager.aoSampler, textureManager.emissiveImageView, textureManager.emissiveSampler);
-  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, 1, textureMaps);
-  buffersIndex++;
-}
\ No newline at end of file
+    vkDestroyBuffer(device, instanceBuffers[i], nullptr);
+    MemoryAllocator::get().free(instanceBuffersMemory[i], device);
+    instanceBuffers[i] = VK_NULL_HANDLE;
+    instanceCapacities[i] = 0;
+  }
+}
@@ -0,0 +1,262 @@
+#include "depthPyramid.hpp"
+#include "utils.h"
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+
+void DepthPyramid::create(VkExtent2D sceneExtent, VkRenderPass renderPass, VkDescriptorSetLayout setLayout, VkFormat depthFormat, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  destroyImages(device);
+  extent = sceneExtent;
+
+  createImage(extent.width, extent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory, device, physicalDevice);
+  depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, device);
+
+  VkFramebufferCreateInfo framebufferInfo{};
+  framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+  framebufferInfo.renderPass = renderPass;
+  framebufferInfo.attachmentCount = 1;
+  framebufferInfo.pAttachments = &depthImageView;
+  framebufferInfo.width = extent.width;
+  framebufferInfo.height = extent.height;
+  framebufferInfo.layers = 1;
+
+  if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create occlusion framebuffer!");
+  }
+
+  // halve until both sides are down to one texel
+  uint32_t width = std::max(extent.width / 2, 1u);
+  uint32_t height = std::max(extent.height / 2, 1u);
+  levelCount = 1;
+  while ((width > 1 || height > 1) && levelCount < MAX_LEVELS)
+  {
+    width = std::max(width / 2, 1u);
+    height = std::max(height / 2, 1u);
+    levelCount++;
+  }
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.extent.width = std::max(extent.width / 2, 1u);
+  imageInfo.extent.height = std::max(extent.height / 2, 1u);
+  imageInfo.extent.depth = 1;
+  imageInfo.mipLevels = levelCount;
+  imageInfo.arrayLayers = 1;
+  imageInfo.format = VK_FORMAT_R32_SFLOAT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateImage(device, &imageInfo, nullptr, &pyramidImage) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create depth pyramid image!");
+  }
+  MemoryAllocator::get().allocateImage(pyramidImage, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, pyramidMemory, device, physicalDevice);
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = pyramidImage;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = VK_FORMAT_R32_SFLOAT;
+  viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  viewInfo.subresourceRange.baseMipLevel = 0;
+  viewInfo.subresourceRange.levelCount = levelCount;
+  viewInfo.subresourceRange.baseArrayLayer = 0;
+  viewInfo.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(device, &viewInfo, nullptr, &pyramidView) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create depth pyramid image view!");
+  }
+
+  // storage images can only be written through single level views
+  levelViews.resize(levelCount);
+  viewInfo.subresourceRange.levelCount = 1;
+  for (uint32_t level = 0; level < levelCount; level++)
+  {
+    viewInfo.subresourceRange.baseMipLevel = level;
+    if (vkCreateImageView(device, &viewInfo, nullptr, &levelViews[level]) != VK_SUCCESS)
+    {
+      throw std::runtime_error("failed to create depth pyramid image view!");
+    }
+  }
+
+  if (sampler == VK_NULL_HANDLE)
+  {
+    // only read with texelFetch, filtering would mix depths
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = static_cast<float>(MAX_LEVELS);
+
+    if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+    {
+      throw std::runtime_error("failed to create depth pyramid sampler!");
+    }
+  }
+
+  // one set per level, reading the level above (the depth image for level 0) and writing the level itself
+  std::array<VkDescriptorPoolSize, 2> poolSizes{};
+  poolSizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSizes[0].descriptorCount = levelCount;
+  poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+  poolSizes[1].descriptorCount = levelCount;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  poolInfo.maxSets = levelCount;
+
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create depth pyramid descriptor pool!");
+  }
+
+  std::vector<VkDescriptorSetLayout> layouts(levelCount, setLayout);
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = descriptorPool;
+  allocInfo.descriptorSetCount = levelCount;
+  allocInfo.pSetLayouts = layouts.data();
+
+  levelSets.resize(levelCount);
+  if (vkAllocateDescriptorSets(device, &allocInfo, levelSets.data()) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to allocate depth pyramid descriptor sets!");
+  }
+
+  for (uint32_t level = 0; level < levelCount; level++)
+  {
+    VkDescriptorImageInfo sourceInfo{};
+    sourceInfo.sampler = sampler;
+    sourceInfo.imageView = level == 0 ? depthImageView : levelViews[level - 1];
+    sourceInfo.imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+    VkDescriptorImageInfo destinationInfo{};
+    destinationInfo.imageView = levelViews[level];
+    destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[0].dstSet = levelSets[level];
+    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstArrayElement = 0;
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    descriptorWrites[0].descriptorCount = 1;
+    descriptorWrites[0].pImageInfo = &sourceInfo;
+
+    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[1].dstSet = levelSets[level];
+    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].dstArrayElement = 0;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorWrites[1].descriptorCount = 1;
+    descriptorWrites[1].pImageInfo = &destinationInfo;
+
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+  }
+}
+
+void DepthPyramid::build(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkPipelineLayout pipelineLayout)
+{
+  // every level is rewritten, so the old contents can be dropped, which also orders this after last frame's reads
+  VkImageMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = pyramidImage;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.baseMipLevel = 0;
+  barrier.subresourceRange.levelCount = levelCount;
+  barrier.subresourceRange.baseArrayLayer = 0;
+  barrier.subresourceRange.layerCount = 1;
+
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+  DepthPyramidConstants constants{};
+  constants.sourceSize = glm::uvec2(extent.width, extent.height);
+  for (uint32_t level = 0; level < levelCount; level++)
+  {
+    constants.destinationSize = glm::max(constants.sourceSize / 2u, glm::uvec2(1));
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &levelSets[level], 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(DepthPyramidConstants), &constants);
+    vkCmdDispatch(commandBuffer, (constants.destinationSize.x + 7) / 8, (constants.destinationSize.y + 7) / 8, 1);
+
+    // the next level reads this one, the culling pass reads all of them
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barrier.subresourceRange.baseMipLevel = level;
+    barrier.subresourceRange.levelCount = 1;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    constants.sourceSize = constants.destinationSize;
+  }
+}
+
+void DepthPyramid::destroyImages(VkDevice device)
+{
+  if (descriptorPool != VK_NULL_HANDLE)
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+  descriptorPool = VK_NULL_HANDLE;
+  levelSets.clear();
+
+  for (VkImageView view : levelViews)
+    vkDestroyImageView(device, view, nullptr);
+  levelViews.clear();
+
+  if (pyramidImage != VK_NULL_HANDLE)
+  {
+    vkDestroyImageView(device, pyramidView, nullptr);
+    vkDestroyImage(device, pyramidImage, nullptr);
+    MemoryAllocator::get().free(pyramidMemory, device);
+    pyramidView = VK_NULL_HANDLE;
+    pyramidImage = VK_NULL_HANDLE;
+  }
+
+  if (depthImage != VK_NULL_HANDLE)
+  {
+    vkDestroyFramebuffer(device, framebuffer, nullptr);
+    vkDestroyImageView(device, depthImageView, nullptr);
+    vkDestroyImage(device, depthImage, nullptr);
+    MemoryAllocator::get().free(depthImageMemory, device);
+    framebuffer = VK_NULL_HANDLE;
+    depthImageView = VK_NULL_HANDLE;
+    depthImage = VK_NULL_HANDLE;
+  }
+
+  extent = {0, 0};
+  levelCount = 0;
+}
+
+void DepthPyramid::cleanup(VkDevice device)
+{
+  destroyImages(device);
+  if (sampler != VK_NULL_HANDLE)
+    vkDestroySampler(device, sampler, nullptr);
+  sampler = VK_NULL_HANDLE;
+}
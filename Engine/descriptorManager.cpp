@@ -4,15 +4,12 @@
 #include "utils.h"
 #include "bufferManager.hpp"
 #include "textureManager.hpp"
+#include <algorithm>
+#include <iostream>
+#include <string>
 
 void DescriptorManager::createDescriptorSetLayout(VkDevice device)
 {
-  VkDescriptorSetLayoutBinding uboLayoutBinding{};
-  uboLayoutBinding.binding = 0;
-  uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  uboLayoutBinding.descriptorCount = 1;
-  uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
   VkDescriptorSetLayoutBinding lightsUboLayoutBinding{};
   lightsUboLayoutBinding.binding = 1;
   lightsUboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
@@ -88,7 +85,7 @@ void DescriptorManager::createDescriptorSetLayout(VkDevice device)
   computeLayoutBinding2.pImmutableSamplers = nullptr;
   computeLayoutBinding2.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-  std::array<VkDescriptorSetLayoutBinding, 9> bindings = {uboLayoutBinding, lightsUboLayoutBinding, albedoSamplerLayoutBinding, normalSamplerLayoutBinding, heightSamplerLayoutBinding, roughnessSamplerLayoutBinding, metallicSamplerLayoutBinding, aoSamplerLayoutBinding, emissiveSamplerLayoutBinding};
+  std::array<VkDescriptorSetLayoutBinding, 8> bindings = {lightsUboLayoutBinding, albedoSamplerLayoutBinding, normalSamplerLayoutBinding, heightSamplerLayoutBinding, roughnessSamplerLayoutBinding, metallicSamplerLayoutBinding, aoSamplerLayoutBinding, emissiveSamplerLayoutBinding};
   VkDescriptorSetLayoutCreateInfo layoutInfo{};
   layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
   layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -112,7 +109,7 @@ void DescriptorManager::createDescriptorSetLayout(VkDevice device)
 
   VkDescriptorSetLayoutBinding animUboLayoutBinding{};
   animUboLayoutBinding.binding = 0;
-  animUboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  animUboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
   animUboLayoutBinding.descriptorCount = 1;
   animUboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
   animUboLayoutBinding.pImmutableSamplers = nullptr;
@@ -126,18 +123,111 @@ void DescriptorManager::createDescriptorSetLayout(VkDevice device)
   {
     throw std::runtime_error("failed to create animation descriptor set layout!");
   }
+
+  VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+  instanceLayoutBinding.binding = 0;
+  instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  instanceLayoutBinding.descriptorCount = 1;
+  instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  instanceLayoutBinding.pImmutableSamplers = nullptr;
+
+  VkDescriptorSetLayoutBinding objectLayoutBinding{};
+  objectLayoutBinding.binding = 1;
+  objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  objectLayoutBinding.descriptorCount = 1;
+  objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  objectLayoutBinding.pImmutableSamplers = nullptr;
+
+  VkDescriptorSetLayoutBinding globalLayoutBinding{};
+  globalLayoutBinding.binding = 2;
+  globalLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  globalLayoutBinding.descriptorCount = 1;
+  globalLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  globalLayoutBinding.pImmutableSamplers = nullptr;
+
+  VkDescriptorSetLayoutBinding materialLayoutBinding{};
+  materialLayoutBinding.binding = 3;
+  materialLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  materialLayoutBinding.descriptorCount = 1;
+  materialLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+  materialLayoutBinding.pImmutableSamplers = nullptr;
+
+  VkDescriptorSetLayoutBinding frameLightsLayoutBinding{};
+  frameLightsLayoutBinding.binding = 4;
+  frameLightsLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  frameLightsLayoutBinding.descriptorCount = 1;
+  frameLightsLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  frameLightsLayoutBinding.pImmutableSamplers = nullptr;
+
+  std::array<VkDescriptorSetLayoutBinding, 5> frameBindings = {instanceLayoutBinding, objectLayoutBinding, globalLayoutBinding, materialLayoutBinding, frameLightsLayoutBinding};
+  VkDescriptorSetLayoutCreateInfo frameLayoutInfo{};
+  frameLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  frameLayoutInfo.bindingCount = static_cast<uint32_t>(frameBindings.size());
+  frameLayoutInfo.pBindings = frameBindings.data();
+
+  if (vkCreateDescriptorSetLayout(device, &frameLayoutInfo, nullptr, &frameDescriptorSetLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create frame descriptor set layout!");
+  }
+
+  // shaders/cull.comp: cull input, batch draws, instance output, compacted draws, their counts, visibility and the depth pyramid
+  std::array<VkDescriptorSetLayoutBinding, 7> cullBindings{};
+  for (uint32_t i = 0; i < cullBindings.size(); i++)
+  {
+    cullBindings[i].binding = i;
+    cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    cullBindings[i].descriptorCount = 1;
+    cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    cullBindings[i].pImmutableSamplers = nullptr;
+  }
+  cullBindings[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+  VkDescriptorSetLayoutCreateInfo cullLayoutInfo{};
+  cullLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  cullLayoutInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+  cullLayoutInfo.pBindings = cullBindings.data();
+
+  if (vkCreateDescriptorSetLayout(device, &cullLayoutInfo, nullptr, &cullDescriptorSetLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create cull descriptor set layout!");
+  }
+
+  // shaders/depthPyramid.comp: the level above, sampled, and the level being written
+  std::array<VkDescriptorSetLayoutBinding, 2> pyramidBindings{};
+  for (uint32_t i = 0; i < pyramidBindings.size(); i++)
+  {
+    pyramidBindings[i].binding = i;
+    pyramidBindings[i].descriptorCount = 1;
+    pyramidBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pyramidBindings[i].pImmutableSamplers = nullptr;
+  }
+  pyramidBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pyramidBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+  VkDescriptorSetLayoutCreateInfo pyramidLayoutInfo{};
+  pyramidLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  pyramidLayoutInfo.bindingCount = static_cast<uint32_t>(pyramidBindings.size());
+  pyramidLayoutInfo.pBindings = pyramidBindings.data();
+
+  if (vkCreateDescriptorSetLayout(device, &pyramidLayoutInfo, nullptr, &depthPyramidDescriptorSetLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create depth pyramid descriptor set layout!");
+  }
 }
 
 void DescriptorManager::createDescriptorPool(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int count)
 {
 
-  std::array<VkDescriptorPoolSize, 3> poolSizes{};
+  std::array<VkDescriptorPoolSize, 4> poolSizes{};
   poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
   poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * count);
   poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
   poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT * count);
   poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
   poolSizes[2].descriptorCount = static_cast<uint32_t>(2 * MAX_FRAMES_IN_FLIGHT * count);
+  // object and bone uniforms in the frame and animation sets
+  poolSizes[3].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  poolSizes[3].descriptorCount = static_cast<uint32_t>(2 * MAX_FRAMES_IN_FLIGHT);
 
   VkDescriptorPoolCreateInfo poolInfo{};
   poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -169,11 +259,6 @@ void DescriptorManager::createDescriptorSets(VkDevice device, int MAX_FRAMES_IN_
 
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT * count; i++)
   {
-    VkDescriptorBufferInfo bufferInfo{};
-    bufferInfo.buffer = bufferManager.uniformBuffers[i];
-    bufferInfo.offset = 0;
-    bufferInfo.range = sizeof(UniformBufferObject);
-
     VkDescriptorBufferInfo lightsBufferInfo{};
     lightsBufferInfo.buffer = bufferManager.lightsUBO[i % MAX_FRAMES_IN_FLIGHT];
     lightsBufferInfo.offset = 0;
@@ -214,79 +299,71 @@ void DescriptorManager::createDescriptorSets(VkDevice device, int MAX_FRAMES_IN_
     emissiveInfo.imageView = textureMaps.emissiveImageView;
     emissiveInfo.sampler = textureMaps.emissiveSampler;
 
-    std::array<VkWriteDescriptorSet, 9> descriptorWrites{};
+    std::array<VkWriteDescriptorSet, 8> descriptorWrites{};
 
     descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[0].dstSet = descriptorSets[i];
-    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstBinding = 1;
     descriptorWrites[0].dstArrayElement = 0;
     descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     descriptorWrites[0].descriptorCount = 1;
-    descriptorWrites[0].pBufferInfo = &bufferInfo;
+    descriptorWrites[0].pBufferInfo = &lightsBufferInfo;
 
     descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[1].dstSet = descriptorSets[i];
-    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].dstBinding = 2;
     descriptorWrites[1].dstArrayElement = 0;
-    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[1].descriptorCount = 1;
-    descriptorWrites[1].pBufferInfo = &lightsBufferInfo;
+    descriptorWrites[1].pImageInfo = &albedoInfo;
 
     descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[2].dstSet = descriptorSets[i];
-    descriptorWrites[2].dstBinding = 2;
+    descriptorWrites[2].dstBinding = 3;
     descriptorWrites[2].dstArrayElement = 0;
     descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[2].descriptorCount = 1;
-    descriptorWrites[2].pImageInfo = &albedoInfo;
+    descriptorWrites[2].pImageInfo = &normalInfo;
 
     descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[3].dstSet = descriptorSets[i];
-    descriptorWrites[3].dstBinding = 3;
+    descriptorWrites[3].dstBinding = 4;
     descriptorWrites[3].dstArrayElement = 0;
     descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[3].descriptorCount = 1;
-    descriptorWrites[3].pImageInfo = &normalInfo;
+    descriptorWrites[3].pImageInfo = &heightInfo;
 
     descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[4].dstSet = descriptorSets[i];
-    descriptorWrites[4].dstBinding = 4;
+    descriptorWrites[4].dstBinding = 5;
     descriptorWrites[4].dstArrayElement = 0;
     descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[4].descriptorCount = 1;
-    descriptorWrites[4].pImageInfo = &heightInfo;
+    descriptorWrites[4].pImageInfo = &roughnessInfo;
 
     descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[5].dstSet = descriptorSets[i];
-    descriptorWrites[5].dstBinding = 5;
+    descriptorWrites[5].dstBinding = 6;
     descriptorWrites[5].dstArrayElement = 0;
     descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[5].descriptorCount = 1;
-    descriptorWrites[5].pImageInfo = &roughnessInfo;
+    descriptorWrites[5].pImageInfo = &metallicInfo;
 
     descriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[6].dstSet = descriptorSets[i];
-    descriptorWrites[6].dstBinding = 6;
+    descriptorWrites[6].dstBinding = 7;
     descriptorWrites[6].dstArrayElement = 0;
     descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[6].descriptorCount = 1;
-    descriptorWrites[6].pImageInfo = &metallicInfo;
+    descriptorWrites[6].pImageInfo = &aoInfo;
 
     descriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[7].dstSet = descriptorSets[i];
-    descriptorWrites[7].dstBinding = 7;
+    descriptorWrites[7].dstBinding = 8;
     descriptorWrites[7].dstArrayElement = 0;
     descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[7].descriptorCount = 1;
-    descriptorWrites[7].pImageInfo = &aoInfo;
-
-    descriptorWrites[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[8].dstSet = descriptorSets[i];
-    descriptorWrites[8].dstBinding = 8;
-    descriptorWrites[8].dstArrayElement = 0;
-    descriptorWrites[8].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrites[8].descriptorCount = 1;
-    descriptorWrites[8].pImageInfo = &emissiveInfo;
+    descriptorWrites[7].pImageInfo = &emissiveInfo;
 
     vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
   }
@@ -422,9 +499,9 @@ void DescriptorManager::addComputeDescriptorSets(VkDevice device, int MAX_FRAMES
   computeDescriptorSets.insert(computeDescriptorSets.end(), newComputeDescriptorSets.begin(), newComputeDescriptorSets.end());
 }
 
-void DescriptorManager::addDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int count, TextureMaps textureMaps)
+void DescriptorManager::addDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int id, TextureMaps textureMaps)
 {
-  std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT * count, descriptorSetLayout);
+  std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
   VkDescriptorSetAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
   allocInfo.descriptorPool = descriptorPool;
@@ -433,19 +510,13 @@ void DescriptorManager::addDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLI
 
   std::vector<VkDescriptorSet> newDescriptorSets;
   newDescriptorSets.resize(layouts.size());
-  size_t previousSetsSize = descriptorSets.size();
   if (vkAllocateDescriptorSets(device, &allocInfo, newDescriptorSets.data()) != VK_SUCCESS)
   {
-    throw std::runtime_error("failed to allocate added descriptor sets!");
+    throw std::runtime_error("failed to allocate added descriptor sets! More than " + std::to_string(MAX_DESCRIPTOR_SET_OBJECTS) + " animated, UI or particle objects?");
   }
 
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT * count; i++)
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
   {
-    VkDescriptorBufferInfo bufferInfo{};
-    bufferInfo.buffer = bufferManager.uniformBuffers[i + previousSetsSize];
-    bufferInfo.offset = 0;
-    bufferInfo.range = sizeof(UniformBufferObject);
-
     VkDescriptorBufferInfo lightsBufferInfo{};
     lightsBufferInfo.buffer = bufferManager.lightsUBO[i % MAX_FRAMES_IN_FLIGHT];
     lightsBufferInfo.offset = 0;
@@ -486,89 +557,86 @@ void DescriptorManager::addDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLI
     emissiveInfo.imageView = textureMaps.emissiveImageView;
     emissiveInfo.sampler = textureMaps.emissiveSampler;
 
-    std::array<VkWriteDescriptorSet, 9> descriptorWrites{};
+    std::array<VkWriteDescriptorSet, 8> descriptorWrites{};
 
     descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[0].dstSet = newDescriptorSets[i];
-    descriptorWrites[0].dstBinding = 0;
+    descriptorWrites[0].dstBinding = 1;
     descriptorWrites[0].dstArrayElement = 0;
     descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     descriptorWrites[0].descriptorCount = 1;
-    descriptorWrites[0].pBufferInfo = &bufferInfo;
+    descriptorWrites[0].pBufferInfo = &lightsBufferInfo;
 
     descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[1].dstSet = newDescriptorSets[i];
-    descriptorWrites[1].dstBinding = 1;
+    descriptorWrites[1].dstBinding = 2;
     descriptorWrites[1].dstArrayElement = 0;
-    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[1].descriptorCount = 1;
-    descriptorWrites[1].pBufferInfo = &lightsBufferInfo;
+    descriptorWrites[1].pImageInfo = &albedoInfo;
 
     descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[2].dstSet = newDescriptorSets[i];
-    descriptorWrites[2].dstBinding = 2;
+    descriptorWrites[2].dstBinding = 3;
     descriptorWrites[2].dstArrayElement = 0;
     descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[2].descriptorCount = 1;
-    descriptorWrites[2].pImageInfo = &albedoInfo;
+    descriptorWrites[2].pImageInfo = &normalInfo;
 
     descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[3].dstSet = newDescriptorSets[i];
-    descriptorWrites[3].dstBinding = 3;
+    descriptorWrites[3].dstBinding = 4;
     descriptorWrites[3].dstArrayElement = 0;
     descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[3].descriptorCount = 1;
-    descriptorWrites[3].pImageInfo = &normalInfo;
+    descriptorWrites[3].pImageInfo = &heightInfo;
 
     descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[4].dstSet = newDescriptorSets[i];
-    descriptorWrites[4].dstBinding = 4;
+    descriptorWrites[4].dstBinding = 5;
     descriptorWrites[4].dstArrayElement = 0;
     descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[4].descriptorCount = 1;
-    descriptorWrites[4].pImageInfo = &heightInfo;
+    descriptorWrites[4].pImageInfo = &roughnessInfo;
 
     descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[5].dstSet = newDescriptorSets[i];
-    descriptorWrites[5].dstBinding = 5;
+    descriptorWrites[5].dstBinding = 6;
     descriptorWrites[5].dstArrayElement = 0;
     descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[5].descriptorCount = 1;
-    descriptorWrites[5].pImageInfo = &roughnessInfo;
+    descriptorWrites[5].pImageInfo = &metallicInfo;
 
     descriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[6].dstSet = newDescriptorSets[i];
-    descriptorWrites[6].dstBinding = 6;
+    descriptorWrites[6].dstBinding = 7;
     descriptorWrites[6].dstArrayElement = 0;
     descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[6].descriptorCount = 1;
-    descriptorWrites[6].pImageInfo = &metallicInfo;
+    descriptorWrites[6].pImageInfo = &aoInfo;
 
     descriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[7].dstSet = newDescriptorSets[i];
-    descriptorWrites[7].dstBinding = 7;
+    descriptorWrites[7].dstBinding = 8;
     descriptorWrites[7].dstArrayElement = 0;
     descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     descriptorWrites[7].descriptorCount = 1;
-    descriptorWrites[7].pImageInfo = &aoInfo;
-
-    descriptorWrites[8].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[8].dstSet = newDescriptorSets[i];
-    descriptorWrites[8].dstBinding = 8;
-    descriptorWrites[8].dstArrayElement = 0;
-    descriptorWrites[8].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    descriptorWrites[8].descriptorCount = 1;
-    descriptorWrites[8].pImageInfo = &emissiveInfo;
+    descriptorWrites[7].pImageInfo = &emissiveInfo;
 
     vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
   }
-  descriptorSets.reserve(descriptorSets.size() + newDescriptorSets.size());
-  descriptorSets.insert(descriptorSets.end(), newDescriptorSets.begin(), newDescriptorSets.end());
+  // ids without sets of their own, like static meshes, leave null handles behind
+  size_t startIndex = static_cast<size_t>(id) * MAX_FRAMES_IN_FLIGHT;
+  if (descriptorSets.size() < startIndex + MAX_FRAMES_IN_FLIGHT)
+    descriptorSets.resize(startIndex + MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+  std::copy(newDescriptorSets.begin(), newDescriptorSets.end(), descriptorSets.begin() + startIndex);
 }
 
-void DescriptorManager::addAnimDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int count, int meshIdStart)
+void DescriptorManager::createFrameDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT)
 {
-  std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT * count, animDescriptorSetLayout);
+  std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, frameDescriptorSetLayout);
+  layouts.insert(layouts.end(), MAX_FRAMES_IN_FLIGHT, animDescriptorSetLayout);
+  layouts.insert(layouts.end(), MAX_FRAMES_IN_FLIGHT, cullDescriptorSetLayout);
 
   VkDescriptorSetAllocateInfo allocInfo{};
   allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -577,45 +645,381 @@ void DescriptorManager::addAnimDescriptorSets(VkDevice device, int MAX_FRAMES_IN
   allocInfo.pSetLayouts = layouts.data();
 
   std::vector<VkDescriptorSet> newDescriptorSets(layouts.size());
-
   if (vkAllocateDescriptorSets(device, &allocInfo, newDescriptorSets.data()) != VK_SUCCESS)
   {
-    throw std::runtime_error("failed to allocate animation descriptor sets!");
+    throw std::runtime_error("failed to allocate frame descriptor sets!");
+  }
+
+  frameDescriptorSets.assign(newDescriptorSets.begin(), newDescriptorSets.begin() + MAX_FRAMES_IN_FLIGHT);
+  animDescriptorSets.assign(newDescriptorSets.begin() + MAX_FRAMES_IN_FLIGHT, newDescriptorSets.begin() + 2 * MAX_FRAMES_IN_FLIGHT);
+  cullDescriptorSets.assign(newDescriptorSets.begin() + 2 * MAX_FRAMES_IN_FLIGHT, newDescriptorSets.end());
+
+  for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+  {
+    updateFrameDescriptorSets(device, frame);
+  }
+}
+
+void DescriptorManager::updateFrameDescriptorSets(VkDevice device, int frame)
+{
+  VkDescriptorBufferInfo instanceInfo{};
+  instanceInfo.buffer = bufferManager.instanceBuffers[frame];
+  instanceInfo.offset = 0;
+  instanceInfo.range = VK_WHOLE_SIZE;
+
+  VkDescriptorBufferInfo objectInfo{};
+  objectInfo.buffer = bufferManager.frameUniformBuffers[frame];
+  objectInfo.offset = 0;
+  objectInfo.range = sizeof(ObjectUniformBufferObject);
+
+  VkDescriptorBufferInfo globalInfo{};
+  globalInfo.buffer = bufferManager.globalUniformBuffers[frame];
+  globalInfo.offset = 0;
+  globalInfo.range = sizeof(GlobalUniformBufferObject);
+
+  VkDescriptorBufferInfo boneInfo{};
+  boneInfo.buffer = bufferManager.frameUniformBuffers[frame];
+  boneInfo.offset = 0;
+  boneInfo.range = sizeof(AnimatedUniformBufferObject);
+
+  VkDescriptorBufferInfo materialInfo{};
+  materialInfo.buffer = bufferManager.materialBuffers[frame];
+  materialInfo.offset = 0;
+  materialInfo.range = VK_WHOLE_SIZE;
+
+  VkDescriptorBufferInfo lightsInfo{};
+  lightsInfo.buffer = bufferManager.lightsUBO[frame];
+  lightsInfo.offset = 0;
+  lightsInfo.range = sizeof(LightsUBO);
+
+  std::array<VkWriteDescriptorSet, 6> descriptorWrites{};
+
+  descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[0].dstSet = frameDescriptorSets[frame];
+  descriptorWrites[0].dstBinding = 0;
+  descriptorWrites[0].dstArrayElement = 0;
+  descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptorWrites[0].descriptorCount = 1;
+  descriptorWrites[0].pBufferInfo = &instanceInfo;
+
+  descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[1].dstSet = frameDescriptorSets[frame];
+  descriptorWrites[1].dstBinding = 1;
+  descriptorWrites[1].dstArrayElement = 0;
+  descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  descriptorWrites[1].descriptorCount = 1;
+  descriptorWrites[1].pBufferInfo = &objectInfo;
+
+  descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[2].dstSet = frameDescriptorSets[frame];
+  descriptorWrites[2].dstBinding = 2;
+  descriptorWrites[2].dstArrayElement = 0;
+  descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  descriptorWrites[2].descriptorCount = 1;
+  descriptorWrites[2].pBufferInfo = &globalInfo;
+
+  descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[3].dstSet = animDescriptorSets[frame];
+  descriptorWrites[3].dstBinding = 0;
+  descriptorWrites[3].dstArrayElement = 0;
+  descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  descriptorWrites[3].descriptorCount = 1;
+  descriptorWrites[3].pBufferInfo = &boneInfo;
+
+  descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[4].dstSet = frameDescriptorSets[frame];
+  descriptorWrites[4].dstBinding = 3;
+  descriptorWrites[4].dstArrayElement = 0;
+  descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptorWrites[4].descriptorCount = 1;
+  descriptorWrites[4].pBufferInfo = &materialInfo;
+
+  descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrites[5].dstSet = frameDescriptorSets[frame];
+  descriptorWrites[5].dstBinding = 4;
+  descriptorWrites[5].dstArrayElement = 0;
+  descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  descriptorWrites[5].descriptorCount = 1;
+  descriptorWrites[5].pBufferInfo = &lightsInfo;
+
+  vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+  // the culling pass writes the visible instances straight into the instance buffer the mesh shaders read
+  const GpuCullBuffers &cullBuffers = bufferManager.gpuCullBuffers[frame];
+  std::array<VkDescriptorBufferInfo, 6> cullInfos{};
+  cullInfos[0].buffer = cullBuffers.instances.buffer;
+  cullInfos[1].buffer = cullBuffers.batches.buffer;
+  cullInfos[2].buffer = bufferManager.instanceBuffers[frame];
+  cullInfos[3].buffer = cullBuffers.commands.buffer;
+  cullInfos[4].buffer = cullBuffers.drawCount.buffer;
+  cullInfos[5].buffer = bufferManager.cullVisibility.buffer;
+
+  // the depth pyramid is written separately by updateCullPyramid
+  std::array<VkWriteDescriptorSet, 6> cullWrites{};
+  for (uint32_t i = 0; i < cullWrites.size(); i++)
+  {
+    cullInfos[i].offset = 0;
+    cullInfos[i].range = VK_WHOLE_SIZE;
+
+    cullWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    cullWrites[i].dstSet = cullDescriptorSets[frame];
+    cullWrites[i].dstBinding = i;
+    cullWrites[i].dstArrayElement = 0;
+    cullWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    cullWrites[i].descriptorCount = 1;
+    cullWrites[i].pBufferInfo = &cullInfos[i];
+  }
+
+  vkUpdateDescriptorSets(device, static_cast<uint32_t>(cullWrites.size()), cullWrites.data(), 0, nullptr);
+}
+
+void DescriptorManager::updateCullPyramid(VkDevice device, int frame, VkImageView pyramidView, VkSampler sampler)
+{
+  VkDescriptorImageInfo pyramidInfo{};
+  pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  pyramidInfo.imageView = pyramidView;
+  pyramidInfo.sampler = sampler;
+
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = cullDescriptorSets[frame];
+  descriptorWrite.dstBinding = 6;
+  descriptorWrite.dstArrayElement = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pImageInfo = &pyramidInfo;
+
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+void DescriptorManager::createBindlessDescriptors(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  VkPhysicalDeviceVulkan12Properties properties12{};
+  properties12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &properties12;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+  bindlessCapacity = std::min({MAX_BINDLESS_TEXTURES, properties12.maxDescriptorSetUpdateAfterBindSampledImages, properties12.maxDescriptorSetUpdateAfterBindSamplers,
+                               properties12.maxPerStageDescriptorUpdateAfterBindSampledImages, properties12.maxPerStageDescriptorUpdateAfterBindSamplers});
+
+  VkDescriptorSetLayoutBinding texturesLayoutBinding{};
+  texturesLayoutBinding.binding = 0;
+  texturesLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  texturesLayoutBinding.descriptorCount = bindlessCapacity;
+  texturesLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+  texturesLayoutBinding.pImmutableSamplers = nullptr;
+
+  // slots nobody uses are never written, and new textures are written while frames using other slots are in flight
+  VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                          VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT;
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+  bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  bindingFlagsInfo.bindingCount = 1;
+  bindingFlagsInfo.pBindingFlags = &bindingFlags;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &bindingFlagsInfo;
+  layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layoutInfo.bindingCount = 1;
+  layoutInfo.pBindings = &texturesLayoutBinding;
+
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &bindlessDescriptorSetLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create bindless descriptor set layout!");
   }
 
-  for (int objectIdx = 0; objectIdx < count; objectIdx++)
+  VkDescriptorPoolSize poolSize{};
+  poolSize.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  poolSize.descriptorCount = bindlessCapacity;
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  poolInfo.poolSizeCount = 1;
+  poolInfo.pPoolSizes = &poolSize;
+  poolInfo.maxSets = 1;
+
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &bindlessDescriptorPool) != VK_SUCCESS)
   {
-    for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
-    {
-      int globalIndex = (meshIdStart + objectIdx) * MAX_FRAMES_IN_FLIGHT + frame;
-      int localIndex = (objectIdx)*MAX_FRAMES_IN_FLIGHT + frame;
-
-      VkDescriptorBufferInfo bufferInfo{};
-      bufferInfo.buffer = bufferManager.animatedUniformBuffers[globalIndex];
-      bufferInfo.offset = 0;
-      bufferInfo.range = sizeof(AnimatedUniformBufferObject);
-
-      std::array<VkWriteDescriptorSet, 1> descriptorWrites{};
-
-      descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-      descriptorWrites[0].dstSet = newDescriptorSets[localIndex];
-      descriptorWrites[0].dstBinding = 0;
-      descriptorWrites[0].dstArrayElement = 0;
-      descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-      descriptorWrites[0].descriptorCount = 1;
-      descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-      vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-
-      int descriptorKey = (meshIdStart + objectIdx) * MAX_FRAMES_IN_FLIGHT + frame;
-      animDescriptorSets[descriptorKey] = newDescriptorSets[localIndex];
-    }
+    throw std::runtime_error("failed to create bindless descriptor pool!");
   }
+
+  VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{};
+  countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+  countInfo.descriptorSetCount = 1;
+  countInfo.pDescriptorCounts = &bindlessCapacity;
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.pNext = &countInfo;
+  allocInfo.descriptorPool = bindlessDescriptorPool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &bindlessDescriptorSetLayout;
+
+  if (vkAllocateDescriptorSets(device, &allocInfo, &bindlessDescriptorSet) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to allocate bindless descriptor set!");
+  }
+}
+
+uint32_t DescriptorManager::allocateBindlessElement()
+{
+  if (!freeBindlessIndices.empty())
+  {
+    uint32_t element = freeBindlessIndices.back();
+    freeBindlessIndices.pop_back();
+    return element;
+  }
+  if (bindlessCount < bindlessCapacity)
+    return bindlessCount++;
+
+  std::cerr << "bindless texture array is full!" << std::endl;
+  return UINT32_MAX;
+}
+
+void DescriptorManager::writeBindlessDescriptor(VkDevice device, uint32_t element, VkImageView imageView, VkSampler sampler)
+{
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  imageInfo.imageView = imageView;
+  imageInfo.sampler = sampler;
+
+  VkWriteDescriptorSet descriptorWrite{};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = bindlessDescriptorSet;
+  descriptorWrite.dstBinding = 0;
+  descriptorWrite.dstArrayElement = element;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pImageInfo = &imageInfo;
+
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+uint32_t DescriptorManager::acquireBindlessTexture(VkDevice device, VkImageView imageView, VkSampler sampler)
+{
+  auto it = bindlessLookup.find(imageView);
+  if (it != bindlessLookup.end())
+  {
+    it->second.users++;
+    return it->second.index;
+  }
+
+  uint32_t index = allocateBindlessElement();
+  if (index == UINT32_MAX)
+    return 0;
+
+  writeBindlessDescriptor(device, index, imageView, sampler);
+
+  if (bindlessElements.size() <= index)
+    bindlessElements.resize(index + 1);
+  bindlessElements[index] = index;
+  bindlessLookup[imageView] = {index, index, 1};
+  return index;
+}
+
+void DescriptorManager::releaseBindlessTexture(VkImageView imageView)
+{
+  auto it = bindlessLookup.find(imageView);
+  if (it == bindlessLookup.end() || --it->second.users > 0)
+    return;
+
+  // frames in flight may still sample the descriptors, they are handed out again framesInFlight frames from now
+  retiredElements.push_back({it->second.index, bindlessFrame});
+  if (it->second.element != it->second.index)
+    retiredElements.push_back({it->second.element, bindlessFrame});
+  bindlessLookup.erase(it);
+}
+
+void DescriptorManager::replaceBindlessTexture(VkDevice device, VkImageView oldView, VkImageView newView, VkSampler sampler)
+{
+  auto it = bindlessLookup.find(oldView);
+  if (it == bindlessLookup.end())
+    return;
+
+  uint32_t element = allocateBindlessElement();
+  if (element == UINT32_MAX)
+    return;
+  writeBindlessDescriptor(device, element, newView, sampler);
+
+  BindlessTexture texture = it->second;
+  // the slot's own element stays reserved, it is what the materials hold
+  if (texture.element != texture.index)
+    retiredElements.push_back({texture.element, bindlessFrame});
+  texture.element = element;
+  bindlessElements[texture.index] = element;
+
+  bindlessLookup.erase(it);
+  bindlessLookup[newView] = texture;
+}
+
+MaterialTextures DescriptorManager::resolveMaterialTextures(const MaterialTextures &textures) const
+{
+  auto resolve = [&](uint32_t index)
+  {
+    return index < bindlessElements.size() ? bindlessElements[index] : index;
+  };
+
+  MaterialTextures resolved;
+  resolved.albedo = resolve(textures.albedo);
+  resolved.normal = resolve(textures.normal);
+  resolved.height = resolve(textures.height);
+  resolved.roughness = resolve(textures.roughness);
+  resolved.metallic = resolve(textures.metallic);
+  resolved.ao = resolve(textures.ao);
+  resolved.emissive = resolve(textures.emissive);
+  return resolved;
+}
+
+void DescriptorManager::releaseRetiredBindless(uint32_t framesInFlight)
+{
+  bindlessFrame++;
+  auto it = std::remove_if(retiredElements.begin(), retiredElements.end(), [&](const RetiredElement &retired)
+                           {
+                             if (bindlessFrame - retired.frame < framesInFlight)
+                               return false;
+                             freeBindlessIndices.push_back(retired.element);
+                             return true; });
+  retiredElements.erase(it, retiredElements.end());
+}
+
+MaterialTextures DescriptorManager::acquireMaterialTextures(VkDevice device, const TextureManager &textureManager)
+{
+  MaterialTextures textures;
+  textures.albedo = acquireBindlessTexture(device, textureManager.albedoImageView, textureManager.albedoSampler);
+  textures.normal = acquireBindlessTexture(device, textureManager.normalImageView, textureManager.normalSampler);
+  textures.height = acquireBindlessTexture(device, textureManager.heightImageView, textureManager.heightSampler);
+  textures.roughness = acquireBindlessTexture(device, textureManager.roughnessImageView, textureManager.roughnessSampler);
+  textures.metallic = acquireBindlessTexture(device, textureManager.metallicImageView, textureManager.metallicSampler);
+  textures.ao = acquireBindlessTexture(device, textureManager.aoImageView, textureManager.aoSampler);
+  textures.emissive = acquireBindlessTexture(device, textureManager.emissiveImageView, textureManager.emissiveSampler);
+  return textures;
+}
+
+void DescriptorManager::releaseMaterialTextures(const TextureManager &textureManager)
+{
+  releaseBindlessTexture(textureManager.albedoImageView);
+  releaseBindlessTexture(textureManager.normalImageView);
+  releaseBindlessTexture(textureManager.heightImageView);
+  releaseBindlessTexture(textureManager.roughnessImageView);
+  releaseBindlessTexture(textureManager.metallicImageView);
+  releaseBindlessTexture(textureManager.aoImageView);
+  releaseBindlessTexture(textureManager.emissiveImageView);
 }
 
 void DescriptorManager::cleanup(VkDevice device)
 {
+  vkDestroyDescriptorPool(device, bindlessDescriptorPool, nullptr);
+  vkDestroyDescriptorSetLayout(device, bindlessDescriptorSetLayout, nullptr);
   vkDestroyDescriptorPool(device, descriptorPool, nullptr);
   vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
   vkDestroyDescriptorSetLayout(device, computeDescriptorSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, animDescriptorSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, frameDescriptorSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, cullDescriptorSetLayout, nullptr);
+  vkDestroyDescriptorSetLayout(device, depthPyramidDescriptorSetLayout, nullptr);
 }
\ No newline at end of file
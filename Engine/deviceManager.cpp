@@ -6,12 +6,12 @@
 #include <ostream>
 #include <iostream>
 
-void DeviceManager::createLogicalDevice(bool enableValidationLayers, const std::vector<const char *> &deviceExtensions, const std::vector<const char *> &validationLayers, VkQueue *presentQueue, VkQueue *graphicsQueue, VkQueue *computeQueue)
+void DeviceManager::createLogicalDevice(bool enableValidationLayers, const std::vector<const char *> &deviceExtensions, const std::vector<const char *> &validationLayers, VkQueue *presentQueue, VkQueue *graphicsQueue, VkQueue *computeQueue, VkQueue *transferQueue)
 {
   QueueFamilyIndices indices = findQueueFamilies(physicalDevice, swapchainManager.surface);
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(), indices.computeFamily.value()};
+  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value(), indices.computeFamily.value(), indices.transferFamily.value()};
 
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -35,9 +35,36 @@ void DeviceManager::createLogicalDevice(bool enableValidationLayers, const std::
   extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
   extendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;
 
+  // descriptor indexing for the bindless texture array
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.pNext = &extendedDynamicStateFeatures;
+  vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+  vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+  vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+  vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+  vulkan12Features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+  vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+  // uploads on the transfer queue signal one, frames wait on it
+  vulkan12Features.timelineSemaphore = VK_TRUE;
+
+  // optional, the GPU culling pass submits its draws with vkCmdDrawIndexedIndirectCount
+  VkPhysicalDeviceVulkan12Features supported12Features{};
+  supported12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  VkPhysicalDeviceFeatures2 supportedFeatures{};
+  supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  supportedFeatures.pNext = &supported12Features;
+  vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+  drawIndirectCountSupported = supported12Features.drawIndirectCount && supportedFeatures.features.multiDrawIndirect;
+  vulkan12Features.drawIndirectCount = drawIndirectCountSupported ? VK_TRUE : VK_FALSE;
+
   VkPhysicalDeviceFeatures deviceFeatures{};
   deviceFeatures.samplerAnisotropy = VK_TRUE;
   deviceFeatures.robustBufferAccess = VK_TRUE;
+  deviceFeatures.multiDrawIndirect = drawIndirectCountSupported ? VK_TRUE : VK_FALSE;
+  // optional, .dds and .ktx2 textures stay block compressed on the GPU
+  deviceFeatures.textureCompressionBC = supportedFeatures.features.textureCompressionBC;
+  compressedFormats = queryCompressedFormatSupport(physicalDevice, supportedFeatures.features.textureCompressionBC);
 
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -45,7 +72,7 @@ void DeviceManager::createLogicalDevice(bool enableValidationLayers, const std::
   createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
-  createInfo.pNext = &extendedDynamicStateFeatures;
+  createInfo.pNext = &vulkan12Features;
 
   createInfo.pEnabledFeatures = &deviceFeatures;
 
@@ -70,6 +97,7 @@ void DeviceManager::createLogicalDevice(bool enableValidationLayers, const std::
   vkGetDeviceQueue(device, indices.presentFamily.value(), 0, presentQueue);
   vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, graphicsQueue);
   vkGetDeviceQueue(device, indices.computeFamily.value(), 0, computeQueue);
+  vkGetDeviceQueue(device, indices.transferFamily.value(), 0, transferQueue);
 }
 
 void DeviceManager::pickPhysicalDevice(VkInstance instance, const std::vector<const char *> &deviceExtensions)
@@ -121,9 +149,13 @@ bool DeviceManager::isDeviceSuitable(VkPhysicalDevice device, const std::vector<
   VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extendedDynamicStateFeatures{};
   extendedDynamicStateFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
 
+  VkPhysicalDeviceVulkan12Features vulkan12Features{};
+  vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  vulkan12Features.pNext = &extendedDynamicStateFeatures;
+
   VkPhysicalDeviceFeatures2 deviceFeatures2{};
   deviceFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
-  deviceFeatures2.pNext = &extendedDynamicStateFeatures;
+  deviceFeatures2.pNext = &vulkan12Features;
 
   vkGetPhysicalDeviceFeatures2(device, &deviceFeatures2);
 
@@ -133,6 +165,14 @@ bool DeviceManager::isDeviceSuitable(VkPhysicalDevice device, const std::vector<
     return false;
   }
 
+  if (!vulkan12Features.shaderSampledImageArrayNonUniformIndexing || !vulkan12Features.descriptorBindingPartiallyBound ||
+      !vulkan12Features.descriptorBindingSampledImageUpdateAfterBind || !vulkan12Features.descriptorBindingUpdateUnusedWhilePending ||
+      !vulkan12Features.descriptorBindingVariableDescriptorCount || !vulkan12Features.runtimeDescriptorArray)
+  {
+    std::cerr << "Device does not support descriptor indexing!" << std::endl;
+    return false;
+  }
+
   return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy && supportedFeatures.robustBufferAccess;
 }
 
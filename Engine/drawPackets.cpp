@@ -0,0 +1,187 @@
+#include "drawPackets.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+// padding after the last field is never initialized, so only the fields take part in hashing and comparing
+static const size_t MATERIAL_BYTES = offsetof(MaterialData, isInstanced) + sizeof(int);
+
+void DrawPacketList::begin(const glm::mat4 &view, const glm::mat4 &proj, const glm::mat4 &ortho, const glm::vec3 &cameraPosition, float farPlane)
+{
+  clear();
+  this->view = view;
+  this->proj = proj;
+  this->ortho = ortho;
+  this->cameraPosition = cameraPosition;
+  this->farPlane = farPlane;
+}
+
+void DrawPacketList::clear()
+{
+  packets.clear();
+  transforms.clear();
+  materials.clear();
+  instances.clear();
+  cullInstances.clear();
+  gpuBatchCount = 0;
+  visibilitySlots = 0;
+  materialTextures.clear();
+  materialLookup.clear();
+}
+
+uint32_t DrawPacketList::addTransform(const glm::mat4 &transform)
+{
+  transforms.push_back(transform);
+  return static_cast<uint32_t>(transforms.size() - 1);
+}
+
+uint32_t DrawPacketList::addMaterial(const MaterialData &material, const MaterialTextures &textures)
+{
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  const unsigned char *bytes = reinterpret_cast<const unsigned char *>(&material);
+  for (size_t i = 0; i < MATERIAL_BYTES; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  bytes = reinterpret_cast<const unsigned char *>(&textures);
+  for (size_t i = 0; i < sizeof(MaterialTextures); i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+
+  auto it = materialLookup.find(hash);
+  if (it != materialLookup.end() && memcmp(&materials[it->second], &material, MATERIAL_BYTES) == 0 &&
+      memcmp(&materialTextures[it->second], &textures, sizeof(MaterialTextures)) == 0)
+    return it->second;
+
+  materials.push_back(material);
+  materialTextures.push_back(textures);
+  uint32_t index = static_cast<uint32_t>(materials.size() - 1);
+  if (it == materialLookup.end())
+    materialLookup.emplace(hash, index);
+  return index;
+}
+
+uint32_t DrawPacketList::quantizeDepth(const glm::vec3 &position, bool backToFront) const
+{
+  const uint32_t maxDepth = (1u << DRAW_KEY_DEPTH_BITS) - 1;
+  float normalized = std::clamp(glm::length(position - cameraPosition) / farPlane, 0.0f, 1.0f);
+  uint32_t depth = static_cast<uint32_t>(normalized * maxDepth);
+  return backToFront ? maxDepth - depth : depth;
+}
+
+void DrawPacketList::sort()
+{
+  size_t count = packets.size();
+  if (count < 2)
+    return;
+
+  sortScratch.resize(count);
+  DrawPacket *src = packets.data();
+  DrawPacket *dst = sortScratch.data();
+
+  for (uint32_t shift = 0; shift < 64; shift += 8)
+  {
+    size_t histogram[256] = {};
+    for (size_t i = 0; i < count; i++)
+      histogram[(src[i].key >> shift) & 0xFF]++;
+
+    // every key has the same byte here, most passes end up skipped since the fields are mostly small numbers
+    if (histogram[(src[0].key >> shift) & 0xFF] == count)
+      continue;
+
+    size_t offset = 0;
+    for (size_t &bucket : histogram)
+    {
+      size_t bucketCount = bucket;
+      bucket = offset;
+      offset += bucketCount;
+    }
+
+    for (size_t i = 0; i < count; i++)
+      dst[histogram[(src[i].key >> shift) & 0xFF]++] = src[i];
+
+    std::swap(src, dst);
+  }
+
+  if (src != packets.data())
+    packets.swap(sortScratch);
+}
+
+void DrawPacketList::buildInstances()
+{
+  instances.clear();
+  cullInstances.clear();
+  firstGpuBatch = 0;
+  gpuBatchCount = 0;
+  visibilitySlots = 0;
+
+  // packets kept in place are compacted to the front
+  size_t kept = 0;
+  for (size_t i = 0; i < packets.size(); i++)
+  {
+    DrawPacket packet = packets[i];
+    if (packet.pipeline() != PipelineMesh)
+    {
+      packets[kept++] = packet;
+      continue;
+    }
+
+    InstanceData instance{};
+    instance.model = transforms[packet.transformIndex];
+    instance.pickingId = packet.pickingId;
+    instance.materialIndex = static_cast<int32_t>(packet.materialIndex);
+
+    bool gpuCulled = gpuCulling && packet.layer() == LayerOpaque;
+    CullInstanceData cullInstance{};
+    if (gpuCulled)
+    {
+      const BoundingVolume &bounds = *static_cast<const BoundingVolume *>(packet.object);
+      cullInstance.instance = instance;
+      cullInstance.boundsCenter = glm::vec4(bounds.center(), bounds.radius);
+      cullInstance.boundsExtent = glm::vec4((bounds.max - bounds.min) * 0.5f, 0.0f);
+      // the instance's position changes with the sort every frame, its mesh's rendering id doesn't
+      cullInstance.visibilityIndex = static_cast<uint32_t>(packet.renderingId);
+      visibilitySlots = std::max(visibilitySlots, cullInstance.visibilityIndex + 1);
+    }
+
+    // opaque keys sort by permutation and mesh so a batch is always a run of neighbours
+    // transparent packets only sort by depth and merge only when they happen to be next to each other
+    if (kept > 0)
+    {
+      DrawPacket &previous = packets[kept - 1];
+      if (previous.pipeline() == PipelineMesh && previous.layer() == packet.layer() && previous.permutation() == packet.permutation() &&
+          previous.geometryId == packet.geometryId && previous.firstIndex == packet.firstIndex && previous.indexCount == packet.indexCount)
+      {
+        instances.push_back(instance);
+        previous.instanceCount++;
+        if (gpuCulled)
+        {
+          cullInstance.batch = static_cast<uint32_t>(kept - 1) - firstGpuBatch;
+          cullInstances.push_back(cullInstance);
+        }
+        continue;
+      }
+    }
+
+    packet.firstInstance = static_cast<uint32_t>(instances.size());
+    packet.instanceCount = 1;
+    instances.push_back(instance);
+
+    // opaque mesh packets sort before everything else, so the batches are one contiguous run
+    if (gpuCulled)
+    {
+      if (gpuBatchCount == 0)
+        firstGpuBatch = static_cast<uint32_t>(kept);
+      cullInstance.batch = gpuBatchCount++;
+      cullInstances.push_back(cullInstance);
+    }
+
+    packets[kept++] = packet;
+  }
+
+  packets.resize(kept);
+}
@@ -17,6 +17,8 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <noImage.hpp>
 #include <utils.h>
+#include <chrono>
+#include <thread>
 
 void Engine::initWindow(std::string windowName)
 {
@@ -61,11 +63,32 @@ void Engine::init(std::string windowName, std::function<void(Engine *)> startFn,
     renderer.engineUI.renderToViewport = debugMode == DebugMode::Viewport ? true : false;
     renderer.engineUI.initImGui(&renderer);
   }
-  physics.debugDrawer = new VulkanDebugDrawer(renderer, nextRenderingId, true);
+  physics.debugDrawer = new VulkanDebugDrawer(renderer, true);
+}
+
+void Engine::initHeadless(std::function<void(Engine *)> startFn, std::function<void(Engine *, float)> updateFn, HeadlessSettings settings)
+{
+  headless = true;
+  headlessSettings = settings;
+  debugMode = DebugMode::Inactive;
+  renderer.debugMode = &debugMode;
+  start = std::move(startFn);
+  update = std::move(updateFn);
+}
+
+void Engine::stop()
+{
+  isRunning = false;
 }
 
 void Engine::run()
 {
+  if (headless)
+  {
+    runHeadless();
+    return;
+  }
+
   float lastFrame = 0.0f;
   float deltaTime = 0.0f;
   glfwSetTime(0);
@@ -101,11 +124,10 @@ void Engine::run()
       }
     }
 
-    updateBoxColliders();
-
-    physics.debugDrawer->clearLines();
+    physics.debugDrawer->clear();
 
-    physics.update(deltaTime);
+    world.step(deltaTime);
+    tickCount++;
     render();
 
     glfwPollEvents();
@@ -113,26 +135,34 @@ void Engine::run()
   vkDeviceWaitIdle(renderer.deviceManager.device);
 }
 
-void Engine::updateBoxColliders()
+void Engine::runHeadless()
 {
-  for (auto &box : registry.boxColliders)
+  start(this);
+
+  const float deltaTime = headlessSettings.fixedDeltaTime;
+  const bool throttled = headlessSettings.tickRate > 0.0f;
+  const auto tickInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(throttled ? 1.0 / headlessSettings.tickRate : 0.0));
+  auto nextTick = std::chrono::steady_clock::now();
+
+  // same order as the windowed loop minus input, UI and rendering
+  while (isRunning && (headlessSettings.maxTicks == 0 || tickCount < headlessSettings.maxTicks))
   {
-    if (!box.second.autoUpdate)
-    {
-      continue;
-    }
-    const TransformComponent &transform = getConstTransformComponent(box.first);
-    if (transform.justUpdated)
+    update(this, deltaTime);
+    world.step(deltaTime);
+    tickCount++;
+
+    if (throttled)
     {
-      box.second.updateWorldAABB(transform.position, transform.rotationZYX, transform.scale);
-      transformComponentDisableJustUpdated(box.first);
+      nextTick += tickInterval;
+      std::this_thread::sleep_until(nextTick);
     }
   }
 }
 
 void Engine::clearHierarchy()
 {
-  vkQueueWaitIdle(renderer.graphicsQueue);
+  if (!headless)
+    vkQueueWaitIdle(renderer.graphicsQueue);
 
   registry.meshes.clear();
   registry.transforms.clear();
@@ -153,16 +183,25 @@ void Engine::clearHierarchy()
 
 void Engine::addTextElement(const std::string &name, glm::vec3 position, std::string text)
 {
+  if (headless)
+    return;
+
   UIElements.emplace(name, std::make_unique<Text>(renderer, &nextRenderingId, text, position));
 }
 
 void Engine::addSquareElement(const std::string &name, glm::vec3 position, glm::vec3 color, std::array<glm::vec2, 2> verticesOffsets, std::array<glm::vec2, 2> uvCoords, std::string texture)
 {
+  if (headless)
+    return;
+
   UIElements.emplace(name, std::make_unique<Square>(renderer, &nextRenderingId, position, verticesOffsets, uvCoords, color, texture));
 }
 
 void Engine::addButtonElement(const std::string &name, glm::vec3 position, std::string text, std::array<glm::vec2, 2> verticesOffsets, glm::vec3 color, glm::vec3 colorHovered, glm::vec3 colorPressed, std::string texture, std::function<void(void)> callback)
 {
+  if (headless)
+    return;
+
   auto btn = std::make_unique<Button>(renderer, &nextRenderingId, text, position, verticesOffsets, texture);
   btn->normalColor = color;
   btn->hoverColor = colorHovered;
@@ -174,13 +213,18 @@ void Engine::addButtonElement(const std::string &name, glm::vec3 position, std::
 void Engine::shutdown()
 {
   clearHierarchy();
-  renderer.renderQueue.clear();
+  if (headless)
+    return;
+
+  renderer.drawPackets.clear();
+  physics.debugDrawer->cleanup(renderer.deviceManager.device);
   renderer.cleanup();
 }
 
 void Engine::render()
 {
-  renderer.renderQueue.clear();
+  if (headless)
+    return;
 
   std::vector<Light> lights;
   for (auto &[e, lightComp] : registry.pointLights)
@@ -194,32 +238,41 @@ void Engine::render()
   renderer.bufferManager.updateLightsUniformBuffer(renderer.getCurrentFrame(), lights, camera.Position);
 
   glm::mat4 view = camera.getViewMatrix();
-  glm::mat4 proj = glm::perspective(glm::radians(camera.Zoom), (float)WIDTH / HEIGHT, 0.1f, 10000.0f);
+  const float farPlane = 10000.0f;
+  glm::mat4 proj = glm::perspective(glm::radians(camera.Zoom), (float)WIDTH / HEIGHT, 0.1f, farPlane);
   glm::mat4 ortho = glm::ortho(0.0f, (float)WIDTH, 0.0f, (float)HEIGHT, 0.05f, 10.0f);
 
-  for (auto &[e, _] : registry.meshes)
-  {
-    renderer.renderQueue.push_back(makeGameObjectCommand(registry, e, &renderer, renderer.getCurrentFrame(), view, proj, debugMode));
-  }
+  DrawPacketList &packets = renderer.drawPackets;
+  packets.begin(view, proj, ortho, camera.Position, farPlane);
+  packets.gpuCulling = renderer.gpuCulling && renderer.deviceManager.drawIndirectCountSupported;
+  // proj[1][1] is the cotangent of half the vertical field of view
+  packets.pixelScale = 0.5f * proj[1][1] * HEIGHT;
+  packets.lodScale = renderer.meshLods ? packets.pixelScale : 0.0f;
+  packets.lodPixelError = renderer.lodPixelError;
+  packets.uploadsCompleted = renderer.bufferManager.uploadManager.completedValue();
+
+  pushGameObjectPackets(packets, registry, renderer.frustumCuller);
 
   for (auto &[e, _] : registry.animatedMeshes)
   {
-    renderer.renderQueue.push_back(makeAnimatedGameObjectCommand(registry, e, &renderer, renderer.getCurrentFrame(), view, proj, debugMode));
+    pushAnimatedGameObjectPackets(packets, registry, e);
   }
 
   for (auto &[_, element] : UIElements)
   {
     glm::mat4 model = glm::translate(glm::mat4(1.0f), element->position);
-    renderer.renderQueue.push_back(makeUICommand(element.get(), &renderer, renderer.getCurrentFrame(), model, ortho, debugMode));
+    pushUIPacket(packets, element.get(), model);
   }
 
   for (ParticleEmitter &emitter : particleEmitters)
   {
     if (!emitter.hide)
-      renderer.renderQueue.push_back(makeParticleCommand(&emitter, &renderer, renderer.getCurrentFrame(), view, proj, debugMode));
+      pushParticlePacket(packets, &emitter);
   }
 
-  renderer.renderQueue.push_back(makeDebugCommand(physics.debugDrawer, &renderer, physics.debugDrawer->debugLines, view, proj, renderer.getCurrentFrame(), debugMode));
+  pushDebugPacket(packets, physics.debugDrawer);
+  packets.sort();
+  packets.buildInstances();
 
   if (debugMode != DebugMode::Inactive)
     renderer.engineUI.renderImGUI(this, &renderer);
@@ -231,8 +284,6 @@ void Engine::updateFreeCam(float dt)
 {
   float moveSpeed = 15.0f;
   const float mouseSensitivity = 0.1f;
-  static bool firstMouse = true;
-  static double lastX = 0.0, lastY = 0.0;
   if (input.keys[GLFW_KEY_LEFT_SHIFT])
     moveSpeed *= 2;
 
@@ -252,34 +303,33 @@ void Engine::updateFreeCam(float dt)
   if (input.mouseButtons[GLFW_MOUSE_BUTTON_RIGHT])
   {
     disableCursor();
-    if (firstMouse)
+    if (freeCamFirstMouse)
     {
-      lastX = input.mouseX;
-      lastY = input.mouseY;
-      firstMouse = false;
+      freeCamLastX = input.mouseX;
+      freeCamLastY = input.mouseY;
+      freeCamFirstMouse = false;
     }
 
-    float xoffset = static_cast<float>(input.mouseX - lastX);
-    float yoffset = static_cast<float>(lastY - input.mouseY);
+    float xoffset = static_cast<float>(input.mouseX - freeCamLastX);
+    float yoffset = static_cast<float>(freeCamLastY - input.mouseY);
 
-    lastX = input.mouseX;
-    lastY = input.mouseY;
+    freeCamLastX = input.mouseX;
+    freeCamLastY = input.mouseY;
 
     rotateCamera(xoffset * mouseSensitivity, yoffset * mouseSensitivity);
   }
   else
   {
     enableCursor();
-    firstMouse = true;
+    freeCamFirstMouse = true;
   }
 
-  static float zoom = 45.0f;
-  zoom -= input.scrollOffsetY;
-  if (zoom < 1.0f)
-    zoom = 1.0f;
-  if (zoom > 90.0f)
-    zoom = 90.0f;
-  setCameraZoom(zoom);
+  freeCamZoom -= input.scrollOffsetY;
+  if (freeCamZoom < 1.0f)
+    freeCamZoom = 1.0f;
+  if (freeCamZoom > 90.0f)
+    freeCamZoom = 90.0f;
+  setCameraZoom(freeCamZoom);
 
   input.scrollOffsetX = 0.0;
   input.scrollOffsetY = 0.0;
@@ -291,7 +341,16 @@ void Engine::loadMaterialAsset(std::string assetName, std::string texturePath, s
     return;
 
   std::shared_ptr<TextureManager> textureManager = std::make_shared<TextureManager>(renderer.bufferManager, renderer);
-  textureManager->createTextureImages(texturePath, normalPath, heightPath, roughnessPath, metallicPath, aoPath, emissivePath, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
+  if (headless)
+  {
+    preloadedTextures.emplace(assetName, textureManager);
+    return;
+  }
+
+  if (renderer.textureStreaming)
+    textureManager->streamTextureImages(texturePath, normalPath, heightPath, roughnessPath, metallicPath, aoPath, emissivePath, renderer.deviceManager.device, renderer.deviceManager.physicalDevice);
+  else
+    textureManager->createTextureImages(texturePath, normalPath, heightPath, roughnessPath, metallicPath, aoPath, emissivePath, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
   textureManager->createTextureImageView(renderer.deviceManager.device);
   textureManager->createTextureSampler(renderer.deviceManager.device, renderer.deviceManager.physicalDevice);
   preloadedTextures.emplace(assetName, textureManager);
@@ -307,7 +366,8 @@ void Engine::removeEntity(Entity entity)
 
     for (auto &mesh : meshComp.meshes)
     {
-      mesh.cleanup(renderer.deviceManager.device, renderer);
+      if (!headless)
+        mesh.cleanup(renderer.deviceManager.device, renderer);
     }
 
     registry.animatedMeshes.erase(entity);
@@ -413,7 +473,11 @@ void Engine::addMeshComponent(Entity entity, MaterialData material, const std::s
     return;
 
   Mesh mesh(renderer, &nextRenderingId, material, vertices, indices);
-  mesh.initGraphics(renderer, texturePath.empty() ? NO_IMAGE : texturePath);
+  mesh.buildLods();
+  if (headless)
+    mesh.texPath = texturePath.empty() ? NO_IMAGE : texturePath;
+  else
+    mesh.initGraphics(renderer, texturePath.empty() ? NO_IMAGE : texturePath);
 
   MeshComponent meshComp;
   meshComp.loadedFromFile = false;
@@ -421,7 +485,7 @@ void Engine::addMeshComponent(Entity entity, MaterialData material, const std::s
   registry.meshes.emplace(entity, std::move(meshComp));
 }
 
-void Engine::addMeshToComponent(Entity entity, MaterialData material, const std::string &texturePath, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices)
+void Engine::addMeshToComponent(Entity entity, MaterialData material, const std::string &texturePath, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const MeshLodChain *lods)
 {
   if (registry.meshes.find(entity) == registry.meshes.end())
     return;
@@ -431,7 +495,14 @@ void Engine::addMeshToComponent(Entity entity, MaterialData material, const std:
     return;
 
   Mesh mesh(renderer, &nextRenderingId, material, vertices, indices);
-  mesh.initGraphics(renderer, texturePath.empty() ? NO_IMAGE : texturePath);
+  if (lods)
+    mesh.setLods(*lods);
+  else
+    mesh.buildLods();
+  if (headless)
+    mesh.texPath = texturePath.empty() ? NO_IMAGE : texturePath;
+  else
+    mesh.initGraphics(renderer, texturePath.empty() ? NO_IMAGE : texturePath);
   meshComp.meshes.emplace_back(std::move(mesh));
 }
 
@@ -445,7 +516,9 @@ void Engine::addMeshToComponent(Entity entity, std::string textureAssetName, Mat
     return;
 
   Mesh mesh(renderer, preloadedTextures.at(textureAssetName), &nextRenderingId, material, vertices, indices);
-  mesh.initGraphics(renderer);
+  mesh.buildLods();
+  if (!headless)
+    mesh.initGraphics(renderer);
   meshComp.meshes.emplace_back(std::move(mesh));
 }
 
@@ -457,7 +530,10 @@ void Engine::addAnimatedMeshToComponent(Entity entity, MaterialData material, co
   AnimatedMeshComponent &meshComp = registry.animatedMeshes.at(entity);
 
   AnimatedMesh mesh(renderer, &nextRenderingId, material, vertices, indices);
-  mesh.initGraphics(renderer, texturePath.empty() ? NO_IMAGE : texturePath);
+  if (headless)
+    mesh.texPath = texturePath.empty() ? NO_IMAGE : texturePath;
+  else
+    mesh.initGraphics(renderer, texturePath.empty() ? NO_IMAGE : texturePath);
   meshComp.meshes.emplace_back(std::move(mesh));
 }
 
@@ -504,6 +580,8 @@ void Engine::createAnimatedModelFromFile(std::string baseName, std::string path,
 
   int i = 0;
 
+  // every node's buffers and textures go to the transfer queue in one submit
+  UploadBatch uploadBatch(renderer.bufferManager.uploadManager);
   Entity baseEntity = createEmptyGameObject(baseName);
 
   for (const auto &node : model.nodes)
@@ -852,7 +930,7 @@ void Engine::createAnimatedModelFromFile(std::string baseName, std::string path,
   }
 }
 
-void Engine::addMeshComponent(Entity entity, const std::string objPath, const std::string mtlPath)
+void Engine::addMeshComponent(Entity entity, const std::string objPath, const std::string mtlPath, const std::vector<MeshLodChain> *cookedLods)
 {
   if (registry.meshes.find(entity) != registry.meshes.end())
     return;
@@ -879,6 +957,8 @@ void Engine::addMeshComponent(Entity entity, const std::string objPath, const st
     throw std::runtime_error("Failed to load OBJ: " + err);
   }
 
+  // every shape's geometry and textures go to the transfer queue in one submit
+  UploadBatch uploadBatch(renderer.bufferManager.uploadManager);
   for (const auto &shape : shapes)
   {
     std::vector<Vertex> meshVertices;
@@ -1001,6 +1081,19 @@ void Engine::addMeshComponent(Entity entity, const std::string objPath, const st
     }
 
     Mesh mesh(renderer, &nextRenderingId, material, meshVertices, meshIndices);
+    // simplifying is the slow part of importing, scene files carry the result so loading them skips it
+    size_t shapeIndex = meshComp.meshes.size();
+    if (cookedLods && shapeIndex < cookedLods->size())
+      mesh.setLods((*cookedLods)[shapeIndex]);
+    else
+      mesh.buildLods();
+
+    if (headless)
+    {
+      mesh.texPath = fullPath;
+      meshComp.meshes.push_back(std::move(mesh));
+      continue;
+    }
 
     try
     {
@@ -1022,7 +1115,8 @@ void Engine::removeMeshComponent(Entity entity)
     MeshComponent &meshComp = registry.meshes[entity];
     for (auto &mesh : meshComp.meshes)
     {
-      mesh.cleanup(renderer.deviceManager.device, renderer);
+      if (!headless)
+        mesh.cleanup(renderer.deviceManager.device, renderer);
     }
 
     registry.meshes.erase(entity);
@@ -1031,9 +1125,7 @@ void Engine::removeMeshComponent(Entity entity)
 
 void Engine::addRigidBodyComponent(Entity entity)
 {
-  if (registry.rigidBodies.find(entity) != registry.rigidBodies.end())
-    return;
-  registry.rigidBodies.emplace(entity, RigidBodyComponent());
+  world.addRigidBodyComponent(entity);
 }
 
 void Engine::removeRigidBodyComponent(Entity entity)
@@ -1071,7 +1163,7 @@ void Engine::applyRigidBodyForce(Entity entity, const glm::vec3 &force)
 
 TransformComponent &Engine::getTransformComponent(Entity entity)
 {
-  registry.transforms[entity].justUpdated = true;
+  registry.transforms[entity].markUpdated();
   return registry.transforms[entity];
 }
 
@@ -1103,14 +1195,7 @@ RigidBodyComponent &Engine::getRigidBodyComponent(Entity entity)
 
 void Engine::addTransformComponent(Entity entity, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
 {
-  if (registry.transforms.find(entity) != registry.transforms.end())
-    return;
-
-  TransformComponent transformComp;
-  transformComp.position = position;
-  transformComp.rotationZYX = rotation;
-  transformComp.scale = scale;
-  registry.transforms.emplace(entity, std::move(transformComp));
+  world.addTransformComponent(entity, position, rotation, scale);
 }
 
 void Engine::addPointLightComponent(Entity entity, glm::vec3 color, int intensity)
@@ -1135,13 +1220,7 @@ void Engine::addBoxColliderComponent(Entity entity, glm::vec3 position, glm::vec
 
 void Engine::addBoxColliderComponent(Entity entity)
 {
-  if (registry.boxColliders.find(entity) != registry.boxColliders.end())
-    return;
-
-  BoxColliderComponent &boxCollider = registry.boxColliders[entity];
-  TransformComponent &transform = getTransformComponent(entity);
-  boxCollider.updateWorldAABB(transform.position, transform.rotationZYX, transform.scale);
-  boxCollider.autoUpdate = true;
+  world.addBoxColliderComponent(entity);
 }
 
 void Engine::updateBoxCollider(Entity entity, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
@@ -1161,13 +1240,12 @@ void Engine::updateBoxCollider(Entity entity)
   BoxColliderComponent &boxCollider = registry.boxColliders[entity];
   TransformComponent &transform = getTransformComponent(entity);
   boxCollider.updateWorldAABB(transform.position, transform.rotationZYX, transform.scale);
+  boxCollider.transformVersion = transform.version;
 }
 
 Entity Engine::createEmptyGameObject(std::string name)
 {
-  Entity e = registry.createEntity(name);
-  addTransformComponent(e, glm::vec3(0), glm::vec3(0), glm::vec3(1));
-  return e;
+  return world.createEmptyGameObject(name);
 }
 
 Entity Engine::getGameObjectHandle(std::string name)
@@ -1184,7 +1262,7 @@ void Engine::serializeScene(const std::string &filePath)
     return;
   }
 
-  int serializationVersion = 1;
+  int serializationVersion = 2;
   writeInt(out, serializationVersion);
 
   writeUInt(out, registry.getNextEntity());
@@ -1198,8 +1276,16 @@ void Engine::serializeScene(const std::string &filePath)
 
 void Engine::deserializeScene(const std::string &filePath)
 {
+  // the old scene's geometry is freed, the arena is compacted before the new one is uploaded into it
+  std::vector<Entity> meshEntities;
+  for (const auto &meshComp : registry.meshes)
+    meshEntities.push_back(meshComp.first);
+  for (Entity entity : meshEntities)
+    removeMeshComponent(entity);
+  if (!headless)
+    renderer.compactGeometry();
+
   registry.transforms.clear();
-  registry.meshes.clear();
   registry.entities.clear();
   registry.boxColliders.clear();
   registry.rigidBodies.clear();
@@ -1213,7 +1299,8 @@ void Engine::deserializeScene(const std::string &filePath)
 
   int serializationVersion;
   readInt(in, serializationVersion);
-  if (serializationVersion != 1)
+  // version 1 has no mesh LODs, they are built again while reading it
+  if (serializationVersion != 1 && serializationVersion != 2)
   {
     std::cerr << "Unsupported version for deserialization." << std::endl;
     return;
@@ -1224,7 +1311,11 @@ void Engine::deserializeScene(const std::string &filePath)
   registry.setNextEntity(nextEntity);
 
   readTransforms(in, registry.transforms);
-  readMeshes(in, this);
+  {
+    // the models of the whole scene are uploaded as one batch
+    UploadBatch uploadBatch(renderer.bufferManager.uploadManager);
+    readMeshes(in, this, serializationVersion);
+  }
   readIdentifiers(in, registry.entities);
   readBoxColliders(in, registry.boxColliders);
 
@@ -54,6 +54,7 @@ void EngineUI::initImGui(Renderer *renderer)
   init_info.DescriptorPool = descriptorPool;
   init_info.RenderPass = renderer->pipelineManager.renderPass;
   init_info.Subpass = 0;
+  init_info.PipelineCache = renderer->pipelineManager.pipelineCache;
   init_info.MinImageCount = 2;
   init_info.ImageCount = 2;
   init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
@@ -163,35 +164,6 @@ void EngineUI::initColorIDResources(Renderer *renderer)
   vkCreateFramebuffer(renderer->deviceManager.device, &framebufferInfo, nullptr, &colorIDFramebuffer);
 }
 
-void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory, VkDevice device, VkPhysicalDevice physicalDevice)
-{
-  VkBufferCreateInfo bufferInfo{};
-  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-  bufferInfo.size = size;
-  bufferInfo.usage = usage;
-  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
-  {
-    throw std::runtime_error("failed to create buffer!");
-  }
-
-  VkMemoryRequirements memRequirements;
-  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, physicalDevice);
-
-  if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-  {
-    throw std::runtime_error("failed to allocate buffer memory!");
-  }
-
-  vkBindBufferMemory(device, buffer, bufferMemory, 0);
-}
-
 uint32_t EngineUI::readColorIDPixel(Renderer *renderer, int px, int py)
 {
   VkDevice device = renderer->deviceManager.device;
@@ -235,9 +207,9 @@ uint32_t EngineUI::readColorIDPixel(Renderer *renderer, int px, int py)
   VkDeviceSize bufferSize = 4;
 
   VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
+  MemoryAllocation stagingBufferMemory;
 
-  createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
+  renderer->bufferManager.createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory, device, physicalDevice);
 
   VkBufferImageCopy region{};
   region.bufferOffset = 0;
@@ -287,15 +259,10 @@ uint32_t EngineUI::readColorIDPixel(Renderer *renderer, int px, int py)
   vkDestroyFence(device, fence, nullptr);
   vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
 
-  void *data;
-  vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-
-  uint32_t pixelValue = *(uint32_t *)data;
-
-  vkUnmapMemory(device, stagingBufferMemory);
+  uint32_t pixelValue = *(uint32_t *)stagingBufferMemory.mapped;
 
   vkDestroyBuffer(device, stagingBuffer, nullptr);
-  vkFreeMemory(device, stagingBufferMemory, nullptr);
+  MemoryAllocator::get().free(stagingBufferMemory, device);
 
   uint8_t b = (pixelValue >> 0) & 0xFF;
   uint8_t g = (pixelValue >> 8) & 0xFF;
@@ -359,7 +326,7 @@ void EngineUI::renderImGUI(Engine *engine, Renderer *renderer)
       updated |= ImGui::DragFloat3("Scale", &transform.scale.x, 0.1f);
       if (updated)
       {
-        transform.justUpdated = true;
+        transform.markUpdated();
       }
     }
     if (engine->registry.boxColliders.find(*selected) != engine->registry.boxColliders.end())
@@ -381,6 +348,7 @@ void EngineUI::renderImGUI(Engine *engine, Renderer *renderer)
       if (updated)
       {
         boxCollider.justUpdated = true;
+        boxCollider.transformVersion = 0; // forces the next refit to pick up the new local bounds
       }
     }
     if (engine->registry.rigidBodies.find(*selected) != engine->registry.rigidBodies.end())
@@ -404,6 +372,74 @@ void EngineUI::renderImGUI(Engine *engine, Renderer *renderer)
   }
   ImGui::End();
 
+  ImGui::Begin("Render Stats");
+  {
+    // counters of the last recorded frame
+    const CommandStateStats &stats = renderer->commandStats;
+    ImGui::Text("Draw packets: %zu  instances: %zu", renderer->drawPackets.packets.size(), renderer->drawPackets.instances.size());
+    const FrustumCullStats &cullStats = renderer->frustumCuller.getStats();
+    ImGui::Text("Meshes visible: %u  culled: %u  (%u threads)", cullStats.visible, cullStats.culled, cullStats.threads);
+    if (renderer->deviceManager.drawIndirectCountSupported)
+    {
+      ImGui::Checkbox("GPU culling", &renderer->gpuCulling);
+      ImGui::SameLine();
+      ImGui::Checkbox("Occlusion culling", &renderer->occlusionCulling);
+      ImGui::Text("GPU batches: %u  occluders: %u  drawn: %u", renderer->drawPackets.gpuBatchCount, renderer->gpuOccluderDraws, renderer->gpuCulledDraws);
+    }
+    ImGui::Text("Mesh shader permutations: %u", renderer->pipelineManager.meshPermutationCount());
+    ImGui::Checkbox("Mesh LODs", &renderer->meshLods);
+    ImGui::SameLine();
+    ImGui::SliderFloat("LOD pixel error", &renderer->lodPixelError, 0.25f, 8.0f);
+    ImGui::Text("Recording: %.2f ms on %zu threads", renderer->recordMilliseconds, renderer->commandRecorder.workerCount() + 1);
+    ImGui::Text("State calls issued: %llu  skipped: %llu", (unsigned long long)stats.totalIssued(), (unsigned long long)stats.totalSkipped());
+    if (ImGui::BeginTable("Command State", 3, ImGuiTableFlags_Borders))
+    {
+      ImGui::TableSetupColumn("State");
+      ImGui::TableSetupColumn("Issued");
+      ImGui::TableSetupColumn("Skipped");
+      ImGui::TableHeadersRow();
+      for (int kind = 0; kind < StateKindCount; kind++)
+      {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(CommandStateStats::kindName(static_cast<CommandStateKind>(kind)));
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", (unsigned long long)stats.issued[kind]);
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", (unsigned long long)stats.skipped[kind]);
+      }
+      ImGui::EndTable();
+    }
+
+    MemoryAllocatorStats memoryStats = MemoryAllocator::get().getStats();
+    const double mb = 1024.0 * 1024.0;
+    ImGui::Separator();
+    ImGui::Text("GPU memory blocks: %u  dedicated: %u  allocations: %u", memoryStats.blockCount, memoryStats.dedicatedCount, memoryStats.allocationCount);
+    ImGui::Text("Blocks: %.1f MB used / %.1f MB free", memoryStats.usedBytes / mb, memoryStats.freeBytes / mb);
+    ImGui::Text("Dedicated: %.1f MB", memoryStats.dedicatedBytes / mb);
+    ImGui::Text("Largest free range: %.1f MB  fragmentation: %.0f%%", memoryStats.largestFreeRange / mb, memoryStats.fragmentation() * 100.0f);
+
+    GeometryArenaStats arenaStats = renderer->bufferManager.geometryArena.getStats();
+    ImGui::Separator();
+    ImGui::Text("Geometry arena: %u meshes  %u free ranges  %u compactions", arenaStats.geometryCount, arenaStats.freeRanges, arenaStats.compactions);
+    ImGui::Text("Vertices: %u / %u  indices: %u / %u", arenaStats.vertexCount, arenaStats.vertexCapacity, arenaStats.indexCount, arenaStats.indexCapacity);
+
+    UploadManager &uploads = renderer->bufferManager.uploadManager;
+    ImGui::Separator();
+    ImGui::Text("Uploads: %s transfer queue  %llu submits  %llu barriers  %.1f MB", uploads.dedicatedQueue() ? "dedicated" : "graphics", (unsigned long long)uploads.stats.submits, (unsigned long long)uploads.stats.barriers, uploads.stats.bytes / mb);
+    ImGui::Text("Staging ring: %.1f / %.1f MB  oversized: %llu  stalls: %llu", uploads.stats.ringUsed / mb, UploadManager::RING_SIZE / mb, (unsigned long long)uploads.stats.dedicatedStaging, (unsigned long long)uploads.stats.stalls);
+
+    TextureStreamStats streamStats = renderer->textureStreamer.stats;
+    ImGui::Separator();
+    ImGui::Checkbox("Stream textures (new meshes)", &renderer->textureStreaming);
+    ImGui::Text("Streamed textures: %u  placeholders: %u  decoding: %u", streamStats.textures, streamStats.placeholders, streamStats.decoding);
+    ImGui::Text("Resident: %.1f / %.1f MB  evicted levels: %llu", streamStats.residentBytes / mb, renderer->textureStreamer.residentBudget / mb, (unsigned long long)streamStats.evictions);
+
+    TextureCacheStats cacheStats = renderer->textureCache.stats;
+    ImGui::Text("Texture cache: %u textures  %llu shared  %llu loaded", cacheStats.textures, (unsigned long long)cacheStats.hits, (unsigned long long)cacheStats.loads);
+  }
+  ImGui::End();
+
   if (renderToViewport)
   {
     ImGui::SetNextWindowSize(ImVec2(1200, 900));
@@ -0,0 +1,244 @@
+#include "frustumCuller.hpp"
+#include "vertex.h"
+#include <algorithm>
+#include <thread>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || defined(__x86_64__)
+#include <xmmintrin.h>
+#define FRUSTUM_CULLER_SSE
+#endif
+
+BoundingVolume BoundingVolume::fromVertices(const std::vector<Vertex> &vertices)
+{
+  BoundingVolume bounds;
+  if (vertices.empty())
+    return bounds;
+
+  bounds.min = bounds.max = vertices[0].pos;
+  for (const Vertex &vertex : vertices)
+  {
+    bounds.min = glm::min(bounds.min, vertex.pos);
+    bounds.max = glm::max(bounds.max, vertex.pos);
+  }
+
+  glm::vec3 center = bounds.center();
+  float radiusSquared = 0.0f;
+  for (const Vertex &vertex : vertices)
+  {
+    glm::vec3 offset = vertex.pos - center;
+    radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+  }
+  bounds.radius = std::sqrt(radiusSquared);
+  return bounds;
+}
+
+FrustumCuller::~FrustumCuller()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quitting = true;
+  }
+  workReady.notify_all();
+
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+void FrustumCuller::begin(const glm::mat4 &viewProj)
+{
+  // Gribb/Hartmann, glm is column major so row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++)
+    rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+
+  // the near plane assumes a -1..1 depth range, with a 0..1 projection it sits slightly behind the real one which only culls less
+  planes[0] = rows[3] + rows[0];
+  planes[1] = rows[3] - rows[0];
+  planes[2] = rows[3] + rows[1];
+  planes[3] = rows[3] - rows[1];
+  planes[4] = rows[3] + rows[2];
+  planes[5] = rows[3] - rows[2];
+  for (glm::vec4 &plane : planes)
+    plane /= glm::length(glm::vec3(plane));
+
+  centerX.clear();
+  centerY.clear();
+  centerZ.clear();
+  extentX.clear();
+  extentY.clear();
+  extentZ.clear();
+  radius.clear();
+  count = 0;
+}
+
+uint32_t FrustumCuller::add(const BoundingVolume &bounds, const glm::mat4 &world)
+{
+  glm::vec3 center = glm::vec3(world * glm::vec4(bounds.center(), 1.0f));
+
+  // the world box around the transformed local box, rotation can only grow it
+  glm::mat3 linear = glm::mat3(world);
+  glm::mat3 absLinear(glm::abs(linear[0]), glm::abs(linear[1]), glm::abs(linear[2]));
+  glm::vec3 extent = absLinear * ((bounds.max - bounds.min) * 0.5f);
+
+  float scale = std::max({glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2])});
+
+  centerX.push_back(center.x);
+  centerY.push_back(center.y);
+  centerZ.push_back(center.z);
+  extentX.push_back(extent.x);
+  extentY.push_back(extent.y);
+  extentZ.push_back(extent.z);
+  radius.push_back(bounds.radius * scale);
+  return count++;
+}
+
+void FrustumCuller::cull()
+{
+  // pad to a multiple of four so the SIMD loop never needs a scalar tail, the padding is never read back
+  uint32_t padded = (count + 3) & ~3u;
+  centerX.resize(padded, 0.0f);
+  centerY.resize(padded, 0.0f);
+  centerZ.resize(padded, 0.0f);
+  extentX.resize(padded, 0.0f);
+  extentY.resize(padded, 0.0f);
+  extentZ.resize(padded, 0.0f);
+  radius.resize(padded, 0.0f);
+  visible.resize(padded);
+
+  uint32_t threadCount = 1;
+  if (count >= PARALLEL_THRESHOLD)
+    threadCount = std::min(std::max(1u, std::thread::hardware_concurrency()), count / (PARALLEL_THRESHOLD / 4));
+
+  if (threadCount <= 1)
+  {
+    cullRange(0, padded);
+  }
+  else
+  {
+    // the calling thread is one of them, the pool only ever grows
+    workers.reserve(threadCount - 1);
+    while (workers.size() < threadCount - 1)
+      workers.emplace_back(&FrustumCuller::workerLoop, this);
+
+    // chunks stay multiples of four
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobChunk = ((padded / threadCount) + 3) & ~3u;
+      jobChunkCount = (padded + jobChunk - 1) / jobChunk;
+      jobPadded = padded;
+      nextChunk.store(0, std::memory_order_relaxed);
+      activeWorkers = workers.size();
+      generation++;
+    }
+    workReady.notify_all();
+
+    cullChunks();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    workDone.wait(lock, [this]
+                  { return activeWorkers == 0; });
+  }
+
+  stats.tested = count;
+  stats.visible = static_cast<uint32_t>(std::count(visible.begin(), visible.begin() + count, 1));
+  stats.culled = count - stats.visible;
+  stats.threads = threadCount;
+}
+
+void FrustumCuller::cullChunks()
+{
+  while (true)
+  {
+    uint32_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+    if (chunk >= jobChunkCount)
+      return;
+    uint32_t first = chunk * jobChunk;
+    cullRange(first, std::min(first + jobChunk, jobPadded));
+  }
+}
+
+void FrustumCuller::workerLoop()
+{
+  uint64_t seenGeneration = 0;
+
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      workReady.wait(lock, [&]
+                     { return quitting || generation != seenGeneration; });
+      if (quitting)
+        return;
+      seenGeneration = generation;
+    }
+
+    cullChunks();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--activeWorkers == 0)
+        workDone.notify_one();
+    }
+  }
+}
+
+// a bounds is outside when it is fully behind any plane
+// the box and the sphere share their center, so the smaller of the two projected radii decides
+void FrustumCuller::cullRange(uint32_t first, uint32_t last)
+{
+#ifdef FRUSTUM_CULLER_SSE
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 signMask = _mm_set1_ps(-0.0f);
+
+  __m128 planeX[6], planeY[6], planeZ[6], planeW[6], planeAbsX[6], planeAbsY[6], planeAbsZ[6];
+  for (int p = 0; p < 6; p++)
+  {
+    planeX[p] = _mm_set1_ps(planes[p].x);
+    planeY[p] = _mm_set1_ps(planes[p].y);
+    planeZ[p] = _mm_set1_ps(planes[p].z);
+    planeW[p] = _mm_set1_ps(planes[p].w);
+    planeAbsX[p] = _mm_andnot_ps(signMask, planeX[p]);
+    planeAbsY[p] = _mm_andnot_ps(signMask, planeY[p]);
+    planeAbsZ[p] = _mm_andnot_ps(signMask, planeZ[p]);
+  }
+
+  for (uint32_t i = first; i < last; i += 4)
+  {
+    __m128 cx = _mm_loadu_ps(&centerX[i]);
+    __m128 cy = _mm_loadu_ps(&centerY[i]);
+    __m128 cz = _mm_loadu_ps(&centerZ[i]);
+    __m128 ex = _mm_loadu_ps(&extentX[i]);
+    __m128 ey = _mm_loadu_ps(&extentY[i]);
+    __m128 ez = _mm_loadu_ps(&extentZ[i]);
+    __m128 r = _mm_loadu_ps(&radius[i]);
+
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; p++)
+    {
+      __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)), _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+      __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeAbsX[p], ex), _mm_mul_ps(planeAbsY[p], ey)), _mm_mul_ps(planeAbsZ[p], ez));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, _mm_min_ps(boxRadius, r)), zero));
+    }
+
+    int mask = _mm_movemask_ps(inside);
+    visible[i] = mask & 1;
+    visible[i + 1] = (mask >> 1) & 1;
+    visible[i + 2] = (mask >> 2) & 1;
+    visible[i + 3] = (mask >> 3) & 1;
+  }
+#else
+  for (uint32_t i = first; i < last; i++)
+  {
+    bool inside = true;
+    for (int p = 0; p < 6 && inside; p++)
+    {
+      const glm::vec4 &plane = planes[p];
+      float distance = plane.x * centerX[i] + plane.y * centerY[i] + plane.z * centerZ[i] + plane.w;
+      float boxRadius = std::abs(plane.x) * extentX[i] + std::abs(plane.y) * extentY[i] + std::abs(plane.z) * extentZ[i];
+      inside = distance + std::min(boxRadius, radius[i]) >= 0.0f;
+    }
+    visible[i] = inside;
+  }
+#endif
+}
@@ -0,0 +1,326 @@
+#include "geometryArena.hpp"
+#include "utils.h"
+#include "uploadManager.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+static const VkBufferUsageFlags ARENA_VERTEX_USAGE = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+static const VkBufferUsageFlags ARENA_INDEX_USAGE = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+static void createArenaBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, MemoryAllocation &memory, const std::vector<uint32_t> &queueFamilies, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  // written on the transfer queue and read by the graphics queue
+  if (queueFamilies.size() > 1)
+  {
+    bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+    bufferInfo.pQueueFamilyIndices = queueFamilies.data();
+  }
+
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create geometry arena buffer!");
+  }
+
+  MemoryAllocator::get().allocateBuffer(buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memory, device, physicalDevice);
+}
+
+uint32_t GeometryArena::FreeList::allocate(uint32_t count)
+{
+  auto best = ranges.end();
+  for (auto it = ranges.begin(); it != ranges.end(); ++it)
+  {
+    if (it->second >= count && (best == ranges.end() || it->second < best->second))
+    {
+      best = it;
+      if (it->second == count)
+        break;
+    }
+  }
+
+  if (best == ranges.end())
+    return UINT32_MAX;
+
+  uint32_t offset = best->first;
+  uint32_t remaining = best->second - count;
+  ranges.erase(best);
+  if (remaining > 0)
+    ranges[offset + count] = remaining;
+
+  used += count;
+  return offset;
+}
+
+void GeometryArena::FreeList::free(uint32_t offset, uint32_t count)
+{
+  used -= count;
+
+  auto next = ranges.lower_bound(offset);
+  if (next != ranges.end() && offset + count == next->first)
+  {
+    count += next->second;
+    next = ranges.erase(next);
+  }
+
+  if (next != ranges.begin())
+  {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == offset)
+    {
+      previous->second += count;
+      return;
+    }
+  }
+
+  ranges[offset] = count;
+}
+
+void GeometryArena::FreeList::grow(uint32_t newCapacity)
+{
+  if (newCapacity <= capacity)
+    return;
+
+  uint32_t added = newCapacity - capacity;
+  uint32_t offset = capacity;
+  capacity = newCapacity;
+
+  // free() takes it off used, which never counted it
+  used += added;
+  free(offset, added);
+}
+
+uint32_t GeometryArena::FreeList::holes() const
+{
+  uint32_t freeCount = capacity - used;
+  if (!ranges.empty())
+  {
+    auto last = std::prev(ranges.end());
+    if (last->first + last->second == capacity)
+      freeCount -= last->second;
+  }
+  return freeCount;
+}
+
+int GeometryArena::allocate(const std::vector<Vertex> &verts, const std::vector<uint32_t> &inputIndices, UploadManager &uploads, VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue)
+{
+  if (verts.empty() || inputIndices.empty())
+    return -1;
+
+  uint32_t vertexCount = static_cast<uint32_t>(verts.size());
+  uint32_t indexCount = static_cast<uint32_t>(inputIndices.size());
+
+  uint32_t firstVertex = vertexRanges.allocate(vertexCount);
+  if (firstVertex == UINT32_MAX)
+  {
+    uint32_t capacity = std::max({INITIAL_VERTICES, vertexRanges.capacity * 2, vertexRanges.capacity + vertexCount});
+    growBuffer(vertexBuffer, vertexMemory, vertexRanges, capacity, sizeof(Vertex), ARENA_VERTEX_USAGE, uploads, device, physicalDevice, graphicsQueue);
+    firstVertex = vertexRanges.allocate(vertexCount);
+  }
+
+  uint32_t firstIndex = indexRanges.allocate(indexCount);
+  if (firstIndex == UINT32_MAX)
+  {
+    uint32_t capacity = std::max({INITIAL_INDICES, indexRanges.capacity * 2, indexRanges.capacity + indexCount});
+    growBuffer(indexBuffer, indexMemory, indexRanges, capacity, sizeof(uint32_t), ARENA_INDEX_USAGE, uploads, device, physicalDevice, graphicsQueue);
+    firstIndex = indexRanges.allocate(indexCount);
+  }
+
+  // no frame in flight reads the ranges anymore, retired ranges only come back through releaseRetired
+  uploads.uploadBuffer(vertexBuffer, sizeof(Vertex) * static_cast<VkDeviceSize>(firstVertex), verts.data(), sizeof(Vertex) * verts.size());
+  uint64_t ticket = uploads.uploadBuffer(indexBuffer, sizeof(uint32_t) * static_cast<VkDeviceSize>(firstIndex), inputIndices.data(), sizeof(uint32_t) * inputIndices.size());
+
+  int slot;
+  if (!freeSlots.empty())
+  {
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+  }
+  else
+  {
+    slot = static_cast<int>(slots.size());
+    slots.emplace_back();
+  }
+
+  GeometryRange &range = slots[slot];
+  range.firstVertex = firstVertex;
+  range.vertexCount = vertexCount;
+  range.firstIndex = firstIndex;
+  range.indexCount = indexCount;
+  // both uploads are in the same submit unless the ring filled up in between, which submits in order
+  range.uploadTicket = ticket;
+  range.used = true;
+  return slot;
+}
+
+void GeometryArena::free(int slot)
+{
+  if (slot < 0 || slot >= static_cast<int>(slots.size()) || !slots[slot].used)
+    return;
+
+  GeometryRange &range = slots[slot];
+  retired.push_back({range, frame});
+  range = GeometryRange();
+  freeSlots.push_back(slot);
+}
+
+void GeometryArena::releaseRetired(uint32_t framesInFlight)
+{
+  frame++;
+
+  // a range freed before a frame was recorded is only read by the frames before it
+  size_t kept = 0;
+  for (const RetiredRange &entry : retired)
+  {
+    if (frame - entry.frame >= framesInFlight)
+    {
+      vertexRanges.free(entry.range.firstVertex, entry.range.vertexCount);
+      indexRanges.free(entry.range.firstIndex, entry.range.indexCount);
+    }
+    else
+    {
+      retired[kept++] = entry;
+    }
+  }
+  retired.resize(kept);
+}
+
+bool GeometryArena::compactIfFragmented(UploadManager &uploads, VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue)
+{
+  // small holes are cheaper to leave alone than to stall the queue for
+  bool vertexHoles = vertexRanges.holes() > std::max(vertexRanges.capacity / 4, INITIAL_VERTICES / 4);
+  bool indexHoles = indexRanges.holes() > std::max(indexRanges.capacity / 4, INITIAL_INDICES / 4);
+  if (!vertexHoles && !indexHoles)
+    return false;
+
+  compact(uploads, device, physicalDevice, graphicsQueue);
+  return true;
+}
+
+void GeometryArena::compact(UploadManager &uploads, VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue)
+{
+  if (vertexBuffer == VK_NULL_HANDLE || indexBuffer == VK_NULL_HANDLE)
+    return;
+
+  // copying into fresh buffers avoids overlapping regions and lets the arena shrink again
+  uint32_t vertexCapacity = std::max(INITIAL_VERTICES, vertexRanges.used + vertexRanges.used / 4);
+  uint32_t indexCapacity = std::max(INITIAL_INDICES, indexRanges.used + indexRanges.used / 4);
+
+  VkBuffer newVertexBuffer;
+  MemoryAllocation newVertexMemory;
+  VkBuffer newIndexBuffer;
+  MemoryAllocation newIndexMemory;
+  createArenaBuffer(sizeof(Vertex) * static_cast<VkDeviceSize>(vertexCapacity), ARENA_VERTEX_USAGE, newVertexBuffer, newVertexMemory, uploads.sharedFamilies(), device, physicalDevice);
+  createArenaBuffer(sizeof(uint32_t) * static_cast<VkDeviceSize>(indexCapacity), ARENA_INDEX_USAGE, newIndexBuffer, newIndexMemory, uploads.sharedFamilies(), device, physicalDevice);
+
+  std::vector<VkBufferCopy> vertexCopies;
+  std::vector<VkBufferCopy> indexCopies;
+  uint32_t vertexHead = 0;
+  uint32_t indexHead = 0;
+  for (GeometryRange &range : slots)
+  {
+    if (!range.used)
+      continue;
+
+    vertexCopies.push_back({sizeof(Vertex) * static_cast<VkDeviceSize>(range.firstVertex), sizeof(Vertex) * static_cast<VkDeviceSize>(vertexHead), sizeof(Vertex) * static_cast<VkDeviceSize>(range.vertexCount)});
+    indexCopies.push_back({sizeof(uint32_t) * static_cast<VkDeviceSize>(range.firstIndex), sizeof(uint32_t) * static_cast<VkDeviceSize>(indexHead), sizeof(uint32_t) * static_cast<VkDeviceSize>(range.indexCount)});
+    range.firstVertex = vertexHead;
+    range.firstIndex = indexHead;
+    vertexHead += range.vertexCount;
+    indexHead += range.indexCount;
+  }
+
+  // nothing may still be reading the old buffers, the copies come after every upload still writing them
+  vkQueueWaitIdle(graphicsQueue);
+  uploads.copyBuffer(vertexBuffer, newVertexBuffer, vertexCopies);
+  uploads.wait(uploads.copyBuffer(indexBuffer, newIndexBuffer, indexCopies));
+  retired.clear();
+
+  vkDestroyBuffer(device, vertexBuffer, nullptr);
+  MemoryAllocator::get().free(vertexMemory, device);
+  vkDestroyBuffer(device, indexBuffer, nullptr);
+  MemoryAllocator::get().free(indexMemory, device);
+
+  vertexBuffer = newVertexBuffer;
+  vertexMemory = newVertexMemory;
+  indexBuffer = newIndexBuffer;
+  indexMemory = newIndexMemory;
+
+  vertexRanges = FreeList();
+  vertexRanges.used = vertexHead;
+  vertexRanges.capacity = vertexHead;
+  vertexRanges.grow(vertexCapacity);
+
+  indexRanges = FreeList();
+  indexRanges.used = indexHead;
+  indexRanges.capacity = indexHead;
+  indexRanges.grow(indexCapacity);
+
+  compactions++;
+}
+
+GeometryArenaStats GeometryArena::getStats() const
+{
+  GeometryArenaStats stats;
+  stats.geometryCount = static_cast<uint32_t>(slots.size() - freeSlots.size());
+  stats.vertexCapacity = vertexRanges.capacity;
+  stats.vertexCount = vertexRanges.used;
+  stats.indexCapacity = indexRanges.capacity;
+  stats.indexCount = indexRanges.used;
+  stats.freeRanges = static_cast<uint32_t>(vertexRanges.ranges.size() + indexRanges.ranges.size());
+  stats.compactions = compactions;
+  return stats;
+}
+
+void GeometryArena::cleanup(VkDevice device)
+{
+  if (vertexBuffer != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(device, vertexBuffer, nullptr);
+    vertexBuffer = VK_NULL_HANDLE;
+  }
+  MemoryAllocator::get().free(vertexMemory, device);
+
+  if (indexBuffer != VK_NULL_HANDLE)
+  {
+    vkDestroyBuffer(device, indexBuffer, nullptr);
+    indexBuffer = VK_NULL_HANDLE;
+  }
+  MemoryAllocator::get().free(indexMemory, device);
+
+  vertexRanges = FreeList();
+  indexRanges = FreeList();
+  slots.clear();
+  freeSlots.clear();
+  retired.clear();
+}
+
+void GeometryArena::growBuffer(VkBuffer &buffer, MemoryAllocation &memory, FreeList &ranges, uint32_t newCapacity, VkDeviceSize elementSize, VkBufferUsageFlags usage, UploadManager &uploads, VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue)
+{
+  VkBuffer newBuffer;
+  MemoryAllocation newMemory;
+  createArenaBuffer(elementSize * newCapacity, usage, newBuffer, newMemory, uploads.sharedFamilies(), device, physicalDevice);
+
+  if (buffer != VK_NULL_HANDLE)
+  {
+    // the only stall left in the arena, it doubles so this gets rare quickly
+    vkQueueWaitIdle(graphicsQueue);
+
+    VkBufferCopy copyRegion{};
+    copyRegion.size = elementSize * ranges.capacity;
+    uploads.wait(uploads.copyBuffer(buffer, newBuffer, {copyRegion}));
+
+    vkDestroyBuffer(device, buffer, nullptr);
+    MemoryAllocator::get().free(memory, device);
+  }
+
+  buffer = newBuffer;
+  memory = newMemory;
+  ranges.grow(newCapacity);
+}
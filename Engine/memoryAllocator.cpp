@@ -0,0 +1,520 @@
+#include "memoryAllocator.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+// every range starts and ends on this, so the small size classes are exact
+static const VkDeviceSize MIN_ALIGNMENT = 16;
+// leftovers smaller than this stay with the allocation instead of becoming a free range
+static const VkDeviceSize MIN_SPLIT_SIZE = 256;
+
+static uint32_t highestBit(uint64_t value)
+{
+  uint32_t bit = 0;
+  while (value >>= 1)
+    bit++;
+  return bit;
+}
+
+static uint32_t lowestBit(uint64_t value)
+{
+  uint32_t bit = 0;
+  while ((value & 1) == 0)
+  {
+    value >>= 1;
+    bit++;
+  }
+  return bit;
+}
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+float MemoryAllocatorStats::fragmentation() const
+{
+  if (freeBytes == 0)
+    return 0.0f;
+  return 1.0f - static_cast<float>(largestFreeRange) / static_cast<float>(freeBytes);
+}
+
+MemoryAllocator &MemoryAllocator::get()
+{
+  static MemoryAllocator allocator;
+  return allocator;
+}
+
+void MemoryAllocator::init(VkPhysicalDevice physicalDevice)
+{
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  bufferImageGranularity = properties.limits.bufferImageGranularity;
+
+  for (uint32_t i = 0; i < pools.size(); i++)
+    pools[i].memoryType = i / 2;
+  initialized = true;
+}
+
+void MemoryAllocator::allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryAllocation &allocation, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  VkMemoryDedicatedRequirements dedicatedRequirements{};
+  dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+  VkMemoryRequirements2 memRequirements{};
+  memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+  memRequirements.pNext = &dedicatedRequirements;
+
+  VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+  requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+  requirementsInfo.buffer = buffer;
+  vkGetBufferMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+
+  bool prefersDedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+  allocate(memRequirements.memoryRequirements, prefersDedicated, false, buffer, VK_NULL_HANDLE, properties, allocation, device, physicalDevice);
+
+  vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+}
+
+void MemoryAllocator::allocateImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, MemoryAllocation &allocation, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  VkMemoryDedicatedRequirements dedicatedRequirements{};
+  dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+  VkMemoryRequirements2 memRequirements{};
+  memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+  memRequirements.pNext = &dedicatedRequirements;
+
+  VkImageMemoryRequirementsInfo2 requirementsInfo{};
+  requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+  requirementsInfo.image = image;
+  vkGetImageMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+
+  bool prefersDedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+  allocate(memRequirements.memoryRequirements, prefersDedicated, tiling == VK_IMAGE_TILING_OPTIMAL, VK_NULL_HANDLE, image, properties, allocation, device, physicalDevice);
+
+  vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+}
+
+void MemoryAllocator::allocate(const VkMemoryRequirements &requirements, bool prefersDedicated, bool optimalImage, VkBuffer buffer, VkImage image, VkMemoryPropertyFlags properties, MemoryAllocation &allocation, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!initialized)
+    init(physicalDevice);
+
+  uint32_t memoryType = UINT32_MAX;
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+  {
+    if ((requirements.memoryTypeBits & (1 << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+    {
+      memoryType = i;
+      break;
+    }
+  }
+  if (memoryType == UINT32_MAX)
+  {
+    throw std::runtime_error("failed to find suitable memory type!");
+  }
+
+  // big resources would waste most of a block, the driver also asks for this on some render targets
+  VkDeviceSize blockSize = blockSizeFor(memoryType);
+  if (prefersDedicated || requirements.size > blockSize / 2)
+  {
+    allocateDedicated(requirements, memoryType, buffer, image, allocation, device);
+    return;
+  }
+
+  bool hostVisible = memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+  uint32_t poolIndex = memoryType * 2 + (optimalImage && bufferImageGranularity > 1 ? 1 : 0);
+  Pool &pool = pools[poolIndex];
+
+  VkDeviceSize size = alignUp(requirements.size, MIN_ALIGNMENT);
+  VkDeviceSize alignment = std::max(requirements.alignment, MIN_ALIGNMENT);
+
+  uint32_t blockIndex = UINT32_MAX;
+  uint32_t rangeIndex = NO_RANGE;
+  for (uint32_t i = 0; i < pool.blocks.size(); i++)
+  {
+    if (pool.blocks[i].memory != VK_NULL_HANDLE && allocateFromBlock(pool.blocks[i], size, alignment, rangeIndex))
+    {
+      blockIndex = i;
+      break;
+    }
+  }
+
+  if (blockIndex == UINT32_MAX)
+  {
+    // reuse a slot of a released block so the indices held by live allocations stay put
+    for (uint32_t i = 0; i < pool.blocks.size() && blockIndex == UINT32_MAX; i++)
+    {
+      if (pool.blocks[i].memory == VK_NULL_HANDLE)
+        blockIndex = i;
+    }
+    if (blockIndex == UINT32_MAX)
+    {
+      blockIndex = static_cast<uint32_t>(pool.blocks.size());
+      pool.blocks.emplace_back();
+    }
+
+    if (!createBlock(pool.blocks[blockIndex], blockSize, memoryType, hostVisible, device))
+    {
+      // out of room for a whole block, the resource might still fit on its own
+      allocateDedicated(requirements, memoryType, buffer, image, allocation, device);
+      return;
+    }
+    allocateFromBlock(pool.blocks[blockIndex], size, alignment, rangeIndex);
+  }
+
+  Block &block = pool.blocks[blockIndex];
+  block.allocationCount++;
+
+  allocation.memory = block.memory;
+  allocation.offset = block.ranges[rangeIndex].offset;
+  allocation.size = block.ranges[rangeIndex].size;
+  allocation.mapped = block.mapped ? static_cast<char *>(block.mapped) + allocation.offset : nullptr;
+  allocation.pool = poolIndex;
+  allocation.block = blockIndex;
+  allocation.range = rangeIndex;
+  allocation.dedicated = false;
+}
+
+void MemoryAllocator::allocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryType, VkBuffer buffer, VkImage image, MemoryAllocation &allocation, VkDevice device)
+{
+  VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+  dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+  dedicatedInfo.buffer = buffer;
+  dedicatedInfo.image = image;
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.pNext = &dedicatedInfo;
+  allocInfo.allocationSize = requirements.size;
+  allocInfo.memoryTypeIndex = memoryType;
+
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to allocate dedicated memory!");
+  }
+
+  void *mapped = nullptr;
+  if (memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    vkMapMemory(device, memory, 0, requirements.size, 0, &mapped);
+
+  dedicatedAllocations.push_back({memory, requirements.size});
+
+  allocation = MemoryAllocation();
+  allocation.memory = memory;
+  allocation.size = requirements.size;
+  allocation.mapped = mapped;
+  allocation.dedicated = true;
+}
+
+void MemoryAllocator::free(MemoryAllocation &allocation, VkDevice device)
+{
+  if (allocation.memory == VK_NULL_HANDLE)
+    return;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (allocation.dedicated)
+  {
+    auto it = std::find_if(dedicatedAllocations.begin(), dedicatedAllocations.end(), [&](const DedicatedAllocation &dedicated)
+                           { return dedicated.memory == allocation.memory; });
+    if (it != dedicatedAllocations.end())
+      dedicatedAllocations.erase(it);
+
+    if (allocation.mapped)
+      vkUnmapMemory(device, allocation.memory);
+    vkFreeMemory(device, allocation.memory, nullptr);
+    allocation = MemoryAllocation();
+    return;
+  }
+
+  Pool &pool = pools[allocation.pool];
+  Block &block = pool.blocks[allocation.block];
+  freeFromBlock(block, allocation.range);
+  block.allocationCount--;
+  allocation = MemoryAllocation();
+
+  if (block.allocationCount > 0)
+    return;
+
+  // an empty block is given back unless it's the last one, which avoids churning on load/unload patterns
+  uint32_t liveBlocks = 0;
+  for (const Block &other : pool.blocks)
+  {
+    if (other.memory != VK_NULL_HANDLE)
+      liveBlocks++;
+  }
+  if (liveBlocks <= 1)
+    return;
+
+  if (block.mapped)
+    vkUnmapMemory(device, block.memory);
+  vkFreeMemory(device, block.memory, nullptr);
+  block = Block();
+}
+
+MemoryAllocatorStats MemoryAllocator::getStats()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  MemoryAllocatorStats stats;
+  for (const Pool &pool : pools)
+  {
+    for (const Block &block : pool.blocks)
+    {
+      if (block.memory == VK_NULL_HANDLE)
+        continue;
+
+      stats.blockCount++;
+      stats.allocationCount += block.allocationCount;
+      stats.blockBytes += block.size;
+      stats.usedBytes += block.used;
+      stats.freeBytes += block.size - block.used;
+
+      for (uint32_t i = 0; i < block.ranges.size(); i++)
+      {
+        const Range &range = block.ranges[i];
+        if (range.free)
+          stats.largestFreeRange = std::max(stats.largestFreeRange, range.size);
+      }
+    }
+  }
+
+  for (const DedicatedAllocation &dedicated : dedicatedAllocations)
+  {
+    stats.dedicatedCount++;
+    stats.allocationCount++;
+    stats.dedicatedBytes += dedicated.size;
+  }
+  return stats;
+}
+
+void MemoryAllocator::cleanup(VkDevice device)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (Pool &pool : pools)
+  {
+    for (Block &block : pool.blocks)
+    {
+      if (block.memory == VK_NULL_HANDLE)
+        continue;
+
+      if (block.mapped)
+        vkUnmapMemory(device, block.memory);
+      vkFreeMemory(device, block.memory, nullptr);
+    }
+    pool.blocks.clear();
+  }
+
+  // freeing the memory also unmaps it
+  for (const DedicatedAllocation &dedicated : dedicatedAllocations)
+    vkFreeMemory(device, dedicated.memory, nullptr);
+  dedicatedAllocations.clear();
+
+  initialized = false;
+}
+
+VkDeviceSize MemoryAllocator::blockSizeFor(uint32_t memoryType) const
+{
+  // small heaps like the host visible BAR window get smaller blocks so one block doesn't take most of it
+  VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryType].heapIndex].size;
+  VkDeviceSize size = std::min(BLOCK_SIZE, heapSize / 8);
+  return std::max(size / MIN_ALIGNMENT * MIN_ALIGNMENT, MIN_SPLIT_SIZE);
+}
+
+bool MemoryAllocator::createBlock(Block &block, VkDeviceSize size, uint32_t memoryType, bool hostVisible, VkDevice device)
+{
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryType;
+
+  block = Block();
+  if (vkAllocateMemory(device, &allocInfo, nullptr, &block.memory) != VK_SUCCESS)
+  {
+    block.memory = VK_NULL_HANDLE;
+    return false;
+  }
+
+  if (hostVisible)
+    vkMapMemory(device, block.memory, 0, size, 0, &block.mapped);
+
+  block.size = size;
+  block.freeHeads.fill(NO_RANGE);
+
+  uint32_t rangeIndex = newRange(block);
+  block.ranges[rangeIndex] = {0, size, NO_RANGE, NO_RANGE, NO_RANGE, NO_RANGE, true};
+  insertFree(block, rangeIndex);
+  return true;
+}
+
+void MemoryAllocator::mapping(VkDeviceSize size, uint32_t &firstLevel, uint32_t &secondLevel)
+{
+  if (size < SMALL_SIZE)
+  {
+    firstLevel = 0;
+    secondLevel = static_cast<uint32_t>(size / (SMALL_SIZE / SECOND_LEVEL_COUNT));
+    return;
+  }
+
+  uint32_t bit = highestBit(size);
+  firstLevel = bit - highestBit(SMALL_SIZE) + 1;
+  secondLevel = static_cast<uint32_t>((size >> (bit - SECOND_LEVEL_BITS)) & (SECOND_LEVEL_COUNT - 1));
+}
+
+bool MemoryAllocator::allocateFromBlock(Block &block, VkDeviceSize size, VkDeviceSize alignment, uint32_t &rangeIndex)
+{
+  // room for the worst case padding in front, the padding goes back on the free lists after
+  VkDeviceSize searchSize = size + alignment - MIN_ALIGNMENT;
+  if (searchSize > block.size - block.used)
+    return false;
+
+  // round up to the next size class so any range found in it is big enough
+  if (searchSize >= SMALL_SIZE)
+    searchSize += (1ull << (highestBit(searchSize) - SECOND_LEVEL_BITS)) - 1;
+
+  uint32_t firstLevel, secondLevel;
+  mapping(searchSize, firstLevel, secondLevel);
+  if (firstLevel >= FIRST_LEVEL_COUNT)
+    return false;
+
+  uint32_t secondLevelMap = block.secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+  if (secondLevelMap == 0)
+  {
+    uint64_t firstLevelMap = block.firstLevelBitmap & (~0ull << (firstLevel + 1));
+    if (firstLevelMap == 0)
+      return false;
+
+    firstLevel = lowestBit(firstLevelMap);
+    secondLevelMap = block.secondLevelBitmaps[firstLevel];
+  }
+  secondLevel = lowestBit(secondLevelMap);
+
+  uint32_t index = block.freeHeads[firstLevel * SECOND_LEVEL_COUNT + secondLevel];
+  removeFree(block, index);
+
+  VkDeviceSize alignedOffset = alignUp(block.ranges[index].offset, alignment);
+  VkDeviceSize padding = alignedOffset - block.ranges[index].offset;
+  if (padding > 0)
+  {
+    // the range before is never free since neighbouring free ranges are always merged
+    uint32_t front = newRange(block);
+    Range &range = block.ranges[index];
+    block.ranges[front] = {range.offset, padding, range.prevPhysical, index, NO_RANGE, NO_RANGE, true};
+    if (range.prevPhysical != NO_RANGE)
+      block.ranges[range.prevPhysical].nextPhysical = front;
+    range.prevPhysical = front;
+    range.offset = alignedOffset;
+    range.size -= padding;
+    insertFree(block, front);
+  }
+
+  if (block.ranges[index].size - size >= MIN_SPLIT_SIZE)
+  {
+    uint32_t back = newRange(block);
+    Range &range = block.ranges[index];
+    block.ranges[back] = {range.offset + size, range.size - size, index, range.nextPhysical, NO_RANGE, NO_RANGE, true};
+    if (range.nextPhysical != NO_RANGE)
+      block.ranges[range.nextPhysical].prevPhysical = back;
+    range.nextPhysical = back;
+    range.size = size;
+    insertFree(block, back);
+  }
+
+  block.ranges[index].free = false;
+  block.used += block.ranges[index].size;
+  rangeIndex = index;
+  return true;
+}
+
+void MemoryAllocator::freeFromBlock(Block &block, uint32_t rangeIndex)
+{
+  uint32_t index = rangeIndex;
+  block.used -= block.ranges[index].size;
+  block.ranges[index].free = true;
+
+  uint32_t prev = block.ranges[index].prevPhysical;
+  if (prev != NO_RANGE && block.ranges[prev].free)
+  {
+    removeFree(block, prev);
+    block.ranges[prev].size += block.ranges[index].size;
+    block.ranges[prev].nextPhysical = block.ranges[index].nextPhysical;
+    if (block.ranges[index].nextPhysical != NO_RANGE)
+      block.ranges[block.ranges[index].nextPhysical].prevPhysical = prev;
+    block.unusedRanges.push_back(index);
+    index = prev;
+  }
+
+  uint32_t next = block.ranges[index].nextPhysical;
+  if (next != NO_RANGE && block.ranges[next].free)
+  {
+    removeFree(block, next);
+    block.ranges[index].size += block.ranges[next].size;
+    block.ranges[index].nextPhysical = block.ranges[next].nextPhysical;
+    if (block.ranges[next].nextPhysical != NO_RANGE)
+      block.ranges[block.ranges[next].nextPhysical].prevPhysical = index;
+    block.unusedRanges.push_back(next);
+  }
+
+  insertFree(block, index);
+}
+
+uint32_t MemoryAllocator::newRange(Block &block)
+{
+  if (!block.unusedRanges.empty())
+  {
+    uint32_t index = block.unusedRanges.back();
+    block.unusedRanges.pop_back();
+    return index;
+  }
+
+  block.ranges.emplace_back();
+  return static_cast<uint32_t>(block.ranges.size() - 1);
+}
+
+void MemoryAllocator::insertFree(Block &block, uint32_t rangeIndex)
+{
+  uint32_t firstLevel, secondLevel;
+  mapping(block.ranges[rangeIndex].size, firstLevel, secondLevel);
+  uint32_t &head = block.freeHeads[firstLevel * SECOND_LEVEL_COUNT + secondLevel];
+
+  Range &range = block.ranges[rangeIndex];
+  range.free = true;
+  range.prevFree = NO_RANGE;
+  range.nextFree = head;
+  if (head != NO_RANGE)
+    block.ranges[head].prevFree = rangeIndex;
+  head = rangeIndex;
+
+  block.firstLevelBitmap |= 1ull << firstLevel;
+  block.secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+void MemoryAllocator::removeFree(Block &block, uint32_t rangeIndex)
+{
+  uint32_t firstLevel, secondLevel;
+  mapping(block.ranges[rangeIndex].size, firstLevel, secondLevel);
+  uint32_t &head = block.freeHeads[firstLevel * SECOND_LEVEL_COUNT + secondLevel];
+
+  Range &range = block.ranges[rangeIndex];
+  if (range.prevFree != NO_RANGE)
+    block.ranges[range.prevFree].nextFree = range.nextFree;
+  else
+    head = range.nextFree;
+  if (range.nextFree != NO_RANGE)
+    block.ranges[range.nextFree].prevFree = range.prevFree;
+  range.prevFree = NO_RANGE;
+  range.nextFree = NO_RANGE;
+
+  if (head == NO_RANGE)
+  {
+    block.secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+    if (block.secondLevelBitmaps[firstLevel] == 0)
+      block.firstLevelBitmap &= ~(1ull << firstLevel);
+  }
+}
@@ -7,12 +7,31 @@
 #include <tiny_obj_loader.h>
 #include <glm/gtc/quaternion.hpp>
 #include <noImage.hpp>
+#include <algorithm>
+
+uint32_t materialFeatures(const MaterialData &material)
+{
+  // the skybox only reads its albedo
+  if (material.isSkybox == 1)
+    return FeatureSkybox | (material.hasAlbedoMap == 1 ? FeatureAlbedoMap : 0);
+
+  uint32_t features = 0;
+  features |= material.hasAlbedoMap == 1 ? FeatureAlbedoMap : 0;
+  features |= material.hasNormalMap == 1 ? FeatureNormalMap : 0;
+  features |= material.hasRoughnessMap == 1 ? FeatureRoughnessMap : 0;
+  features |= material.hasMetallicMap == 1 ? FeatureMetallicMap : 0;
+  features |= material.hasAOMap == 1 ? FeatureAOMap : 0;
+  features |= material.hasEmissiveMap == 1 ? FeatureEmissiveMap : 0;
+  return features;
+}
 
 Mesh::Mesh(Renderer &renderer, std::shared_ptr<TextureManager> texture, int *nextRenderingId, MaterialData newMaterial, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) : vertices(vertices), indices(indices), material(newMaterial), textureManager(texture)
 {
   ownsTextureManager = false;
   id = *nextRenderingId;
   (*nextRenderingId)++;
+  geometryId = -1;
+  bounds = BoundingVolume::fromVertices(vertices);
 }
 
 Mesh::Mesh(Renderer &renderer, int *nextRenderingId, MaterialData newMaterial, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices) : vertices(vertices), indices(indices), material(newMaterial), textureManager(std::make_shared<TextureManager>(renderer.bufferManager, renderer))
@@ -20,6 +39,52 @@ Mesh::Mesh(Renderer &renderer, int *nextRenderingId, MaterialData newMaterial, c
   ownsTextureManager = true;
   id = *nextRenderingId;
   (*nextRenderingId)++;
+  geometryId = -1;
+  bounds = BoundingVolume::fromVertices(vertices);
+}
+
+void Mesh::buildLods()
+{
+  lodChain = buildMeshLods(vertices, indices);
+  lodLevel = 0;
+}
+
+void Mesh::setLods(const MeshLodChain &chain)
+{
+  // the model changed since the chain was cooked
+  uint32_t end = static_cast<uint32_t>(indices.size());
+  bool fits = true;
+  for (const MeshLod &lod : chain.lods)
+  {
+    fits &= lod.firstIndex == end && lod.indexCount % 3 == 0;
+    end += lod.indexCount;
+  }
+  fits &= end == indices.size() + chain.indices.size();
+  for (uint32_t index : chain.indices)
+    fits &= index < vertices.size();
+  // an empty chain on a mesh big enough to simplify was never built, not cooked empty on purpose
+  fits &= !chain.lods.empty() || indices.size() / 3 < MESH_LOD_MIN_TRIANGLES;
+
+  if (!fits)
+  {
+    std::cerr << "Cooked LODs don't match the mesh, simplifying it again" << std::endl;
+    buildLods();
+    return;
+  }
+  lodChain = chain;
+  lodLevel = 0;
+}
+
+std::vector<uint32_t> Mesh::uploadedIndices() const
+{
+  if (lodChain.indices.empty())
+    return indices;
+
+  std::vector<uint32_t> uploaded;
+  uploaded.reserve(indices.size() + lodChain.indices.size());
+  uploaded.insert(uploaded.end(), indices.begin(), indices.end());
+  uploaded.insert(uploaded.end(), lodChain.indices.begin(), lodChain.indices.end());
+  return uploaded;
 }
 
 void Mesh::initGraphics(Renderer &renderer)
@@ -30,14 +95,11 @@ void Mesh::initGraphics(Renderer &renderer)
     return;
   }
 
-  renderer.bufferManager.createVertexBuffer(vertices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
-
-  renderer.bufferManager.createIndexBuffer(indices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
-
-  renderer.bufferManager.createUniformBuffers(renderer.MAX_FRAMES_IN_FLIGHT, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, 1);
-
-  TextureMaps textureMaps(textureManager->albedoImageView, textureManager->albedoSampler, textureManager->normalImageView, textureManager->normalSampler, textureManager->heightImageView, textureManager->heightSampler, textureManager->roughnessImageView, textureManager->roughnessSampler, textureManager->metallicImageView, textureManager->metallicSampler, textureManager->aoImageView, textureManager->aoSampler, textureManager->emissiveImageView, textureManager->emissiveSampler);
-  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, 1, textureMaps);
+  geometryId = renderer.bufferManager.acquireGeometry(vertices, uploadedIndices(), renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.graphicsQueue);
+  uploadTicket = textureManager->uploadTicket;
+  if (geometryId >= 0)
+    uploadTicket = std::max(uploadTicket, renderer.bufferManager.geometryArena.get(geometryId).uploadTicket);
+  textures = renderer.descriptorManager.acquireMaterialTextures(renderer.deviceManager.device, *textureManager);
 }
 
 void Mesh::initGraphics(Renderer &renderer, std::string texturePath, std::string normalPath, std::string heightPath, std::string roughnessPath, std::string metallicPath, std::string aoPath, std::string emissivePath)
@@ -49,103 +111,30 @@ void Mesh::initGraphics(Renderer &renderer, std::string texturePath, std::string
   }
 
   texPath = texturePath;
-  textureManager->createTextureImages(texturePath, normalPath, heightPath, roughnessPath, metallicPath, aoPath, emissivePath, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
+  if (renderer.textureStreaming)
+    textureManager->streamTextureImages(texturePath, normalPath, heightPath, roughnessPath, metallicPath, aoPath, emissivePath, renderer.deviceManager.device, renderer.deviceManager.physicalDevice);
+  else
+    textureManager->createTextureImages(texturePath, normalPath, heightPath, roughnessPath, metallicPath, aoPath, emissivePath, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
   textureManager->createTextureImageView(renderer.deviceManager.device);
   textureManager->createTextureSampler(renderer.deviceManager.device, renderer.deviceManager.physicalDevice);
 
-  renderer.bufferManager.createVertexBuffer(vertices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
-
-  renderer.bufferManager.createIndexBuffer(indices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
-
-  renderer.bufferManager.createUniformBuffers(renderer.MAX_FRAMES_IN_FLIGHT, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, 1);
-
-  TextureMaps textureMaps(textureManager->albedoImageView, textureManager->albedoSampler, textureManager->normalImageView, textureManager->normalSampler, textureManager->heightImageView, textureManager->heightSampler, textureManager->roughnessImageView, textureManager->roughnessSampler, textureManager->metallicImageView, textureManager->metallicSampler, textureManager->aoImageView, textureManager->aoSampler, textureManager->emissiveImageView, textureManager->emissiveSampler);
-  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, 1, textureMaps);
-}
-
-void Mesh::draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, glm::mat4 view, glm::mat4 projectionMatrix, VkCommandBuffer commandBuffer, int colorStageID)
-{
-
-  VkBuffer vertexBuffersArray[] = {renderer->bufferManager.vertexBuffers[id]};
-  VkDeviceSize offsets[] = {0};
-  vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersArray, offsets);
-
-  vkCmdBindIndexBuffer(commandBuffer, renderer->bufferManager.indexBuffers[id], 0, VK_INDEX_TYPE_UINT32);
-
-  if (colorStageID == -1)
-  {
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.pipelineLayout, 0, 1, &renderer->descriptorManager.descriptorSets[currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT], 0, nullptr);
-
-    renderer->bufferManager.updateUniformBuffer(currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT, transformation, view, projectionMatrix);
-
-    vkCmdPushConstants(
-        commandBuffer,
-        renderer->pipelineManager.pipelineLayout,
-        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        0,
-        sizeof(MaterialData),
-        &material);
-  }
-  else
-  {
-    struct ColorIDPushConstant
-    {
-      int id;
-    };
-    ColorIDPushConstant pc;
-    pc.id = colorStageID;
-
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.colorIDPipelineLayout, 0, 1, &renderer->descriptorManager.descriptorSets[currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT], 0, nullptr);
-
-    renderer->bufferManager.updateUniformBuffer(currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT, transformation, view, projectionMatrix);
-
-    vkCmdPushConstants(
-        commandBuffer,
-        renderer->pipelineManager.colorIDPipelineLayout,
-        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
-        0,
-        sizeof(ColorIDPushConstant),
-        &pc);
-  }
-
-  vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+  geometryId = renderer.bufferManager.acquireGeometry(vertices, uploadedIndices(), renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.graphicsQueue);
+  uploadTicket = textureManager->uploadTicket;
+  if (geometryId >= 0)
+    uploadTicket = std::max(uploadTicket, renderer.bufferManager.geometryArena.get(geometryId).uploadTicket);
+  textures = renderer.descriptorManager.acquireMaterialTextures(renderer.deviceManager.device, *textureManager);
 }
 
 void Mesh::cleanup(VkDevice device, Renderer &renderer)
 {
+  renderer.descriptorManager.releaseMaterialTextures(*textureManager);
+
   if (ownsTextureManager)
   {
     textureManager->cleanup(device);
   }
 
-  if (renderer.bufferManager.vertexBuffers.size() > id && renderer.bufferManager.vertexBuffers[id] != VK_NULL_HANDLE)
-  {
-    vkDestroyBuffer(device, renderer.bufferManager.vertexBuffers[id], nullptr);
-    renderer.bufferManager.vertexBuffers[id] = VK_NULL_HANDLE;
-  }
-
-  if (renderer.bufferManager.indexBuffers.size() > id && renderer.bufferManager.indexBuffers[id] != VK_NULL_HANDLE)
-  {
-    vkDestroyBuffer(device, renderer.bufferManager.indexBuffers[id], nullptr);
-    renderer.bufferManager.indexBuffers[id] = VK_NULL_HANDLE;
-  }
-
-  for (int i = 0; i < renderer.MAX_FRAMES_IN_FLIGHT; i++)
-  {
-    vkDestroyBuffer(device, renderer.bufferManager.uniformBuffers[id * renderer.MAX_FRAMES_IN_FLIGHT + i], nullptr);
-
-    renderer.bufferManager.uniformBuffers[id * renderer.MAX_FRAMES_IN_FLIGHT + i] = VK_NULL_HANDLE;
-  }
-
-  uint32_t descriptorSetCount = renderer.MAX_FRAMES_IN_FLIGHT;
-  uint32_t startIndex = id * renderer.MAX_FRAMES_IN_FLIGHT;
-  if (renderer.descriptorManager.descriptorSets.size() >= startIndex + descriptorSetCount)
-  {
-    VkDescriptorSet *pDescriptorSets = renderer.descriptorManager.descriptorSets.data() + startIndex;
-    VkResult result = vkFreeDescriptorSets(device, renderer.descriptorManager.descriptorPool, descriptorSetCount, pDescriptorSets);
-    if (result != VK_SUCCESS)
-    {
-      std::cerr << "Failed to free descriptor sets for mesh id " << id << std::endl;
-    }
-  }
-}
\ No newline at end of file
+  // other meshes might still be drawing from the same geometry, the arena space is reclaimed after the last one
+  renderer.bufferManager.releaseGeometry(geometryId);
+  geometryId = -1;
+}
@@ -0,0 +1,421 @@
+#include "meshSimplifier.hpp"
+#include <algorithm>
+#include <numeric>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+
+// symmetric 4x4 matrix of a set of planes, the error at a point is the sum of its squared distances to them
+struct Quadric
+{
+  double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+  double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+  double a22 = 0.0, a23 = 0.0;
+  double a33 = 0.0;
+
+  void addPlane(const glm::dvec3 &n, double d)
+  {
+    a00 += n.x * n.x;
+    a01 += n.x * n.y;
+    a02 += n.x * n.z;
+    a03 += n.x * d;
+    a11 += n.y * n.y;
+    a12 += n.y * n.z;
+    a13 += n.y * d;
+    a22 += n.z * n.z;
+    a23 += n.z * d;
+    a33 += d * d;
+  }
+
+  void add(const Quadric &q)
+  {
+    a00 += q.a00;
+    a01 += q.a01;
+    a02 += q.a02;
+    a03 += q.a03;
+    a11 += q.a11;
+    a12 += q.a12;
+    a13 += q.a13;
+    a22 += q.a22;
+    a23 += q.a23;
+    a33 += q.a33;
+  }
+
+  double error(const glm::vec3 &p) const
+  {
+    double x = p.x, y = p.y, z = p.z;
+    double e = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x +
+               a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y +
+               a22 * z * z + 2.0 * a23 * z + a33;
+    // rounding can push a zero error slightly negative
+    return std::max(e, 0.0);
+  }
+};
+
+struct Collapse
+{
+  double cost;
+  // geometric part of the cost, the level's error only grows by this
+  double error;
+  uint32_t from;
+  uint32_t to;
+};
+
+// mesh state shared by every level, collapses only ever reduce it further
+// a collapse moves a whole position, with every attribute copy at it landing on one of the copies at the target position
+struct SimplifyState
+{
+  const std::vector<Vertex> &vertices;
+  // vertex of the position group a vertex belongs to, quadrics, topology and collapses work on positions
+  std::vector<uint32_t> position;
+  // the welded vertices sharing each position, indexed by the position's vertex
+  std::vector<uint32_t> copyOffsets;
+  std::vector<uint32_t> copies;
+  std::vector<uint8_t> locked;
+  std::vector<Quadric> quadrics;
+  std::vector<uint32_t> triangles;
+  float error = 0.0f;
+
+  // triangles around each vertex, rebuilt at the start of every pass
+  std::vector<uint32_t> adjacencyOffsets;
+  std::vector<uint32_t> adjacency;
+
+  // filled by mapCopies, the copy at the target each copy at the collapsed position moves onto
+  std::vector<uint32_t> targets;
+
+  explicit SimplifyState(const std::vector<Vertex> &vertices) : vertices(vertices) {}
+
+  void buildAdjacency();
+  bool mapCopies(uint32_t from, uint32_t to, double &attributeError);
+  bool canCollapse(uint32_t from, uint32_t to);
+  // one independent set of collapses, returns the number of triangles they remove
+  uint32_t collapsePass(uint32_t trianglesToRemove);
+};
+
+static double attributeDistance(const Vertex &a, const Vertex &b)
+{
+  glm::vec3 normal = a.normal - b.normal;
+  glm::vec4 texPos = a.texPos - b.texPos;
+  glm::vec3 color = a.color - b.color;
+  return glm::dot(normal, normal) + glm::dot(texPos, texPos) + glm::dot(color, color);
+}
+
+void SimplifyState::buildAdjacency()
+{
+  adjacencyOffsets.assign(vertices.size() + 1, 0);
+  for (uint32_t v : triangles)
+    adjacencyOffsets[v + 1]++;
+  for (size_t i = 1; i < adjacencyOffsets.size(); i++)
+    adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+
+  adjacency.resize(triangles.size());
+  std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+  for (size_t i = 0; i < triangles.size(); i++)
+    adjacency[fill[triangles[i]]++] = static_cast<uint32_t>(i / 3);
+}
+
+bool SimplifyState::mapCopies(uint32_t from, uint32_t to, double &attributeError)
+{
+  targets.clear();
+  attributeError = 0.0;
+  for (uint32_t c = copyOffsets[from]; c < copyOffsets[from + 1]; c++)
+  {
+    uint32_t copy = copies[c];
+    // nothing references the copy anymore, it stays where it is
+    if (adjacencyOffsets[copy] == adjacencyOffsets[copy + 1])
+    {
+      targets.push_back(copy);
+      continue;
+    }
+
+    uint32_t target = UINT32_MAX;
+    // copies with triangles on the collapsed edge follow them, so a seam running along the edge stays a seam
+    for (uint32_t a = adjacencyOffsets[copy]; a < adjacencyOffsets[copy + 1]; a++)
+    {
+      const uint32_t *triangle = &triangles[adjacency[a] * 3];
+      for (int k = 0; k < 3; k++)
+      {
+        if (position[triangle[k]] != to)
+          continue;
+        // the seam ends at the collapsed position, the two sides can't both keep their attributes
+        if (target != UINT32_MAX && target != triangle[k])
+          return false;
+        target = triangle[k];
+      }
+    }
+
+    // copies away from the edge take the closest attributes at the target, the difference is paid for in the cost
+    if (target == UINT32_MAX)
+    {
+      double best = DBL_MAX;
+      for (uint32_t t = copyOffsets[to]; t < copyOffsets[to + 1]; t++)
+      {
+        uint32_t candidate = copies[t];
+        if (adjacencyOffsets[candidate] == adjacencyOffsets[candidate + 1])
+          continue;
+        double distance = attributeDistance(vertices[copy], vertices[candidate]);
+        if (distance < best)
+        {
+          best = distance;
+          target = candidate;
+        }
+      }
+      if (target == UINT32_MAX)
+        return false;
+      attributeError = std::max(attributeError, best);
+    }
+    targets.push_back(target);
+  }
+  return true;
+}
+
+bool SimplifyState::canCollapse(uint32_t from, uint32_t to)
+{
+  double attributeError;
+  if (!mapCopies(from, to, attributeError))
+    return false;
+
+  const glm::vec3 &target = vertices[to].pos;
+  for (uint32_t c = copyOffsets[from]; c < copyOffsets[from + 1]; c++)
+  {
+    for (uint32_t a = adjacencyOffsets[copies[c]]; a < adjacencyOffsets[copies[c] + 1]; a++)
+    {
+      const uint32_t *triangle = &triangles[adjacency[a] * 3];
+      // the triangles on the edge disappear, the rest must not fold over
+      if (position[triangle[0]] == to || position[triangle[1]] == to || position[triangle[2]] == to)
+        continue;
+
+      glm::vec3 corners[3];
+      glm::vec3 moved[3];
+      for (int k = 0; k < 3; k++)
+      {
+        corners[k] = vertices[triangle[k]].pos;
+        moved[k] = position[triangle[k]] == from ? target : corners[k];
+      }
+      glm::vec3 before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+      glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+      if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after))
+        return false;
+    }
+  }
+  return true;
+}
+
+uint32_t SimplifyState::collapsePass(uint32_t trianglesToRemove)
+{
+  buildAdjacency();
+
+  std::vector<Collapse> candidates;
+  candidates.reserve(triangles.size() * 2);
+  for (size_t i = 0; i < triangles.size(); i += 3)
+  {
+    for (int k = 0; k < 3; k++)
+    {
+      uint32_t a = position[triangles[i + k]];
+      uint32_t b = position[triangles[i + (k + 1) % 3]];
+      Quadric q = quadrics[a];
+      q.add(quadrics[b]);
+      // moving attributes by the length of the edge costs as much as moving the surface that far
+      glm::vec3 edge = vertices[b].pos - vertices[a].pos;
+      double edgeLength = glm::dot(edge, edge);
+      double attributeError;
+      if (!locked[a] && mapCopies(a, b, attributeError))
+      {
+        double error = q.error(vertices[b].pos);
+        candidates.push_back({error + attributeError * edgeLength, error, a, b});
+      }
+      if (!locked[b] && mapCopies(b, a, attributeError))
+      {
+        double error = q.error(vertices[a].pos);
+        candidates.push_back({error + attributeError * edgeLength, error, b, a});
+      }
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), [](const Collapse &l, const Collapse &r)
+            { return l.cost < r.cost; });
+
+  // a collapse changes every triangle around the removed position, so their corners sit out the rest of the pass
+  std::vector<uint8_t> touched(vertices.size(), 0);
+  std::vector<uint32_t> collapsed(vertices.size());
+  std::iota(collapsed.begin(), collapsed.end(), 0u);
+
+  uint32_t removed = 0;
+  for (const Collapse &collapse : candidates)
+  {
+    if (removed >= trianglesToRemove)
+      break;
+    if (touched[collapse.from] || touched[collapse.to] || !canCollapse(collapse.from, collapse.to))
+      continue;
+
+    for (uint32_t c = copyOffsets[collapse.from]; c < copyOffsets[collapse.from + 1]; c++)
+    {
+      uint32_t copy = copies[c];
+      for (uint32_t a = adjacencyOffsets[copy]; a < adjacencyOffsets[copy + 1]; a++)
+      {
+        const uint32_t *triangle = &triangles[adjacency[a] * 3];
+        bool sharesEdge = false;
+        for (int k = 0; k < 3; k++)
+        {
+          touched[position[triangle[k]]] = 1;
+          sharesEdge |= position[triangle[k]] == collapse.to;
+        }
+        removed += sharesEdge;
+      }
+      collapsed[copy] = targets[c - copyOffsets[collapse.from]];
+    }
+
+    quadrics[collapse.to].add(quadrics[collapse.from]);
+    error = std::max(error, static_cast<float>(std::sqrt(collapse.error)));
+  }
+
+  // triangles that lost an edge have two corners on the same position now
+  size_t kept = 0;
+  for (size_t i = 0; i < triangles.size(); i += 3)
+  {
+    uint32_t a = collapsed[triangles[i]];
+    uint32_t b = collapsed[triangles[i + 1]];
+    uint32_t c = collapsed[triangles[i + 2]];
+    if (position[a] == position[b] || position[b] == position[c] || position[c] == position[a])
+      continue;
+    triangles[kept++] = a;
+    triangles[kept++] = b;
+    triangles[kept++] = c;
+  }
+  triangles.resize(kept);
+  return removed;
+}
+
+MeshLodChain buildMeshLods(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, uint32_t maxLods)
+{
+  MeshLodChain chain;
+  if (indices.size() % 3 != 0 || indices.size() / 3 < MESH_LOD_MIN_TRIANGLES)
+    return chain;
+  for (uint32_t index : indices)
+    if (index >= vertices.size())
+      return chain;
+
+  SimplifyState state(vertices);
+
+  // loaders emit a vertex per corner, identical ones are welded so the triangles share edges
+  std::vector<uint32_t> order(indices);
+  std::sort(order.begin(), order.end());
+  order.erase(std::unique(order.begin(), order.end()), order.end());
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+            {
+              int byPosition = memcmp(&vertices[a].pos, &vertices[b].pos, sizeof(glm::vec3));
+              if (byPosition != 0)
+                return byPosition < 0;
+              return memcmp(&vertices[a], &vertices[b], sizeof(Vertex)) < 0; });
+
+  std::vector<uint32_t> weld(vertices.size());
+  state.position.resize(vertices.size());
+  state.locked.assign(vertices.size(), 0);
+  state.copyOffsets.assign(vertices.size() + 1, 0);
+  for (size_t i = 0; i < order.size();)
+  {
+    size_t groupEnd = i + 1;
+    while (groupEnd < order.size() && memcmp(&vertices[order[i]].pos, &vertices[order[groupEnd]].pos, sizeof(glm::vec3)) == 0)
+      groupEnd++;
+
+    // ties on position but not on the rest of the vertex are seams, each side keeps its own copy
+    for (size_t j = i; j < groupEnd; j++)
+    {
+      uint32_t v = order[j];
+      bool duplicate = j > i && memcmp(&vertices[order[j - 1]], &vertices[v], sizeof(Vertex)) == 0;
+      weld[v] = duplicate ? weld[order[j - 1]] : v;
+      state.position[v] = order[i];
+      if (!duplicate)
+        state.copyOffsets[order[i] + 1]++;
+    }
+    i = groupEnd;
+  }
+  for (size_t i = 1; i < state.copyOffsets.size(); i++)
+    state.copyOffsets[i] += state.copyOffsets[i - 1];
+  state.copies.resize(state.copyOffsets.back());
+  std::vector<uint32_t> copyFill(state.copyOffsets.begin(), state.copyOffsets.end() - 1);
+  for (uint32_t v : order)
+    if (weld[v] == v)
+      state.copies[copyFill[state.position[v]]++] = v;
+
+  state.triangles.reserve(indices.size());
+  for (size_t i = 0; i < indices.size(); i += 3)
+  {
+    uint32_t a = weld[indices[i]], b = weld[indices[i + 1]], c = weld[indices[i + 2]];
+    if (state.position[a] == state.position[b] || state.position[b] == state.position[c] || state.position[c] == state.position[a])
+      continue;
+    state.triangles.push_back(a);
+    state.triangles.push_back(b);
+    state.triangles.push_back(c);
+  }
+
+  // edges used by one triangle are open borders, more than two is non manifold, both stay where they are
+  std::vector<std::pair<uint32_t, uint32_t>> edges;
+  edges.reserve(state.triangles.size());
+  state.quadrics.assign(vertices.size(), Quadric());
+  for (size_t i = 0; i < state.triangles.size(); i += 3)
+  {
+    glm::vec3 p0 = vertices[state.triangles[i]].pos;
+    glm::vec3 p1 = vertices[state.triangles[i + 1]].pos;
+    glm::vec3 p2 = vertices[state.triangles[i + 2]].pos;
+    glm::dvec3 normal = glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+    double length = glm::length(normal);
+    if (length > 0.0)
+    {
+      normal /= length;
+      double d = -glm::dot(normal, glm::dvec3(p0));
+      for (int k = 0; k < 3; k++)
+        state.quadrics[state.position[state.triangles[i + k]]].addPlane(normal, d);
+    }
+
+    for (int k = 0; k < 3; k++)
+    {
+      uint32_t a = state.position[state.triangles[i + k]];
+      uint32_t b = state.position[state.triangles[i + (k + 1) % 3]];
+      edges.emplace_back(std::min(a, b), std::max(a, b));
+    }
+  }
+  std::sort(edges.begin(), edges.end());
+  for (size_t i = 0; i < edges.size();)
+  {
+    size_t next = i + 1;
+    while (next < edges.size() && edges[next] == edges[i])
+      next++;
+    if (next - i != 2)
+    {
+      state.locked[edges[i].first] = 1;
+      state.locked[edges[i].second] = 1;
+    }
+    i = next;
+  }
+  uint32_t firstIndex = static_cast<uint32_t>(indices.size());
+  uint32_t previousTriangles = static_cast<uint32_t>(indices.size() / 3);
+  for (uint32_t level = 0; level < maxLods; level++)
+  {
+    uint32_t target = previousTriangles / 2;
+    uint32_t triangleCount = static_cast<uint32_t>(state.triangles.size() / 3);
+    while (triangleCount > target)
+    {
+      if (state.collapsePass(triangleCount - target) == 0)
+        break;
+      triangleCount = static_cast<uint32_t>(state.triangles.size() / 3);
+    }
+
+    // the open borders hold the rest of the mesh in place, another level would draw about the same
+    if (triangleCount > previousTriangles * 3 / 4 || triangleCount == 0)
+      break;
+
+    MeshLod lod;
+    lod.firstIndex = firstIndex;
+    lod.indexCount = static_cast<uint32_t>(state.triangles.size());
+    lod.error = state.error;
+    chain.lods.push_back(lod);
+    chain.indices.insert(chain.indices.end(), state.triangles.begin(), state.triangles.end());
+
+    firstIndex += lod.indexCount;
+    previousTriangles = triangleCount;
+    if (triangleCount < MESH_LOD_MIN_TRIANGLES / 4)
+      break;
+  }
+  return chain;
+}
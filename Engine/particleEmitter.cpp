@@ -45,14 +45,13 @@ void ParticleEmitter::initGraphics(Renderer &renderer, std::string texturePath)
   textureManager.createTextureImages(texturePath, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, NO_IMAGE, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
   textureManager.createTextureImageView(renderer.deviceManager.device);
   textureManager.createTextureSampler(renderer.deviceManager.device, renderer.deviceManager.physicalDevice);
-
-  renderer.bufferManager.createUniformBuffers(renderer.MAX_FRAMES_IN_FLIGHT, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, 1);
+  renderer.bufferManager.uploadManager.wait(textureManager.uploadTicket);
 
   TextureMaps textureMaps(textureManager.albedoImageView, textureManager.albedoSampler, textureManager.normalImageView, textureManager.normalSampler, textureManager.heightImageView, textureManager.heightSampler, textureManager.roughnessImageView, textureManager.roughnessSampler, textureManager.metallicImageView, textureManager.metallicSampler, textureManager.aoImageView, textureManager.aoSampler, textureManager.emissiveImageView, textureManager.emissiveSampler);
-  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, 1, textureMaps);
+  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, id, textureMaps);
 }
 
-void ParticleEmitter::draw(Renderer *renderer, int currentFrame, glm::mat4 view, glm::mat4 projectionMatrix, VkCommandBuffer commandBuffer)
+void ParticleEmitter::draw(Renderer *renderer, int currentFrame, VkCommandBuffer commandBuffer)
 {
   if (hide)
     return;
@@ -61,12 +60,12 @@ void ParticleEmitter::draw(Renderer *renderer, int currentFrame, glm::mat4 view,
   VkDeviceSize offsets[] = {0};
   vkCmdBindVertexBuffers(commandBuffer, 1, 1, vertexBuffers, offsets);
 
-  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.pipelineLayout, 0, 1, &renderer->descriptorManager.descriptorSets[currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT], 0, nullptr);
-
   glm::mat4 transform = glm::mat4(1.0f);
   transform = glm::translate(transform, pos) * glm::mat4(rotation);
   transform = glm::scale(transform, glm::vec3(0.2));
-  renderer->bufferManager.updateUniformBuffer(currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT, transform, view, projectionMatrix);
+  uint32_t dynamicOffset = renderer->bufferManager.pushObjectUniforms(currentFrame, transform, CameraScene);
+  VkDescriptorSet descriptorSets[] = {renderer->descriptorManager.descriptorSets[currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT], renderer->descriptorManager.frameDescriptorSets[currentFrame]};
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.pipelineLayout, 0, 2, descriptorSets, 1, &dynamicOffset);
 
   MaterialData materialData;
   materialData.albedoColor = glm::vec3(0);
@@ -2,9 +2,16 @@
 #include "ECSRegistry.hpp"
 #include "debugDrawer.hpp"
 #include <algorithm>
-#include <unordered_set>
+#include <cmath>
+#include <cfloat>
+#include <chrono>
 
-bool PhysicsSystem::SATCollision(Entity entityA, Entity entityB, const BoxColliderComponent &a, const BoxColliderComponent &b, glm::vec3 &mtv, glm::vec3 &collisionNormal)
+static double millisecondsSince(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool PhysicsSystem::SATCollision(Entity entityA, Entity entityB, const BoxColliderComponent &a, const BoxColliderComponent &b, glm::vec3 &mtv, glm::vec3 &collisionNormal, CollisionPair *pair)
 {
   bool entityAHasTransform = registry.transforms.find(entityA) != registry.transforms.end();
   bool entityBHasTransform = registry.transforms.find(entityB) != registry.transforms.end();
@@ -34,19 +41,47 @@ bool PhysicsSystem::SATCollision(Entity entityA, Entity entityB, const BoxCollid
   auto aCorners = a.getWorldCorners(ta.position, ta.rotationZYX, ta.scale);
   auto bCorners = b.getWorldCorners(tb.position, tb.rotationZYX, tb.scale);
 
+  auto projectionsSeparate = [&](const glm::vec3 &axis)
+  {
+    float minA = FLT_MAX, maxA = -FLT_MAX;
+    float minB = FLT_MAX, maxB = -FLT_MAX;
+    for (const glm::vec3 &v : aCorners)
+    {
+      float projection = glm::dot(v, axis);
+      minA = std::min(minA, projection);
+      maxA = std::max(maxA, projection);
+    }
+    for (const glm::vec3 &v : bCorners)
+    {
+      float projection = glm::dot(v, axis);
+      minB = std::min(minB, projection);
+      maxB = std::max(maxB, projection);
+    }
+    return maxA < minB || maxB < minA;
+  };
+
+  // whatever separated the pair last step usually still does, so try it before the full 15 axes
+  if (pair != nullptr && pair->hasSeparatingAxis && projectionsSeparate(pair->separatingAxis))
+  {
+    stats.satEarlyOuts++;
+    return false;
+  }
+
   glm::vec3 aAxes[3], bAxes[3];
   a.getWorldAxes(ta.rotationZYX, aAxes);
   b.getWorldAxes(tb.rotationZYX, bAxes);
 
-  std::vector<glm::vec3> axes;
+  // 3 face axes per box plus at most 9 edge cross products
+  glm::vec3 axes[15];
+  int axisCount = 0;
 
-  axes.push_back(glm::normalize(aAxes[0]));
-  axes.push_back(glm::normalize(aAxes[1]));
-  axes.push_back(glm::normalize(aAxes[2]));
+  axes[axisCount++] = glm::normalize(aAxes[0]);
+  axes[axisCount++] = glm::normalize(aAxes[1]);
+  axes[axisCount++] = glm::normalize(aAxes[2]);
 
-  axes.push_back(glm::normalize(bAxes[0]));
-  axes.push_back(glm::normalize(bAxes[1]));
-  axes.push_back(glm::normalize(bAxes[2]));
+  axes[axisCount++] = glm::normalize(bAxes[0]);
+  axes[axisCount++] = glm::normalize(bAxes[1]);
+  axes[axisCount++] = glm::normalize(bAxes[2]);
 
   for (int i = 0; i < 3; i++)
   {
@@ -54,15 +89,16 @@ bool PhysicsSystem::SATCollision(Entity entityA, Entity entityB, const BoxCollid
     {
       glm::vec3 axis = glm::cross(aAxes[i], bAxes[j]);
       if (glm::length(axis) > 1e-6f)
-        axes.push_back(glm::normalize(axis));
+        axes[axisCount++] = glm::normalize(axis);
     }
   }
 
   float minOverlap = FLT_MAX;
   glm::vec3 smallestAxis;
 
-  for (const glm::vec3 &axis : axes)
+  for (int axisIndex = 0; axisIndex < axisCount; axisIndex++)
   {
+    const glm::vec3 &axis = axes[axisIndex];
     float minA = FLT_MAX, maxA = -FLT_MAX;
     float minB = FLT_MAX, maxB = -FLT_MAX;
 
@@ -82,6 +118,11 @@ bool PhysicsSystem::SATCollision(Entity entityA, Entity entityB, const BoxCollid
 
     if (maxA < minB || maxB < minA)
     {
+      if (pair != nullptr)
+      {
+        pair->hasSeparatingAxis = true;
+        pair->separatingAxis = axis;
+      }
       return false;
     }
     else
@@ -155,8 +196,127 @@ bool PhysicsSystem::SATCollision(Entity entityA, Entity entityB, const BoxCollid
   return true;
 }
 
-void PhysicsSystem::update(float deltaTime)
+// branch free SoA loop so the compiler can vectorize it across colliders
+// the columns only get treated as non aliasing through __restrict parameters, the same qualifiers on locals leave the loop scalar in gcc
+static void refitKernel(size_t count, const float *__restrict cx, const float *__restrict cy, const float *__restrict cz,
+                        const float *__restrict hx, const float *__restrict hy, const float *__restrict hz,
+                        const float *__restrict r00, const float *__restrict r01, const float *__restrict r02,
+                        const float *__restrict r10, const float *__restrict r11, const float *__restrict r12,
+                        const float *__restrict r20, const float *__restrict r21, const float *__restrict r22,
+                        float *__restrict minX, float *__restrict minY, float *__restrict minZ,
+                        float *__restrict maxX, float *__restrict maxY, float *__restrict maxZ)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    float worldX = r00[i] * cx[i] + r01[i] * cy[i] + r02[i] * cz[i] + minX[i];
+    float worldY = r10[i] * cx[i] + r11[i] * cy[i] + r12[i] * cz[i] + minY[i];
+    float worldZ = r20[i] * cx[i] + r21[i] * cy[i] + r22[i] * cz[i] + minZ[i];
+
+    float extentX = std::fabs(r00[i]) * hx[i] + std::fabs(r01[i]) * hy[i] + std::fabs(r02[i]) * hz[i];
+    float extentY = std::fabs(r10[i]) * hx[i] + std::fabs(r11[i]) * hy[i] + std::fabs(r12[i]) * hz[i];
+    float extentZ = std::fabs(r20[i]) * hx[i] + std::fabs(r21[i]) * hy[i] + std::fabs(r22[i]) * hz[i];
+
+    minX[i] = worldX - extentX;
+    minY[i] = worldY - extentY;
+    minZ[i] = worldZ - extentZ;
+    maxX[i] = worldX + extentX;
+    maxY[i] = worldY + extentY;
+    maxZ[i] = worldZ + extentZ;
+  }
+}
+
+void PhysicsSystem::ColliderRefitBatch::allocate(ScratchArena &scratch, size_t count)
+{
+  colliders = scratch.allocateArray<BoxColliderComponent *>(count);
+  for (float **array : {&centerX, &centerY, &centerZ, &halfX, &halfY, &halfZ, &r00, &r01, &r02, &r10, &r11, &r12, &r20, &r21, &r22, &minX, &minY, &minZ, &maxX, &maxY, &maxZ})
+  {
+    *array = scratch.allocateArray<float>(count);
+  }
+}
+
+void PhysicsSystem::refitBoxColliders(ScratchArena &scratch)
+{
+  auto refitStart = std::chrono::steady_clock::now();
+  ColliderRefitBatch batch;
+  batch.allocate(scratch, registry.boxColliders.size());
+
+  // gather: only colliders whose transform changed since the last refit
+  size_t count = 0;
+  for (auto &[entity, collider] : registry.boxColliders)
+  {
+    if (!collider.autoUpdate)
+      continue;
+
+    auto transformIt = registry.transforms.find(entity);
+    if (transformIt == registry.transforms.end())
+      continue;
+
+    TransformComponent &transform = transformIt->second;
+    if (transform.version == collider.transformVersion)
+      continue;
+
+    collider.position = transform.position;
+    collider.rotationZYX = transform.rotationZYX;
+    collider.scale = transform.scale;
+    collider.transformVersion = transform.version;
+    transform.justUpdated = false;
+
+    const glm::mat3 &r = collider.getRotationMatrix(transform.rotationZYX);
+    glm::vec3 scaledMin = collider.localMin * transform.scale;
+    glm::vec3 scaledMax = collider.localMax * transform.scale;
+    glm::vec3 localCenter = (scaledMin + scaledMax) * 0.5f;
+    glm::vec3 localHalf = glm::abs((scaledMax - scaledMin) * 0.5f);
+
+    // glm is column major, so r[column][row]
+    batch.colliders[count] = &collider;
+    batch.centerX[count] = localCenter.x;
+    batch.centerY[count] = localCenter.y;
+    batch.centerZ[count] = localCenter.z;
+    batch.halfX[count] = localHalf.x;
+    batch.halfY[count] = localHalf.y;
+    batch.halfZ[count] = localHalf.z;
+    batch.r00[count] = r[0][0];
+    batch.r01[count] = r[1][0];
+    batch.r02[count] = r[2][0];
+    batch.r10[count] = r[0][1];
+    batch.r11[count] = r[1][1];
+    batch.r12[count] = r[2][1];
+    batch.r20[count] = r[0][2];
+    batch.r21[count] = r[1][2];
+    batch.r22[count] = r[2][2];
+    batch.minX[count] = transform.position.x;
+    batch.minY[count] = transform.position.y;
+    batch.minZ[count] = transform.position.z;
+    count++;
+  }
+
+  stats.collidersRefit += count;
+  if (count == 0)
+  {
+    stats.refitMs += millisecondsSince(refitStart);
+    return;
+  }
+
+  // minX/Y/Z hold the positions on the way in and the world mins on the way out
+  refitKernel(count, batch.centerX, batch.centerY, batch.centerZ, batch.halfX, batch.halfY, batch.halfZ,
+              batch.r00, batch.r01, batch.r02, batch.r10, batch.r11, batch.r12, batch.r20, batch.r21, batch.r22,
+              batch.minX, batch.minY, batch.minZ, batch.maxX, batch.maxY, batch.maxZ);
+
+  for (size_t i = 0; i < count; i++)
+  {
+    BoxColliderComponent &collider = *batch.colliders[i];
+    collider.worldMin = glm::vec3(batch.minX[i], batch.minY[i], batch.minZ[i]);
+    collider.worldMax = glm::vec3(batch.maxX[i], batch.maxY[i], batch.maxZ[i]);
+    collider.justUpdated = true;
+  }
+  stats.refitMs += millisecondsSince(refitStart);
+}
+
+void PhysicsSystem::update(float deltaTime, ScratchArena &scratch)
 {
+  stats.steps++;
+  auto phaseStart = std::chrono::steady_clock::now();
+
   auto &rigidBodies = registry.rigidBodies;
   for (auto rigidBody = rigidBodies.begin(); rigidBody != rigidBodies.end(); ++rigidBody)
   {
@@ -169,41 +329,145 @@ void PhysicsSystem::update(float deltaTime)
     rigidBody->second.applyVelocity(transform, deltaTime);
   }
 
+  stats.integrateMs += millisecondsSince(phaseStart);
+  phaseStart = std::chrono::steady_clock::now();
+
   auto &boxColliders = registry.boxColliders;
-  std::unordered_set<Entity> updatedEntities;
 
-  for (auto it1 = boxColliders.begin(); it1 != boxColliders.end(); ++it1)
+  // flat copies of the collider map so the pair loop walks arrays, resolved[i] marks colliders pushed apart this step
+  size_t colliderCount = boxColliders.size();
+  Entity *entities = scratch.allocateArray<Entity>(colliderCount);
+  BoxColliderComponent **colliders = scratch.allocateArray<BoxColliderComponent *>(colliderCount);
+  bool *resolved = scratch.allocateArray<bool>(colliderCount);
+  size_t colliderIndex = 0;
+  for (auto &[entity, collider] : boxColliders)
+  {
+    entities[colliderIndex] = entity;
+    colliders[colliderIndex] = &collider;
+    resolved[colliderIndex] = false;
+    colliderIndex++;
+  }
+
+  collisionEnterEvents.clear();
+  collisionStayEvents.clear();
+  collisionExitEvents.clear();
+  triggerEnterEvents.clear();
+  triggerStayEvents.clear();
+  triggerExitEvents.clear();
+  pairCache.beginStep();
+
+  for (size_t i = 0; i < colliderCount; i++)
   {
-    if (it1->first == registry.selected)
+    BoxColliderComponent &a = *colliders[i];
+    if (entities[i] == registry.selected)
     {
-      drawAABB(it1->second, glm::vec3(1.f));
+      drawAABB(a, glm::vec3(1.f));
     }
     else if (doDebugDraw)
     {
-      drawAABB(it1->second, glm::vec3(0.2f));
+      drawAABB(a, glm::vec3(0.2f));
     }
 
-    auto it2 = it1;
-    ++it2;
-    for (; it2 != boxColliders.end(); ++it2)
+    for (size_t j = i + 1; j < colliderCount; j++)
     {
-      if (it1->second.justUpdated == false && it2->second.justUpdated == false)
+      BoxColliderComponent &b = *colliders[j];
+      // pairs where nothing moved are handled by the cache sweep below
+      if (a.justUpdated == false && b.justUpdated == false)
         continue;
+      stats.pairsTested++;
+      if (!AABBOverlap(a, b))
+        continue;
+      stats.aabbOverlaps++;
+
+      CollisionPair &pair = pairCache.findOrInsert(entities[i], entities[j]);
+      pair.lastVisitedStep = pairCache.step;
+      pair.isTrigger = a.isTrigger || b.isTrigger;
+      bool wasTouching = pair.touching;
+
       glm::vec3 mtv;
       glm::vec3 collisionNormal;
-      if (AABBOverlap(it1->second, it2->second) && SATCollision(it1->first, it2->first, it1->second, it2->second, mtv, collisionNormal))
+      stats.satCalls++;
+      pair.touching = SATCollision(entities[i], entities[j], a, b, mtv, collisionNormal, &pair);
+      if (pair.touching)
       {
-        updatedEntities.insert(it1->first);
-        updatedEntities.insert(it2->first);
-        resolveCollision(it1->first, it2->first, it1->second, it2->second, mtv, collisionNormal);
+        stats.contacts++;
+        pair.normal = entities[i] == pair.entityA ? collisionNormal : -collisionNormal;
+        if (!pair.isTrigger)
+        {
+          resolved[i] = true;
+          resolved[j] = true;
+          resolveCollision(entities[i], entities[j], a, b, mtv, collisionNormal);
+        }
       }
+      recordPairEvent(pair, wasTouching);
     }
   }
 
-  for (auto &[entity, collider] : boxColliders)
+  stats.narrowPhaseMs += millisecondsSince(phaseStart);
+  phaseStart = std::chrono::steady_clock::now();
+
+  // pairs not visited this step either stopped overlapping, lost a collider, or are resting with nothing moving
+  for (CollisionPair &pair : pairCache.entries)
   {
-    collider.justUpdated = updatedEntities.find(entity) != updatedEntities.end();
+    if (pair.slotState != CollisionPair::Occupied || pair.lastVisitedStep == pairCache.step)
+      continue;
+
+    auto colliderA = boxColliders.find(pair.entityA);
+    auto colliderB = boxColliders.find(pair.entityB);
+    bool bothAlive = colliderA != boxColliders.end() && colliderB != boxColliders.end();
+    if (bothAlive && !colliderA->second.justUpdated && !colliderB->second.justUpdated)
+    {
+      recordPairEvent(pair, pair.touching);
+      continue;
+    }
+
+    bool wasTouching = pair.touching;
+    pair.touching = false;
+    recordPairEvent(pair, wasTouching);
+    pairCache.erase(pair);
+  }
+
+  for (size_t i = 0; i < colliderCount; i++)
+  {
+    colliders[i]->justUpdated = resolved[i];
   }
+
+  dispatchCollisionEvents();
+  stats.pairSweepMs += millisecondsSince(phaseStart);
+}
+
+void PhysicsSystem::recordPairEvent(const CollisionPair &pair, bool wasTouching)
+{
+  if (!pair.touching && !wasTouching)
+    return;
+
+  CollisionEvent event;
+  event.entityA = pair.entityA;
+  event.entityB = pair.entityB;
+  event.normal = pair.touching ? pair.normal : glm::vec3(0.0f);
+
+  if (pair.touching && !wasTouching)
+    (pair.isTrigger ? triggerEnterEvents : collisionEnterEvents).push_back(event);
+  else if (pair.touching)
+    (pair.isTrigger ? triggerStayEvents : collisionStayEvents).push_back(event);
+  else
+    (pair.isTrigger ? triggerExitEvents : collisionExitEvents).push_back(event);
+}
+
+void PhysicsSystem::dispatchCollisionEvents()
+{
+  if (onCollisionEnter && !collisionEnterEvents.empty())
+    onCollisionEnter(collisionEnterEvents);
+  if (onCollisionStay && !collisionStayEvents.empty())
+    onCollisionStay(collisionStayEvents);
+  if (onCollisionExit && !collisionExitEvents.empty())
+    onCollisionExit(collisionExitEvents);
+  if (onTriggerEnter && !triggerEnterEvents.empty())
+    onTriggerEnter(triggerEnterEvents);
+  if (onTriggerStay && !triggerStayEvents.empty())
+    onTriggerStay(triggerStayEvents);
+  if (onTriggerExit && !triggerExitEvents.empty())
+    onTriggerExit(triggerExitEvents);
 }
 
 void PhysicsSystem::resolveCollision(Entity entityA, Entity entityB, const BoxColliderComponent &a, const BoxColliderComponent &b, glm::vec3 &mtv, glm::vec3 &collisionNormal)
@@ -229,7 +493,7 @@ void PhysicsSystem::resolveCollision(Entity entityA, Entity entityB, const BoxCo
 
   if (entityAStatic)
   {
-    registry.transforms[entityB].justUpdated = true;
+    registry.transforms[entityB].markUpdated();
     registry.transforms[entityB].position -= mtv;
     if (entityBHasRigidBody)
     {
@@ -240,7 +504,7 @@ void PhysicsSystem::resolveCollision(Entity entityA, Entity entityB, const BoxCo
 
   if (entityBStatic)
   {
-    registry.transforms[entityA].justUpdated = true;
+    registry.transforms[entityA].markUpdated();
     registry.transforms[entityA].position += mtv;
     if (entityAHasRigidBody)
     {
@@ -249,8 +513,8 @@ void PhysicsSystem::resolveCollision(Entity entityA, Entity entityB, const BoxCo
     return;
   }
 
-  registry.transforms[entityA].justUpdated = true;
-  registry.transforms[entityB].justUpdated = true;
+  registry.transforms[entityA].markUpdated();
+  registry.transforms[entityB].markUpdated();
   registry.transforms[entityA].position += halfMTV;
   registry.transforms[entityB].position -= halfMTV;
   registry.rigidBodies[entityA].velocity = removeVelocityAlongAxis(registry.rigidBodies[entityA].velocity, collisionNormal);
@@ -288,30 +552,5 @@ void PhysicsSystem::drawAABB(const BoxColliderComponent &box, const glm::vec3 &c
   {
     return;
   }
-  glm::vec3 min = box.worldMin;
-  glm::vec3 max = box.worldMax;
-
-  std::vector<glm::vec3> corners = {
-      {min.x, min.y, min.z}, {max.x, min.y, min.z}, {max.x, max.y, min.z}, {min.x, max.y, min.z}, {min.x, min.y, max.z}, {max.x, min.y, max.z}, {max.x, max.y, max.z}, {min.x, max.y, max.z}};
-
-  auto addLine = [&](glm::vec3 a, glm::vec3 b)
-  {
-    debugDrawer->debugLines.push_back(Vertex{a, color});
-    debugDrawer->debugLines.push_back(Vertex{b, color});
-  };
-
-  addLine(corners[0], corners[1]);
-  addLine(corners[1], corners[2]);
-  addLine(corners[2], corners[3]);
-  addLine(corners[3], corners[0]);
-
-  addLine(corners[4], corners[5]);
-  addLine(corners[5], corners[6]);
-  addLine(corners[6], corners[7]);
-  addLine(corners[7], corners[4]);
-
-  addLine(corners[0], corners[4]);
-  addLine(corners[1], corners[5]);
-  addLine(corners[2], corners[6]);
-  addLine(corners[3], corners[7]);
+  debugDrawer->drawAABB(box.worldMin, box.worldMax, color);
 }
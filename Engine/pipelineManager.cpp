@@ -5,7 +5,144 @@
 #include "descriptorManager.hpp"
 #include "mesh.hpp"
 #include "vertex.h"
+#include "debugDrawer.hpp"
+#include "utils.h"
 #include <fstream>
+#include <thread>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <cstring>
+
+static const uint32_t PIPELINE_CACHE_MAGIC = 0x43504B56; // "VKPC"
+static const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+// FNV-1a
+static uint64_t hashCacheData(const char *data, size_t size)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+void PipelineManager::createPipelineCache(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  cacheFileHeader.magic = PIPELINE_CACHE_MAGIC;
+  cacheFileHeader.version = PIPELINE_CACHE_VERSION;
+  cacheFileHeader.vendorID = properties.vendorID;
+  cacheFileHeader.deviceID = properties.deviceID;
+  cacheFileHeader.driverVersion = properties.driverVersion;
+  std::memcpy(cacheFileHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+  // a missing or stale file just means the pipelines are compiled from scratch this time
+  std::vector<char> data;
+  std::ifstream file(pipelineCachePath, std::ios::binary);
+  PipelineCacheFileHeader header{};
+  if (file.is_open() && file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+  {
+    bool matches = header.magic == cacheFileHeader.magic && header.version == cacheFileHeader.version &&
+                   header.vendorID == cacheFileHeader.vendorID && header.deviceID == cacheFileHeader.deviceID &&
+                   header.driverVersion == cacheFileHeader.driverVersion &&
+                   std::memcmp(header.pipelineCacheUUID, cacheFileHeader.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    if (matches)
+    {
+      data.resize(static_cast<size_t>(header.dataSize));
+      if (!file.read(data.data(), data.size()) || hashCacheData(data.data(), data.size()) != header.dataHash)
+      {
+        std::cerr << "pipeline cache " << pipelineCachePath << " is damaged, pipelines are compiled from scratch" << std::endl;
+        data.clear();
+      }
+    }
+  }
+  file.close();
+
+  VkPipelineCacheCreateInfo cacheInfo{};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = data.size();
+  cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+  if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+}
+
+void PipelineManager::savePipelineCache(VkDevice device)
+{
+  size_t size = 0;
+  if (vkGetPipelineCacheData(device, pipelineCache, &size, nullptr) != VK_SUCCESS || size == 0)
+    return;
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS)
+    return;
+  data.resize(size);
+
+  PipelineCacheFileHeader header = cacheFileHeader;
+  header.dataSize = size;
+  header.dataHash = hashCacheData(data.data(), data.size());
+
+  // written next to the old file and renamed over it, so a crash while writing never leaves half a cache behind
+  std::string tempPath = pipelineCachePath + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(data.data(), data.size());
+    file.flush();
+    if (!file)
+    {
+      std::cerr << "failed to write pipeline cache " << tempPath << std::endl;
+      return;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempPath, pipelineCachePath, error);
+  if (error)
+  {
+    std::cerr << "failed to replace pipeline cache " << pipelineCachePath << ": " << error.message() << std::endl;
+    std::filesystem::remove(tempPath, error);
+  }
+}
+
+void PipelineManager::createPipelines(VkDevice device)
+{
+  // every function fills its own members and only reads state created before, the driver synchronizes the pipeline cache
+  // the graphics pipelines are the most, so they stay on the calling thread
+  void (PipelineManager::*creators[])(VkDevice) = {&PipelineManager::createGraphicsPipeline, &PipelineManager::createMeshPipeline, &PipelineManager::createColorIDPipeline, &PipelineManager::createDebugPipeline, &PipelineManager::createComputePipeline, &PipelineManager::createCullPipeline};
+  const size_t count = sizeof(creators) / sizeof(creators[0]);
+  std::exception_ptr errors[count];
+
+  auto create = [&](size_t i)
+  {
+    try
+    {
+      (this->*creators[i])(device);
+    }
+    catch (...)
+    {
+      errors[i] = std::current_exception();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(count - 1);
+  for (size_t i = 1; i < count; i++)
+    workers.emplace_back(create, i);
+  create(0);
+  for (std::thread &worker : workers)
+    worker.join();
+
+  for (std::exception_ptr &error : errors)
+    if (error)
+      std::rethrow_exception(error);
+}
 
 void PipelineManager::createOffScreenRenderPass(VkDevice device, VkPhysicalDevice physicalDevice)
 {
@@ -193,6 +330,59 @@ void PipelineManager::createColorIDRenderPass(VkDevice device, VkPhysicalDevice
   }
 }
 
+void PipelineManager::createOcclusionRenderPass(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  VkAttachmentDescription depthAttachment{};
+  depthAttachment.format = swapchainManager.findDepthFormat(physicalDevice);
+  depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  // read by the first level of the depth pyramid right after the pass
+  depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+  VkAttachmentReference depthRef{};
+  depthRef.attachment = 0;
+  depthRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 0;
+  subpass.pDepthStencilAttachment = &depthRef;
+
+  // the depth was sampled by last frame's pyramid build before it is cleared, and is sampled by this frame's after the pass
+  std::array<VkSubpassDependency, 2> dependencies{};
+  dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[0].dstSubpass = 0;
+  dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  dependencies[0].srcAccessMask = 0;
+  dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+  dependencies[1].srcSubpass = 0;
+  dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+  dependencies[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+  dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+  dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+  dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+  VkRenderPassCreateInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &depthAttachment;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+  renderPassInfo.pDependencies = dependencies.data();
+
+  if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &occlusionRenderPass) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create occlusion render pass!");
+  }
+}
+
 VkShaderModule PipelineManager::createShaderModule(const std::vector<char> &code, VkDevice device)
 {
   VkShaderModuleCreateInfo createInfo{};
@@ -256,12 +446,83 @@ void PipelineManager::createComputePipeline(VkDevice device)
   pipelineInfo.layout = computePipelineLayout;
   pipelineInfo.stage = computeShaderStageInfo;
 
-  if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
+  if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS)
   {
     throw std::runtime_error("failed to create compute pipeline!");
   }
 }
 
+void PipelineManager::createCullPipeline(VkDevice device)
+{
+  auto cullShaderCode = readFile("shaders/cull.spv");
+
+  VkShaderModule cullShaderModule = createShaderModule(cullShaderCode, device);
+
+  VkPipelineShaderStageCreateInfo cullShaderStageInfo{};
+  cullShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  cullShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  cullShaderStageInfo.module = cullShaderModule;
+  cullShaderStageInfo.pName = "main";
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(CullConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &descriptorManager.cullDescriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create cull pipeline layout!");
+  }
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.layout = cullPipelineLayout;
+  pipelineInfo.stage = cullShaderStageInfo;
+
+  if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &cullPipeline) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create cull pipeline!");
+  }
+
+  vkDestroyShaderModule(device, cullShaderModule, nullptr);
+
+  auto pyramidShaderCode = readFile("shaders/depthPyramid.spv");
+
+  VkShaderModule pyramidShaderModule = createShaderModule(pyramidShaderCode, device);
+
+  VkPipelineShaderStageCreateInfo pyramidShaderStageInfo = cullShaderStageInfo;
+  pyramidShaderStageInfo.module = pyramidShaderModule;
+
+  VkPushConstantRange pyramidPushConstantRange = pushConstantRange;
+  pyramidPushConstantRange.size = sizeof(DepthPyramidConstants);
+
+  VkPipelineLayoutCreateInfo pyramidLayoutInfo = pipelineLayoutInfo;
+  pyramidLayoutInfo.pSetLayouts = &descriptorManager.depthPyramidDescriptorSetLayout;
+  pyramidLayoutInfo.pPushConstantRanges = &pyramidPushConstantRange;
+
+  if (vkCreatePipelineLayout(device, &pyramidLayoutInfo, nullptr, &depthPyramidPipelineLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create depth pyramid pipeline layout!");
+  }
+
+  pipelineInfo.layout = depthPyramidPipelineLayout;
+  pipelineInfo.stage = pyramidShaderStageInfo;
+
+  if (vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &depthPyramidPipeline) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create depth pyramid pipeline!");
+  }
+
+  vkDestroyShaderModule(device, pyramidShaderModule, nullptr);
+}
+
 void PipelineManager::createGraphicsPipeline(VkDevice device)
 {
   auto vertShaderCode = readFile("shaders/vert.spv");
@@ -381,10 +642,12 @@ void PipelineManager::createGraphicsPipeline(VkDevice device)
   pushConstantRange.offset = 0;
   pushConstantRange.size = sizeof(MaterialData);
 
+  std::array<VkDescriptorSetLayout, 2> meshSetLayouts = {descriptorManager.descriptorSetLayout, descriptorManager.frameDescriptorSetLayout};
+
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &descriptorManager.descriptorSetLayout;
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(meshSetLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = meshSetLayouts.data();
   pipelineLayoutInfo.pushConstantRangeCount = 1;
   pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
@@ -417,7 +680,7 @@ void PipelineManager::createGraphicsPipeline(VkDevice device)
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
   pipelineInfo.basePipelineIndex;
 
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
   {
     throw std::runtime_error("failed to create graphics pipeline!");
   }
@@ -425,7 +688,7 @@ void PipelineManager::createGraphicsPipeline(VkDevice device)
   pipelineInfo.pVertexInputState = &particleInputInfo;
   pipelineInfo.pInputAssemblyState = &particleInputAssembly;
 
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsParticlePipeline) != VK_SUCCESS)
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &graphicsParticlePipeline) != VK_SUCCESS)
   {
     throw std::runtime_error("failed to create graphics pipeline!");
   }
@@ -451,7 +714,7 @@ void PipelineManager::createGraphicsPipeline(VkDevice device)
   animatedVertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(animatedVertexAttributes.size());
   animatedVertexInputInfo.pVertexAttributeDescriptions = animatedVertexAttributes.data();
 
-  std::array<VkDescriptorSetLayout, 2> setLayouts = {descriptorManager.descriptorSetLayout, descriptorManager.animDescriptorSetLayout};
+  std::array<VkDescriptorSetLayout, 3> setLayouts = {descriptorManager.descriptorSetLayout, descriptorManager.frameDescriptorSetLayout, descriptorManager.animDescriptorSetLayout};
 
   VkPipelineLayoutCreateInfo animPipelineLayoutInfo{};
   animPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -484,7 +747,7 @@ void PipelineManager::createGraphicsPipeline(VkDevice device)
   animPipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
   animPipelineInfo.basePipelineIndex;
 
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &animPipelineInfo, nullptr, &animationPipeline) != VK_SUCCESS)
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &animPipelineInfo, nullptr, &animationPipeline) != VK_SUCCESS)
   {
     throw std::runtime_error("failed to create animation pipeline!");
   }
@@ -494,6 +757,187 @@ void PipelineManager::createGraphicsPipeline(VkDevice device)
   vkDestroyShaderModule(device, animatedVertShaderModule, nullptr);
 }
 
+void PipelineManager::createMeshPipeline(VkDevice device)
+{
+  // static meshes read their material from the frame's material buffer and their textures from the bindless array
+  // so they need neither push constants nor a descriptor set of their own
+  // the modules stay alive for the permutations created later
+  meshVertShaderModule = createShaderModule(readFile("shaders/meshVert.spv"), device);
+  meshFragShaderModule = createShaderModule(readFile("shaders/meshFrag.spv"), device);
+
+  std::array<VkDescriptorSetLayout, 2> bindlessSetLayouts = {descriptorManager.bindlessDescriptorSetLayout, descriptorManager.frameDescriptorSetLayout};
+
+  VkPipelineLayoutCreateInfo meshPipelineLayoutInfo{};
+  meshPipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  meshPipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(bindlessSetLayouts.size());
+  meshPipelineLayoutInfo.pSetLayouts = bindlessSetLayouts.data();
+  meshPipelineLayoutInfo.pushConstantRangeCount = 0;
+
+  if (vkCreatePipelineLayout(device, &meshPipelineLayoutInfo, nullptr, &meshPipelineLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+
+  meshPipeline = createMeshVariant(device, MATERIAL_FEATURES_ALL, false);
+  occluderPipeline = createMeshVariant(device, 0, true);
+  std::lock_guard<std::mutex> lock(meshVariantMutex);
+  meshVariants[MATERIAL_FEATURES_ALL] = meshPipeline;
+}
+
+VkPipeline PipelineManager::getMeshPipeline(VkDevice device, uint32_t features)
+{
+  std::lock_guard<std::mutex> lock(meshVariantMutex);
+  auto it = meshVariants.find(features);
+  if (it != meshVariants.end())
+    return it->second;
+
+  // the first draw of a permutation waits for it, the pipeline cache makes that cheap from the second run on
+  VkPipeline pipeline = createMeshVariant(device, features, false);
+  meshVariants.emplace(features, pipeline);
+  return pipeline;
+}
+
+uint32_t PipelineManager::meshPermutationCount()
+{
+  std::lock_guard<std::mutex> lock(meshVariantMutex);
+  return static_cast<uint32_t>(meshVariants.size());
+}
+
+VkPipeline PipelineManager::createMeshVariant(VkDevice device, uint32_t features, bool occluder)
+{
+  // every feature is a VkBool32 specialization constant whose constant_id is the feature's bit, see shaders/mesh.frag
+  std::array<VkSpecializationMapEntry, MATERIAL_FEATURE_COUNT> specializationEntries{};
+  std::array<VkBool32, MATERIAL_FEATURE_COUNT> specializationValues{};
+  for (uint32_t i = 0; i < MATERIAL_FEATURE_COUNT; i++)
+  {
+    specializationEntries[i].constantID = i;
+    specializationEntries[i].offset = i * sizeof(VkBool32);
+    specializationEntries[i].size = sizeof(VkBool32);
+    specializationValues[i] = (features >> i) & 1 ? VK_TRUE : VK_FALSE;
+  }
+
+  VkSpecializationInfo specialization{};
+  specialization.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+  specialization.pMapEntries = specializationEntries.data();
+  specialization.dataSize = sizeof(specializationValues);
+  specialization.pData = specializationValues.data();
+
+  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+  vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  vertShaderStageInfo.module = meshVertShaderModule;
+  vertShaderStageInfo.pName = "main";
+
+  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+  fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  fragShaderStageInfo.module = meshFragShaderModule;
+  fragShaderStageInfo.pName = "main";
+  fragShaderStageInfo.pSpecializationInfo = &specialization;
+
+  VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+  VkPipelineDepthStencilStateCreateInfo depthStencil{};
+  depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = VK_TRUE;
+  depthStencil.depthWriteEnable = VK_TRUE;
+  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.minDepthBounds = 0.0f;
+  depthStencil.maxDepthBounds = 1.0f;
+
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+  dynamicState.pDynamicStates = dynamicStates.data();
+
+  VkVertexInputBindingDescription vertexBinding = Vertex::getBindingDescription();
+  auto vertexAttributes = Vertex::getAttributeDescriptions();
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.pVertexBindingDescriptions = &vertexBinding;
+  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttributes.size());
+  vertexInputInfo.pVertexAttributeDescriptions = vertexAttributes.data();
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  VkPipelineViewportStateCreateInfo viewportState{};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterizer.depthBiasEnable = VK_FALSE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.minSampleShading = 1.0f;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.blendEnable = VK_TRUE;
+  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  VkPipelineColorBlendStateCreateInfo colorBlending{};
+  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.logicOpEnable = VK_FALSE;
+  colorBlending.logicOp = VK_LOGIC_OP_COPY;
+  colorBlending.attachmentCount = 1;
+  colorBlending.pAttachments = &colorBlendAttachment;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.layout = meshPipelineLayout;
+  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  if (occluder)
+  {
+    // only depth is written, the mesh vertex shader's outputs go unused
+    pipelineInfo.stageCount = 1;
+    pipelineInfo.pStages = &vertShaderStageInfo;
+    pipelineInfo.pColorBlendState = nullptr;
+    pipelineInfo.renderPass = occlusionRenderPass;
+  }
+
+  VkPipeline pipeline;
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+  {
+    throw std::runtime_error(occluder ? "failed to create occluder pipeline!" : "failed to create mesh pipeline!");
+  }
+  return pipeline;
+}
+
 void PipelineManager::createColorIDPipeline(VkDevice device)
 {
   auto vertShaderCode = readFile("shaders/vertColorID.spv");
@@ -593,22 +1037,14 @@ void PipelineManager::createColorIDPipeline(VkDevice device)
   colorBlending.blendConstants[2] = 0.0f;
   colorBlending.blendConstants[3] = 0.0f;
 
-  struct ColorIDPushConstant
-  {
-    int id;
-  };
-
-  VkPushConstantRange pushConstantRange{};
-  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-  pushConstantRange.offset = 0;
-  pushConstantRange.size = sizeof(ColorIDPushConstant);
+  // the picking id comes from the instance buffer so there are no push constants
+  std::array<VkDescriptorSetLayout, 2> meshSetLayouts = {descriptorManager.descriptorSetLayout, descriptorManager.frameDescriptorSetLayout};
 
   VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
   pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 1;
-  pipelineLayoutInfo.pSetLayouts = &descriptorManager.descriptorSetLayout;
-  pipelineLayoutInfo.pushConstantRangeCount = 1;
-  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(meshSetLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = meshSetLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = 0;
 
   if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &colorIDPipelineLayout) != VK_SUCCESS)
   {
@@ -637,7 +1073,7 @@ void PipelineManager::createColorIDPipeline(VkDevice device)
 
   pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &colorIDPipeline) != VK_SUCCESS)
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &colorIDPipeline) != VK_SUCCESS)
   {
     throw std::runtime_error("failed to create graphics pipeline!");
   }
@@ -646,13 +1082,164 @@ void PipelineManager::createColorIDPipeline(VkDevice device)
   vkDestroyShaderModule(device, vertShaderModule, nullptr);
 }
 
+void PipelineManager::createDebugPipeline(VkDevice device)
+{
+  auto vertShaderCode = readFile("shaders/debugVert.spv");
+  auto fragShaderCode = readFile("shaders/debugFrag.spv");
+
+  VkShaderModule vertShaderModule = createShaderModule(vertShaderCode, device);
+  VkShaderModule fragShaderModule = createShaderModule(fragShaderCode, device);
+
+  VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+  vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  vertShaderStageInfo.module = vertShaderModule;
+  vertShaderStageInfo.pName = "main";
+
+  VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+  fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  fragShaderStageInfo.module = fragShaderModule;
+  fragShaderStageInfo.pName = "main";
+
+  VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
+
+  VkPipelineDepthStencilStateCreateInfo depthStencil{};
+  depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = VK_TRUE;
+  depthStencil.depthWriteEnable = VK_TRUE;
+  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+  depthStencil.depthBoundsTestEnable = VK_FALSE;
+  depthStencil.minDepthBounds = 0.0f;
+  depthStencil.maxDepthBounds = 1.0f;
+
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+  dynamicState.pDynamicStates = dynamicStates.data();
+
+  // no per vertex data, the vertex shader builds the line geometry from gl_VertexIndex and the instance record
+  VkVertexInputBindingDescription instanceBinding = DebugInstance::getBindingDescription();
+  auto instanceAttributes = DebugInstance::getAttributeDescriptions();
+
+  VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+  vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInputInfo.vertexBindingDescriptionCount = 1;
+  vertexInputInfo.pVertexBindingDescriptions = &instanceBinding;
+  vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(instanceAttributes.size());
+  vertexInputInfo.pVertexAttributeDescriptions = instanceAttributes.data();
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+  inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+  inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+  VkPipelineViewportStateCreateInfo viewportState{};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{};
+  rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.depthClampEnable = VK_FALSE;
+  rasterizer.rasterizerDiscardEnable = VK_FALSE;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0f;
+  rasterizer.cullMode = VK_CULL_MODE_NONE;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterizer.depthBiasEnable = VK_FALSE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{};
+  multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.sampleShadingEnable = VK_FALSE;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+  multisampling.minSampleShading = 1.0f;
+
+  VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+  colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  colorBlendAttachment.blendEnable = VK_TRUE;
+  colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+  VkPipelineColorBlendStateCreateInfo colorBlending{};
+  colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.logicOpEnable = VK_FALSE;
+  colorBlending.logicOp = VK_LOGIC_OP_COPY;
+  colorBlending.attachmentCount = 1;
+  colorBlending.pAttachments = &colorBlendAttachment;
+
+  VkPushConstantRange pushConstantRange{};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(DebugPushConstants);
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 0;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &debugPipelineLayout) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create debug pipeline layout!");
+  }
+
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.pStages = shaderStages;
+  pipelineInfo.pVertexInputState = &vertexInputInfo;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.layout = debugPipelineLayout;
+  pipelineInfo.renderPass = renderPass;
+  pipelineInfo.subpass = 0;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, &debugPipeline) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create debug pipeline!");
+  }
+
+  vkDestroyShaderModule(device, fragShaderModule, nullptr);
+  vkDestroyShaderModule(device, vertShaderModule, nullptr);
+}
+
 void PipelineManager::cleanup(VkDevice device)
 {
+  savePipelineCache(device);
+  vkDestroyPipelineCache(device, pipelineCache, nullptr);
+  pipelineCache = VK_NULL_HANDLE;
+
   vkDestroyPipeline(device, graphicsPipeline, nullptr);
   vkDestroyPipeline(device, graphicsParticlePipeline, nullptr);
   vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+  // meshPipeline is one of the permutations
+  for (auto &[features, pipeline] : meshVariants)
+    vkDestroyPipeline(device, pipeline, nullptr);
+  meshVariants.clear();
+  vkDestroyPipeline(device, occluderPipeline, nullptr);
+  vkDestroyShaderModule(device, meshVertShaderModule, nullptr);
+  vkDestroyShaderModule(device, meshFragShaderModule, nullptr);
+  vkDestroyPipelineLayout(device, meshPipelineLayout, nullptr);
   vkDestroyPipeline(device, computePipeline, nullptr);
   vkDestroyPipelineLayout(device, computePipelineLayout, nullptr);
+  vkDestroyPipeline(device, cullPipeline, nullptr);
+  vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+  vkDestroyPipeline(device, depthPyramidPipeline, nullptr);
+  vkDestroyPipelineLayout(device, depthPyramidPipelineLayout, nullptr);
+  vkDestroyPipeline(device, debugPipeline, nullptr);
+  vkDestroyPipelineLayout(device, debugPipelineLayout, nullptr);
   vkDestroyRenderPass(device, renderPass, nullptr);
   vkDestroyRenderPass(device, offscreenRenderPass, nullptr);
+  vkDestroyRenderPass(device, occlusionRenderPass, nullptr);
 }
\ No newline at end of file
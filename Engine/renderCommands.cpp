@@ -4,407 +4,411 @@
 #include "debugDrawer.hpp"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <limits>
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/string_cast.hpp>
 
-void setupViewportScissor(Renderer *renderer, VkCommandBuffer commandBuffer)
+glm::mat4 getWorldTransform(ECSRegistry &registry, Entity e)
 {
-  VkViewport viewport{};
-
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
+  auto transformIt = registry.transforms.find(e);
+  glm::mat4 transformation(1.0f);
 
-  viewport.width = static_cast<float>(renderer->swapchainManager.swapChainExtent.width);
-  viewport.height = static_cast<float>(renderer->swapchainManager.swapChainExtent.height);
+  if (transformIt != registry.transforms.end())
+  {
+    const TransformComponent &transform = transformIt->second;
 
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
+    transformation = glm::translate(transformation, transform.position);
+    transformation = glm::rotate(transformation, glm::radians(transform.rotationZYX.x), glm::vec3(0.0f, 0.0f, 1.0f));
+    transformation = glm::rotate(transformation, glm::radians(transform.rotationZYX.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    transformation = glm::rotate(transformation, glm::radians(transform.rotationZYX.z), glm::vec3(1.0f, 0.0f, 0.0f));
+    transformation = glm::scale(transformation, transform.scale);
+  }
 
-  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  auto parentIt = registry.parents.find(e);
+  if (parentIt != registry.parents.end())
+  {
+    Entity parent = parentIt->second.parent;
+    glm::mat4 parentTransform = getWorldTransform(registry, parent);
+    transformation = parentTransform * transformation;
+  }
 
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = renderer->swapchainManager.swapChainExtent;
-  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+  return transformation;
 }
 
-void setupViewportScissor(VkCommandBuffer commandBuffer, VkExtent2D extent)
-{
-  VkViewport viewport{};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = static_cast<float>(extent.width);
-  viewport.height = static_cast<float>(extent.height);
-  viewport.minDepth = 0.0f;
-  viewport.maxDepth = 1.0f;
-
-  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+// a level is entered once its error drops below this share of the pixel budget and kept until it is this much over it
+static const float LOD_HYSTERESIS = 0.25f;
 
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = extent;
+// the coarsest level whose error stays within the pixel budget at the mesh's projected size
+static uint32_t selectMeshLod(const DrawPacketList &list, Mesh &mesh, const glm::mat4 &transformation)
+{
+  uint32_t levelCount = mesh.lodCount();
+  if (levelCount == 1 || list.lodScale <= 0.0f)
+    return mesh.lodLevel = 0;
+
+  // the nearest point of the bounding sphere decides, a camera inside it always sees the full mesh
+  glm::vec3 center = glm::vec3(transformation * glm::vec4(mesh.bounds.center(), 1.0f));
+  float scale = std::max({glm::length(glm::vec3(transformation[0])), glm::length(glm::vec3(transformation[1])), glm::length(glm::vec3(transformation[2]))});
+  float distance = glm::length(center - list.cameraPosition) - mesh.bounds.radius * scale;
+  if (distance <= 0.0f)
+    return mesh.lodLevel = 0;
+
+  float pixelsPerUnit = list.lodScale * scale / distance;
+  auto pixelError = [&](uint32_t level)
+  {
+    return level == 0 ? 0.0f : mesh.lodChain.lods[level - 1].error * pixelsPerUnit;
+  };
+
+  uint32_t level = std::min(mesh.lodLevel, levelCount - 1);
+  while (level > 0 && pixelError(level) > list.lodPixelError * (1.0f + LOD_HYSTERESIS))
+    level--;
+  while (level + 1 < levelCount && pixelError(level + 1) < list.lodPixelError * (1.0f - LOD_HYSTERESIS))
+    level++;
+  return mesh.lodLevel = level;
+}
 
-  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+// diameter of the mesh's bounding sphere on screen, unbounded when the camera is inside it
+static float projectedPixels(const DrawPacketList &list, const Mesh &mesh, const glm::mat4 &transformation)
+{
+  glm::vec3 center = glm::vec3(transformation * glm::vec4(mesh.bounds.center(), 1.0f));
+  float scale = std::max({glm::length(glm::vec3(transformation[0])), glm::length(glm::vec3(transformation[1])), glm::length(glm::vec3(transformation[2]))});
+  float radius = mesh.bounds.radius * scale;
+  float distance = glm::length(center - list.cameraPosition) - radius;
+  if (distance <= 0.0f)
+    return std::numeric_limits<float>::max();
+  return 2.0f * radius * list.pixelScale / distance;
 }
 
-void setTriangleTopology(Renderer *renderer, VkCommandBuffer commandBuffer)
+void pushGameObjectPackets(DrawPacketList &list, ECSRegistry &registry, FrustumCuller &culler)
 {
-  if (!renderer->fpCmdSetPrimitiveTopology)
+  culler.begin(list.proj * list.view);
+
+  // opaque meshes are left to the GPU culling pass when it runs, only the rest is tested here
+  auto cpuCulled = [&list](const Mesh &mesh)
   {
-    PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT =
-        (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(renderer->deviceManager.device, "vkCmdSetPrimitiveTopologyEXT");
+    return !list.gpuCulling || mesh.material.opacity < 1.0f;
+  };
 
-    if (!vkCmdSetPrimitiveTopologyEXT)
-    {
-      std::cerr << "vkCmdSetPrimitiveTopology is not available and failed to load vkCmdSetPrimitiveTopologyEXT!" << std::endl;
-    }
-    else
-    {
-      vkCmdSetPrimitiveTopologyEXT(commandBuffer, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
-    }
-  }
-  else
+  // every shown entity gets one transform, in the same order both loops visit the registry
+  uint32_t firstTransform = static_cast<uint32_t>(list.transforms.size());
+  for (auto &[e, meshComponent] : registry.meshes)
   {
-    vkCmdSetPrimitiveTopology(commandBuffer, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    if (meshComponent.hide)
+      continue;
+
+    glm::mat4 transformation = getWorldTransform(registry, e);
+    list.addTransform(transformation);
+    for (Mesh &mesh : meshComponent.meshes)
+      if (cpuCulled(mesh))
+        culler.add(mesh.bounds, transformation);
   }
-}
 
-void setLineListTopology(Renderer *renderer, VkCommandBuffer commandBuffer)
-{
-  if (!renderer->fpCmdSetPrimitiveTopology)
+  culler.cull();
+
+  uint32_t transformIndex = firstTransform;
+  uint32_t boundsIndex = 0;
+  for (auto &[e, meshComponent] : registry.meshes)
   {
-    PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT =
-        (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(renderer->deviceManager.device, "vkCmdSetPrimitiveTopologyEXT");
+    if (meshComponent.hide)
+      continue;
 
-    if (!vkCmdSetPrimitiveTopologyEXT)
+    glm::vec3 position = glm::vec3(list.transforms[transformIndex][3]);
+    for (Mesh &mesh : meshComponent.meshes)
     {
-      std::cerr << "vkCmdSetPrimitiveTopology is not available and failed to load vkCmdSetPrimitiveTopologyEXT!" << std::endl;
+      if (cpuCulled(mesh) && !culler.visible[boundsIndex++])
+        continue;
+      // nothing was uploaded for empty meshes
+      if (mesh.geometryId < 0)
+        continue;
+      // still on the transfer queue, the mesh shows up a frame or two later instead of stalling this one
+      if (mesh.uploadTicket > list.uploadsCompleted)
+        continue;
+
+      uint32_t level = selectMeshLod(list, mesh, list.transforms[transformIndex]);
+      // the texture streamer keeps the mips this size needs resident
+      if (mesh.textureManager)
+        mesh.textureManager->streamPixels = std::max(mesh.textureManager->streamPixels, projectedPixels(list, mesh, list.transforms[transformIndex]));
+
+      DrawPacket packet;
+      packet.renderingId = mesh.id;
+      packet.indexCount = level == 0 ? static_cast<uint32_t>(mesh.indices.size()) : mesh.lodChain.lods[level - 1].indexCount;
+      packet.firstIndex = level == 0 ? 0 : mesh.lodChain.lods[level - 1].firstIndex;
+      packet.transformIndex = transformIndex;
+      packet.materialIndex = list.addMaterial(mesh.material, mesh.textures);
+      packet.pickingId = static_cast<int32_t>(e);
+      packet.object = &mesh.bounds;
+      packet.geometryId = mesh.geometryId;
+      packet.firstInstance = 0;
+      packet.instanceCount = 1;
+
+      if (mesh.material.opacity < 1.0f)
+        // back to front whatever the material, so every transparent mesh is drawn with the permutation that keeps all features
+        packet.key = DrawPacketList::makeKey(LayerTransparent, PipelineMesh, MATERIAL_FEATURES_ALL, 0, list.quantizeDepth(position, true));
+      else
+        // materials are read per instance, so opaque meshes only sort by shader permutation, geometry and level to end up next to their instancing partners
+        // the level takes the low three bits of the mesh field, MESH_MAX_LODS stays below 8
+        // which leaves 17 bits for the geometry slot, so instancing holds up to 131072 geometries
+        packet.key = DrawPacketList::makeKey(LayerOpaque, PipelineMesh, materialFeatures(mesh.material), (mesh.geometryId << 3) | level, list.quantizeDepth(position, false));
+
+      list.add(packet);
     }
-    else
-    {
-      vkCmdSetPrimitiveTopologyEXT(commandBuffer, VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
-    }
-  }
-  else
-  {
-    vkCmdSetPrimitiveTopology(commandBuffer, VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
+    transformIndex++;
   }
 }
 
-void setPointListTopology(Renderer *renderer, VkCommandBuffer commandBuffer)
+void pushAnimatedGameObjectPackets(DrawPacketList &list, ECSRegistry &registry, Entity e)
 {
-  if (!renderer->fpCmdSetPrimitiveTopology)
-  {
-    PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT =
-        (PFN_vkCmdSetPrimitiveTopologyEXT)vkGetDeviceProcAddr(renderer->deviceManager.device, "vkCmdSetPrimitiveTopologyEXT");
+  auto animMeshIt = registry.animatedMeshes.find(e);
+  if (animMeshIt == registry.animatedMeshes.end() || animMeshIt->second.hide)
+    return;
 
-    if (!vkCmdSetPrimitiveTopologyEXT)
-    {
-      std::cerr << "vkCmdSetPrimitiveTopology is not available and failed to load vkCmdSetPrimitiveTopologyEXT!" << std::endl;
-    }
-    else
-    {
-      vkCmdSetPrimitiveTopologyEXT(commandBuffer, VK_PRIMITIVE_TOPOLOGY_POINT_LIST);
-    }
-  }
-  else
+  // sampled and skinned by AnimationSystem::update before the frame is recorded
+  auto skeletonIt = registry.animationSkeletons.find(e);
+  if (skeletonIt == registry.animationSkeletons.end())
+    return;
+
+  glm::mat4 transformation = getWorldTransform(registry, e);
+  uint32_t transformIndex = list.addTransform(transformation);
+  uint32_t depth = list.quantizeDepth(glm::vec3(transformation[3]), false);
+
+  for (AnimatedMesh &mesh : animMeshIt->second.meshes)
   {
-    vkCmdSetPrimitiveTopology(commandBuffer, VK_PRIMITIVE_TOPOLOGY_POINT_LIST);
+    if (mesh.uploadTicket > list.uploadsCompleted)
+      continue;
+
+    DrawPacket packet;
+    packet.renderingId = mesh.id;
+    packet.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    packet.firstIndex = 0;
+    packet.transformIndex = transformIndex;
+    packet.materialIndex = list.addMaterial(mesh.material);
+    packet.pickingId = -1; // Need to add support for color picking with animated meshes later
+    packet.object = &skeletonIt->second.finalBoneMatrices;
+    packet.geometryId = mesh.id;
+    packet.firstInstance = 0;
+    packet.instanceCount = 1;
+    packet.key = DrawPacketList::makeKey(LayerOpaque, PipelineAnimated, packet.materialIndex, mesh.id, depth);
+    list.add(packet);
   }
 }
 
-void enableDepthWrite(Renderer *renderer, VkCommandBuffer commandBuffer)
+// packets that draw themselves only need the object and keep their submission order
+static void pushObjectPacket(DrawPacketList &list, DrawLayer layer, DrawPipeline pipeline, void *object, uint32_t transformIndex)
 {
-  if (!renderer->vkCmdSetDepthWriteEnableEXT)
-  {
-    std::cerr << "vkCmdSetPrimitiveTopology is not available and failed to load vkCmdSetPrimitiveTopologyEXT!" << std::endl;
-  }
-  else
-  {
-    renderer->vkCmdSetDepthWriteEnableEXT(commandBuffer, VK_TRUE);
-  }
+  DrawPacket packet{};
+  packet.key = DrawPacketList::makeKey(layer, pipeline, 0, 0, 0);
+  packet.renderingId = -1;
+  packet.geometryId = -1;
+  packet.transformIndex = transformIndex;
+  packet.pickingId = -1;
+  packet.object = object;
+  list.add(packet);
 }
 
-void disableDepthWrite(Renderer *renderer, VkCommandBuffer commandBuffer)
+void pushUIPacket(DrawPacketList &list, UI *ui, glm::mat4 model)
 {
-  if (!renderer->vkCmdSetDepthWriteEnableEXT)
-  {
-    std::cerr << "vkCmdSetPrimitiveTopology is not available and failed to load vkCmdSetPrimitiveTopologyEXT!" << std::endl;
-  }
-  else
-  {
-    renderer->vkCmdSetDepthWriteEnableEXT(commandBuffer, VK_FALSE);
-  }
+  pushObjectPacket(list, LayerUI, PipelineUI, ui, list.addTransform(model));
 }
 
-glm::mat4 getLocalTransform(SkeletonComponent &skeleton, int nodeIndex)
+void pushParticlePacket(DrawPacketList &list, ParticleEmitter *emitter)
 {
-
-  glm::mat4 translation = glm::mat4(1.0f);
-  glm::mat4 rotation = glm::mat4(1.0f);
-  glm::mat4 scale = glm::mat4(1.0f);
-
-  translation = glm::translate(translation, glm::vec3(skeleton.nodeTransforms[nodeIndex].translation[0], skeleton.nodeTransforms[nodeIndex].translation[1], skeleton.nodeTransforms[nodeIndex].translation[2]));
-
-  glm::quat q = glm::quat(skeleton.nodeTransforms[nodeIndex].rotation[0], skeleton.nodeTransforms[nodeIndex].rotation[1], skeleton.nodeTransforms[nodeIndex].rotation[2], skeleton.nodeTransforms[nodeIndex].rotation[3]);
-  rotation = glm::mat4_cast(q);
-
-  scale = glm::scale(scale, glm::vec3(skeleton.nodeTransforms[nodeIndex].scale[0], skeleton.nodeTransforms[nodeIndex].scale[1], skeleton.nodeTransforms[nodeIndex].scale[2]));
-
-  return translation * rotation * scale;
+  pushObjectPacket(list, LayerParticles, PipelineParticles, emitter, 0);
 }
 
-glm::mat4 getGlobalTransform(int nodeIndex, SkeletonComponent &skeleton, glm::mat4 startMatrix = glm::mat4(1.0f))
+void pushDebugPacket(DrawPacketList &list, VulkanDebugDrawer *drawer)
 {
-  glm::mat4 transform = startMatrix;
-
-  while (nodeIndex >= 0)
-  {
-    transform = getLocalTransform(skeleton, nodeIndex) * transform;
-
-    auto it = skeleton.nodeToParent.find(nodeIndex);
-    if (it == skeleton.nodeToParent.end())
-      break;
-    nodeIndex = it->second;
-  }
-
-  return transform;
+  if (drawer)
+    pushObjectPacket(list, LayerDebug, PipelineDebug, drawer, 0);
 }
 
-glm::mat4 getWorldTransform(ECSRegistry &registry, Entity e)
+VkExtent2D getSceneExtent(Renderer *renderer, RenderStage renderStage)
 {
-  auto transformIt = registry.transforms.find(e);
-  glm::mat4 transformation(1.0f);
-
-  if (transformIt != registry.transforms.end())
-  {
-    const TransformComponent &transform = transformIt->second;
+  if (renderStage == ColorID || *renderer->debugMode == DebugMode::Viewport)
+    return {static_cast<uint32_t>(renderer->engineUI.imageW), static_cast<uint32_t>(renderer->engineUI.imageH)};
+  return renderer->swapchainManager.swapChainExtent;
+}
 
-    transformation = glm::translate(transformation, transform.position);
-    transformation = glm::rotate(transformation, glm::radians(transform.rotationZYX.x), glm::vec3(0.0f, 0.0f, 1.0f));
-    transformation = glm::rotate(transformation, glm::radians(transform.rotationZYX.y), glm::vec3(0.0f, 1.0f, 0.0f));
-    transformation = glm::rotate(transformation, glm::radians(transform.rotationZYX.z), glm::vec3(1.0f, 0.0f, 0.0f));
-    transformation = glm::scale(transformation, transform.scale);
-  }
+static void bindPipelineState(Renderer *renderer, CommandStateCache &state, const DrawPacket &packet, RenderStage renderStage, int currentFrame)
+{
+  PipelineManager &pipelines = renderer->pipelineManager;
+  VkDescriptorSet frameSet = renderer->descriptorManager.frameDescriptorSets[currentFrame];
+  // instanced meshes don't read the per-draw uniforms, any offset will do
+  uint32_t noOffset = 0;
 
-  auto parentIt = registry.parents.find(e);
-  if (parentIt != registry.parents.end())
+  switch (packet.pipeline())
   {
-    Entity parent = parentIt->second.parent;
-    glm::mat4 parentTransform = getWorldTransform(registry, parent);
-    transformation = parentTransform * transformation;
+  case PipelineMesh:
+    if (renderStage == MainRender)
+    {
+      // textures and materials are indexed per instance, nothing is bound per draw
+      VkDescriptorSet meshSets[] = {renderer->descriptorManager.bindlessDescriptorSet, frameSet};
+      state.bindPipeline(pipelines.getMeshPipeline(renderer->deviceManager.device, packet.permutation()));
+      state.bindDescriptorSets(pipelines.meshPipelineLayout, 0, 2, meshSets, 1, &noOffset);
+    }
+    else
+    {
+      state.bindPipeline(pipelines.colorIDPipeline);
+      state.bindDescriptorSets(pipelines.colorIDPipelineLayout, 1, 1, &frameSet, 1, &noOffset);
+    }
+    // every static mesh draws from the arena, packets only pick their range
+    state.bindVertexBuffer(0, renderer->bufferManager.geometryArena.vertexBuffer);
+    state.bindIndexBuffer(renderer->bufferManager.geometryArena.indexBuffer);
+    state.setPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    state.setDepthWriteEnable(true);
+    state.setViewportScissor(getSceneExtent(renderer, renderStage));
+    break;
+  case PipelineAnimated:
+    state.bindPipeline(pipelines.animationPipeline);
+    state.setPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    state.setDepthWriteEnable(true);
+    state.setViewportScissor(getSceneExtent(renderer, renderStage));
+    break;
+  case PipelineUI:
+    state.bindPipeline(pipelines.graphicsPipeline);
+    state.setPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    state.setDepthWriteEnable(true);
+    state.setViewportScissor(getSceneExtent(renderer, renderStage));
+    break;
+  case PipelineParticles:
+    state.bindPipeline(pipelines.graphicsParticlePipeline);
+    state.setPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_POINT_LIST);
+    state.setDepthWriteEnable(false);
+    state.setViewportScissor(renderer->swapchainManager.swapChainExtent);
+    break;
+  case PipelineDebug:
+    state.bindPipeline(pipelines.debugPipeline);
+    state.setPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
+    state.setDepthWriteEnable(true);
+    state.setViewportScissor(getSceneExtent(renderer, renderStage));
+    break;
   }
-
-  return transformation;
 }
 
-RenderCommand makeGameObjectCommand(ECSRegistry &registry, Entity e, Renderer *renderer, int currentFrame, glm::mat4 view, glm::mat4 proj, DebugMode debugMode)
+void executeDrawPackets(Renderer *renderer, CommandStateCache &state, const DrawPacketList &list, RenderStage renderStage, int currentFrame, size_t first, size_t last)
 {
-  return {
-      [&registry, renderer, e, currentFrame, view, proj, debugMode](VkCommandBuffer cmdBuf, RenderStage renderStage)
-      {
-        auto meshIt = registry.meshes.find(e);
-        if (meshIt == registry.meshes.end() || meshIt->second.hide)
-        {
-          return;
-        }
-
-        if (renderStage == MainRender)
-        {
-          vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.graphicsPipeline);
-          setTriangleTopology(renderer, cmdBuf);
-          enableDepthWrite(renderer, cmdBuf);
-
-          VkExtent2D offscreenExtent;
-          offscreenExtent.width = debugMode == DebugMode::Viewport ? renderer->engineUI.imageW : renderer->swapchainManager.swapChainExtent.width;
-          offscreenExtent.height = debugMode == DebugMode::Viewport ? renderer->engineUI.imageH : renderer->swapchainManager.swapChainExtent.height;
-          setupViewportScissor(cmdBuf, offscreenExtent);
-        }
-        else if (renderStage == ColorID)
-        {
-          vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.colorIDPipeline);
-          setTriangleTopology(renderer, cmdBuf);
-          enableDepthWrite(renderer, cmdBuf);
-
-          VkExtent2D offscreenExtent;
-          offscreenExtent.width = renderer->engineUI.imageW;
-          offscreenExtent.height = renderer->engineUI.imageH;
-          setupViewportScissor(cmdBuf, offscreenExtent);
-        }
-
-        MeshComponent &meshComp = registry.meshes.at(e);
-
-        if (meshComp.hide)
-          return;
-
-        glm::mat4 transformation = getWorldTransform(registry, e);
-
-        for (auto &mesh : meshComp.meshes)
-        {
-          mesh.draw(renderer, currentFrame, transformation, view, proj, cmdBuf, renderStage == MainRender ? -1 : e);
-        }
-      }};
-}
+  VkCommandBuffer commandBuffer = state.getCommandBuffer();
+  BufferManager &buffers = renderer->bufferManager;
+  DescriptorManager &descriptors = renderer->descriptorManager;
+  PipelineManager &pipelines = renderer->pipelineManager;
+  const int framesInFlight = renderer->MAX_FRAMES_IN_FLIGHT;
+
+  // buffers, sets and dynamic state are filtered by the cache, push constants are tracked here
+  uint64_t boundState = UINT64_MAX;
+  uint32_t pushedMaterial = UINT32_MAX;
+
+  last = std::min(last, list.packets.size());
+  for (size_t i = first; i < last; i++)
+  {
+    const DrawPacket &packet = list.packets[i];
+    DrawPipeline pipeline = packet.pipeline();
+    if (renderStage == ColorID && pipeline != PipelineMesh)
+      continue;
+
+    // static meshes switch pipelines with their permutation, the others only with the pipeline bits
+    uint64_t pipelineState = pipeline == PipelineMesh ? packet.key >> DRAW_KEY_MATERIAL_SHIFT : (packet.key >> DRAW_KEY_PIPELINE_SHIFT) << 16;
+    if (pipelineState != boundState)
+    {
+      bindPipelineState(renderer, state, packet, renderStage, currentFrame);
+      boundState = pipelineState;
+      pushedMaterial = UINT32_MAX;
+    }
 
-RenderCommand makeAnimatedGameObjectCommand(ECSRegistry &registry, Entity e, Renderer *renderer, int currentFrame, glm::mat4 view, glm::mat4 proj, DebugMode debugMode)
-{
-  return {
-      [&registry, renderer, e, currentFrame, view, proj, debugMode](VkCommandBuffer cmdBuf, RenderStage renderStage)
+    switch (pipeline)
+    {
+    case PipelineMesh:
+    {
+      // the batches of one permutation are neighbours and go out together with the first of them
+      // the culling pass compacted the run's visible batches to its start and counted them at the run's first batch
+      uint32_t packetIndex = static_cast<uint32_t>(i);
+      uint32_t gpuLast = list.firstGpuBatch + list.gpuBatchCount;
+      if (list.gpuBatchCount > 0 && packetIndex >= list.firstGpuBatch && packetIndex < gpuLast)
       {
-        auto animMeshIt = registry.animatedMeshes.find(e);
-        if (animMeshIt == registry.animatedMeshes.end() || animMeshIt->second.hide)
-        {
-          return;
-        }
-
-        if (renderStage == ColorID) // Need to add support for color picking with animated meshes later
+        if (packetIndex == list.firstGpuBatch || list.packets[i - 1].permutation() != packet.permutation())
         {
-          return;
+          uint32_t runEnd = packetIndex + 1;
+          while (runEnd < gpuLast && list.packets[runEnd].permutation() == packet.permutation())
+            runEnd++;
+          const GpuCullBuffers &cull = buffers.gpuCullBuffers[currentFrame];
+          uint32_t runStart = packetIndex - list.firstGpuBatch;
+          VkDeviceSize offset = runStart * sizeof(VkDrawIndexedIndirectCommand);
+          VkDeviceSize countOffset = (2 + runStart) * sizeof(uint32_t);
+          vkCmdDrawIndexedIndirectCount(commandBuffer, cull.commands.buffer, offset, cull.drawCount.buffer, countOffset, runEnd - packetIndex, sizeof(VkDrawIndexedIndirectCommand));
         }
-        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.animationPipeline);
-        setTriangleTopology(renderer, cmdBuf);
-        enableDepthWrite(renderer, cmdBuf);
-
-        VkExtent2D offscreenExtent;
-        offscreenExtent.width = debugMode == DebugMode::Viewport ? renderer->engineUI.imageW : renderer->swapchainManager.swapChainExtent.width;
-        offscreenExtent.height = debugMode == DebugMode::Viewport ? renderer->engineUI.imageH : renderer->swapchainManager.swapChainExtent.height;
-        setupViewportScissor(cmdBuf, offscreenExtent);
-
-        AnimatedMeshComponent &animMeshComp = registry.animatedMeshes.at(e);
-
-        if (animMeshComp.hide)
-          return;
+        break;
+      }
 
-        glm::mat4 transformation = getWorldTransform(registry, e);
+      // every static mesh draws from the arena, set 0 and set 1 stay bound from bindPipelineState
+      const GeometryRange &range = buffers.geometryArena.get(packet.geometryId);
+      vkCmdDrawIndexed(commandBuffer, packet.indexCount, packet.instanceCount, range.firstIndex + packet.firstIndex, static_cast<int32_t>(range.firstVertex), packet.firstInstance);
+      break;
+    }
+    case PipelineAnimated:
+    {
+      int bufferIndex = currentFrame + packet.renderingId * framesInFlight;
+      VkPipelineLayout layout = pipelines.animPipelineLayout;
 
-        SkeletonComponent &skeleton = registry.animationSkeletons.at(e);
-        if (registry.animationComponents.find(e) != registry.animationComponents.end())
-        {
-          float currentTime = glfwGetTime();
-          if (currentTime > 0)
-          {
-            AnimationComponent &animations = registry.animationComponents.at(e);
-            Animation &animation = animations.animations.at(0);
-            currentTime = fmod(currentTime, animation.duration);
-
-            for (auto &channel : animation.channels)
-            {
-              AnimationSampler &sampler = animation.samplers[channel.samplerIndex];
-              int frameIndex = 0;
-              for (size_t i = 0; i < sampler.inputTimes.size(); ++i)
-              {
-                if (sampler.inputTimes[i] > currentTime)
-                  break;
-                frameIndex = i;
-              }
-
-              if (channel.path == "translation")
-              {
-                skeleton.nodeTransforms[channel.nodeIndex].translation = glm::vec3(sampler.outputValues[frameIndex]);
-                skeleton.computeFinalBoneMatrices = true;
-              }
-              else if (channel.path == "rotation")
-              {
-                skeleton.nodeTransforms[channel.nodeIndex].rotation = glm::vec4(sampler.outputValues[frameIndex][3], sampler.outputValues[frameIndex][0], sampler.outputValues[frameIndex][1], sampler.outputValues[frameIndex][2]);
-                skeleton.computeFinalBoneMatrices = true;
-              }
-              else if (channel.path == "scale")
-              {
-                skeleton.nodeTransforms[channel.nodeIndex].scale = glm::vec3(sampler.outputValues[frameIndex]);
-                skeleton.computeFinalBoneMatrices = true;
-              }
-            }
-          }
-        }
+      state.bindVertexBuffer(0, buffers.vertexBuffers[packet.geometryId]);
+      state.bindIndexBuffer(buffers.indexBuffers[packet.geometryId]);
+      state.bindDescriptorSets(layout, 0, 1, &descriptors.descriptorSets[bufferIndex]);
 
-        if (skeleton.computeFinalBoneMatrices)
-        {
-          skeleton.computeFinalBoneMatrices = !skeleton.computeFinalBoneMatrices;
-          skeleton.finalBoneMatrices = {};
-
-          const tinygltf::Skin &skin = skeleton.model->skins[skeleton.node->skin];
-          for (int i = 0; i < skin.joints.size(); i++)
-          {
-            int jointNodeIndex = skin.joints[i];
-
-            glm::mat4 jointGlobalTransform = getGlobalTransform(jointNodeIndex, skeleton);
-            glm::mat4 inverseBind = skeleton.inverseBindMats[i];
-            skeleton.finalBoneMatrices[i] = jointGlobalTransform * inverseBind;
-          }
-        }
-
-        for (auto &mesh : animMeshComp.meshes)
-        {
-          mesh.draw(renderer, currentFrame, transformation, view, proj, skeleton.finalBoneMatrices, cmdBuf, renderStage == MainRender ? -1 : e);
-        }
-      }};
-}
+      // animated meshes are only drawn in the main stage, so each gets its uniforms pushed once per frame
+      uint32_t dynamicOffsets[] = {buffers.pushObjectUniforms(currentFrame, list.transforms[packet.transformIndex], CameraScene),
+                                   buffers.pushBoneUniforms(currentFrame, *static_cast<const std::array<glm::mat4, 100> *>(packet.object))};
+      VkDescriptorSet descriptorSets[] = {descriptors.frameDescriptorSets[currentFrame], descriptors.animDescriptorSets[currentFrame]};
+      state.bindDescriptorSets(layout, 1, 2, descriptorSets, 2, dynamicOffsets);
 
-RenderCommand makeUICommand(UI *ui, Renderer *renderer, int currentFrame, glm::mat4 model, glm::mat4 ortho, DebugMode debugMode)
-{
-  return {
-      [=](VkCommandBuffer cmdBuf, RenderStage renderStage)
+      if (packet.materialIndex != pushedMaterial)
       {
-        if (renderStage != MainRender)
-        {
-          return;
-        }
-        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.graphicsPipeline);
-        setTriangleTopology(renderer, cmdBuf);
-        enableDepthWrite(renderer, cmdBuf);
-
-        glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 0.0f);
-        glm::vec3 cameraTarget = glm::vec3(0.0f, 0.0f, -1.0f);
-        glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
-        glm::mat4 staticView = glm::lookAt(cameraPos, cameraTarget, cameraUp);
-
-        VkExtent2D offscreenExtent;
-        offscreenExtent.width = debugMode == DebugMode::Viewport ? renderer->engineUI.imageW : renderer->swapchainManager.swapChainExtent.width;
-        offscreenExtent.height = debugMode == DebugMode::Viewport ? renderer->engineUI.imageH : renderer->swapchainManager.swapChainExtent.height;
-        setupViewportScissor(cmdBuf, offscreenExtent);
-        ui->draw(renderer, currentFrame, model, staticView, ortho, cmdBuf);
-      }};
-}
+        vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MaterialData), &list.materials[packet.materialIndex]);
+        pushedMaterial = packet.materialIndex;
+      }
 
-RenderCommand makeParticleCommand(ParticleEmitter *emitter, Renderer *renderer, int currentFrame, glm::mat4 view, glm::mat4 proj, DebugMode debugMode)
-{
-  return {
-      [=](VkCommandBuffer cmdBuf, RenderStage renderStage)
-      {
-        if (renderStage != MainRender)
-        {
-          return;
-        }
+      vkCmdDrawIndexed(commandBuffer, packet.indexCount, 1, 0, 0, 0);
+      break;
+    }
+    case PipelineUI:
+      static_cast<UI *>(packet.object)->draw(renderer, currentFrame, list.transforms[packet.transformIndex], commandBuffer);
+      break;
+    case PipelineParticles:
+      static_cast<ParticleEmitter *>(packet.object)->draw(renderer, currentFrame, commandBuffer);
+      break;
+    case PipelineDebug:
+      static_cast<VulkanDebugDrawer *>(packet.object)->drawDebugGeometry(commandBuffer, list.view, list.proj, currentFrame);
+      break;
+    }
 
-        vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.graphicsParticlePipeline);
-        setPointListTopology(renderer, cmdBuf);
-        disableDepthWrite(renderer, cmdBuf);
-        setupViewportScissor(renderer, cmdBuf);
-        emitter->draw(renderer, currentFrame, view, proj, cmdBuf);
-      }};
+    // these bind their own buffers and sets and push their own constants
+    if (pipeline != PipelineMesh && pipeline != PipelineAnimated)
+    {
+      state.invalidateBindings();
+      pushedMaterial = UINT32_MAX;
+    }
+  }
 }
 
-RenderCommand makeDebugCommand(VulkanDebugDrawer *drawer, Renderer *renderer, const std::vector<Vertex> &lines, glm::mat4 view, glm::mat4 proj, int currentFrame, DebugMode debugMode)
+VkDeviceSize frameUniformBytes(const BufferManager &buffers, const DrawPacketList &list)
 {
-  return {
-      [=](VkCommandBuffer cmdBuf, RenderStage renderStage)
-      {
-        if (renderStage != MainRender)
-        {
-          return;
-        }
+  VkDeviceSize objectSize = buffers.alignUniformSize(sizeof(ObjectUniformBufferObject));
+  VkDeviceSize boneSize = buffers.alignUniformSize(sizeof(AnimatedUniformBufferObject));
 
-        if (drawer)
-        {
-          vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.graphicsPipeline);
-          setLineListTopology(renderer, cmdBuf);
-          enableDepthWrite(renderer, cmdBuf);
-
-          VkExtent2D offscreenExtent;
-          offscreenExtent.width = debugMode == DebugMode::Viewport ? renderer->engineUI.imageW : renderer->swapchainManager.swapChainExtent.width;
-          offscreenExtent.height = debugMode == DebugMode::Viewport ? renderer->engineUI.imageH : renderer->swapchainManager.swapChainExtent.height;
-          setupViewportScissor(cmdBuf, offscreenExtent);
-          drawer->drawDebugLines(cmdBuf, lines, view, proj, currentFrame);
-        }
-      }};
+  VkDeviceSize size = 0;
+  for (const DrawPacket &packet : list.packets)
+  {
+    switch (packet.pipeline())
+    {
+    case PipelineAnimated:
+      size += objectSize + boneSize;
+      break;
+    case PipelineUI:
+      // a button draws its text as well
+      size += 2 * objectSize;
+      break;
+    case PipelineParticles:
+      size += objectSize;
+      break;
+    default:
+      break;
+    }
+  }
+  return size;
 }
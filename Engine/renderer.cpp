@@ -5,6 +5,7 @@
 #include <cstring>
 #include "text.hpp"
 #include "particleEmitter.hpp"
+#include "renderCommands.hpp"
 #include <imgui.h>
 #include <imgui_impl_vulkan.h>
 
@@ -33,25 +34,41 @@ void Renderer::initVulkan()
   createInstance();
   swapchainManager.createSurface(instance);
   deviceManager.pickPhysicalDevice(instance, deviceExtensions);
-  deviceManager.createLogicalDevice(enableValidationLayers, deviceExtensions, validationLayers, &presentQueue, &graphicsQueue, &computeQueue);
+  deviceManager.createLogicalDevice(enableValidationLayers, deviceExtensions, validationLayers, &presentQueue, &graphicsQueue, &computeQueue, &transferQueue);
 
   swapchainManager.createSwapChain(deviceManager.device, deviceManager.physicalDevice);
   swapchainManager.createImageViews(deviceManager.device);
   pipelineManager.createRenderPass(deviceManager.device, deviceManager.physicalDevice);
   pipelineManager.createOffScreenRenderPass(deviceManager.device, deviceManager.physicalDevice);
   pipelineManager.createColorIDRenderPass(deviceManager.device, deviceManager.physicalDevice);
+  pipelineManager.createOcclusionRenderPass(deviceManager.device, deviceManager.physicalDevice);
   descriptorManager.createDescriptorSetLayout(deviceManager.device);
-  pipelineManager.createGraphicsPipeline(deviceManager.device);
-  pipelineManager.createColorIDPipeline(deviceManager.device);
-  pipelineManager.createComputePipeline(deviceManager.device);
+  descriptorManager.createBindlessDescriptors(deviceManager.device, deviceManager.physicalDevice);
+  pipelineManager.createPipelineCache(deviceManager.device, deviceManager.physicalDevice);
+  pipelineManager.createPipelines(deviceManager.device);
   createCommandPool();
+  QueueFamilyIndices queueFamilies = findQueueFamilies(deviceManager.physicalDevice, swapchainManager.surface);
+  bufferManager.uploadManager.init(deviceManager.device, deviceManager.physicalDevice, transferQueue, queueFamilies.transferFamily.value(), queueFamilies.graphicsFamily.value());
+  textureStreamer.init(MAX_FRAMES_IN_FLIGHT, deviceManager.compressedFormats);
+  textureCache.init(*this);
   swapchainManager.createDepthResources(deviceManager.device, deviceManager.physicalDevice, commandPool, graphicsQueue);
   swapchainManager.createFramebuffers(deviceManager.device, pipelineManager.renderPass);
   // bufferManager.createVertexBuffer(vertices, 0, deviceManager.device, deviceManager.physicalDevice, commandPool, graphicsQueue);
   // bufferManager.createIndexBuffer(indices, 0, deviceManager.device, deviceManager.physicalDevice, commandPool, //graphicsQueue);
   // bufferManager.createUniformBuffers(MAX_FRAMES_IN_FLIGHT, deviceManager.device, deviceManager.physicalDevice, 2);
   bufferManager.createLightsUniformBuffers(MAX_FRAMES_IN_FLIGHT, deviceManager.device, deviceManager.physicalDevice);
-  descriptorManager.createDescriptorPool(deviceManager.device, MAX_FRAMES_IN_FLIGHT, 250);
+  descriptorManager.createDescriptorPool(deviceManager.device, MAX_FRAMES_IN_FLIGHT, DescriptorManager::MAX_DESCRIPTOR_SET_OBJECTS);
+  bufferManager.createGlobalUniformBuffers(MAX_FRAMES_IN_FLIGHT, deviceManager.device, deviceManager.physicalDevice);
+  for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+  {
+    bufferManager.reserveInstanceBuffer(i, 1024, deviceManager.device, deviceManager.physicalDevice);
+    bufferManager.reserveMaterialBuffer(i, 256, deviceManager.device, deviceManager.physicalDevice);
+    bufferManager.reserveFrameUniforms(i, 256 * 1024, deviceManager.device, deviceManager.physicalDevice);
+    bufferManager.reserveGpuCullBuffers(i, 1024, 256, deviceManager.device, deviceManager.physicalDevice);
+  }
+  bufferManager.reserveCullVisibility(1024, deviceManager.device, deviceManager.physicalDevice);
+  gpuCulling = deviceManager.drawIndirectCountSupported;
+  descriptorManager.createFrameDescriptorSets(deviceManager.device, MAX_FRAMES_IN_FLIGHT);
 
   // descriptorManager.createDescriptorSets(deviceManager.device, MAX_FRAMES_IN_FLIGHT, 1);
   // descriptorManager.addDescriptorSets(deviceManager.device, MAX_FRAMES_IN_FLIGHT, 1);
@@ -60,6 +77,8 @@ void Renderer::initVulkan()
 
   fpCmdSetPrimitiveTopology = (PFN_vkCmdSetPrimitiveTopology)vkGetDeviceProcAddr(deviceManager.device, "vkCmdSetPrimitiveTopology");
   vkCmdSetDepthWriteEnableEXT = (PFN_vkCmdSetDepthWriteEnableEXT)vkGetDeviceProcAddr(deviceManager.device, "vkCmdSetDepthWriteEnableEXT");
+  commandState.init(deviceManager.device, fpCmdSetPrimitiveTopology, vkCmdSetDepthWriteEnableEXT);
+  commandRecorder.init(deviceManager.device, findQueueFamilies(deviceManager.physicalDevice, swapchainManager.surface).graphicsFamily.value(), MAX_FRAMES_IN_FLIGHT, fpCmdSetPrimitiveTopology, vkCmdSetDepthWriteEnableEXT);
 }
 
 void Renderer::recreateSwapChain()
@@ -158,7 +177,7 @@ void Renderer::beginCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageI
   }
 }
 
-void Renderer::beginOffscreenRenderPass(VkCommandBuffer commandBuffer)
+void Renderer::beginOffscreenRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 {
   VkImageMemoryBarrier barrier{};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -202,10 +221,11 @@ void Renderer::beginOffscreenRenderPass(VkCommandBuffer commandBuffer)
   renderPassInfo.clearValueCount = 2;
   renderPassInfo.pClearValues = clearValues;
 
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+  commandState.invalidate();
 }
 
-void Renderer::beginColorIDRenderPass(VkCommandBuffer commandBuffer)
+void Renderer::beginColorIDRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents)
 {
   VkImageMemoryBarrier barrier{};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -249,10 +269,11 @@ void Renderer::beginColorIDRenderPass(VkCommandBuffer commandBuffer)
   renderPassInfo.clearValueCount = 2;
   renderPassInfo.pClearValues = clearValues;
 
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+  commandState.invalidate();
 }
 
-void Renderer::beginRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+void Renderer::beginRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkSubpassContents contents)
 {
   VkImageMemoryBarrier barrier = {};
   barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
@@ -283,7 +304,8 @@ void Renderer::beginRenderPass(VkCommandBuffer commandBuffer, uint32_t imageInde
   renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
   renderPassInfo.pClearValues = clearValues.data();
 
-  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, contents);
+  commandState.invalidate();
 }
 
 void Renderer::endCommandBuffer(VkCommandBuffer commandBuffer)
@@ -299,17 +321,232 @@ void Renderer::endRenderPass(VkCommandBuffer commandBuffer)
   vkCmdEndRenderPass(commandBuffer);
 }
 
+// the frame's fence has been waited on, so its uniform, instance, material buffers and descriptor sets are no longer in use
+void Renderer::updateFrameUniforms()
+{
+  GlobalUniformBufferObject globals{};
+  globals.cameras[CameraScene].view = drawPackets.view;
+  globals.cameras[CameraScene].proj = drawPackets.proj;
+  globals.cameras[CameraScene].proj[1][1] *= -1;
+  globals.cameras[CameraScene].position = glm::vec4(drawPackets.cameraPosition, 1.0f);
+  // the UI camera sits at the origin looking down -z, which is the identity view
+  globals.cameras[CameraScreen].view = glm::mat4(1.0f);
+  globals.cameras[CameraScreen].proj = drawPackets.ortho;
+  globals.cameras[CameraScreen].proj[1][1] *= -1;
+  globals.cameras[CameraScreen].position = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  bufferManager.updateGlobalUniformBuffer(currentFrame, globals);
+
+  bool grown = bufferManager.reserveFrameUniforms(currentFrame, frameUniformBytes(bufferManager, drawPackets), deviceManager.device, deviceManager.physicalDevice);
+  bufferManager.resetFrameUniforms(currentFrame);
+
+  const std::vector<InstanceData> &instances = drawPackets.instances;
+  if (bufferManager.reserveInstanceBuffer(currentFrame, instances.size(), deviceManager.device, deviceManager.physicalDevice))
+    grown = true;
+  size_t materialCount = drawPackets.materials.size();
+  if (bufferManager.reserveMaterialBuffer(currentFrame, materialCount, deviceManager.device, deviceManager.physicalDevice))
+    grown = true;
+  if (bufferManager.reserveGpuCullBuffers(currentFrame, drawPackets.cullInstances.size(), drawPackets.gpuBatchCount, deviceManager.device, deviceManager.physicalDevice))
+    grown = true;
+  prepareOcclusionCulling();
+  if (grown)
+    descriptorManager.updateFrameDescriptorSets(deviceManager.device, currentFrame);
+
+  if (!instances.empty())
+    memcpy(bufferManager.instanceBuffersMapped[currentFrame], instances.data(), instances.size() * sizeof(InstanceData));
+
+  BindlessMaterial *materials = static_cast<BindlessMaterial *>(bufferManager.materialBuffersMapped[currentFrame]);
+  for (size_t i = 0; i < materialCount; i++)
+  {
+    materials[i].factors = drawPackets.materials[i];
+    materials[i].textures = descriptorManager.resolveMaterialTextures(drawPackets.materialTextures[i]);
+  }
+
+  GpuCullBuffers &cull = bufferManager.gpuCullBuffers[currentFrame];
+  uint32_t *drawCounts = static_cast<uint32_t *>(cull.drawCount.mapped);
+  // the GPU finished with this frame's buffers at the fence, so the counts are from MAX_FRAMES_IN_FLIGHT frames ago
+  gpuCulledDraws = drawCounts[0];
+  gpuOccluderDraws = drawCounts[1];
+  memset(drawCounts, 0, (2 + drawPackets.gpuBatchCount) * sizeof(uint32_t));
+
+  if (drawPackets.gpuBatchCount == 0)
+    return;
+
+  memcpy(cull.instances.mapped, drawPackets.cullInstances.data(), drawPackets.cullInstances.size() * sizeof(CullInstanceData));
+
+  // instanceCount starts at zero and is counted up by the culling pass, firstInstance is where the batch's visible instances go
+  GpuBatchData *batches = static_cast<GpuBatchData *>(cull.batches.mapped);
+  uint32_t runStart = 0;
+  for (uint32_t i = 0; i < drawPackets.gpuBatchCount; i++)
+  {
+    const DrawPacket &packet = drawPackets.packets[drawPackets.firstGpuBatch + i];
+    const GeometryRange &range = bufferManager.geometryArena.get(packet.geometryId);
+    if (i > 0 && drawPackets.packets[drawPackets.firstGpuBatch + i - 1].permutation() != packet.permutation())
+      runStart = i;
+    batches[i].draw.indexCount = packet.indexCount;
+    batches[i].draw.instanceCount = 0;
+    batches[i].draw.firstIndex = range.firstIndex + packet.firstIndex;
+    batches[i].draw.vertexOffset = static_cast<int32_t>(range.firstVertex);
+    batches[i].draw.firstInstance = packet.firstInstance;
+    batches[i].runStart = runStart;
+  }
+}
+
+void Renderer::prepareOcclusionCulling()
+{
+  if (!drawPackets.gpuCulling)
+    return;
+
+  // the pyramid is created even with occlusion culling off, the culling pass always has it bound
+  VkExtent2D sceneExtent = getSceneExtent(this, RenderStage::MainRender);
+  bool resize = sceneExtent.width > 0 && sceneExtent.height > 0 && (sceneExtent.width != depthPyramid.extent.width || sceneExtent.height != depthPyramid.extent.height);
+  bool grow = drawPackets.visibilitySlots * sizeof(uint32_t) > bufferManager.cullVisibility.capacity;
+  if (!resize && !grow)
+    return;
+
+  // the other frames in flight still read both
+  vkDeviceWaitIdle(deviceManager.device);
+
+  if (grow)
+    bufferManager.reserveCullVisibility(drawPackets.visibilitySlots, deviceManager.device, deviceManager.physicalDevice);
+  if (resize)
+    depthPyramid.create(sceneExtent, pipelineManager.occlusionRenderPass, descriptorManager.depthPyramidDescriptorSetLayout, swapchainManager.findDepthFormat(deviceManager.physicalDevice), deviceManager.device, deviceManager.physicalDevice);
+
+  for (int frame = 0; frame < MAX_FRAMES_IN_FLIGHT; frame++)
+  {
+    if (grow)
+      descriptorManager.updateFrameDescriptorSets(deviceManager.device, frame);
+    if (resize)
+      descriptorManager.updateCullPyramid(deviceManager.device, frame, depthPyramid.pyramidView, depthPyramid.sampler);
+  }
+}
+
+static void cullBarrier(VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = dstAccess;
+  vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void Renderer::recordCullPass(VkCommandBuffer commandBuffer)
+{
+  // without a pyramid the scene has no size, the draw count stays zero and nothing is drawn
+  if (drawPackets.gpuBatchCount == 0 || depthPyramid.levelCount == 0)
+    return;
+
+  bool occlusion = occlusionCulling;
+  uint32_t instanceCount = static_cast<uint32_t>(drawPackets.cullInstances.size());
+  uint32_t batchCount = drawPackets.gpuBatchCount;
+
+  CullConstants constants{};
+  glm::mat4 proj = drawPackets.proj;
+  proj[1][1] *= -1;
+  constants.viewProj = proj * drawPackets.view;
+  constants.depthSize = glm::uvec2(depthPyramid.extent.width, depthPyramid.extent.height);
+  constants.pyramidLevels = depthPyramid.levelCount;
+  constants.occlusion = occlusion ? 1 : 0;
+
+  auto bindCullPipeline = [&]()
+  {
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineManager.cullPipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineManager.cullPipelineLayout, 0, 1, &descriptorManager.cullDescriptorSets[currentFrame], 0, nullptr);
+  };
+  auto dispatch = [&](CullPass pass, uint32_t count)
+  {
+    constants.pass = pass;
+    constants.count = count;
+    vkCmdPushConstants(commandBuffer, pipelineManager.cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+    vkCmdDispatch(commandBuffer, (count + 63) / 64, 1, 1);
+  };
+
+  // the visibility flags were last written by the previous frame's occlusion pass
+  cullBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  bindCullPipeline();
+  dispatch(CullPassFrustum, instanceCount);
+  cullBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+  if (occlusion)
+  {
+    dispatch(CullPassCompactOccluders, batchCount);
+    cullBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    recordOccluderPass(commandBuffer);
+    depthPyramid.build(commandBuffer, pipelineManager.depthPyramidPipeline, pipelineManager.depthPyramidPipelineLayout);
+
+    // the occluders' vertex shaders read the instances the occlusion pass overwrites
+    cullBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    bindCullPipeline();
+    dispatch(CullPassOcclusion, instanceCount);
+    cullBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
+  dispatch(CullPassCompact, batchCount);
+  cullBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT);
+}
+
+// draws the instances that were visible last frame into the occlusion depth
+void Renderer::recordOccluderPass(VkCommandBuffer commandBuffer)
+{
+  VkRenderPassBeginInfo renderPassInfo{};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = pipelineManager.occlusionRenderPass;
+  renderPassInfo.framebuffer = depthPyramid.framebuffer;
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = depthPyramid.extent;
+
+  VkClearValue clearValue{};
+  clearValue.depthStencil = {1.0f, 0};
+  renderPassInfo.clearValueCount = 1;
+  renderPassInfo.pClearValues = &clearValue;
+
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+  commandState.invalidate();
+
+  VkDescriptorSet meshSets[] = {descriptorManager.bindlessDescriptorSet, descriptorManager.frameDescriptorSets[currentFrame]};
+  uint32_t noOffset = 0;
+  commandState.bindPipeline(pipelineManager.occluderPipeline);
+  commandState.bindDescriptorSets(pipelineManager.meshPipelineLayout, 0, 2, meshSets, 1, &noOffset);
+  commandState.bindVertexBuffer(0, bufferManager.geometryArena.vertexBuffer);
+  commandState.bindIndexBuffer(bufferManager.geometryArena.indexBuffer);
+  commandState.setPrimitiveTopology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+  commandState.setDepthWriteEnable(true);
+  commandState.setViewportScissor(depthPyramid.extent);
+
+  // the occluder draws follow the main draws in the command buffer, their count is the second one
+  const GpuCullBuffers &cull = bufferManager.gpuCullBuffers[currentFrame];
+  VkDeviceSize occluderOffset = drawPackets.gpuBatchCount * sizeof(VkDrawIndexedIndirectCommand);
+  vkCmdDrawIndexedIndirectCount(commandBuffer, cull.commands.buffer, occluderOffset, cull.drawCount.buffer, sizeof(uint32_t), drawPackets.gpuBatchCount, sizeof(VkDrawIndexedIndirectCommand));
+
+  endRenderPass(commandBuffer);
+}
+
+// secondaries recorded for a render pass have to name it and the framebuffer they draw into
+static VkCommandBufferInheritanceInfo renderPassInheritance(VkRenderPass renderPass, VkFramebuffer framebuffer)
+{
+  VkCommandBufferInheritanceInfo inheritance{};
+  inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance.renderPass = renderPass;
+  inheritance.subpass = 0;
+  inheritance.framebuffer = framebuffer;
+  return inheritance;
+}
+
 void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
   beginCommandBuffer(commandBuffer, imageIndex);
+  commandState.begin(commandBuffer);
+  commandRecorder.beginFrame(deviceManager.device, currentFrame);
+  recordCullPass(commandBuffer);
   if (*debugMode == DebugMode::Viewport)
   {
-    beginOffscreenRenderPass(commandBuffer);
+    beginOffscreenRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-    for (const auto &cmd : renderQueue)
-    {
-      cmd.execute(commandBuffer, RenderStage::MainRender);
-    }
+    VkCommandBufferInheritanceInfo offscreenInheritance = renderPassInheritance(pipelineManager.offscreenRenderPass, engineUI.offscreenFramebuffer);
+    commandRecorder.record(this, drawPackets, RenderStage::MainRender, commandBuffer, offscreenInheritance);
 
     endRenderPass(commandBuffer);
 
@@ -330,12 +567,10 @@ void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t image
 
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-    beginColorIDRenderPass(commandBuffer);
+    beginColorIDRenderPass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-    for (const auto &cmd : renderQueue)
-    {
-      cmd.execute(commandBuffer, RenderStage::ColorID);
-    }
+    VkCommandBufferInheritanceInfo colorIDInheritance = renderPassInheritance(pipelineManager.colorIDRenderPass, engineUI.colorIDFramebuffer);
+    commandRecorder.record(this, drawPackets, RenderStage::ColorID, commandBuffer, colorIDInheritance);
 
     endRenderPass(commandBuffer);
 
@@ -358,37 +593,38 @@ void Renderer::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t image
 
     beginRenderPass(commandBuffer, imageIndex);
 
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineManager.graphicsPipeline);
+    commandState.bindPipeline(pipelineManager.graphicsPipeline);
     ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+    commandState.invalidate();
 
     endRenderPass(commandBuffer);
   }
   else if (*debugMode == DebugMode::Tools)
   {
-    beginRenderPass(commandBuffer, imageIndex);
+    beginRenderPass(commandBuffer, imageIndex, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-    for (const auto &cmd : renderQueue)
-    {
-      cmd.execute(commandBuffer, RenderStage::MainRender);
-    }
-
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineManager.graphicsPipeline);
-    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+    // a subpass begun for secondaries can't take inline commands, so ImGui goes into the last secondary
+    VkCommandBufferInheritanceInfo inheritance = renderPassInheritance(pipelineManager.renderPass, swapchainManager.swapChainFramebuffers[imageIndex]);
+    commandRecorder.record(this, drawPackets, RenderStage::MainRender, commandBuffer, inheritance, [this](CommandStateCache &state)
+                           {
+                             state.bindPipeline(pipelineManager.graphicsPipeline);
+                             ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), state.getCommandBuffer());
+                             state.invalidate(); });
 
     endRenderPass(commandBuffer);
   }
   else if (*debugMode == DebugMode::Inactive)
   {
-    beginRenderPass(commandBuffer, imageIndex);
+    beginRenderPass(commandBuffer, imageIndex, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
 
-    for (const auto &cmd : renderQueue)
-    {
-      cmd.execute(commandBuffer, RenderStage::MainRender);
-    }
+    VkCommandBufferInheritanceInfo inheritance = renderPassInheritance(pipelineManager.renderPass, swapchainManager.swapChainFramebuffers[imageIndex]);
+    commandRecorder.record(this, drawPackets, RenderStage::MainRender, commandBuffer, inheritance);
 
     endRenderPass(commandBuffer);
   }
   endCommandBuffer(commandBuffer);
+  commandStats = commandState.stats;
+  commandStats.add(commandRecorder.stats);
 }
 
 void Renderer::recordComputeCommandBuffer(VkCommandBuffer commandBuffer, uint32_t currentFrame)
@@ -436,8 +672,20 @@ void Renderer::createCommandPool()
   }
 }
 
+void Renderer::compactGeometry()
+{
+  // nothing is in flight after the wait, so the retired ranges count as holes too
+  vkDeviceWaitIdle(deviceManager.device);
+  bufferManager.geometryArena.releaseRetired(0);
+  // packets look up the moved ranges while recording
+  bufferManager.geometryArena.compactIfFragmented(bufferManager.uploadManager, deviceManager.device, deviceManager.physicalDevice, graphicsQueue);
+}
+
 void Renderer::drawFrame()
 {
+  // uploads recorded since the last frame start on the transfer queue while this one is built
+  bufferManager.uploadManager.flush();
+
   vkWaitForFences(deviceManager.device, 1, &computeInFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
 
   bufferManager.updateComputeUniformBuffer(currentFrame, 0.0005);
@@ -479,15 +727,32 @@ void Renderer::drawFrame()
 
   vkResetCommandBuffer(commandBuffers[currentFrame], 0);
 
+  // the frame that last used this slot is done, geometry freed before it can't be read anymore
+  bufferManager.geometryArena.releaseRetired(MAX_FRAMES_IN_FLIGHT);
+  descriptorManager.releaseRetiredBindless(MAX_FRAMES_IN_FLIGHT);
+  // swaps in finished mips before the material buffer resolves the texture slots
+  textureStreamer.update(*this, drawPackets.uploadsCompleted);
+
+  updateFrameUniforms();
+  auto recordStart = std::chrono::steady_clock::now();
   recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+  recordMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count();
 
   VkSubmitInfo submitInfo{};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-  VkSemaphore waitSemaphores[] = {computeFinishedSemaphores[currentFrame], imageAvailableSemaphores[currentFrame]};
-  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT};
+  // the packets only draw uploads the transfer queue already finished, waiting on that value makes their writes visible without stalling
+  VkSemaphore waitSemaphores[] = {computeFinishedSemaphores[currentFrame], imageAvailableSemaphores[currentFrame], bufferManager.uploadManager.timelineSemaphore()};
+  VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT};
+  uint64_t waitValues[] = {0, 0, drawPackets.uploadsCompleted};
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount = 3;
+  timelineInfo.pWaitSemaphoreValues = waitValues;
+  submitInfo.pNext = &timelineInfo;
 
-  submitInfo.waitSemaphoreCount = 2;
+  submitInfo.waitSemaphoreCount = 3;
   submitInfo.pWaitSemaphores = waitSemaphores;
   submitInfo.pWaitDstStageMask = waitStages;
 
@@ -540,6 +805,10 @@ void Renderer::cleanup()
   swapchainManager.cleanupDepthImages(deviceManager.device);
   swapchainManager.cleanupSwapChain(deviceManager.device);
 
+  depthPyramid.cleanup(deviceManager.device);
+  bufferManager.uploadManager.waitIdle();
+  textureStreamer.cleanup(deviceManager.device);
+  textureCache.cleanup(deviceManager.device);
   bufferManager.cleanup(deviceManager.device);
 
   descriptorManager.cleanup(deviceManager.device);
@@ -553,7 +822,10 @@ void Renderer::cleanup()
     vkDestroyFence(deviceManager.device, inFlightFences[i], nullptr);
   }
 
+  commandRecorder.cleanup(deviceManager.device);
   vkDestroyCommandPool(deviceManager.device, commandPool, nullptr);
+  // also frees what was never given back, like the emitters' storage buffers
+  MemoryAllocator::get().cleanup(deviceManager.device);
   vkDestroyDevice(deviceManager.device, nullptr);
   vkDestroySurfaceKHR(instance, swapchainManager.surface, nullptr);
   vkDestroyInstance(instance, nullptr);
@@ -0,0 +1,36 @@
+#include "scratchArena.hpp"
+#include <algorithm>
+
+ScratchArena::ScratchArena(size_t capacity) : buffer(new unsigned char[capacity]), bufferSize(capacity)
+{
+}
+
+void *ScratchArena::allocate(size_t size, size_t alignment)
+{
+  size_t aligned = (offset + alignment - 1) & ~(alignment - 1);
+  if (aligned + size <= bufferSize)
+  {
+    offset = aligned + size;
+    return buffer.get() + aligned;
+  }
+
+  // new[] is aligned for max_align_t, bigger alignments get padded
+  size_t blockSize = size + alignment;
+  overflowBlocks.emplace_back(new unsigned char[blockSize]);
+  overflowBytes += blockSize;
+
+  uintptr_t address = reinterpret_cast<uintptr_t>(overflowBlocks.back().get());
+  return reinterpret_cast<void *>((address + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+void ScratchArena::reset()
+{
+  if (!overflowBlocks.empty())
+  {
+    bufferSize = std::max(bufferSize * 2, offset + overflowBytes);
+    buffer.reset(new unsigned char[bufferSize]);
+    overflowBlocks.clear();
+    overflowBytes = 0;
+  }
+  offset = 0;
+}
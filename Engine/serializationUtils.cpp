@@ -169,6 +169,46 @@ void readMaterialData(std::ifstream &in, MaterialData &mat)
   readInt(in, mat.isParticle);
 }
 
+void writeMeshLods(std::ofstream &out, const MeshLodChain &chain)
+{
+  uint32_t size = static_cast<uint32_t>(chain.lods.size());
+  writeUInt(out, size);
+  for (const MeshLod &lod : chain.lods)
+  {
+    writeUInt(out, lod.firstIndex);
+    writeUInt(out, lod.indexCount);
+    writeFloat(out, lod.error);
+  }
+
+  size = static_cast<uint32_t>(chain.indices.size());
+  writeUInt(out, size);
+  for (uint32_t i : chain.indices)
+  {
+    writeUInt(out, i);
+  }
+}
+
+void readMeshLods(std::ifstream &in, MeshLodChain &chain)
+{
+  uint32_t lodCount;
+  readUInt(in, lodCount);
+  chain.lods.resize(lodCount);
+  for (MeshLod &lod : chain.lods)
+  {
+    readUInt(in, lod.firstIndex);
+    readUInt(in, lod.indexCount);
+    readFloat(in, lod.error);
+  }
+
+  uint32_t indicesCount;
+  readUInt(in, indicesCount);
+  chain.indices.resize(indicesCount);
+  for (uint32_t &i : chain.indices)
+  {
+    readUInt(in, i);
+  }
+}
+
 void writeMeshes(std::ofstream &out, const std::unordered_map<Entity, MeshComponent> &meshes)
 {
   uint32_t size = static_cast<uint32_t>(meshes.size());
@@ -182,6 +222,14 @@ void writeMeshes(std::ofstream &out, const std::unordered_map<Entity, MeshCompon
     {
       writeString(out, value.objPath);
       writeString(out, value.mtlPath);
+
+      // the model is imported again on load, only the simplified levels are cooked into the scene
+      size = static_cast<uint32_t>(value.meshes.size());
+      writeUInt(out, size);
+      for (const auto &mesh : value.meshes)
+      {
+        writeMeshLods(out, mesh.lodChain);
+      }
     }
     else
     {
@@ -209,12 +257,14 @@ void writeMeshes(std::ofstream &out, const std::unordered_map<Entity, MeshCompon
         {
           writeUInt(out, i);
         }
+
+        writeMeshLods(out, mesh.lodChain);
       }
     }
   }
 }
 
-void readMeshes(std::ifstream &in, Engine *engine)
+void readMeshes(std::ifstream &in, Engine *engine, int version)
 {
   uint32_t meshCount;
   readUInt(in, meshCount);
@@ -232,7 +282,22 @@ void readMeshes(std::ifstream &in, Engine *engine)
       std::string mtl;
       readString(in, obj);
       readString(in, mtl);
-      engine->addMeshComponent(key, obj, mtl);
+
+      if (version >= 2)
+      {
+        uint32_t lodCount;
+        readUInt(in, lodCount);
+        std::vector<MeshLodChain> lods(lodCount);
+        for (MeshLodChain &chain : lods)
+        {
+          readMeshLods(in, chain);
+        }
+        engine->addMeshComponent(key, obj, mtl, &lods);
+      }
+      else
+      {
+        engine->addMeshComponent(key, obj, mtl);
+      }
       engine->registry.meshes.at(key).hide = hide;
     }
     else
@@ -270,7 +335,14 @@ void readMeshes(std::ifstream &in, Engine *engine)
           readUInt(in, num);
           indices.emplace_back(num);
         }
-        engine->addMeshToComponent(key, mat, texPath, vertices, indices);
+
+        // version 1 scenes have no cooked LODs, the mesh simplifies itself on load
+        MeshLodChain lods;
+        if (version >= 2)
+        {
+          readMeshLods(in, lods);
+        }
+        engine->addMeshToComponent(key, mat, texPath, vertices, indices, version >= 2 ? &lods : nullptr);
         engine->registry.meshes.at(key).hide = hide;
       }
     }
@@ -183,7 +183,7 @@ void SwapchainManager::cleanupDepthImages(VkDevice device)
 {
   vkDestroyImageView(device, depthImageView, nullptr);
   vkDestroyImage(device, depthImage, nullptr);
-  vkFreeMemory(device, depthImageMemory, nullptr);
+  MemoryAllocator::get().free(depthImageMemory, device);
 }
 
 void SwapchainManager::createImageViews(VkDevice device)
@@ -107,10 +107,8 @@ void Text::initGraphics(Renderer &renderer)
 {
   renderer.bufferManager.createVertexBuffer(vertices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
 
-  renderer.bufferManager.createUniformBuffers(renderer.MAX_FRAMES_IN_FLIGHT, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, 1);
-
   TextureMaps textureMaps(textureManager.albedoImageView, textureManager.albedoSampler, textureManager.normalImageView, textureManager.normalSampler, textureManager.heightImageView, textureManager.heightSampler, textureManager.roughnessImageView, textureManager.roughnessSampler, textureManager.metallicImageView, textureManager.metallicSampler, textureManager.aoImageView, textureManager.aoSampler, textureManager.emissiveImageView, textureManager.emissiveSampler);
-  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, 1, textureMaps);
+  renderer.descriptorManager.addDescriptorSets(renderer.deviceManager.device, renderer.MAX_FRAMES_IN_FLIGHT, id, textureMaps);
 }
 
 void Text::updateText(const std::string &newText, Renderer &renderer)
@@ -121,7 +119,7 @@ void Text::updateText(const std::string &newText, Renderer &renderer)
   renderer.bufferManager.createVertexBuffer(vertices, id, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, renderer.commandPool, renderer.graphicsQueue);
 }
 
-void Text::draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, glm::mat4 view, glm::mat4 projectionMatrix, VkCommandBuffer commandBuffer)
+void Text::draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, VkCommandBuffer commandBuffer)
 {
   if (hide)
     return;
@@ -132,9 +130,9 @@ void Text::draw(Renderer *renderer, int currentFrame, glm::mat4 transformation,
   VkDeviceSize offsets[] = {0};
   vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffersArray, offsets);
 
-  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.pipelineLayout, 0, 1, &renderer->descriptorManager.descriptorSets[currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT], 0, nullptr);
-
-  renderer->bufferManager.updateUniformBuffer(currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT, transformation, view, projectionMatrix);
+  uint32_t dynamicOffset = renderer->bufferManager.pushObjectUniforms(currentFrame, transformation, CameraScreen);
+  VkDescriptorSet descriptorSets[] = {renderer->descriptorManager.descriptorSets[currentFrame + id * renderer->MAX_FRAMES_IN_FLIGHT], renderer->descriptorManager.frameDescriptorSets[currentFrame]};
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->pipelineManager.pipelineLayout, 0, 2, descriptorSets, 1, &dynamicOffset);
 
   MaterialData materialData;
   materialData.albedoColor = glm::vec3(1);
@@ -230,13 +228,6 @@ void Text::cleanup(VkDevice device, Renderer &renderer)
     renderer.bufferManager.vertexBuffers[id] = VK_NULL_HANDLE;
   }
 
-  for (int i = 0; i < renderer.MAX_FRAMES_IN_FLIGHT; i++)
-  {
-    vkDestroyBuffer(device, renderer.bufferManager.uniformBuffers[id * renderer.MAX_FRAMES_IN_FLIGHT + i], nullptr);
-
-    renderer.bufferManager.uniformBuffers[id * renderer.MAX_FRAMES_IN_FLIGHT + i] = VK_NULL_HANDLE;
-  }
-
   uint32_t descriptorSetCount = renderer.MAX_FRAMES_IN_FLIGHT;
   uint32_t startIndex = id * renderer.MAX_FRAMES_IN_FLIGHT;
   if (renderer.descriptorManager.descriptorSets.size() >= startIndex + descriptorSetCount)
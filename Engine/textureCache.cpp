@@ -0,0 +1,265 @@
+#include "textureCache.hpp"
+#include "textureLoader.hpp"
+#include "renderer.hpp"
+#include "utils.h"
+#include <noImage.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+// FNV-1a, only used to tell whether two files hold the same texture
+static uint64_t hashContent(const std::vector<uint8_t> &file)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for (uint8_t byte : file)
+  {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static std::string textureKey(const std::string &name, VkFormat format, bool streamed)
+{
+  return name + "|" + std::to_string(static_cast<uint32_t>(format)) + (streamed ? "|streamed" : "");
+}
+
+void TextureCache::init(Renderer &renderer)
+{
+  this->renderer = &renderer;
+  VkDevice device = renderer.deviceManager.device;
+
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_NEAREST;
+  samplerInfo.minFilter = VK_FILTER_NEAREST;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.anisotropyEnable = VK_FALSE;
+
+  VkPhysicalDeviceProperties properties{};
+  vkGetPhysicalDeviceProperties(renderer.deviceManager.physicalDevice, &properties);
+  samplerInfo.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+
+  samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+  samplerInfo.unnormalizedCoordinates = VK_FALSE;
+  samplerInfo.compareEnable = VK_FALSE;
+  samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  samplerInfo.mipLodBias = 0.0f;
+  samplerInfo.minLod = 0.0f;
+  // textures have mips, images with a single level clamp to it anyway
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  if (vkCreateSampler(device, &samplerInfo, nullptr, &sharedSampler) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create texture sampler!");
+  }
+
+  // what NO_IMAGE holds, a white texel, for each format a map is sampled as
+  createDefault(VK_FORMAT_R8G8B8A8_SRGB);
+  createDefault(VK_FORMAT_R8G8B8A8_UNORM);
+  createDefault(VK_FORMAT_R8_UNORM);
+}
+
+void TextureCache::createView(CachedTexture &texture)
+{
+  texture.view = createImageView(texture.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, renderer->deviceManager.device, texture.mipLevels);
+}
+
+CachedTexture &TextureCache::createDefault(VkFormat format)
+{
+  UploadManager &uploads = renderer->bufferManager.uploadManager;
+  std::unique_ptr<CachedTexture> texture = std::make_unique<CachedTexture>();
+  texture->mapFormat = format;
+  texture->format = format;
+
+  const uint8_t white[4] = {255, 255, 255, 255};
+  createImage(1, 1, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture->image, texture->memory, renderer->deviceManager.device, renderer->deviceManager.physicalDevice, uploads.sharedFamilies());
+  texture->uploadTicket = uploads.uploadImage(texture->image, 1, 1, white, format == VK_FORMAT_R8_UNORM ? 1 : 4);
+  createView(*texture);
+
+  defaults.push_back(texture.get());
+  textures.push_back(std::move(texture));
+  return *textures.back();
+}
+
+CachedTexture *TextureCache::createLoaded(const std::string &path, const std::vector<uint8_t> &file, VkFormat mapFormat)
+{
+  std::shared_ptr<DecodedTexture> decoded = loadTexture(path, file, mapFormat, renderer->deviceManager.compressedFormats);
+  if (!decoded)
+  {
+    throw std::runtime_error("failed to load texture image! Filepath: " + path);
+  }
+
+  UploadManager &uploads = renderer->bufferManager.uploadManager;
+  std::unique_ptr<CachedTexture> texture = std::make_unique<CachedTexture>();
+  texture->path = path;
+  texture->mapFormat = mapFormat;
+  texture->format = decoded->format;
+  texture->mipLevels = decoded->mipCount;
+
+  createImage(decoded->width, decoded->height, decoded->format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture->image, texture->memory, renderer->deviceManager.device, renderer->deviceManager.physicalDevice, uploads.sharedFamilies(), decoded->mipCount);
+  // every level is copied into the staging ring, the transfer queue takes it from there
+  texture->uploadTicket = uploads.uploadImage(texture->image, decoded->mipCount, textureCopyRegions(*decoded), decoded->pixels.data(), decoded->offsets[decoded->mipCount]);
+  createView(*texture);
+
+  textures.push_back(std::move(texture));
+  return textures.back().get();
+}
+
+CachedTexture *TextureCache::createStreamed(const std::string &path, VkFormat mapFormat)
+{
+  UploadManager &uploads = renderer->bufferManager.uploadManager;
+  const DecodedTexture &placeholder = renderer->textureStreamer.placeholder(mapFormat);
+  std::unique_ptr<CachedTexture> texture = std::make_unique<CachedTexture>();
+  texture->path = path;
+  texture->mapFormat = mapFormat;
+  texture->format = mapFormat;
+  texture->streamed = true;
+
+  createImage(placeholder.width, placeholder.height, mapFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture->image, texture->memory, renderer->deviceManager.device, renderer->deviceManager.physicalDevice, uploads.sharedFamilies());
+  texture->uploadTicket = uploads.uploadImage(texture->image, placeholder.width, placeholder.height, placeholder.pixels.data(), placeholder.offsets[1]);
+  createView(*texture);
+
+  textures.push_back(std::move(texture));
+  CachedTexture *created = textures.back().get();
+  renderer->textureStreamer.request(*created);
+  return created;
+}
+
+void TextureCache::acquire(TextureManager &owner, TextureMapType map, const std::string &path, bool streamed)
+{
+  if (owner.cached[map])
+    release(owner, map);
+
+  VkFormat mapFormat = TextureManager::mapFormat(map);
+  CachedTexture *texture = nullptr;
+  bool loaded = false;
+  if (!path.empty() && path != NO_IMAGE)
+  {
+    std::string pathKey = textureKey(path, mapFormat, streamed);
+    auto it = lookup.find(pathKey);
+    if (it != lookup.end())
+      texture = it->second;
+    else if (streamed)
+    {
+      // the streamer's worker is the only one reading the file, a file it can't read keeps the placeholder
+      texture = createStreamed(path, mapFormat);
+      loaded = true;
+      stats.loads++;
+      texture->keys.push_back(pathKey);
+      lookup[pathKey] = texture;
+    }
+    else
+    {
+      std::vector<uint8_t> file;
+      if (!readTextureFile(path, file))
+        throw std::runtime_error("failed to load texture image! Filepath: " + path);
+
+      // the same content under another path shares the image, once the bytes of the file it was loaded from compare equal
+      std::string contentKey = textureKey(std::to_string(file.size()) + ":" + std::to_string(hashContent(file)), mapFormat, streamed);
+      auto content = lookup.find(contentKey);
+      if (content != lookup.end())
+      {
+        std::vector<uint8_t> cachedFile;
+        if (readTextureFile(content->second->path, cachedFile) && cachedFile == file)
+          texture = content->second;
+      }
+      if (!texture)
+      {
+        // a hash collision or a file changed on disk gets its own image, only reachable through its path
+        texture = createLoaded(path, file, mapFormat);
+        if (content == lookup.end())
+        {
+          texture->keys.push_back(contentKey);
+          lookup[contentKey] = texture;
+        }
+        loaded = true;
+        stats.loads++;
+      }
+      texture->keys.push_back(pathKey);
+      lookup[pathKey] = texture;
+    }
+  }
+  if (!texture)
+  {
+    auto it = std::find_if(defaults.begin(), defaults.end(), [&](const CachedTexture *texture)
+                           { return texture->mapFormat == mapFormat; });
+    texture = *it;
+  }
+  if (!loaded)
+    stats.hits++;
+
+  texture->users.push_back({&owner, map});
+  owner.cached[map] = texture;
+  owner.uploadTicket = std::max(owner.uploadTicket, texture->uploadTicket);
+  // the memory stays with the cache, the map only borrows the handles
+  *owner.mapHandles(map).memory = MemoryAllocation();
+  updateUsers(*texture);
+  stats.textures = static_cast<uint32_t>(textures.size());
+}
+
+void TextureCache::updateUsers(CachedTexture &texture)
+{
+  for (const TextureUser &user : texture.users)
+  {
+    TextureMapHandles handles = user.owner->mapHandles(user.map);
+    *handles.image = texture.image;
+    *handles.view = texture.view;
+    user.owner->formats[user.map] = texture.format;
+    user.owner->mipLevels[user.map] = texture.mipLevels;
+  }
+}
+
+void TextureCache::release(TextureManager &owner, TextureMapType map)
+{
+  CachedTexture *texture = owner.cached[map];
+  if (!texture)
+    return;
+  owner.cached[map] = nullptr;
+
+  auto user = std::find_if(texture->users.begin(), texture->users.end(), [&](const TextureUser &user)
+                           { return user.owner == &owner && user.map == map; });
+  if (user != texture->users.end())
+    texture->users.erase(user);
+  if (!texture->users.empty() || std::find(defaults.begin(), defaults.end(), texture) != defaults.end())
+    return;
+
+  destroy(*texture, renderer->deviceManager.device);
+  auto it = std::find_if(textures.begin(), textures.end(), [&](const std::unique_ptr<CachedTexture> &entry)
+                         { return entry.get() == texture; });
+  textures.erase(it);
+  stats.textures = static_cast<uint32_t>(textures.size());
+}
+
+void TextureCache::destroy(CachedTexture &texture, VkDevice device)
+{
+  // a streamed texture's image is whatever the streamer swapped in last, uploads still going into the next one are retired there
+  if (texture.streamed)
+    renderer->textureStreamer.release(texture);
+  renderer->bufferManager.uploadManager.wait(texture.uploadTicket);
+
+  for (const std::string &key : texture.keys)
+    lookup.erase(key);
+  vkDestroyImageView(device, texture.view, nullptr);
+  vkDestroyImage(device, texture.image, nullptr);
+  MemoryAllocator::get().free(texture.memory, device);
+}
+
+void TextureCache::cleanup(VkDevice device)
+{
+  // the upload manager and the device are idle by now, what is left are the defaults and textures of maps never cleaned up
+  for (std::unique_ptr<CachedTexture> &texture : textures)
+  {
+    vkDestroyImageView(device, texture->view, nullptr);
+    vkDestroyImage(device, texture->image, nullptr);
+    MemoryAllocator::get().free(texture->memory, device);
+  }
+  textures.clear();
+  lookup.clear();
+  defaults.clear();
+
+  vkDestroySampler(device, sharedSampler, nullptr);
+  sharedSampler = VK_NULL_HANDLE;
+}
@@ -0,0 +1,780 @@
+#include "textureLoader.hpp"
+#include <stb_image.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static bool isSrgb(VkFormat format)
+{
+  switch (format)
+  {
+  case VK_FORMAT_R8G8B8A8_SRGB:
+  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+  case VK_FORMAT_BC3_SRGB_BLOCK:
+  case VK_FORMAT_BC7_SRGB_BLOCK:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// rgba for every uncompressed format except the single channel one the AO maps use
+static uint32_t texelSize(VkFormat format)
+{
+  return format == VK_FORMAT_R8_UNORM ? 1 : 4;
+}
+
+bool isBlockCompressed(VkFormat format)
+{
+  switch (format)
+  {
+  case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+  case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+  case VK_FORMAT_BC3_UNORM_BLOCK:
+  case VK_FORMAT_BC3_SRGB_BLOCK:
+  case VK_FORMAT_BC5_UNORM_BLOCK:
+  case VK_FORMAT_BC7_UNORM_BLOCK:
+  case VK_FORMAT_BC7_SRGB_BLOCK:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static bool isBC1(VkFormat format)
+{
+  return format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+         format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+}
+
+VkDeviceSize textureLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+  if (isBlockCompressed(format))
+    return VkDeviceSize((width + 3) / 4) * ((height + 3) / 4) * (isBC1(format) ? 8 : 16);
+  return VkDeviceSize(width) * height * texelSize(format);
+}
+
+CompressedFormatSupport queryCompressedFormatSupport(VkPhysicalDevice physicalDevice, bool textureCompressionBC)
+{
+  CompressedFormatSupport support;
+  if (!textureCompressionBC)
+    return support;
+
+  auto sampled = [&](VkFormat format)
+  {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+    VkFormatFeatureFlags needed = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+    return (properties.optimalTilingFeatures & needed) == needed;
+  };
+  support.bc1 = sampled(VK_FORMAT_BC1_RGB_UNORM_BLOCK) && sampled(VK_FORMAT_BC1_RGB_SRGB_BLOCK) &&
+                sampled(VK_FORMAT_BC1_RGBA_UNORM_BLOCK) && sampled(VK_FORMAT_BC1_RGBA_SRGB_BLOCK);
+  support.bc3 = sampled(VK_FORMAT_BC3_UNORM_BLOCK) && sampled(VK_FORMAT_BC3_SRGB_BLOCK);
+  support.bc5 = sampled(VK_FORMAT_BC5_UNORM_BLOCK);
+  support.bc7 = sampled(VK_FORMAT_BC7_UNORM_BLOCK) && sampled(VK_FORMAT_BC7_SRGB_BLOCK);
+  return support;
+}
+
+static bool isSupported(VkFormat format, const CompressedFormatSupport &support)
+{
+  switch (format)
+  {
+  case VK_FORMAT_BC3_UNORM_BLOCK:
+  case VK_FORMAT_BC3_SRGB_BLOCK:
+    return support.bc3;
+  case VK_FORMAT_BC5_UNORM_BLOCK:
+    return support.bc5;
+  case VK_FORMAT_BC7_UNORM_BLOCK:
+  case VK_FORMAT_BC7_SRGB_BLOCK:
+    return support.bc7;
+  default:
+    return isBC1(format) && support.bc1;
+  }
+}
+
+// the map decides whether its texels are sRGB, whatever the file was tagged with, BC5 only holds linear data
+static VkFormat withColorSpace(VkFormat format, bool srgb)
+{
+  switch (format)
+  {
+  case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+  case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  case VK_FORMAT_BC3_UNORM_BLOCK:
+  case VK_FORMAT_BC3_SRGB_BLOCK:
+    return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+  case VK_FORMAT_BC7_UNORM_BLOCK:
+  case VK_FORMAT_BC7_SRGB_BLOCK:
+    return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+  default:
+    return format;
+  }
+}
+
+// level offsets are kept at multiples of 16, copies of block compressed levels have to start on a whole block
+static void allocateLevels(DecodedTexture &texture)
+{
+  texture.offsets.resize(texture.mipCount + 1);
+  VkDeviceSize offset = 0;
+  for (uint32_t level = 0; level < texture.mipCount; level++)
+  {
+    texture.offsets[level] = offset;
+    VkDeviceSize levelSize = textureLevelSize(texture.format, std::max(1u, texture.width >> level), std::max(1u, texture.height >> level));
+    offset += (levelSize + 15) & ~VkDeviceSize(15);
+  }
+  texture.offsets[texture.mipCount] = offset;
+  texture.pixels.resize(static_cast<size_t>(offset));
+}
+
+static uint32_t fullMipCount(uint32_t width, uint32_t height)
+{
+  return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+}
+
+// box filters every level below the first, color channels of sRGB textures are averaged as linear values
+static void generateMips(DecodedTexture &texture)
+{
+  static const std::vector<float> toLinear = []
+  {
+    std::vector<float> table(256);
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      float c = i / 255.0f;
+      table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    return table;
+  }();
+  auto toSrgb = [](float c)
+  {
+    c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+    return static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+  };
+
+  uint32_t channels = texelSize(texture.format);
+  bool srgb = isSrgb(texture.format);
+  for (uint32_t level = 1; level < texture.mipCount; level++)
+  {
+    uint32_t srcWidth = std::max(1u, texture.width >> (level - 1));
+    uint32_t srcHeight = std::max(1u, texture.height >> (level - 1));
+    uint32_t dstWidth = std::max(1u, texture.width >> level);
+    uint32_t dstHeight = std::max(1u, texture.height >> level);
+    const uint8_t *src = texture.pixels.data() + texture.offsets[level - 1];
+    uint8_t *dst = texture.pixels.data() + texture.offsets[level];
+
+    for (uint32_t y = 0; y < dstHeight; y++)
+      for (uint32_t x = 0; x < dstWidth; x++)
+      {
+        // a side that was already 1 texel wide is not halved again
+        uint32_t x0 = std::min(x * 2, srcWidth - 1), x1 = std::min(x * 2 + 1, srcWidth - 1);
+        uint32_t y0 = std::min(y * 2, srcHeight - 1), y1 = std::min(y * 2 + 1, srcHeight - 1);
+        const uint8_t *texels[4] = {src + (y0 * srcWidth + x0) * channels, src + (y0 * srcWidth + x1) * channels,
+                                    src + (y1 * srcWidth + x0) * channels, src + (y1 * srcWidth + x1) * channels};
+        for (uint32_t c = 0; c < channels; c++)
+        {
+          uint8_t &out = dst[(y * dstWidth + x) * channels + c];
+          if (srgb && c < 3)
+            out = toSrgb((toLinear[texels[0][c]] + toLinear[texels[1][c]] + toLinear[texels[2][c]] + toLinear[texels[3][c]]) * 0.25f);
+          else
+            out = static_cast<uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+        }
+      }
+  }
+}
+
+static std::shared_ptr<DecodedTexture> loadImageFile(const std::vector<uint8_t> &file, VkFormat format, bool mipChain)
+{
+  int texWidth, texHeight, texChannels;
+  stbi_uc *pixels = stbi_load_from_memory(file.data(), static_cast<int>(file.size()), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+  if (!pixels)
+    return nullptr;
+
+  std::shared_ptr<DecodedTexture> texture = std::make_shared<DecodedTexture>();
+  texture->format = format;
+  texture->width = static_cast<uint32_t>(texWidth);
+  texture->height = static_cast<uint32_t>(texHeight);
+  texture->mipCount = mipChain ? fullMipCount(texture->width, texture->height) : 1;
+  allocateLevels(*texture);
+
+  uint32_t channels = texelSize(format);
+  uint8_t *top = texture->pixels.data();
+  size_t texelCount = size_t(texture->width) * texture->height;
+  for (size_t i = 0; i < texelCount; i++)
+    for (uint32_t c = 0; c < channels; c++)
+      top[i * channels + c] = pixels[i * 4 + c];
+  stbi_image_free(pixels);
+
+  generateMips(*texture);
+  return texture;
+}
+
+// block decoders for the CPU fallback, every one writes a 4x4 block of rgba texels in row order
+
+static void expand565(uint16_t color, uint8_t *out)
+{
+  uint32_t r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+  out[0] = static_cast<uint8_t>((r << 3) | (r >> 2));
+  out[1] = static_cast<uint8_t>((g << 2) | (g >> 4));
+  out[2] = static_cast<uint8_t>((b << 3) | (b >> 2));
+  out[3] = 255;
+}
+
+// the 8 byte color block of BC1 and BC3, BC3 always uses four colors
+static void decodeColorBlock(const uint8_t *block, uint8_t texels[16][4], bool fourColors, bool punchThrough)
+{
+  uint16_t c0 = static_cast<uint16_t>(block[0] | block[1] << 8);
+  uint16_t c1 = static_cast<uint16_t>(block[2] | block[3] << 8);
+  uint8_t palette[4][4];
+  expand565(c0, palette[0]);
+  expand565(c1, palette[1]);
+  for (uint32_t c = 0; c < 3; c++)
+  {
+    if (fourColors || c0 > c1)
+    {
+      palette[2][c] = static_cast<uint8_t>((2 * palette[0][c] + palette[1][c] + 1) / 3);
+      palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+    }
+    else
+    {
+      palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c] + 1) / 2);
+      palette[3][c] = 0;
+    }
+  }
+  palette[2][3] = 255;
+  palette[3][3] = fourColors || c0 > c1 || !punchThrough ? 255 : 0;
+
+  uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | uint32_t(block[7]) << 24;
+  for (uint32_t i = 0; i < 16; i++)
+    std::memcpy(texels[i], palette[(indices >> (2 * i)) & 3], 4);
+}
+
+// the 8 byte single channel block of BC3 alpha and both BC5 channels
+static void decodeChannelBlock(const uint8_t *block, uint8_t texels[16][4], uint32_t channel)
+{
+  uint32_t a0 = block[0], a1 = block[1];
+  uint8_t palette[8] = {block[0], block[1]};
+  if (a0 > a1)
+  {
+    for (uint32_t i = 1; i < 7; i++)
+      palette[i + 1] = static_cast<uint8_t>(((7 - i) * a0 + i * a1 + 3) / 7);
+  }
+  else
+  {
+    for (uint32_t i = 1; i < 5; i++)
+      palette[i + 1] = static_cast<uint8_t>(((5 - i) * a0 + i * a1 + 2) / 5);
+    palette[6] = 0;
+    palette[7] = 255;
+  }
+
+  uint64_t bits = 0;
+  for (uint32_t i = 0; i < 6; i++)
+    bits |= uint64_t(block[2 + i]) << (8 * i);
+  for (uint32_t i = 0; i < 16; i++)
+    texels[i][channel] = palette[(bits >> (3 * i)) & 7];
+}
+
+struct Bc7Mode
+{
+  uint8_t subsets;
+  uint8_t partitionBits;
+  uint8_t rotationBits;
+  uint8_t indexSelectionBits;
+  uint8_t colorBits;
+  uint8_t alphaBits;
+  uint8_t endpointPBits;
+  uint8_t sharedPBits;
+  uint8_t indexBits;
+  uint8_t secondaryIndexBits;
+};
+
+static const Bc7Mode BC7_MODES[8] = {
+    {3, 4, 0, 0, 4, 0, 1, 0, 3, 0},
+    {2, 6, 0, 0, 6, 0, 0, 1, 3, 0},
+    {3, 6, 0, 0, 5, 0, 0, 0, 2, 0},
+    {2, 6, 0, 0, 7, 0, 1, 0, 2, 0},
+    {1, 0, 2, 1, 5, 6, 0, 0, 2, 3},
+    {1, 0, 2, 0, 7, 8, 0, 0, 2, 2},
+    {1, 0, 0, 0, 7, 7, 1, 0, 4, 0},
+    {2, 6, 0, 0, 5, 5, 1, 0, 2, 0},
+};
+
+// bit i set when texel i belongs to the second subset
+static const uint16_t BC7_PARTITIONS2[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+    0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+    0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22};
+
+static const uint8_t BC7_PARTITIONS3[64][16] = {
+    {0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2}, {0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1}, {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2}, {0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2},
+    {0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1}, {0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1},
+    {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2}, {0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2},
+    {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2},
+    {0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2}, {0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2},
+    {0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2}, {0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0},
+    {0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2}, {0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0},
+    {0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2}, {0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1},
+    {0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2}, {0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2}, {0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0},
+    {0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0}, {0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2},
+    {0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0}, {0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1},
+    {0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2}, {0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2},
+    {0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1}, {0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1},
+    {0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2}, {0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1},
+    {0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2}, {0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0},
+    {0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0}, {0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0},
+    {0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0}, {0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1},
+    {0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1}, {0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2},
+    {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1}, {0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2},
+    {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1}, {0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1},
+    {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1}, {0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1},
+    {0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2}, {0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1},
+    {0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2}, {0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2},
+    {0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2}, {0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2},
+    {0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2}, {0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2},
+    {0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2},
+    {0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2}, {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2},
+    {0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1}, {0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2},
+    {0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2}, {0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0}};
+
+// texels whose index is stored with one bit less, texel 0 is the anchor of the first subset in every partition
+static const uint8_t BC7_ANCHORS2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2, 8, 2, 2, 8, 8, 15, 2, 8, 2, 2, 8, 8, 2, 2,
+    15, 15, 6, 8, 2, 8, 15, 15, 2, 8, 2, 2, 2, 15, 15, 6,
+    6, 2, 6, 8, 15, 15, 2, 2, 15, 15, 15, 15, 15, 2, 2, 15};
+
+static const uint8_t BC7_ANCHORS3_SECOND[64] = {
+    3, 3, 15, 15, 8, 3, 15, 15, 8, 8, 6, 6, 6, 5, 3, 3,
+    3, 3, 8, 15, 3, 3, 6, 10, 5, 8, 8, 6, 8, 5, 15, 15,
+    8, 15, 3, 5, 6, 10, 8, 15, 15, 3, 15, 5, 15, 15, 15, 15,
+    3, 15, 5, 5, 5, 8, 5, 10, 5, 10, 8, 13, 15, 12, 3, 3};
+
+static const uint8_t BC7_ANCHORS3_THIRD[64] = {
+    15, 8, 8, 3, 15, 15, 3, 8, 15, 15, 15, 15, 15, 15, 15, 8,
+    15, 8, 15, 3, 15, 8, 15, 8, 3, 15, 6, 10, 15, 15, 10, 8,
+    15, 3, 15, 10, 10, 8, 9, 10, 6, 15, 8, 15, 3, 6, 6, 8,
+    15, 3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3, 15, 15, 8};
+
+static const uint8_t BC7_WEIGHTS2[4] = {0, 21, 43, 64};
+static const uint8_t BC7_WEIGHTS3[8] = {0, 9, 18, 27, 37, 46, 55, 64};
+static const uint8_t BC7_WEIGHTS4[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+// reads the 128 bit block from the least significant bit of the first byte on
+struct BlockBits
+{
+  const uint8_t *data;
+  uint32_t position = 0;
+
+  uint32_t read(uint32_t count)
+  {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < count; i++, position++)
+      value |= uint32_t((data[position >> 3] >> (position & 7)) & 1) << i;
+    return value;
+  }
+};
+
+static uint8_t bc7Interpolate(uint8_t e0, uint8_t e1, uint32_t index, uint32_t indexBits)
+{
+  const uint8_t *weights = indexBits == 2 ? BC7_WEIGHTS2 : indexBits == 3 ? BC7_WEIGHTS3
+                                                                          : BC7_WEIGHTS4;
+  uint32_t weight = weights[index];
+  return static_cast<uint8_t>(((64 - weight) * e0 + weight * e1 + 32) >> 6);
+}
+
+static void decodeBC7Block(const uint8_t *block, uint8_t texels[16][4])
+{
+  BlockBits bits{block};
+  uint32_t modeIndex = 0;
+  while (modeIndex < 8 && bits.read(1) == 0)
+    modeIndex++;
+  if (modeIndex == 8)
+  {
+    // reserved mode, decoders output transparent black
+    std::memset(texels, 0, 16 * 4);
+    return;
+  }
+  const Bc7Mode &mode = BC7_MODES[modeIndex];
+
+  uint32_t partition = bits.read(mode.partitionBits);
+  uint32_t rotation = bits.read(mode.rotationBits);
+  uint32_t indexSelection = bits.read(mode.indexSelectionBits);
+
+  uint32_t endpointCount = mode.subsets * 2u;
+  uint8_t endpoints[6][4] = {};
+  for (uint32_t c = 0; c < 3; c++)
+    for (uint32_t e = 0; e < endpointCount; e++)
+      endpoints[e][c] = static_cast<uint8_t>(bits.read(mode.colorBits));
+  for (uint32_t e = 0; e < endpointCount; e++)
+    endpoints[e][3] = static_cast<uint8_t>(bits.read(mode.alphaBits));
+
+  uint32_t pBits[6] = {};
+  if (mode.endpointPBits)
+    for (uint32_t e = 0; e < endpointCount; e++)
+      pBits[e] = bits.read(1);
+  if (mode.sharedPBits)
+    for (uint32_t s = 0; s < mode.subsets; s++)
+      pBits[s * 2] = pBits[s * 2 + 1] = bits.read(1);
+
+  bool hasPBit = mode.endpointPBits || mode.sharedPBits;
+  for (uint32_t e = 0; e < endpointCount; e++)
+    for (uint32_t c = 0; c < 4; c++)
+    {
+      uint32_t precision = c < 3 ? mode.colorBits : mode.alphaBits;
+      if (precision == 0)
+      {
+        endpoints[e][c] = 255;
+        continue;
+      }
+      uint32_t value = endpoints[e][c];
+      if (hasPBit)
+      {
+        value = (value << 1) | pBits[e];
+        precision++;
+      }
+      // the top bits are repeated below to fill 8 bits
+      endpoints[e][c] = static_cast<uint8_t>((value << (8 - precision)) | (value >> (2 * precision - 8)));
+    }
+
+  auto subsetOf = [&](uint32_t texel) -> uint32_t
+  {
+    if (mode.subsets == 2)
+      return (BC7_PARTITIONS2[partition] >> texel) & 1;
+    if (mode.subsets == 3)
+      return BC7_PARTITIONS3[partition][texel];
+    return 0;
+  };
+  auto isAnchor = [&](uint32_t texel)
+  {
+    if (texel == 0)
+      return true;
+    if (mode.subsets == 2)
+      return texel == BC7_ANCHORS2[partition];
+    if (mode.subsets == 3)
+      return texel == BC7_ANCHORS3_SECOND[partition] || texel == BC7_ANCHORS3_THIRD[partition];
+    return false;
+  };
+
+  uint32_t indices[16];
+  for (uint32_t i = 0; i < 16; i++)
+    indices[i] = bits.read(isAnchor(i) ? mode.indexBits - 1u : mode.indexBits);
+  uint32_t secondaryIndices[16] = {};
+  if (mode.secondaryIndexBits)
+    for (uint32_t i = 0; i < 16; i++)
+      secondaryIndices[i] = bits.read(i == 0 ? mode.secondaryIndexBits - 1u : mode.secondaryIndexBits);
+
+  for (uint32_t i = 0; i < 16; i++)
+  {
+    uint32_t subset = subsetOf(i);
+    const uint8_t *e0 = endpoints[subset * 2];
+    const uint8_t *e1 = endpoints[subset * 2 + 1];
+
+    uint32_t colorIndex = indices[i], colorBits = mode.indexBits;
+    uint32_t alphaIndex = indices[i], alphaBits = mode.indexBits;
+    if (mode.secondaryIndexBits)
+    {
+      // the index selection bit swaps which set of indices the color uses
+      if (indexSelection)
+      {
+        colorIndex = secondaryIndices[i];
+        colorBits = mode.secondaryIndexBits;
+      }
+      else
+      {
+        alphaIndex = secondaryIndices[i];
+        alphaBits = mode.secondaryIndexBits;
+      }
+    }
+
+    for (uint32_t c = 0; c < 3; c++)
+      texels[i][c] = bc7Interpolate(e0[c], e1[c], colorIndex, colorBits);
+    texels[i][3] = bc7Interpolate(e0[3], e1[3], alphaIndex, alphaBits);
+    if (rotation > 0)
+      std::swap(texels[i][3], texels[i][rotation - 1]);
+  }
+}
+
+static void decodeBlock(VkFormat format, const uint8_t *block, uint8_t texels[16][4])
+{
+  switch (format)
+  {
+  case VK_FORMAT_BC3_UNORM_BLOCK:
+  case VK_FORMAT_BC3_SRGB_BLOCK:
+    decodeColorBlock(block + 8, texels, true, false);
+    decodeChannelBlock(block, texels, 3);
+    break;
+  case VK_FORMAT_BC5_UNORM_BLOCK:
+    // two channel normal maps, z is rebuilt so the result works as an ordinary rgb normal map
+    decodeChannelBlock(block, texels, 0);
+    decodeChannelBlock(block + 8, texels, 1);
+    for (uint32_t i = 0; i < 16; i++)
+    {
+      float x = texels[i][0] / 127.5f - 1.0f, y = texels[i][1] / 127.5f - 1.0f;
+      float z = std::sqrt(std::max(0.0f, 1.0f - x * x - y * y));
+      texels[i][2] = static_cast<uint8_t>((z * 0.5f + 0.5f) * 255.0f + 0.5f);
+      texels[i][3] = 255;
+    }
+    break;
+  case VK_FORMAT_BC7_UNORM_BLOCK:
+  case VK_FORMAT_BC7_SRGB_BLOCK:
+    decodeBC7Block(block, texels);
+    break;
+  default:
+    decodeColorBlock(block, texels, false, format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK);
+    break;
+  }
+}
+
+// the level of a block compressed format into dst, channels bytes per texel
+static void transcodeLevel(VkFormat format, const uint8_t *src, uint32_t width, uint32_t height, uint8_t *dst, uint32_t channels)
+{
+  uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+  uint32_t blockSize = isBC1(format) ? 8 : 16;
+  uint8_t texels[16][4];
+  for (uint32_t by = 0; by < blocksY; by++)
+    for (uint32_t bx = 0; bx < blocksX; bx++, src += blockSize)
+    {
+      decodeBlock(format, src, texels);
+      for (uint32_t i = 0; i < 16; i++)
+      {
+        uint32_t x = bx * 4 + (i & 3), y = by * 4 + (i >> 2);
+        if (x < width && y < height)
+          std::memcpy(dst + (size_t(y) * width + x) * channels, texels[i], channels);
+      }
+    }
+}
+
+// the levels of a container file, pointing into its bytes
+struct ContainerLevels
+{
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<const uint8_t *> levels;
+};
+
+static uint32_t readU32(const uint8_t *p)
+{
+  return p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24;
+}
+
+static uint64_t readU64(const uint8_t *p)
+{
+  return readU32(p) | uint64_t(readU32(p + 4)) << 32;
+}
+
+static constexpr uint32_t fourCC(char a, char b, char c, char d)
+{
+  return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+}
+
+// the first image of a DDS file, legacy DXT1/DXT5/ATI2 headers or a DX10 header
+static bool parseDDS(const std::vector<uint8_t> &file, ContainerLevels &container)
+{
+  constexpr size_t HEADER_END = 4 + 124;
+  constexpr uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+  constexpr uint32_t DDPF_FOURCC = 0x4;
+  if (file.size() < HEADER_END || readU32(file.data()) != fourCC('D', 'D', 'S', ' '))
+    return false;
+
+  const uint8_t *header = file.data() + 4;
+  uint32_t flags = readU32(header + 4);
+  container.height = readU32(header + 8);
+  container.width = readU32(header + 12);
+  uint32_t mipCount = flags & DDSD_MIPMAPCOUNT ? std::max(1u, readU32(header + 24)) : 1;
+  uint32_t pixelFlags = readU32(header + 76);
+  uint32_t code = readU32(header + 80);
+  if (!(pixelFlags & DDPF_FOURCC))
+    return false;
+
+  size_t dataOffset = HEADER_END;
+  if (code == fourCC('D', 'X', 'T', '1'))
+    container.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+  else if (code == fourCC('D', 'X', 'T', '5'))
+    container.format = VK_FORMAT_BC3_UNORM_BLOCK;
+  else if (code == fourCC('A', 'T', 'I', '2') || code == fourCC('B', 'C', '5', 'U'))
+    container.format = VK_FORMAT_BC5_UNORM_BLOCK;
+  else if (code == fourCC('D', 'X', '1', '0'))
+  {
+    dataOffset += 20;
+    if (file.size() < dataOffset)
+      return false;
+    switch (readU32(file.data() + HEADER_END))
+    {
+    case 71: // DXGI_FORMAT_BC1_UNORM
+    case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+      container.format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+      break;
+    case 77: // DXGI_FORMAT_BC3_UNORM
+    case 78: // DXGI_FORMAT_BC3_UNORM_SRGB
+      container.format = VK_FORMAT_BC3_UNORM_BLOCK;
+      break;
+    case 83: // DXGI_FORMAT_BC5_UNORM
+      container.format = VK_FORMAT_BC5_UNORM_BLOCK;
+      break;
+    case 98: // DXGI_FORMAT_BC7_UNORM
+    case 99: // DXGI_FORMAT_BC7_UNORM_SRGB
+      container.format = VK_FORMAT_BC7_UNORM_BLOCK;
+      break;
+    default:
+      return false;
+    }
+  }
+  else
+    return false;
+
+  // a header can claim more levels than the size allows, the ones below 1x1 aren't there
+  if (container.width == 0 || container.height == 0)
+    return false;
+  mipCount = std::min(mipCount, fullMipCount(container.width, container.height));
+
+  size_t offset = dataOffset;
+  for (uint32_t level = 0; level < mipCount; level++)
+  {
+    size_t size = static_cast<size_t>(textureLevelSize(container.format, std::max(1u, container.width >> level), std::max(1u, container.height >> level)));
+    if (offset + size > file.size())
+      return false;
+    container.levels.push_back(file.data() + offset);
+    offset += size;
+  }
+  return true;
+}
+
+// a KTX2 file without supercompression, Basis Universal and zstd payloads aren't read
+static bool parseKTX2(const std::vector<uint8_t> &file, ContainerLevels &container)
+{
+  static const uint8_t IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+  constexpr size_t LEVEL_INDEX = 80;
+  if (file.size() < LEVEL_INDEX || std::memcmp(file.data(), IDENTIFIER, sizeof(IDENTIFIER)) != 0)
+    return false;
+
+  container.format = static_cast<VkFormat>(readU32(file.data() + 12));
+  container.width = readU32(file.data() + 20);
+  container.height = std::max(1u, readU32(file.data() + 24));
+  uint32_t mipCount = std::max(1u, readU32(file.data() + 40));
+  uint32_t supercompression = readU32(file.data() + 44);
+  if (container.width == 0 || supercompression != 0 || !isBlockCompressed(container.format))
+    return false;
+  // only the levels down to 1x1 are read, the index has to hold them
+  mipCount = std::min(mipCount, fullMipCount(container.width, container.height));
+  if (file.size() < LEVEL_INDEX + size_t(mipCount) * 24)
+    return false;
+
+  for (uint32_t level = 0; level < mipCount; level++)
+  {
+    const uint8_t *entry = file.data() + LEVEL_INDEX + level * 24;
+    uint64_t offset = readU64(entry);
+    uint64_t length = readU64(entry + 8);
+    uint64_t size = textureLevelSize(container.format, std::max(1u, container.width >> level), std::max(1u, container.height >> level));
+    if (length < size || offset > file.size() || size > file.size() - offset)
+      return false;
+    container.levels.push_back(file.data() + offset);
+  }
+  return true;
+}
+
+static std::shared_ptr<DecodedTexture> loadContainer(const std::string &path, const std::vector<uint8_t> &file, bool ktx2, VkFormat format, const CompressedFormatSupport &support, bool mipChain)
+{
+  ContainerLevels container;
+  if (!(ktx2 ? parseKTX2(file, container) : parseDDS(file, container)))
+  {
+    std::cerr << "unsupported texture container, expected BC1/BC3/BC5/BC7 without supercompression: " << path << std::endl;
+    return nullptr;
+  }
+  VkFormat fileFormat = withColorSpace(container.format, isSrgb(format));
+  if (!mipChain)
+    container.levels.resize(1);
+
+  std::shared_ptr<DecodedTexture> texture = std::make_shared<DecodedTexture>();
+  texture->width = container.width;
+  texture->height = container.height;
+
+  if (isSupported(fileFormat, support))
+  {
+    texture->format = fileFormat;
+    texture->mipCount = static_cast<uint32_t>(container.levels.size());
+    allocateLevels(*texture);
+    for (uint32_t level = 0; level < texture->mipCount; level++)
+      std::memcpy(texture->pixels.data() + texture->offsets[level], container.levels[level],
+                  static_cast<size_t>(textureLevelSize(fileFormat, std::max(1u, texture->width >> level), std::max(1u, texture->height >> level))));
+    return texture;
+  }
+
+  // the device can't sample it, the levels the file has are decoded and a missing chain is filtered from the first one
+  texture->format = format;
+  bool filter = mipChain && container.levels.size() == 1;
+  texture->mipCount = filter ? fullMipCount(texture->width, texture->height) : static_cast<uint32_t>(container.levels.size());
+  allocateLevels(*texture);
+  uint32_t decodedLevels = filter ? 1 : texture->mipCount;
+  for (uint32_t level = 0; level < decodedLevels; level++)
+    transcodeLevel(fileFormat, container.levels[level], std::max(1u, texture->width >> level), std::max(1u, texture->height >> level),
+                   texture->pixels.data() + texture->offsets[level], texelSize(format));
+  if (filter)
+    generateMips(*texture);
+  return texture;
+}
+
+bool readTextureFile(const std::string &path, std::vector<uint8_t> &file)
+{
+  std::ifstream stream(path, std::ios::binary | std::ios::ate);
+  if (!stream)
+    return false;
+  file.resize(static_cast<size_t>(stream.tellg()));
+  stream.seekg(0);
+  return static_cast<bool>(stream.read(reinterpret_cast<char *>(file.data()), file.size()));
+}
+
+std::shared_ptr<DecodedTexture> loadTexture(const std::string &path, const std::vector<uint8_t> &file, VkFormat format, const CompressedFormatSupport &support, bool mipChain)
+{
+  std::string extension = path.substr(path.find_last_of('.') + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c)
+                 { return static_cast<char>(std::tolower(c)); });
+
+  if (extension == "dds" || extension == "ktx2")
+    return loadContainer(path, file, extension == "ktx2", format, support, mipChain);
+  return loadImageFile(file, format, mipChain);
+}
+
+std::shared_ptr<DecodedTexture> loadTexture(const std::string &path, VkFormat format, const CompressedFormatSupport &support, bool mipChain)
+{
+  std::vector<uint8_t> file;
+  if (!readTextureFile(path, file))
+    return nullptr;
+  return loadTexture(path, file, format, support, mipChain);
+}
+
+std::vector<VkBufferImageCopy> textureCopyRegions(const DecodedTexture &texture, uint32_t firstMip)
+{
+  uint32_t width = std::max(1u, texture.width >> firstMip);
+  uint32_t height = std::max(1u, texture.height >> firstMip);
+  std::vector<VkBufferImageCopy> regions(texture.mipCount - firstMip);
+  for (uint32_t level = 0; level < regions.size(); level++)
+  {
+    VkBufferImageCopy &region = regions[level];
+    region.bufferOffset = texture.offsets[firstMip + level] - texture.offsets[firstMip];
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {std::max(1u, width >> level), std::max(1u, height >> level), 1};
+  }
+  return regions;
+}
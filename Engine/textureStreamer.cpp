@@ -0,0 +1,378 @@
+#include "textureStreamer.hpp"
+#include "textureCache.hpp"
+#include "renderer.hpp"
+#include "utils.h"
+#include <noImage.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+TextureStreamer::~TextureStreamer()
+{
+  stopWorkers();
+}
+
+void TextureStreamer::stopWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quitting = true;
+  }
+  jobReady.notify_all();
+
+  for (std::thread &worker : workers)
+    worker.join();
+  workers.clear();
+}
+
+void TextureStreamer::init(uint32_t framesInFlight, const CompressedFormatSupport &support)
+{
+  this->framesInFlight = framesInFlight;
+  this->support = support;
+
+  std::shared_ptr<DecodedTexture> color = loadTexture(NO_IMAGE, VK_FORMAT_R8G8B8A8_UNORM, support);
+  std::shared_ptr<DecodedTexture> single = loadTexture(NO_IMAGE, VK_FORMAT_R8_UNORM, support);
+  if (!color || !single)
+  {
+    throw std::runtime_error("failed to load texture image! Filepath: " + std::string(NO_IMAGE));
+  }
+  placeholderColor = *color;
+  placeholderSingle = *single;
+
+  // decoding is mostly waiting on the disk and stb, the render and recording threads keep the rest of the cores
+  uint32_t workerCount = std::min(MAX_WORKERS, std::max(1u, std::thread::hardware_concurrency() / 4));
+  quitting = false;
+  workers.reserve(workerCount);
+  for (uint32_t i = 0; i < workerCount; i++)
+    workers.emplace_back(&TextureStreamer::workerLoop, this);
+}
+
+const DecodedTexture &TextureStreamer::placeholder(VkFormat format) const
+{
+  return format == VK_FORMAT_R8_UNORM ? placeholderSingle : placeholderColor;
+}
+
+void TextureStreamer::workerLoop()
+{
+  while (true)
+  {
+    DecodeJob job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      jobReady.wait(lock, [this]
+                    { return quitting || !jobs.empty(); });
+      if (quitting)
+        return;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+
+    std::shared_ptr<DecodedTexture> texture = loadTexture(job.path, job.format, support);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    results.push_back({job.id, std::move(texture)});
+  }
+}
+
+void TextureStreamer::queueDecode(Request &request)
+{
+  request.decoding = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back({request.id, request.path, request.texture->mapFormat});
+  }
+  jobReady.notify_one();
+}
+
+void TextureStreamer::request(CachedTexture &texture)
+{
+  Request request;
+  request.id = nextId++;
+  request.texture = &texture;
+  request.path = texture.path;
+  request.format = texture.mapFormat;
+  request.lastUsedFrame = frame;
+  queueDecode(request);
+  requests.push_back(std::move(request));
+}
+
+void TextureStreamer::release(CachedTexture &texture)
+{
+  auto it = std::remove_if(requests.begin(), requests.end(), [&](Request &request)
+                           {
+                             if (request.texture != &texture)
+                               return false;
+                             // a decode still running for it is dropped when it comes back
+                             if (request.pendingImage != VK_NULL_HANDLE)
+                               retire(request.pendingImage, request.pendingMemory, VK_NULL_HANDLE, request.pendingTicket);
+                             return true; });
+  requests.erase(it, requests.end());
+}
+
+void TextureStreamer::retire(VkImage image, MemoryAllocation memory, VkImageView view, uint64_t ticket)
+{
+  retired.push_back({image, memory, view, frame, ticket});
+}
+
+uint32_t TextureStreamer::tailMip(const Request &request) const
+{
+  uint32_t mip = 0;
+  while (mip + 1 < request.mipCount && std::max(request.width >> mip, request.height >> mip) > TAIL_SIZE)
+    mip++;
+  return mip;
+}
+
+void TextureStreamer::uploadLevels(Renderer &renderer, Request &request, uint32_t mip)
+{
+  const DecodedTexture &texture = *request.decoded;
+  uint32_t levels = texture.mipCount - mip;
+  uint32_t width = std::max(1u, texture.width >> mip);
+  uint32_t height = std::max(1u, texture.height >> mip);
+
+  UploadManager &uploads = renderer.bufferManager.uploadManager;
+  createImage(width, height, request.format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+              request.pendingImage, request.pendingMemory, renderer.deviceManager.device, renderer.deviceManager.physicalDevice, uploads.sharedFamilies(), levels);
+
+  std::vector<VkBufferImageCopy> regions = textureCopyRegions(texture, mip);
+  VkDeviceSize size = texture.offsets[texture.mipCount] - texture.offsets[mip];
+  request.pendingTicket = uploads.uploadImage(request.pendingImage, levels, regions, texture.pixels.data() + texture.offsets[mip], size);
+  request.pendingMip = mip;
+}
+
+void TextureStreamer::swapIn(Renderer &renderer, Request &request)
+{
+  VkDevice device = renderer.deviceManager.device;
+  CachedTexture &texture = *request.texture;
+
+  VkImageView view = createImageView(request.pendingImage, request.format, VK_IMAGE_ASPECT_COLOR_BIT, device, request.mipCount - request.pendingMip);
+  renderer.descriptorManager.replaceBindlessTexture(device, texture.view, view, renderer.textureCache.sampler());
+
+  // frames in flight still sample what the texture showed until now
+  retire(texture.image, texture.memory, texture.view, 0);
+  texture.image = request.pendingImage;
+  texture.memory = request.pendingMemory;
+  texture.view = view;
+  texture.format = request.format;
+  texture.mipLevels = request.mipCount - request.pendingMip;
+  renderer.textureCache.updateUsers(texture);
+
+  request.residentMip = request.pendingMip;
+  request.residentBytes = request.pendingMemory.size;
+  request.pendingImage = VK_NULL_HANDLE;
+  request.pendingMemory = MemoryAllocation();
+}
+
+void TextureStreamer::update(Renderer &renderer, uint64_t uploadsCompleted)
+{
+  VkDevice device = renderer.deviceManager.device;
+  UploadManager &uploads = renderer.bufferManager.uploadManager;
+  uint64_t completed = uploads.completedValue();
+  frame++;
+
+  auto retiredEnd = std::remove_if(retired.begin(), retired.end(), [&](RetiredImage &image)
+                                   {
+                                     if (frame - image.frame < framesInFlight || image.ticket > completed)
+                                       return false;
+                                     if (image.view != VK_NULL_HANDLE)
+                                       vkDestroyImageView(device, image.view, nullptr);
+                                     vkDestroyImage(device, image.image, nullptr);
+                                     MemoryAllocator::get().free(image.memory, device);
+                                     return true; });
+  retired.erase(retiredEnd, retired.end());
+
+  std::vector<DecodeResult> finished;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    finished.swap(results);
+  }
+  for (DecodeResult &result : finished)
+  {
+    auto it = std::find_if(requests.begin(), requests.end(), [&](const Request &request)
+                           { return request.id == result.id; });
+    if (it == requests.end())
+      continue;
+
+    it->decoding = false;
+    if (!result.texture)
+    {
+      it->failed = true;
+      std::cerr << "failed to load texture image! Filepath: " << it->path << std::endl;
+      continue;
+    }
+    if (it->mipCount == 0)
+    {
+      it->format = result.texture->format;
+      it->width = result.texture->width;
+      it->height = result.texture->height;
+      it->mipCount = result.texture->mipCount;
+      it->residentMip = it->mipCount;
+      it->wantedMip = tailMip(*it);
+      it->budgetMip = 0;
+    }
+    it->decoded = std::move(result.texture);
+  }
+
+  // a texture is as large as the largest mesh showing it, owners share several textures, so the sizes are read by all of them before they are reset
+  for (Request &request : requests)
+  {
+    request.pixels = 0.0f;
+    for (const TextureUser &user : request.texture->users)
+      request.pixels = std::max(request.pixels, user.owner->streamPixels);
+    if (request.pixels > 0.0f)
+      request.lastUsedFrame = frame;
+  }
+  for (Request &request : requests)
+    for (const TextureUser &user : request.texture->users)
+      user.owner->streamPixels = 0.0f;
+
+  VkDeviceSize residentBytes = 0;
+  uint64_t evictions = stats.evictions;
+  stats = TextureStreamStats();
+  stats.evictions = evictions;
+  for (Request &request : requests)
+  {
+    // only uploads the frame's submit waits on, the timeline may have moved on since the packets were built
+    // and an image finished after that has no wait covering its transfer queue copy and layout transition
+    if (request.pendingImage != VK_NULL_HANDLE && request.pendingTicket <= uploadsCompleted)
+      swapIn(renderer, request);
+
+    residentBytes += request.residentBytes;
+    stats.decoding += request.decoding;
+    if (request.mipCount == 0 || request.failed)
+      continue;
+
+    // one texel per pixel covered, the mesh's UVs are assumed to span the texture once
+    uint32_t tail = tailMip(request);
+    uint32_t demand = 0;
+    float largest = static_cast<float>(std::max(request.width, request.height));
+    if (frame - request.lastUsedFrame > UNUSED_FRAMES)
+      demand = tail;
+    else if (request.pixels < largest)
+      demand = static_cast<uint32_t>(std::floor(std::log2(largest / std::max(request.pixels, 1.0f))));
+    request.wantedMip = std::min(std::max(demand, request.budgetMip), tail);
+  }
+
+  // the texture drawn with the fewest pixels per resident texel gives up its largest level
+  auto texelRatio = [&](const Request &request)
+  {
+    if (frame - request.lastUsedFrame > UNUSED_FRAMES)
+      return -1.0f;
+    return request.pixels / static_cast<float>(std::max({1u, request.width >> request.residentMip, request.height >> request.residentMip}));
+  };
+  auto levelBytes = [&](const Request &request, uint32_t mip)
+  {
+    return textureLevelSize(request.format, std::max(1u, request.width >> mip), std::max(1u, request.height >> mip));
+  };
+
+  VkDeviceSize projected = residentBytes;
+  while (projected > residentBudget)
+  {
+    Request *victim = nullptr;
+    for (Request &request : requests)
+    {
+      if (request.mipCount == 0 || request.residentMip >= tailMip(request) || request.budgetMip > request.residentMip)
+        continue;
+      if (!victim || texelRatio(request) < texelRatio(*victim))
+        victim = &request;
+    }
+    if (!victim)
+      break;
+
+    victim->budgetMip = victim->residentMip + 1;
+    victim->wantedMip = std::max(victim->wantedMip, victim->budgetMip);
+    projected -= std::min(projected, levelBytes(*victim, victim->residentMip));
+    stats.evictions++;
+  }
+  // well under the budget the most wanted capped texture may grow again
+  if (projected < residentBudget / 10 * 9)
+  {
+    Request *capped = nullptr;
+    for (Request &request : requests)
+      if (request.budgetMip > 0 && (!capped || texelRatio(request) > texelRatio(*capped)))
+        capped = &request;
+    if (capped && levelBytes(*capped, capped->budgetMip - 1) + projected < residentBudget)
+      capped->budgetMip--;
+  }
+
+  // placeholders first, then the textures missing the most texels on screen
+  std::vector<Request *> changes;
+  for (Request &request : requests)
+  {
+    if (request.mipCount == 0 || request.failed || request.pendingImage != VK_NULL_HANDLE || request.residentMip == request.wantedMip)
+      continue;
+    if (!request.decoded)
+    {
+      if (!request.decoding)
+        queueDecode(request);
+      continue;
+    }
+    changes.push_back(&request);
+  }
+  std::sort(changes.begin(), changes.end(), [&](const Request *a, const Request *b)
+            {
+              bool aPlaceholder = a->residentMip == a->mipCount;
+              bool bPlaceholder = b->residentMip == b->mipCount;
+              if (aPlaceholder != bPlaceholder)
+                return aPlaceholder;
+              return texelRatio(*a) > texelRatio(*b); });
+
+  VkDeviceSize uploadBytes = 0;
+  for (Request *request : changes)
+  {
+    bool placeholder = request->residentMip == request->mipCount;
+    uint32_t mip = request->wantedMip;
+    if (placeholder)
+      mip = tailMip(*request);
+    else if (request->wantedMip < request->residentMip)
+      mip = request->residentMip - 1;
+
+    VkDeviceSize size = request->decoded->offsets[request->mipCount] - request->decoded->offsets[mip];
+    if (uploadBytes > 0 && uploadBytes + size > FRAME_UPLOAD_BYTES)
+      break;
+    if (!placeholder && mip < request->residentMip && projected + levelBytes(*request, mip) > residentBudget)
+      continue;
+
+    uploadLevels(renderer, *request, mip);
+    uploadBytes += size;
+    if (mip < request->residentMip)
+      projected += levelBytes(*request, mip);
+  }
+
+  for (Request &request : requests)
+  {
+    if (request.pendingImage != VK_NULL_HANDLE || request.residentMip != request.wantedMip)
+      request.settledFrame = frame;
+    else if (frame - request.settledFrame > KEEP_DECODED_FRAMES)
+      request.decoded.reset();
+
+    stats.textures++;
+    stats.placeholders += request.mipCount == 0 || request.residentMip == request.mipCount;
+  }
+  stats.residentBytes = residentBytes;
+}
+
+void TextureStreamer::cleanup(VkDevice device)
+{
+  stopWorkers();
+
+  // the upload manager and the device are idle by now
+  for (RetiredImage &image : retired)
+  {
+    if (image.view != VK_NULL_HANDLE)
+      vkDestroyImageView(device, image.view, nullptr);
+    vkDestroyImage(device, image.image, nullptr);
+    MemoryAllocator::get().free(image.memory, device);
+  }
+  retired.clear();
+
+  for (Request &request : requests)
+  {
+    if (request.pendingImage == VK_NULL_HANDLE)
+      continue;
+    vkDestroyImage(device, request.pendingImage, nullptr);
+    MemoryAllocator::get().free(request.pendingMemory, device);
+  }
+  requests.clear();
+  jobs.clear();
+  results.clear();
+}
@@ -0,0 +1,457 @@
+#include "uploadManager.hpp"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+
+static void createStagingBuffer(VkDeviceSize size, VkBuffer &buffer, MemoryAllocation &memory, VkDevice device, VkPhysicalDevice physicalDevice)
+{
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  // only ever read by the queue the uploads run on
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create staging buffer!");
+  }
+
+  MemoryAllocator::get().allocateBuffer(buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memory, device, physicalDevice);
+}
+
+void UploadManager::init(VkDevice device, VkPhysicalDevice physicalDevice, VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily)
+{
+  this->device = device;
+  this->physicalDevice = physicalDevice;
+  queue = transferQueue;
+
+  // sharing concurrently saves the queue family ownership transfer every upload would otherwise need on both queues
+  families.clear();
+  if (transferFamily != graphicsFamily)
+    families = {graphicsFamily, transferFamily};
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = transferFamily;
+
+  if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create upload command pool!");
+  }
+
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to create upload timeline semaphore!");
+  }
+
+  createStagingBuffer(RING_SIZE, ringBuffer, ringMemory, device, physicalDevice);
+
+  // 16 also covers the texel block size of every format the engine uploads
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  ringAlignment = std::max<VkDeviceSize>(16, properties.limits.optimalBufferCopyOffsetAlignment);
+}
+
+UploadManager::Batch &UploadManager::recordingBatch()
+{
+  if (recording >= 0)
+    return batches[recording];
+
+  auto it = std::find_if(batches.begin(), batches.end(), [](const Batch &batch)
+                         { return batch.value == 0; });
+  if (it == batches.end())
+  {
+    Batch batch;
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(device, &allocInfo, &batch.commandBuffer) != VK_SUCCESS)
+    {
+      throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+    batches.push_back(batch);
+    it = std::prev(batches.end());
+  }
+
+  Batch &batch = *it;
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to begin recording upload command buffer!");
+  }
+
+  // an earlier submit may have written what this one overwrites, like an arena range that was handed out again
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  stats.barriers++;
+
+  batch.value = nextValue;
+  recording = static_cast<int>(it - batches.begin());
+  return batch;
+}
+
+VkDeviceSize UploadManager::stage(const void *data, VkDeviceSize size, VkBuffer &source)
+{
+  stats.bytes += size;
+
+  if (size > RING_SIZE)
+  {
+    StagingBuffer staging;
+    createStagingBuffer(size, staging.buffer, staging.memory, device, physicalDevice);
+    memcpy(staging.memory.mapped, data, static_cast<size_t>(size));
+    recordingBatch().dedicated.push_back(staging);
+    stats.dedicatedStaging++;
+    source = staging.buffer;
+    return 0;
+  }
+
+  VkDeviceSize alignedSize = (size + ringAlignment - 1) / ringAlignment * ringAlignment;
+  VkDeviceSize skipped = 0;
+  while (true)
+  {
+    reclaim();
+    // a copy never wraps, the end of the ring is skipped instead
+    skipped = ringHead + alignedSize > RING_SIZE ? RING_SIZE - ringHead : 0;
+    if (ringUsed + skipped + alignedSize <= RING_SIZE)
+      break;
+
+    // everything in the ring is still waiting on the transfer queue
+    stats.stalls++;
+    if (recording >= 0 && batches[recording].ringBytes > 0)
+      submit();
+
+    uint64_t oldest = UINT64_MAX;
+    for (const Batch &batch : batches)
+      if (batch.value != 0)
+        oldest = std::min(oldest, batch.value);
+    if (oldest == UINT64_MAX)
+      throw std::runtime_error("failed to find space in the upload ring!");
+    waitValue(oldest);
+  }
+
+  VkDeviceSize offset = skipped > 0 ? 0 : ringHead;
+  memcpy(static_cast<char *>(ringMemory.mapped) + offset, data, static_cast<size_t>(size));
+  ringHead = offset + alignedSize;
+  ringUsed += skipped + alignedSize;
+  recordingBatch().ringBytes += skipped + alignedSize;
+  stats.ringUsed = ringUsed;
+
+  source = ringBuffer;
+  return offset;
+}
+
+void UploadManager::reclaim()
+{
+  if (vkGetSemaphoreCounterValue(device, semaphore, &completed) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to read upload timeline semaphore!");
+  }
+
+  for (Batch &batch : batches)
+  {
+    if (batch.value == 0 || batch.value > completed)
+      continue;
+
+    ringUsed -= batch.ringBytes;
+    batch.ringBytes = 0;
+    for (StagingBuffer &staging : batch.dedicated)
+    {
+      vkDestroyBuffer(device, staging.buffer, nullptr);
+      MemoryAllocator::get().free(staging.memory, device);
+    }
+    batch.dedicated.clear();
+    batch.value = 0;
+  }
+
+  if (ringUsed == 0)
+    ringHead = 0;
+  stats.ringUsed = ringUsed;
+}
+
+void UploadManager::recordPending()
+{
+  if (pendingBuffers.empty() && pendingImages.empty())
+    return;
+
+  Batch &batch = recordingBatch();
+
+  if (!pendingImages.empty())
+  {
+    std::vector<VkImageMemoryBarrier> imageBarriers(pendingImages.size());
+    for (size_t i = 0; i < pendingImages.size(); i++)
+    {
+      VkImageMemoryBarrier &barrier = imageBarriers[i];
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = pendingImages[i].image;
+      barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+      barrier.subresourceRange.baseMipLevel = 0;
+      barrier.subresourceRange.levelCount = pendingImages[i].mipLevels;
+      barrier.subresourceRange.baseArrayLayer = 0;
+      barrier.subresourceRange.layerCount = 1;
+      barrier.srcAccessMask = 0;
+      barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    }
+    vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+    stats.barriers++;
+
+    for (const PendingImageCopy &copy : pendingImages)
+      vkCmdCopyBufferToImage(batch.commandBuffer, copy.source, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copy.regions.size()), copy.regions.data());
+
+    // a transfer queue has no shader stages, the frame waiting on the semaphore makes the writes visible to them
+    for (VkImageMemoryBarrier &barrier : imageBarriers)
+    {
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+      barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      barrier.dstAccessMask = 0;
+    }
+    vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+    stats.barriers++;
+  }
+
+  // pending buffer copies never overlap, so they are grouped by source and destination into one command each
+  std::stable_sort(pendingBuffers.begin(), pendingBuffers.end(), [](const PendingBufferCopy &a, const PendingBufferCopy &b)
+                   { return a.dst != b.dst ? std::less<VkBuffer>()(a.dst, b.dst) : std::less<VkBuffer>()(a.source, b.source); });
+  std::vector<VkBufferCopy> regions;
+  for (size_t first = 0; first < pendingBuffers.size();)
+  {
+    size_t last = first;
+    regions.clear();
+    while (last < pendingBuffers.size() && pendingBuffers[last].dst == pendingBuffers[first].dst && pendingBuffers[last].source == pendingBuffers[first].source)
+      regions.push_back(pendingBuffers[last++].region);
+    vkCmdCopyBuffer(batch.commandBuffer, pendingBuffers[first].source, pendingBuffers[first].dst, static_cast<uint32_t>(regions.size()), regions.data());
+    first = last;
+  }
+
+  pendingBuffers.clear();
+  pendingImages.clear();
+}
+
+void UploadManager::submit()
+{
+  recordPending();
+  Batch &batch = batches[recording];
+  if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to record upload command buffer!");
+  }
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues = &batch.value;
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.commandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &semaphore;
+
+  if (vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to submit upload command buffer!");
+  }
+
+  recording = -1;
+  nextValue++;
+  stats.submits++;
+}
+
+void UploadManager::waitValue(uint64_t value)
+{
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &semaphore;
+  waitInfo.pValues = &value;
+
+  if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+  {
+    throw std::runtime_error("failed to wait for uploads!");
+  }
+}
+
+uint64_t UploadManager::uploadBuffer(VkBuffer dst, VkDeviceSize offset, const void *data, VkDeviceSize size)
+{
+  if (size == 0)
+    return 0;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  VkBuffer source;
+  VkDeviceSize sourceOffset = stage(data, size, source);
+
+  VkBufferCopy copyRegion{};
+  copyRegion.srcOffset = sourceOffset;
+  copyRegion.dstOffset = offset;
+  copyRegion.size = size;
+  pendingBuffers.push_back({source, dst, copyRegion});
+
+  uint64_t ticket = batches[recording].value;
+  if (batchDepth == 0)
+    recordPending();
+  return ticket;
+}
+
+uint64_t UploadManager::uploadImage(VkImage image, uint32_t width, uint32_t height, const void *data, VkDeviceSize size)
+{
+  VkBufferImageCopy region{};
+  region.bufferOffset = 0;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.mipLevel = 0;
+  region.imageSubresource.baseArrayLayer = 0;
+  region.imageSubresource.layerCount = 1;
+  region.imageOffset = {0, 0, 0};
+  region.imageExtent = {width, height, 1};
+  return uploadImage(image, 1, {region}, data, size);
+}
+
+uint64_t UploadManager::uploadImage(VkImage image, uint32_t mipLevels, const std::vector<VkBufferImageCopy> &regions, const void *data, VkDeviceSize size)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  VkBuffer source;
+  VkDeviceSize sourceOffset = stage(data, size, source);
+
+  PendingImageCopy copy{source, image, mipLevels, regions};
+  for (VkBufferImageCopy &region : copy.regions)
+    region.bufferOffset += sourceOffset;
+  pendingImages.push_back(std::move(copy));
+
+  uint64_t ticket = batches[recording].value;
+  if (batchDepth == 0)
+    recordPending();
+  return ticket;
+}
+
+uint64_t UploadManager::copyBuffer(VkBuffer src, VkBuffer dst, const std::vector<VkBufferCopy> &regions)
+{
+  if (regions.empty())
+    return 0;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  recordPending();
+  Batch &batch = recordingBatch();
+
+  // uploads into src recorded earlier in the same submit
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+  stats.barriers++;
+
+  vkCmdCopyBuffer(batch.commandBuffer, src, dst, static_cast<uint32_t>(regions.size()), regions.data());
+  return batch.value;
+}
+
+void UploadManager::beginBatch()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  batchDepth++;
+}
+
+uint64_t UploadManager::endBatch()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (batchDepth > 0)
+    batchDepth--;
+  if (batchDepth > 0 || recording < 0)
+    return recording >= 0 ? batches[recording].value : nextValue - 1;
+
+  uint64_t ticket = batches[recording].value;
+  submit();
+  return ticket;
+}
+
+void UploadManager::flush()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (recording >= 0)
+    submit();
+}
+
+uint64_t UploadManager::completedValue()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  reclaim();
+  return completed;
+}
+
+bool UploadManager::isComplete(uint64_t ticket)
+{
+  return ticket <= completedValue();
+}
+
+void UploadManager::wait(uint64_t ticket)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  if (ticket <= completed)
+    return;
+  if (recording >= 0 && batches[recording].value <= ticket)
+    submit();
+
+  // other threads keep uploading while this one waits
+  lock.unlock();
+  waitValue(ticket);
+  lock.lock();
+  reclaim();
+}
+
+void UploadManager::waitIdle()
+{
+  uint64_t last;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (recording >= 0)
+      submit();
+    last = nextValue - 1;
+  }
+  wait(last);
+}
+
+void UploadManager::cleanup(VkDevice device)
+{
+  if (semaphore == VK_NULL_HANDLE)
+    return;
+
+  waitIdle();
+  reclaim();
+  batches.clear();
+
+  vkDestroyBuffer(device, ringBuffer, nullptr);
+  ringBuffer = VK_NULL_HANDLE;
+  MemoryAllocator::get().free(ringMemory, device);
+
+  // destroying the pool frees its command buffers
+  vkDestroyCommandPool(device, commandPool, nullptr);
+  commandPool = VK_NULL_HANDLE;
+  vkDestroySemaphore(device, semaphore, nullptr);
+  semaphore = VK_NULL_HANDLE;
+}
@@ -42,10 +42,23 @@ QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surfa
     i++;
   }
 
+  // a queue family that can only transfer is usually a DMA engine that copies alongside rendering
+  for (uint32_t family = 0; family < queueFamilyCount; family++)
+  {
+    VkQueueFlags flags = queueFamilies[family].queueFlags;
+    if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT))
+    {
+      indices.transferFamily = family;
+      break;
+    }
+  }
+  if (!indices.transferFamily.has_value())
+    indices.transferFamily = indices.graphicsFamily;
+
   return indices;
 }
 
-VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkDevice device)
+VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkDevice device, uint32_t mipLevels)
 {
   VkImageViewCreateInfo viewInfo{};
   viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -60,7 +73,7 @@ VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags a
     viewInfo.components.a = VK_COMPONENT_SWIZZLE_R;
   }
   viewInfo.subresourceRange.baseMipLevel = 0;
-  viewInfo.subresourceRange.levelCount = 1;
+  viewInfo.subresourceRange.levelCount = mipLevels;
   viewInfo.subresourceRange.aspectMask = aspectFlags;
   viewInfo.subresourceRange.baseArrayLayer = 0;
   viewInfo.subresourceRange.layerCount = 1;
@@ -247,7 +260,7 @@ void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayo
   endSingleTimeCommands(commandBuffer, device, commandPool, graphicsQueue);
 }
 
-void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory, VkDevice device, VkPhysicalDevice physicalDevice)
+void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, MemoryAllocation &imageMemory, VkDevice device, VkPhysicalDevice physicalDevice, const std::vector<uint32_t> &queueFamilies, uint32_t mipLevels)
 {
   VkImageCreateInfo imageInfo{};
   imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -255,7 +268,7 @@ void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling
   imageInfo.extent.width = width;
   imageInfo.extent.height = height;
   imageInfo.extent.depth = 1;
-  imageInfo.mipLevels = 1;
+  imageInfo.mipLevels = mipLevels;
   imageInfo.arrayLayers = 1;
   imageInfo.format = format;
   imageInfo.tiling = tiling;
@@ -263,26 +276,19 @@ void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling
   imageInfo.usage = usage;
   imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
   imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-  if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+  if (queueFamilies.size() > 1)
   {
-    throw std::runtime_error("failed to create image!");
+    imageInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+    imageInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+    imageInfo.pQueueFamilyIndices = queueFamilies.data();
   }
 
-  VkMemoryRequirements memRequirements;
-  vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = memRequirements.size;
-  allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties, physicalDevice);
-
-  if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
+  if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
   {
-    throw std::runtime_error("failed to allocate image memory!");
+    throw std::runtime_error("failed to create image!");
   }
 
-  vkBindImageMemory(device, image, imageMemory, 0);
+  MemoryAllocator::get().allocateImage(image, tiling, properties, imageMemory, device, physicalDevice);
 }
 
 void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue)
@@ -0,0 +1,63 @@
+#include "world.hpp"
+
+void World::step(float deltaTime, ScratchArena *scratchArena)
+{
+  if (scratchArena == nullptr)
+  {
+    if (!ownScratch)
+      ownScratch = std::make_unique<ScratchArena>();
+    ownScratch->reset();
+    scratchArena = ownScratch.get();
+  }
+  scratch = scratchArena;
+
+  if (update)
+    update(this, deltaTime);
+
+  physics.refitBoxColliders(*scratch);
+  physics.update(deltaTime, *scratch);
+  animations.update(deltaTime);
+
+  steps++;
+  simulationTime += deltaTime;
+  scratch = nullptr;
+}
+
+Entity World::createEmptyGameObject(const std::string &name)
+{
+  Entity e = registry.createEntity(name);
+  addTransformComponent(e, glm::vec3(0), glm::vec3(0), glm::vec3(1));
+  return e;
+}
+
+void World::addTransformComponent(Entity entity, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale)
+{
+  if (registry.transforms.find(entity) != registry.transforms.end())
+    return;
+
+  TransformComponent transformComp;
+  transformComp.position = position;
+  transformComp.rotationZYX = rotation;
+  transformComp.scale = scale;
+  registry.transforms.emplace(entity, std::move(transformComp));
+}
+
+void World::addBoxColliderComponent(Entity entity)
+{
+  if (registry.boxColliders.find(entity) != registry.boxColliders.end())
+    return;
+
+  BoxColliderComponent &boxCollider = registry.boxColliders[entity];
+  TransformComponent &transform = registry.transforms[entity];
+  transform.markUpdated();
+  boxCollider.updateWorldAABB(transform.position, transform.rotationZYX, transform.scale);
+  boxCollider.transformVersion = transform.version;
+  boxCollider.autoUpdate = true;
+}
+
+void World::addRigidBodyComponent(Entity entity)
+{
+  if (registry.rigidBodies.find(entity) != registry.rigidBodies.end())
+    return;
+  registry.rigidBodies.emplace(entity, RigidBodyComponent());
+}
@@ -0,0 +1,106 @@
+#include "worldBatch.hpp"
+#include <chrono>
+#include <algorithm>
+
+WorldBatch::WorldBatch(size_t threadCount, size_t scratchBytesPerWorker)
+{
+  if (threadCount == 0)
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+  arenas.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++)
+    arenas.emplace_back(scratchBytesPerWorker);
+
+  workers.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; i++)
+    workers.emplace_back(&WorldBatch::workerLoop, this, i);
+}
+
+WorldBatch::~WorldBatch()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    quitting = true;
+  }
+  workReady.notify_all();
+
+  for (std::thread &worker : workers)
+    worker.join();
+}
+
+World &WorldBatch::addWorld()
+{
+  worlds.push_back(std::make_unique<World>());
+  return *worlds.back();
+}
+
+void WorldBatch::clear()
+{
+  worlds.clear();
+}
+
+void WorldBatch::step(float deltaTime, uint32_t stepsPerWorld)
+{
+  if (worlds.empty() || stepsPerWorld == 0)
+    return;
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    nextWorld.store(0, std::memory_order_relaxed);
+    jobDeltaTime = deltaTime;
+    jobSteps = stepsPerWorld;
+    activeWorkers = workers.size();
+    generation++;
+  }
+  workReady.notify_all();
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    workDone.wait(lock, [this]
+                  { return activeWorkers == 0; });
+  }
+
+  stats.batchSteps += stepsPerWorld;
+  stats.worldSteps += static_cast<uint64_t>(worlds.size()) * stepsPerWorld;
+  stats.wallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void WorldBatch::workerLoop(size_t workerIndex)
+{
+  ScratchArena &arena = arenas[workerIndex];
+  uint64_t seenGeneration = 0;
+
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      workReady.wait(lock, [&]
+                     { return quitting || generation != seenGeneration; });
+      if (quitting)
+        return;
+      seenGeneration = generation;
+    }
+
+    // a world stays on one worker for all of its steps so its data stays in that core's cache
+    while (true)
+    {
+      size_t index = nextWorld.fetch_add(1, std::memory_order_relaxed);
+      if (index >= worlds.size())
+        break;
+
+      World &world = *worlds[index];
+      for (uint32_t i = 0; i < jobSteps; i++)
+      {
+        arena.reset();
+        world.step(jobDeltaTime, &arena);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--activeWorkers == 0)
+        workDone.notify_one();
+    }
+  }
+}
@@ -35,7 +35,7 @@ public:
 
   virtual void initGraphics(Renderer &renderer) = 0;
 
-  virtual void draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, glm::mat4 view, glm::mat4 projectionMatrix, VkCommandBuffer commandBuffer) = 0;
+  virtual void draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, VkCommandBuffer commandBuffer) = 0;
 
   virtual void cleanup(VkDevice device, Renderer &renderer) = 0;
 };
\ No newline at end of file
@@ -2,8 +2,13 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <array>
 #include "vertex.h"
 #include "utils.h"
+#include "memoryAllocator.hpp"
+#include "geometryArena.hpp"
+#include "uploadManager.hpp"
 
 #ifdef BUILD_ENGINE_DLL
 
@@ -19,6 +24,23 @@
 
 #endif
 
+// host visible, persistently mapped and only ever grown
+struct ENGINE_API MappedBuffer
+{
+  VkBuffer buffer = VK_NULL_HANDLE;
+  MemoryAllocation memory;
+  void *mapped = nullptr;
+  VkDeviceSize capacity = 0; // bytes
+};
+
+struct ENGINE_API GpuCullBuffers
+{
+  MappedBuffer instances; // CullInstanceData written by the CPU
+  MappedBuffer batches;   // GpuBatchData per opaque mesh batch, written with no instances and counted up by the pass
+  MappedBuffer commands;  // the batches left with instances, compacted per permutation run for vkCmdDrawIndexedIndirectCount, the occluder draws follow the main ones
+  MappedBuffer drawCount; // main draws with instances, occluder draws, then the draws of each permutation run at its first batch
+};
+
 class ENGINE_API BufferManager
 {
 public:
@@ -28,40 +50,77 @@ public:
   ~BufferManager()
   {
   }
+  // static mesh geometry, the per id vertex/index buffers below are left for animated meshes and UI
+  GeometryArena geometryArena;
+  // device local buffers and textures are filled through it on the transfer queue, initialized by the renderer
+  UploadManager uploadManager;
+
   std::vector<VkBuffer> vertexBuffers;
   std::vector<VkDeviceSize> vertexBufferSizes;
-  std::vector<VkDeviceMemory> vertexBufferMemory;
+  std::vector<MemoryAllocation> vertexBufferMemory;
 
   std::vector<VkBuffer> indexBuffers;
-  std::vector<VkDeviceMemory> indexBufferMemory;
+  std::vector<MemoryAllocation> indexBufferMemory;
 
   std::vector<VkBuffer> shaderStorageBuffers;
-  std::vector<VkDeviceMemory> shaderStorageBuffersMemory;
+  std::vector<MemoryAllocation> shaderStorageBuffersMemory;
 
   std::vector<VkBuffer> computeUniformBuffers;
-  std::vector<VkDeviceMemory> computeUniformBuffersMemory;
+  std::vector<MemoryAllocation> computeUniformBuffersMemory;
   std::vector<void *> computeUniformBuffersMapped;
 
-  std::vector<VkBuffer> uniformBuffers;
-  std::vector<VkDeviceMemory> uniformBuffersMemory;
-  std::vector<void *> uniformBuffersMapped;
+  // per frame view/proj of both cameras
+  std::vector<VkBuffer> globalUniformBuffers;
+  std::vector<MemoryAllocation> globalUniformBuffersMemory;
+  std::vector<void *> globalUniformBuffersMapped;
+
+  // per frame, persistently mapped, per-draw uniforms are suballocated linearly and bound with dynamic offsets
+  std::vector<VkBuffer> frameUniformBuffers;
+  std::vector<MemoryAllocation> frameUniformBuffersMemory;
+  std::vector<void *> frameUniformBuffersMapped;
+  std::vector<VkDeviceSize> frameUniformCapacities;
+  std::vector<VkDeviceSize> frameUniformHeads;
+  VkDeviceSize uniformAlignment = 256;
 
   std::vector<VkBuffer> lightsUBO;
-  std::vector<VkDeviceMemory> lightsUBOMemory;
+  std::vector<MemoryAllocation> lightsUBOMemory;
   std::vector<void *> lightsUBOMapped;
 
-  std::map<int, VkBuffer> animatedUniformBuffers;
-  std::map<int, VkDeviceMemory> animatedUniformBuffersMemory;
-  std::map<int, void *> animatedUniformBuffersMapped;
+  // per frame, persistently mapped, grown by reserveInstanceBuffer
+  std::vector<VkBuffer> instanceBuffers;
+  std::vector<MemoryAllocation> instanceBuffersMemory;
+  std::vector<void *> instanceBuffersMapped;
+  std::vector<size_t> instanceCapacities;
+
+  // per frame BindlessMaterial records for the mesh shaders, grown by reserveMaterialBuffer
+  std::vector<VkBuffer> materialBuffers;
+  std::vector<MemoryAllocation> materialBuffersMemory;
+  std::vector<void *> materialBuffersMapped;
+  std::vector<size_t> materialCapacities;
+
+  // inputs and outputs of the GPU culling pass, per frame and persistently mapped
+  std::vector<GpuCullBuffers> gpuCullBuffers;
+  // one flag per mesh rendering id, written by the occlusion pass for the next frame's occluders
+  // shared by the frames in flight, so it may only grow while the device is idle
+  MappedBuffer cullVisibility;
 
   void createComputeUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevice device, VkPhysicalDevice physicalDevice, int count);
   void updateComputeUniformBuffer(uint32_t currentImage, float deltaTime);
 
-  void createUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevice device, VkPhysicalDevice physicalDevice, int count);
+  void createGlobalUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevice device, VkPhysicalDevice physicalDevice);
   void createLightsUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevice device, VkPhysicalDevice physicalDevice);
-  void createAnimationUniformBuffers(int MAX_FRAMES_IN_FLIGHT, VkDevice device, VkPhysicalDevice physicalDevice, int count, int startingId);
 
-  void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, VkDeviceMemory &bufferMemory, VkDevice device, VkPhysicalDevice physicalDevice);
+  // returns true when the buffer was recreated and descriptor sets pointing at it need updating
+  bool reserveFrameUniforms(int frame, VkDeviceSize size, VkDevice device, VkPhysicalDevice physicalDevice);
+  void resetFrameUniforms(int frame);
+  // copies data into the frame uniform buffer and returns its dynamic offset, bindingRange is the range of the descriptor reading it
+  uint32_t pushFrameUniforms(int frame, const void *data, VkDeviceSize size, VkDeviceSize bindingRange);
+  uint32_t pushObjectUniforms(int frame, const glm::mat4 &model, UniformCamera camera);
+  uint32_t pushBoneUniforms(int frame, const std::array<glm::mat4, 100> &boneMatrices);
+  VkDeviceSize alignUniformSize(VkDeviceSize size) const;
+
+  // the buffer is shared concurrently between queueFamilies, fewer than two keep it exclusive
+  void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer &buffer, MemoryAllocation &bufferMemory, VkDevice device, VkPhysicalDevice physicalDevice, const std::vector<uint32_t> &queueFamilies = {});
 
   void freeVertexBuffer(int index, VkDevice device, VkQueue graphicsQueue);
   void freeIndexBuffer(int index, VkDevice device, VkQueue graphicsQueue);
@@ -70,11 +129,39 @@ public:
 
   void createVertexBuffer(const std::vector<Vertex> &verts, int targetBuffer, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue);
   void createAnimatedVertexBuffer(const std::vector<AnimatedVertex> &verts, int targetBuffer, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue);
-  void createIndexBuffer(const std::vector<uint32_t> &inputIndices, int targetBuffer, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue);
+  // returns the upload ticket, the buffer may be drawn from once uploadManager completed it
+  uint64_t createIndexBuffer(const std::vector<uint32_t> &inputIndices, int targetBuffer, VkDevice device, VkPhysicalDevice physicalDevice);
+
+  // returns the geometry arena slot already holding identical vertices and indices, or starts uploading them to a new one
+  // -1 for empty geometry, which has nothing to draw
+  int acquireGeometry(const std::vector<Vertex> &verts, const std::vector<uint32_t> &inputIndices, VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue);
+  // the arena ranges are freed once the last user is gone
+  void releaseGeometry(int slot);
+
+  // returns true when the buffer was recreated and descriptor sets pointing at it need updating
+  bool reserveInstanceBuffer(int frame, size_t count, VkDevice device, VkPhysicalDevice physicalDevice);
+  bool reserveMaterialBuffer(int frame, size_t count, VkDevice device, VkPhysicalDevice physicalDevice);
+  bool reserveGpuCullBuffers(int frame, size_t instanceCount, size_t batchCount, VkDevice device, VkPhysicalDevice physicalDevice);
+  bool reserveCullVisibility(size_t slotCount, VkDevice device, VkPhysicalDevice physicalDevice);
 
   void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue);
   void cleanup(VkDevice device);
-  void updateUniformBuffer(uint32_t currentImage, glm::mat4 transformation, glm::mat4 view, glm::mat4 proj);
+  void updateGlobalUniformBuffer(uint32_t currentImage, const GlobalUniformBufferObject &globals);
   void updateLightsUniformBuffer(uint32_t currentImage, const std::vector<Light> &lights, const glm::vec3 &cameraPos);
-  void updateAnimationUniformBuffer(uint32_t currentImage, std::array<glm::mat4, 100> &boneMatrices);
+
+private:
+  bool reserveMappedBuffer(MappedBuffer &buffer, VkDeviceSize size, VkBufferUsageFlags usage, VkDevice device, VkPhysicalDevice physicalDevice);
+  void destroyMappedBuffer(MappedBuffer &buffer, VkDevice device);
+
+  // a copy of the contents is kept so a hash match is only shared once the bytes compare equal
+  struct SharedGeometry
+  {
+    uint64_t hash;
+    uint32_t users;
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+  };
+  // hash to the slot that first uploaded it, colliding geometry gets its own slot without an entry here
+  std::unordered_map<uint64_t, int> geometryLookup;
+  std::unordered_map<int, SharedGeometry> sharedGeometry;
 };
\ No newline at end of file
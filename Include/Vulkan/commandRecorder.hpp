@@ -0,0 +1,111 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include "commandStateCache.hpp"
+#include "drawPackets.hpp"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+class Renderer;
+
+// records the draw packets of a render stage into secondary command buffers on a fixed pool of worker threads
+// the sorted list is cut into contiguous ranges and the primary executes their buffers in list order
+// only static mesh packets are recorded on the workers, everything else pushes into shared per frame buffers and stays on the calling thread
+class ENGINE_API CommandRecorder
+{
+public:
+  // a range smaller than this costs more to hand to a worker than to record in place
+  static constexpr uint32_t MIN_PACKETS_PER_JOB = 128;
+  static constexpr uint32_t MAX_WORKERS = 7;
+
+  // summed over every secondary recorded since beginFrame
+  CommandStateStats stats;
+
+  CommandRecorder() = default;
+  ~CommandRecorder();
+
+  CommandRecorder(const CommandRecorder &) = delete;
+  CommandRecorder &operator=(const CommandRecorder &) = delete;
+
+  // creates a command pool per thread and frame in flight and starts the workers, 0 workers records everything on the calling thread
+  void init(VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, PFN_vkCmdSetPrimitiveTopology setPrimitiveTopology, PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable);
+  // resets the frame's pools, the frame's fence has to be signaled
+  void beginFrame(VkDevice device, uint32_t frame);
+  // the render pass has to be begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, inheritance names it and its framebuffer
+  // tail is recorded last on the calling thread, for anything drawn into the same pass outside the packet list
+  void record(Renderer *renderer, const DrawPacketList &list, RenderStage renderStage, VkCommandBuffer primary, const VkCommandBufferInheritanceInfo &inheritance,
+              const std::function<void(CommandStateCache &)> &tail = nullptr);
+  void cleanup(VkDevice device);
+
+  size_t workerCount() const
+  {
+    return workers.size();
+  }
+
+private:
+  // a contiguous packet range and the secondary it was recorded into
+  struct Job
+  {
+    uint32_t first;
+    uint32_t last;
+    bool parallel;
+    VkCommandBuffer commandBuffer;
+  };
+
+  // index 0 is the calling thread, the rest belong to the workers
+  struct ThreadContext
+  {
+    std::vector<VkCommandPool> pools; // one per frame in flight
+    std::vector<std::vector<VkCommandBuffer>> buffers;
+    uint32_t used = 0; // buffers of the current frame handed out so far
+    CommandStateCache state;
+    CommandStateStats stats;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  uint32_t frame = 0;
+  std::vector<ThreadContext> contexts;
+  std::vector<Job> jobs;
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable workReady;
+  std::condition_variable workDone;
+  uint64_t generation = 0;
+  size_t activeWorkers = 0;
+  bool quitting = false;
+
+  // what the current record() call draws, read by the workers
+  std::atomic<size_t> nextJob{0};
+  Renderer *jobRenderer = nullptr;
+  const DrawPacketList *jobList = nullptr;
+  RenderStage jobStage = MainRender;
+  const VkCommandBufferInheritanceInfo *jobInheritance = nullptr;
+
+  VkCommandBuffer acquireSecondary(ThreadContext &context);
+  VkCommandBuffer beginSecondary(ThreadContext &context);
+  void endSecondary(ThreadContext &context, VkCommandBuffer commandBuffer);
+  void recordJob(ThreadContext &context, Job &job);
+  // takes parallel jobs until none are left
+  void drainJobs(ThreadContext &context);
+  void buildJobs(const DrawPacketList &list, RenderStage renderStage);
+  void workerLoop(size_t workerIndex);
+  void stopWorkers();
+};
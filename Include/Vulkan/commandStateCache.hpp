@@ -0,0 +1,115 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <array>
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+enum CommandStateKind
+{
+  StatePipeline,
+  StateDescriptorSets,
+  StateVertexBuffer,
+  StateIndexBuffer,
+  StateTopology,
+  StateDepthWrite,
+  StateViewport,
+  StateScissor,
+  StateKindCount,
+};
+
+struct ENGINE_API CommandStateStats
+{
+  std::array<uint64_t, StateKindCount> issued{};
+  std::array<uint64_t, StateKindCount> skipped{};
+
+  void add(const CommandStateStats &other);
+  uint64_t totalIssued() const;
+  uint64_t totalSkipped() const;
+  static const char *kindName(CommandStateKind kind);
+};
+
+// remembers what was last recorded into one command buffer and drops calls that wouldn't change anything
+// all pipelines share the same dynamic states so those stay valid across pipeline binds
+class ENGINE_API CommandStateCache
+{
+public:
+  static const uint32_t MAX_VERTEX_BINDINGS = 4;
+  static const uint32_t MAX_DESCRIPTOR_SETS = 4;
+  static const uint32_t MAX_DYNAMIC_OFFSETS = 4;
+
+  // reset by begin()
+  CommandStateStats stats;
+
+  // the dynamic state commands are loaded once here instead of on every call
+  void init(VkDevice device, PFN_vkCmdSetPrimitiveTopology setPrimitiveTopology, PFN_vkCmdSetDepthWriteEnableEXT setDepthWriteEnable);
+
+  void begin(VkCommandBuffer commandBuffer);
+  // call after anything records into the command buffer without going through the cache
+  void invalidate();
+  // only forgets buffers and descriptor sets, for objects that bind their own but leave the pipeline alone
+  void invalidateBindings();
+
+  void bindPipeline(VkPipeline pipeline);
+  // calls with dynamic offsets are only skipped when they repeat the last call that had dynamic offsets
+  void bindDescriptorSets(VkPipelineLayout layout, uint32_t firstSet, uint32_t setCount, const VkDescriptorSet *sets, uint32_t dynamicOffsetCount = 0, const uint32_t *dynamicOffsets = nullptr);
+  void bindVertexBuffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0);
+  void bindIndexBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkIndexType indexType = VK_INDEX_TYPE_UINT32);
+  void setPrimitiveTopology(VkPrimitiveTopology topology);
+  void setDepthWriteEnable(bool enable);
+  // viewport and scissor covering the whole extent
+  void setViewportScissor(VkExtent2D extent);
+
+  VkCommandBuffer getCommandBuffer() const
+  {
+    return commandBuffer;
+  }
+
+private:
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+  PFN_vkCmdSetPrimitiveTopology cmdSetPrimitiveTopology = nullptr;
+  PFN_vkCmdSetDepthWriteEnableEXT cmdSetDepthWriteEnable = nullptr;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkPipelineLayout descriptorLayout = VK_NULL_HANDLE;
+  std::array<VkDescriptorSet, MAX_DESCRIPTOR_SETS> descriptorSets{};
+  uint32_t dynamicFirstSet = 0;
+  uint32_t dynamicSetCount = 0;
+  uint32_t dynamicOffsetCount = 0;
+  std::array<uint32_t, MAX_DYNAMIC_OFFSETS> dynamicOffsets{};
+  std::array<VkBuffer, MAX_VERTEX_BINDINGS> vertexBuffers{};
+  std::array<VkDeviceSize, MAX_VERTEX_BINDINGS> vertexOffsets{};
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  VkDeviceSize indexOffset = 0;
+  VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+  bool topologyValid = false;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  bool depthWriteValid = false;
+  bool depthWrite = false;
+  bool viewportValid = false;
+  VkViewport viewport{};
+  bool scissorValid = false;
+  VkRect2D scissor{};
+
+  bool skip(CommandStateKind kind, bool redundant)
+  {
+    if (redundant)
+      stats.skipped[kind]++;
+    else
+      stats.issued[kind]++;
+    return redundant;
+  }
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+#include "memoryAllocator.hpp"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+// depth of the occluders and its max reduced mip chain, which the culling pass tests instance bounds against
+// level 0 is half the depth image, every texel holds the farthest depth of the texels it covers
+// the last texel of a row or column also covers the odd one left over, so any footprint is covered conservatively
+class ENGINE_API DepthPyramid
+{
+public:
+  static constexpr uint32_t MAX_LEVELS = 16;
+
+  // the occlusion render pass draws into these
+  VkImage depthImage = VK_NULL_HANDLE;
+  VkImageView depthImageView = VK_NULL_HANDLE;
+  VkFramebuffer framebuffer = VK_NULL_HANDLE;
+
+  // R32 float, stays in the general layout
+  VkImage pyramidImage = VK_NULL_HANDLE;
+  VkImageView pyramidView = VK_NULL_HANDLE;
+  VkSampler sampler = VK_NULL_HANDLE;
+
+  VkExtent2D extent = {0, 0};
+  uint32_t levelCount = 0;
+
+  // recreates every image for a new scene extent, the caller has to make sure the GPU is done with the old ones
+  void create(VkExtent2D sceneExtent, VkRenderPass renderPass, VkDescriptorSetLayout setLayout, VkFormat depthFormat, VkDevice device, VkPhysicalDevice physicalDevice);
+  // reduces the depth image level by level, expects it in the depth read only layout
+  void build(VkCommandBuffer commandBuffer, VkPipeline pipeline, VkPipelineLayout pipelineLayout);
+  void cleanup(VkDevice device);
+
+private:
+  MemoryAllocation depthImageMemory;
+  MemoryAllocation pyramidMemory;
+  std::vector<VkImageView> levelViews;
+  std::vector<VkDescriptorSet> levelSets;
+  VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+
+  void destroyImages(VkDevice device);
+};
@@ -2,6 +2,8 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <cstdint>
 
 #ifdef BUILD_ENGINE_DLL
 
@@ -65,19 +67,51 @@ struct ENGINE_API TextureMaps
   VkSampler &emissiveSampler;
 };
 
+// slots in the bindless texture array, one per map of a material
+struct ENGINE_API MaterialTextures
+{
+  uint32_t albedo = 0;
+  uint32_t normal = 0;
+  uint32_t height = 0;
+  uint32_t roughness = 0;
+  uint32_t metallic = 0;
+  uint32_t ao = 0;
+  uint32_t emissive = 0;
+};
+
 class BufferManager;
 class TextureManager;
 class ENGINE_API DescriptorManager
 {
 public:
+  static constexpr uint32_t MAX_BINDLESS_TEXTURES = 16384;
+  // objects with their own per frame sets in descriptorPool: animated meshes, UI elements, text and particle emitters
+  // static meshes draw bindless and take none, the pool is fixed so the 251st such object fails to allocate
+  static constexpr int MAX_DESCRIPTOR_SET_OBJECTS = 250;
+
   VkDescriptorSetLayout descriptorSetLayout;
   VkDescriptorSetLayout animDescriptorSetLayout;
 
   VkDescriptorPool descriptorPool;
   std::vector<VkDescriptorSet> descriptorSets;
-  std::map<int, VkDescriptorSet> animDescriptorSets;
+  // one per frame, bone matrices bound with a dynamic offset into the frame uniform buffer
+  std::vector<VkDescriptorSet> animDescriptorSets;
   VkDescriptorSetLayout computeDescriptorSetLayout;
   std::vector<VkDescriptorSet> computeDescriptorSets;
+  // set 0 of the GPU culling pass, one per frame
+  VkDescriptorSetLayout cullDescriptorSetLayout;
+  std::vector<VkDescriptorSet> cullDescriptorSets;
+  // set 0 of the depth pyramid reduction, the sets are owned by the DepthPyramid
+  VkDescriptorSetLayout depthPyramidDescriptorSetLayout;
+  // set 1 of the mesh pipelines, one per frame: instance buffer, per-draw uniforms (dynamic offset), the global uniforms,
+  // the material buffer and the lights
+  VkDescriptorSetLayout frameDescriptorSetLayout;
+  std::vector<VkDescriptorSet> frameDescriptorSets;
+  // set 0 of the mesh pipeline, a single set with every material texture, written whenever a texture is added
+  VkDescriptorSetLayout bindlessDescriptorSetLayout;
+  VkDescriptorPool bindlessDescriptorPool;
+  VkDescriptorSet bindlessDescriptorSet;
+  uint32_t bindlessCapacity = 0;
   BufferManager &bufferManager;
   DescriptorManager(BufferManager &bufferManager) : bufferManager(bufferManager)
   {
@@ -88,10 +122,56 @@ public:
   void createDescriptorSetLayout(VkDevice device);
   void createDescriptorPool(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int count);
   void createDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int count, TextureMaps textureMaps);
-  void addDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int count, TextureMaps textureMaps);
-  void addAnimDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int count, int meshIdStart);
+  // the sets of a rendering id are stored at id * MAX_FRAMES_IN_FLIGHT
+  void addDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int id, TextureMaps textureMaps);
   void createComputeDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int count);
   void addComputeDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT, int count);
+  // also allocates the animation and cull sets, call once the frame buffers exist
+  void createFrameDescriptorSets(VkDevice device, int MAX_FRAMES_IN_FLIGHT);
+  // call after any of the frame's buffers were recreated
+  void updateFrameDescriptorSets(VkDevice device, int frame);
+  // call whenever the depth pyramid was recreated, before the next culling pass
+  void updateCullPyramid(VkDevice device, int frame, VkImageView pyramidView, VkSampler sampler);
+
+  // the array is sized to what the device allows, up to MAX_BINDLESS_TEXTURES
+  void createBindlessDescriptors(VkDevice device, VkPhysicalDevice physicalDevice);
+  // image views already in the array share their slot
+  uint32_t acquireBindlessTexture(VkDevice device, VkImageView imageView, VkSampler sampler);
+  // the slot and its element are retired like replaced ones, not reused while a frame in flight may read them
+  void releaseBindlessTexture(VkImageView imageView);
+  MaterialTextures acquireMaterialTextures(VkDevice device, const TextureManager &textureManager);
+  void releaseMaterialTextures(const TextureManager &textureManager);
+  // the slot of oldView keeps its number but shows newView from the next frame on, nothing happens when oldView has no slot
+  // frames in flight may still read the old descriptor, so the new one is written to a spare array element the slot is redirected to
+  void replaceBindlessTexture(VkDevice device, VkImageView oldView, VkImageView newView, VkSampler sampler);
+  // the array elements the slots currently point at, for the material buffer
+  MaterialTextures resolveMaterialTextures(const MaterialTextures &textures) const;
+  // once per frame after the frame's fence, elements replaced or released framesInFlight frames ago are handed out again
+  void releaseRetiredBindless(uint32_t framesInFlight);
 
   void cleanup(VkDevice device);
+
+private:
+  struct BindlessTexture
+  {
+    uint32_t index;   // the slot handed out
+    uint32_t element; // the array element written last, the slot itself until the texture was replaced
+    uint32_t users;
+  };
+  struct RetiredElement
+  {
+    uint32_t element;
+    uint64_t frame;
+  };
+  std::unordered_map<VkImageView, BindlessTexture> bindlessLookup;
+  std::vector<uint32_t> freeBindlessIndices;
+  uint32_t bindlessCount = 0;
+  // slot to array element, only differs for replaced textures
+  std::vector<uint32_t> bindlessElements;
+  std::vector<RetiredElement> retiredElements;
+  uint64_t bindlessFrame = 0;
+
+  // UINT32_MAX when the array is full
+  uint32_t allocateBindlessElement();
+  void writeBindlessDescriptor(VkDevice device, uint32_t element, VkImageView imageView, VkSampler sampler);
 };
\ No newline at end of file
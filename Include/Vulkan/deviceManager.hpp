@@ -1,6 +1,7 @@
 #pragma once
 #include <vulkan/vulkan.h>
 #include <vector>
+#include "textureLoader.hpp"
 
 #ifdef BUILD_ENGINE_DLL
 
@@ -21,6 +22,10 @@ class ENGINE_API DeviceManager
 public:
   VkDevice device;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  // set by createLogicalDevice, GPU culling falls back to the CPU path without it
+  bool drawIndirectCountSupported = false;
+  // set by createLogicalDevice, BC textures are transcoded on load for the formats missing here
+  CompressedFormatSupport compressedFormats;
   SwapchainManager &swapchainManager;
   DeviceManager(SwapchainManager &swapchainManager) : swapchainManager(swapchainManager)
   {
@@ -29,7 +34,7 @@ public:
   {
   }
 
-  void createLogicalDevice(bool enableValidationLayers, const std::vector<const char *> &deviceExtensions, const std::vector<const char *> &validationLayers, VkQueue *presentQueue, VkQueue *graphicsQueue, VkQueue *computeQueue);
+  void createLogicalDevice(bool enableValidationLayers, const std::vector<const char *> &deviceExtensions, const std::vector<const char *> &validationLayers, VkQueue *presentQueue, VkQueue *graphicsQueue, VkQueue *computeQueue, VkQueue *transferQueue);
   void pickPhysicalDevice(VkInstance instance, const std::vector<const char *> &deviceExtensions);
 
 private:
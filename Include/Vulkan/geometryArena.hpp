@@ -0,0 +1,116 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+#include <cstdint>
+#include "vertex.h"
+#include "memoryAllocator.hpp"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+class UploadManager;
+
+// where one mesh's geometry lives inside the arena, indices stay relative to the mesh's first vertex
+struct ENGINE_API GeometryRange
+{
+  uint32_t firstVertex = 0;
+  uint32_t vertexCount = 0;
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  // the upload writing the ranges, the geometry may be drawn once it is complete
+  uint64_t uploadTicket = 0;
+  bool used = false;
+};
+
+struct ENGINE_API GeometryArenaStats
+{
+  uint32_t geometryCount = 0;
+  uint32_t vertexCapacity = 0;
+  uint32_t vertexCount = 0;
+  uint32_t indexCapacity = 0;
+  uint32_t indexCount = 0;
+  uint32_t freeRanges = 0;
+  uint32_t compactions = 0;
+};
+
+// every static mesh shares one device local vertex buffer and one index buffer
+// meshes are drawn with firstIndex/vertexOffset, so the buffers are bound once instead of per mesh
+// ranges are looked up by slot every frame because compact() moves them
+// geometry is uploaded on the transfer queue, freed ranges are only handed out again once no frame in flight can still read them
+class ENGINE_API GeometryArena
+{
+public:
+  static constexpr uint32_t INITIAL_VERTICES = 256 * 1024;
+  static constexpr uint32_t INITIAL_INDICES = 1024 * 1024;
+
+  VkBuffer vertexBuffer = VK_NULL_HANDLE;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+
+  // starts uploading the geometry and returns its slot, grows the buffers when no free range is large enough
+  int allocate(const std::vector<Vertex> &verts, const std::vector<uint32_t> &inputIndices, UploadManager &uploads, VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue);
+  // the slot can be handed out again right away, its ranges once releaseRetired was called framesInFlight times
+  void free(int slot);
+  // call once per frame after waiting for the frame's fence
+  void releaseRetired(uint32_t framesInFlight);
+
+  const GeometryRange &get(int slot) const
+  {
+    return slots[slot];
+  }
+
+  // moves every live range to the front of fresh buffers once enough space is lost to holes
+  // waits for the queue to go idle, so only call it at load points and never while a frame is recorded
+  bool compactIfFragmented(UploadManager &uploads, VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue);
+  void compact(UploadManager &uploads, VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue);
+
+  GeometryArenaStats getStats() const;
+  void cleanup(VkDevice device);
+
+private:
+  // free ranges by offset, neighbours are merged when a range is given back
+  struct FreeList
+  {
+    std::map<uint32_t, uint32_t> ranges;
+    uint32_t capacity = 0;
+    uint32_t used = 0;
+
+    // best fit, UINT32_MAX when nothing is large enough
+    uint32_t allocate(uint32_t count);
+    void free(uint32_t offset, uint32_t count);
+    // adds [capacity, newCapacity) as free space
+    void grow(uint32_t newCapacity);
+    // free space that isn't the tail, which is what compaction gets back
+    uint32_t holes() const;
+  };
+
+  // ranges of a freed slot that a frame in flight may still be drawing
+  struct RetiredRange
+  {
+    GeometryRange range;
+    uint32_t frame;
+  };
+
+  MemoryAllocation vertexMemory;
+  MemoryAllocation indexMemory;
+  FreeList vertexRanges;
+  FreeList indexRanges;
+  std::vector<GeometryRange> slots;
+  std::vector<int> freeSlots;
+  std::vector<RetiredRange> retired;
+  uint32_t frame = 0;
+  uint32_t compactions = 0;
+
+  void growBuffer(VkBuffer &buffer, MemoryAllocation &memory, FreeList &ranges, uint32_t newCapacity, VkDeviceSize elementSize, VkBufferUsageFlags usage, UploadManager &uploads, VkDevice device, VkPhysicalDevice physicalDevice, VkQueue graphicsQueue);
+};
@@ -0,0 +1,134 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <cstdint>
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+// a range of device memory handed out by MemoryAllocator, default constructed means nothing is allocated
+struct ENGINE_API MemoryAllocation
+{
+  VkDeviceMemory memory = VK_NULL_HANDLE; // shared with other allocations unless dedicated
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  void *mapped = nullptr; // host visible memory stays mapped for as long as it's allocated
+  uint32_t pool = 0;
+  uint32_t block = 0;
+  uint32_t range = 0;
+  bool dedicated = false;
+};
+
+struct ENGINE_API MemoryAllocatorStats
+{
+  uint32_t blockCount = 0;
+  uint32_t dedicatedCount = 0;
+  uint32_t allocationCount = 0;
+  VkDeviceSize blockBytes = 0;
+  VkDeviceSize dedicatedBytes = 0;
+  VkDeviceSize usedBytes = 0; // inside blocks, dedicated allocations are always fully used
+  VkDeviceSize freeBytes = 0;
+  VkDeviceSize largestFreeRange = 0;
+
+  // 0 when all free memory is one range, close to 1 when it's scattered in small pieces
+  float fragmentation() const;
+};
+
+// grabs large blocks of device memory per memory type and suballocates them with TLSF
+// buffers and images go through here instead of calling vkAllocateMemory each, which keeps far below maxMemoryAllocationCount
+class ENGINE_API MemoryAllocator
+{
+public:
+  static constexpr VkDeviceSize BLOCK_SIZE = 64ull * 1024 * 1024;
+
+  // one device per process, so there is one allocator shared by every manager
+  static MemoryAllocator &get();
+
+  void allocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryAllocation &allocation, VkDevice device, VkPhysicalDevice physicalDevice);
+  void allocateImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, MemoryAllocation &allocation, VkDevice device, VkPhysicalDevice physicalDevice);
+  // resets the allocation, does nothing for one that was never allocated
+  void free(MemoryAllocation &allocation, VkDevice device);
+
+  MemoryAllocatorStats getStats();
+  // frees every block, anything still allocated becomes invalid
+  void cleanup(VkDevice device);
+
+private:
+  // TLSF: free ranges are kept in lists by size class, first level is the power of two and second level splits it in SECOND_LEVEL_COUNT
+  static constexpr uint32_t SECOND_LEVEL_BITS = 4;
+  static constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_BITS;
+  static constexpr uint32_t FIRST_LEVEL_COUNT = 40;
+  static constexpr VkDeviceSize SMALL_SIZE = 256; // everything below shares first level 0
+  static constexpr uint32_t NO_RANGE = UINT32_MAX;
+
+  struct Range
+  {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    uint32_t prevPhysical;
+    uint32_t nextPhysical;
+    uint32_t prevFree;
+    uint32_t nextFree;
+    bool free;
+  };
+
+  struct Block
+  {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    void *mapped = nullptr;
+    VkDeviceSize size = 0;
+    VkDeviceSize used = 0;
+    uint32_t allocationCount = 0;
+    std::vector<Range> ranges;
+    std::vector<uint32_t> unusedRanges;
+    uint64_t firstLevelBitmap = 0;
+    std::array<uint32_t, FIRST_LEVEL_COUNT> secondLevelBitmaps{};
+    std::array<uint32_t, FIRST_LEVEL_COUNT * SECOND_LEVEL_COUNT> freeHeads{};
+  };
+
+  // one per memory type and resource kind, optimal images get their own pools so bufferImageGranularity never applies between neighbours
+  struct Pool
+  {
+    uint32_t memoryType = 0;
+    std::vector<Block> blocks;
+  };
+
+  struct DedicatedAllocation
+  {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+  };
+
+  std::mutex mutex;
+  bool initialized = false;
+  VkPhysicalDeviceMemoryProperties memoryProperties{};
+  VkDeviceSize bufferImageGranularity = 1;
+  std::array<Pool, VK_MAX_MEMORY_TYPES * 2> pools;
+  std::vector<DedicatedAllocation> dedicatedAllocations;
+
+  void init(VkPhysicalDevice physicalDevice);
+  void allocate(const VkMemoryRequirements &requirements, bool prefersDedicated, bool optimalImage, VkBuffer buffer, VkImage image, VkMemoryPropertyFlags properties, MemoryAllocation &allocation, VkDevice device, VkPhysicalDevice physicalDevice);
+  void allocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryType, VkBuffer buffer, VkImage image, MemoryAllocation &allocation, VkDevice device);
+  VkDeviceSize blockSizeFor(uint32_t memoryType) const;
+
+  static bool createBlock(Block &block, VkDeviceSize size, uint32_t memoryType, bool hostVisible, VkDevice device);
+  static bool allocateFromBlock(Block &block, VkDeviceSize size, VkDeviceSize alignment, uint32_t &rangeIndex);
+  static void freeFromBlock(Block &block, uint32_t rangeIndex);
+  static uint32_t newRange(Block &block);
+  static void insertFree(Block &block, uint32_t rangeIndex);
+  static void removeFree(Block &block, uint32_t rangeIndex);
+  static void mapping(VkDeviceSize size, uint32_t &firstLevel, uint32_t &secondLevel);
+};
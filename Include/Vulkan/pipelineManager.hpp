@@ -4,6 +4,8 @@
 #include <glm/glm.hpp>
 #include <vector>
 #include <string>
+#include <mutex>
+#include <unordered_map>
 
 #ifdef BUILD_ENGINE_DLL
 
@@ -24,21 +26,43 @@ class DescriptorManager;
 class ENGINE_API PipelineManager
 {
 public:
+  // compiled pipelines of earlier runs, read from pipelineCachePath by createPipelineCache and written back by cleanup
+  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+  std::string pipelineCachePath = "pipelineCache.bin";
+
   VkRenderPass renderPass;
   VkRenderPass offscreenRenderPass;
   VkRenderPass colorIDRenderPass;
+  // depth only, last frame's visible meshes are drawn into it before the depth pyramid is built
+  VkRenderPass occlusionRenderPass;
 
   VkPipelineLayout pipelineLayout;
   VkPipelineLayout animPipelineLayout;
   VkPipeline graphicsPipeline;
   VkPipeline animationPipeline;
   VkPipeline graphicsParticlePipeline;
+  // bindless static meshes, set 0 is the texture array
+  VkPipelineLayout meshPipelineLayout;
+  // the permutation with every material feature, which still tests the material's flags, for draws whose materials differ
+  // the others come from getMeshPipeline
+  VkPipeline meshPipeline;
+  // meshPipeline's vertex stage without a fragment stage, for the occlusion render pass
+  VkPipeline occluderPipeline;
 
   VkPipelineLayout colorIDPipelineLayout;
   VkPipeline colorIDPipeline;
 
   VkPipelineLayout computePipelineLayout;
   VkPipeline computePipeline;
+  // frustum culls the opaque mesh instances and writes the indirect draws, see shaders/cull.comp
+  VkPipelineLayout cullPipelineLayout;
+  VkPipeline cullPipeline;
+  // reduces one level of the depth pyramid, see shaders/depthPyramid.comp
+  VkPipelineLayout depthPyramidPipelineLayout;
+  VkPipeline depthPyramidPipeline;
+
+  VkPipelineLayout debugPipelineLayout;
+  VkPipeline debugPipeline;
 
   SwapchainManager &swapchainManager;
   DescriptorManager &descriptorManager;
@@ -54,12 +78,49 @@ public:
   void createOffScreenRenderPass(VkDevice device, VkPhysicalDevice physicalDevice);
   void createRenderPass(VkDevice device, VkPhysicalDevice physicalDevice);
   void createColorIDRenderPass(VkDevice device, VkPhysicalDevice physicalDevice);
+  void createOcclusionRenderPass(VkDevice device, VkPhysicalDevice physicalDevice);
+  // before any pipeline, the file is only used when it was written for this device and driver version
+  void createPipelineCache(VkDevice device, VkPhysicalDevice physicalDevice);
+  // the graphics, mesh, colorID, debug, compute and cull pipelines, each on its own thread, after the render passes and descriptor set layouts
+  void createPipelines(VkDevice device);
   void createGraphicsPipeline(VkDevice device);
+  // the mesh pipeline layout, meshPipeline and the occluder pipeline
+  void createMeshPipeline(VkDevice device);
+  // the mesh pipeline specialized on the material features (see materialFeatures), created on first use and kept
+  // called while recording, from any thread
+  VkPipeline getMeshPipeline(VkDevice device, uint32_t features);
+  uint32_t meshPermutationCount();
   void createColorIDPipeline(VkDevice device);
   void createComputePipeline(VkDevice device);
+  // also creates the depth pyramid pipeline
+  void createCullPipeline(VkDevice device);
+  void createDebugPipeline(VkDevice device);
+  // also writes the pipeline cache back
   void cleanup(VkDevice device);
 
 private:
+  // what the cache file was written for, the driver's data follows the header
+  struct PipelineCacheFileHeader
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    // of the data, a file cut short or damaged is not handed to the driver
+    uint64_t dataHash;
+  };
+  PipelineCacheFileHeader cacheFileHeader{};
+
+  void savePipelineCache(VkDevice device);
+
+  VkShaderModule meshVertShaderModule = VK_NULL_HANDLE;
+  VkShaderModule meshFragShaderModule = VK_NULL_HANDLE;
+  std::unordered_map<uint32_t, VkPipeline> meshVariants;
+  std::mutex meshVariantMutex;
+  VkPipeline createMeshVariant(VkDevice device, uint32_t features, bool occluder);
   static std::vector<char> readFile(const std::string &filename);
   static VkShaderModule createShaderModule(const std::vector<char> &code, VkDevice device);
 };
\ No newline at end of file
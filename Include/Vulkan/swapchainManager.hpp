@@ -4,6 +4,7 @@
 #include <memory>
 #include <stdexcept>
 #include <GLFW/glfw3.h>
+#include "memoryAllocator.hpp"
 
 #ifdef BUILD_ENGINE_DLL
 
@@ -31,7 +32,7 @@ public:
   std::vector<VkImageView> swapChainImageViews;
   std::vector<VkFramebuffer> swapChainFramebuffers;
   VkImage depthImage;
-  VkDeviceMemory depthImageMemory;
+  MemoryAllocation depthImageMemory;
   VkImageView depthImageView;
 
   SwapchainManager(GLFWwindow *window) : window(window)
@@ -0,0 +1,108 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include "memoryAllocator.hpp"
+#include "textureManager.hpp"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+class Renderer;
+
+struct ENGINE_API TextureCacheStats
+{
+  // textures alive, the defaults included
+  uint32_t textures = 0;
+  // maps pointed at a texture that was loaded already
+  uint64_t hits = 0;
+  // files read and decoded or handed to the streamer
+  uint64_t loads = 0;
+};
+
+// a map showing a cached texture
+struct ENGINE_API TextureUser
+{
+  TextureManager *owner;
+  TextureMapType map;
+};
+
+// one image shared by every map showing the same file content as the same format
+struct ENGINE_API CachedTexture
+{
+  // empty for the defaults
+  std::string path;
+  // what the maps sample it as, the image itself may be block compressed
+  VkFormat mapFormat;
+  bool streamed = false;
+
+  VkImage image = VK_NULL_HANDLE;
+  MemoryAllocation memory;
+  VkImageView view = VK_NULL_HANDLE;
+  VkFormat format;
+  uint32_t mipLevels = 1;
+  uint64_t uploadTicket = 0;
+
+  std::vector<TextureUser> users;
+  // every lookup key leading here, dropped with the texture
+  std::vector<std::string> keys;
+};
+
+// textures of every TextureManager, keyed by file path and by content size and hash so the same file under another name is shared as well
+// a content match is only shared once the file it was loaded from reads back byte for byte the same
+// streamed textures are only keyed by path, reading and hashing them here would put the disk back on the main thread
+// a texture is destroyed with the last map showing it, the white 1x1 defaults NO_IMAGE maps get are created at init and live until cleanup
+// all maps sample through one sampler owned here
+class ENGINE_API TextureCache
+{
+public:
+  TextureCacheStats stats;
+
+  TextureCache() = default;
+  TextureCache(const TextureCache &) = delete;
+  TextureCache &operator=(const TextureCache &) = delete;
+
+  // after the upload manager and the texture streamer
+  void init(Renderer &renderer);
+  VkSampler sampler() const
+  {
+    return sharedSampler;
+  }
+
+  // points the map of owner at the texture of path, loading it unless the same content was loaded for the map's format already
+  // streamed textures start as the placeholder and are handed to the renderer's texture streamer, without touching the file
+  void acquire(TextureManager &owner, TextureMapType map, const std::string &path, bool streamed);
+  // the caller makes sure the GPU is done with the texture when this was its last map
+  void release(TextureManager &owner, TextureMapType map);
+  // writes the image and view of texture into every map showing it, after the streamer replaced them
+  void updateUsers(CachedTexture &texture);
+
+  void cleanup(VkDevice device);
+
+private:
+  Renderer *renderer = nullptr;
+  VkSampler sharedSampler = VK_NULL_HANDLE;
+  std::vector<std::unique_ptr<CachedTexture>> textures;
+  std::unordered_map<std::string, CachedTexture *> lookup;
+  std::vector<CachedTexture *> defaults;
+
+  CachedTexture &createDefault(VkFormat format);
+  CachedTexture *createLoaded(const std::string &path, const std::vector<uint8_t> &file, VkFormat mapFormat);
+  CachedTexture *createStreamed(const std::string &path, VkFormat mapFormat);
+  void createView(CachedTexture &texture);
+  void destroy(CachedTexture &texture, VkDevice device);
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+// the block compressed formats the device samples from optimally tiled images
+// textures in the others are transcoded to 8 bit per channel on the CPU when they are loaded
+struct ENGINE_API CompressedFormatSupport
+{
+  bool bc1 = false;
+  bool bc3 = false;
+  bool bc5 = false;
+  bool bc7 = false;
+};
+
+// a decoded file and its whole mip chain, levels are stored back to back from the largest
+struct ENGINE_API DecodedTexture
+{
+  // the format the levels are stored in, block compressed when the file was and the device samples it
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t mipCount = 0;
+  std::vector<uint8_t> pixels;
+  // mipCount + 1 entries, the last one is the end of the chain
+  std::vector<VkDeviceSize> offsets;
+};
+
+ENGINE_API CompressedFormatSupport queryCompressedFormatSupport(VkPhysicalDevice physicalDevice, bool textureCompressionBC);
+
+// bytes of one level, whole 4x4 blocks for the block compressed formats
+ENGINE_API VkDeviceSize textureLevelSize(VkFormat format, uint32_t width, uint32_t height);
+ENGINE_API bool isBlockCompressed(VkFormat format);
+
+// format is what the map is sampled as (R8G8B8A8 SRGB or UNORM, or R8), BC files keep its color space
+// .dds and .ktx2 files holding BC1/BC3/BC5/BC7 keep their own mips, everything else goes through stb_image and is box filtered down to 1x1
+// unless mipChain is false, returns null when the file can't be read
+ENGINE_API std::shared_ptr<DecodedTexture> loadTexture(const std::string &path, VkFormat format, const CompressedFormatSupport &support, bool mipChain = true);
+// the same for a file that was read already, path only picks the container by its extension
+ENGINE_API std::shared_ptr<DecodedTexture> loadTexture(const std::string &path, const std::vector<uint8_t> &file, VkFormat format, const CompressedFormatSupport &support, bool mipChain = true);
+ENGINE_API bool readTextureFile(const std::string &path, std::vector<uint8_t> &file);
+
+// copies of the levels from firstMip on into an image whose first level is firstMip, buffer offsets are relative to that level's
+ENGINE_API std::vector<VkBufferImageCopy> textureCopyRegions(const DecodedTexture &texture, uint32_t firstMip = 0);
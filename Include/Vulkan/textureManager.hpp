@@ -2,6 +2,7 @@
 #include <vulkan/vulkan.h>
 #include <memory>
 #include <vector>
+#include "memoryAllocator.hpp"
 
 #ifdef BUILD_ENGINE_DLL
 
@@ -19,50 +20,93 @@
 
 class BufferManager;
 class Renderer;
+struct CachedTexture;
 struct FT_Bitmap_;
 typedef FT_Bitmap_ FT_Bitmap;
+
+enum TextureMapType : uint32_t
+{
+  MapAlbedo,
+  MapNormal,
+  MapHeight,
+  MapRoughness,
+  MapMetallic,
+  MapAO,
+  MapEmissive,
+  MapCount
+};
+
+// the handles of one map, pointing into its TextureManager
+struct ENGINE_API TextureMapHandles
+{
+  VkImage *image;
+  MemoryAllocation *memory;
+  VkImageView *view;
+  VkSampler *sampler;
+};
+
 class ENGINE_API TextureManager
 {
 public:
   VkImage albedoImage;
-  VkDeviceMemory albedoImageMemory;
+  MemoryAllocation albedoImageMemory;
   VkImageView albedoImageView;
   VkSampler albedoSampler;
 
   VkImage normalImage;
-  VkDeviceMemory normalImageMemory;
+  MemoryAllocation normalImageMemory;
   VkImageView normalImageView;
   VkSampler normalSampler;
 
   VkImage heightImage;
-  VkDeviceMemory heightImageMemory;
+  MemoryAllocation heightImageMemory;
   VkImageView heightImageView;
   VkSampler heightSampler;
 
   VkImage roughnessImage;
-  VkDeviceMemory roughnessImageMemory;
+  MemoryAllocation roughnessImageMemory;
   VkImageView roughnessImageView;
   VkSampler roughnessSampler;
 
   VkImage metallicImage;
-  VkDeviceMemory metallicImageMemory;
+  MemoryAllocation metallicImageMemory;
   VkImageView metallicImageView;
   VkSampler metallicSampler;
 
   VkImage aoImage;
-  VkDeviceMemory aoImageMemory;
+  MemoryAllocation aoImageMemory;
   VkImageView aoImageView;
   VkSampler aoSampler;
 
   VkImage emissiveImage;
-  VkDeviceMemory emissiveImageMemory;
+  MemoryAllocation emissiveImageMemory;
   VkImageView emissiveImageView;
   VkSampler emissiveSampler;
 
+  // the last upload writing any of the images, they may be sampled once the upload manager completed it
+  uint64_t uploadTicket = 0;
+  // largest size in pixels a mesh using the maps was drawn at this frame, read and reset by the texture streamer
+  float streamPixels = 0.0f;
+  // what each map's image holds, the views are created with them
+  VkFormat formats[MapCount];
+  uint32_t mipLevels[MapCount];
+  // the renderer's texture cache entry a map borrows its image and view from, null for images of its own like glyph atlases
+  CachedTexture *cached[MapCount];
+
   BufferManager &bufferManager;
   Renderer &renderer;
   TextureManager(BufferManager &bufferManager, Renderer &renderer) : bufferManager(bufferManager), renderer(renderer)
   {
+    for (uint32_t i = 0; i < MapCount; i++)
+    {
+      formats[i] = mapFormat(static_cast<TextureMapType>(i));
+      mipLevels[i] = 1;
+      cached[i] = nullptr;
+      TextureMapHandles handles = mapHandles(static_cast<TextureMapType>(i));
+      *handles.image = VK_NULL_HANDLE;
+      *handles.view = VK_NULL_HANDLE;
+      *handles.sampler = VK_NULL_HANDLE;
+    }
   }
   ~TextureManager()
   {
@@ -70,11 +114,20 @@ public:
   void createTextureImageView(VkDevice device);
   void createTextTextureImageView(VkDevice device);
 
+  static VkFormat mapFormat(TextureMapType map);
+  TextureMapHandles mapHandles(TextureMapType map);
+
+  // maps come from the renderer's texture cache, NO_IMAGE maps get its default texture
   void createTextureImages(std::string albedoPath, std::string normalPath, std::string heightPath, std::string roughnessPath, std::string metallicPath, std::string aoPath, std::string emissivePath, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue);
-  void createTextureImage(std::string texturePath, VkImage &image, VkDeviceMemory &imageMemory, VkFormat format, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue);
+  // every map starts as the placeholder and is decoded and uploaded by the renderer's texture streamer, shared through the texture cache
+  // like loaded maps, NO_IMAGE maps get the cache's default texture
+  void streamTextureImages(std::string albedoPath, std::string normalPath, std::string heightPath, std::string roughnessPath, std::string metallicPath, std::string aoPath, std::string emissivePath, VkDevice device, VkPhysicalDevice physicalDevice);
+  // one map from the texture cache, loaded with its whole mip chain unless the same content is loaded already
+  void createTextureImage(std::string texturePath, TextureMapType map, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue);
   void createTextureImage(const FT_Bitmap &bitmap, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue);
   void createTextureImage(const std::vector<uint8_t> &textureData, int texWidth, int texHeight, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue);
 
+  // every map samples through the texture cache's sampler
   void createTextureSampler(VkDevice device, VkPhysicalDevice physicalDevice);
 
   void updateTexture(std::string newTexturePath, VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue);
@@ -0,0 +1,168 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "textureLoader.hpp"
+#include "memoryAllocator.hpp"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+class Renderer;
+struct CachedTexture;
+
+struct ENGINE_API TextureStreamStats
+{
+  uint32_t textures = 0;
+  // textures still showing the placeholder
+  uint32_t placeholders = 0;
+  uint32_t decoding = 0;
+  VkDeviceSize residentBytes = 0;
+  // mip levels given up to stay within the budget
+  uint64_t evictions = 0;
+};
+
+// decodes mesh textures on worker threads and keeps as many of their mips on the GPU as the screen size of the meshes using them asks for
+// a texture shows the placeholder until its smallest mips arrive, larger mips follow one level at a time, the textures missing the most
+// pixels first, and textures drawn small or not at all give mips back whenever the resident ones would not fit the budget
+// every change creates a new image with the resident levels, the texture's bindless slot and the maps showing it are pointed at it
+// once the upload finished
+class ENGINE_API TextureStreamer
+{
+public:
+  static constexpr uint32_t MAX_WORKERS = 3;
+  // levels up to this size go up first and are never evicted
+  static constexpr uint32_t TAIL_SIZE = 64;
+  // a texture no mesh was drawn with for this many frames only keeps its tail
+  static constexpr uint64_t UNUSED_FRAMES = 300;
+  // decoded pixels are dropped once the resident levels stayed the wanted ones this long
+  static constexpr uint64_t KEEP_DECODED_FRAMES = 120;
+  // bytes handed to the upload manager per frame
+  static constexpr VkDeviceSize FRAME_UPLOAD_BYTES = 32ull * 1024 * 1024;
+
+  // device memory the streamed images may take together
+  VkDeviceSize residentBudget = 512ull * 1024 * 1024;
+  TextureStreamStats stats;
+
+  TextureStreamer() = default;
+  ~TextureStreamer();
+
+  TextureStreamer(const TextureStreamer &) = delete;
+  TextureStreamer &operator=(const TextureStreamer &) = delete;
+
+  // decodes the placeholder and starts the workers, BC files in the formats support lacks are transcoded by the workers
+  void init(uint32_t framesInFlight, const CompressedFormatSupport &support);
+  // the placeholder pixels for a map of the format, 1 or 4 bytes per texel
+  const DecodedTexture &placeholder(VkFormat format) const;
+
+  // the texture cache entry has to hold the placeholder already, its image, view and bindless slot are replaced as mips arrive
+  void request(CachedTexture &texture);
+  // forgets the texture, the cache still destroys the image it holds
+  void release(CachedTexture &texture);
+
+  // once per frame after the frame's fence and after the draw packets were built
+  // uploadsCompleted is the ticket the frame's submit waits on, later uploads are swapped in by a later frame
+  void update(Renderer &renderer, uint64_t uploadsCompleted);
+  void cleanup(VkDevice device);
+
+private:
+  struct Request
+  {
+    uint64_t id;
+    CachedTexture *texture;
+    std::string path;
+    // the maps' format until the file was decoded, then the one the decoded levels are in
+    VkFormat format;
+
+    // 0 until the file was decoded once
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipCount = 0;
+    // first level of the file that is on the GPU, mipCount while the placeholder is shown
+    uint32_t residentMip = 0;
+    VkDeviceSize residentBytes = 0;
+    // what the screen size asks for, and the coarsest level the budget allows
+    uint32_t wantedMip = 0;
+    uint32_t budgetMip = 0;
+    float pixels = 0.0f;
+    uint64_t lastUsedFrame = 0;
+
+    bool decoding = false;
+    bool failed = false;
+    // kept for a while after the resident levels became the wanted ones, so a camera moving back and forth doesn't decode again
+    std::shared_ptr<DecodedTexture> decoded;
+    uint64_t settledFrame = 0;
+
+    // uploaded but not shown yet
+    VkImage pendingImage = VK_NULL_HANDLE;
+    MemoryAllocation pendingMemory;
+    uint32_t pendingMip = 0;
+    uint64_t pendingTicket = 0;
+  };
+
+  struct DecodeJob
+  {
+    uint64_t id;
+    std::string path;
+    VkFormat format;
+  };
+
+  struct DecodeResult
+  {
+    uint64_t id;
+    std::shared_ptr<DecodedTexture> texture; // null when the file could not be read
+  };
+
+  // destroyed once no frame in flight and no upload uses it anymore
+  struct RetiredImage
+  {
+    VkImage image;
+    MemoryAllocation memory;
+    VkImageView view;
+    uint64_t frame;
+    uint64_t ticket;
+  };
+
+  DecodedTexture placeholderColor;
+  DecodedTexture placeholderSingle;
+  CompressedFormatSupport support;
+  uint32_t framesInFlight = 2;
+  uint64_t frame = 0;
+  uint64_t nextId = 1;
+  std::vector<Request> requests;
+  std::vector<RetiredImage> retired;
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable jobReady;
+  std::deque<DecodeJob> jobs;
+  std::vector<DecodeResult> results;
+  bool quitting = false;
+
+  void workerLoop();
+  void stopWorkers();
+  void queueDecode(Request &request);
+  uint32_t tailMip(const Request &request) const;
+  // starts uploading levels from mip on into a new image
+  void uploadLevels(Renderer &renderer, Request &request, uint32_t mip);
+  // shows a finished upload in place of what the map showed before
+  void swapIn(Renderer &renderer, Request &request);
+  void retire(VkImage image, MemoryAllocation memory, VkImageView view, uint64_t ticket);
+};
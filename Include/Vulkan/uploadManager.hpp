@@ -0,0 +1,180 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include "memoryAllocator.hpp"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+struct ENGINE_API UploadStats
+{
+  uint64_t submits = 0;
+  uint64_t bytes = 0;
+  // ring bytes still waiting on the transfer queue
+  VkDeviceSize ringUsed = 0;
+  // uploads too large for the ring, staged in a buffer of their own
+  uint64_t dedicatedStaging = 0;
+  // times the ring was full and recording had to wait for the transfer queue
+  uint64_t stalls = 0;
+  // pipeline barriers recorded, an upload batch puts the layout transitions of all its images into two
+  uint64_t barriers = 0;
+};
+
+// copies into device local buffers and images on the transfer queue without waiting for it
+// sources are staged in one persistently mapped ring, every submit signals the next value of a timeline semaphore
+// and the ring space it used is handed out again once the semaphore has passed that value
+// an upload returns that value as its ticket, whatever it wrote may be used once completedValue() reached the ticket
+// and the frame reading it waits on the semaphore, ticket 0 is always complete
+class ENGINE_API UploadManager
+{
+public:
+  static constexpr VkDeviceSize RING_SIZE = 64ull * 1024 * 1024;
+
+  UploadStats stats;
+
+  UploadManager() = default;
+  UploadManager(const UploadManager &) = delete;
+  UploadManager &operator=(const UploadManager &) = delete;
+
+  // transferFamily is the graphics family on devices without a separate transfer queue
+  void init(VkDevice device, VkPhysicalDevice physicalDevice, VkQueue transferQueue, uint32_t transferFamily, uint32_t graphicsFamily);
+
+  // the data is copied into the ring before returning
+  uint64_t uploadBuffer(VkBuffer dst, VkDeviceSize offset, const void *data, VkDeviceSize size);
+  // fills mip 0 of a 2D color image that is still in UNDEFINED layout and leaves it in SHADER_READ_ONLY_OPTIMAL
+  uint64_t uploadImage(VkImage image, uint32_t width, uint32_t height, const void *data, VkDeviceSize size);
+  // the same for the first mipLevels levels, region buffer offsets are relative to data
+  uint64_t uploadImage(VkImage image, uint32_t mipLevels, const std::vector<VkBufferImageCopy> &regions, const void *data, VkDeviceSize size);
+  // device to device, ordered after every upload recorded before it
+  uint64_t copyBuffer(VkBuffer src, VkBuffer dst, const std::vector<VkBufferCopy> &regions);
+
+  // uploads between beginBatch and the matching endBatch are recorded together when the outermost batch ends
+  // the layout transitions of all their images share two barriers and copies into the same buffer share one command
+  // endBatch submits right away and returns the ticket covering everything in the batch, batches nest
+  void beginBatch();
+  uint64_t endBatch();
+
+  // submits everything recorded since the last flush, called once per frame by the renderer
+  void flush();
+  // highest ticket the transfer queue has finished, also gives back the ring space of finished submits
+  uint64_t completedValue();
+  bool isComplete(uint64_t ticket);
+  // flushes the ticket when it is still being recorded and blocks until the transfer queue finished it
+  void wait(uint64_t ticket);
+  void waitIdle();
+
+  // the queue families a resource written here and read by the graphics queue is shared between
+  // empty when uploads go through the graphics family, resources stay exclusive then
+  const std::vector<uint32_t> &sharedFamilies() const
+  {
+    return families;
+  }
+  VkSemaphore timelineSemaphore() const
+  {
+    return semaphore;
+  }
+  bool dedicatedQueue() const
+  {
+    return !families.empty();
+  }
+
+  void cleanup(VkDevice device);
+
+private:
+  struct StagingBuffer
+  {
+    VkBuffer buffer;
+    MemoryAllocation memory;
+  };
+
+  // one submit, reused once the semaphore passed its value
+  struct Batch
+  {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    uint64_t value = 0; // 0 once finished
+    VkDeviceSize ringBytes = 0;
+    std::vector<StagingBuffer> dedicated;
+  };
+
+  VkDevice device = VK_NULL_HANDLE;
+  VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+  VkQueue queue = VK_NULL_HANDLE;
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+  VkSemaphore semaphore = VK_NULL_HANDLE;
+  std::vector<uint32_t> families;
+
+  VkBuffer ringBuffer = VK_NULL_HANDLE;
+  MemoryAllocation ringMemory;
+  VkDeviceSize ringAlignment = 16;
+  VkDeviceSize ringHead = 0;
+  // bytes from the oldest unfinished submit up to the head, including the end skipped when wrapping
+  VkDeviceSize ringUsed = 0;
+
+  // staged in the ring already, recorded into the batch that holds their ring space
+  struct PendingBufferCopy
+  {
+    VkBuffer source;
+    VkBuffer dst;
+    VkBufferCopy region;
+  };
+  struct PendingImageCopy
+  {
+    VkBuffer source;
+    VkImage image;
+    uint32_t mipLevels;
+    std::vector<VkBufferImageCopy> regions;
+  };
+
+  std::vector<Batch> batches;
+  std::vector<PendingBufferCopy> pendingBuffers;
+  std::vector<PendingImageCopy> pendingImages;
+  uint32_t batchDepth = 0;
+  int recording = -1;
+  uint64_t nextValue = 1;
+  uint64_t completed = 0;
+
+  // uploads may come from loading threads, everything below expects it to be held
+  std::mutex mutex;
+
+  Batch &recordingBatch();
+  // copies data into the ring, or into a dedicated buffer when it doesn't fit, and returns where it went
+  VkDeviceSize stage(const void *data, VkDeviceSize size, VkBuffer &source);
+  void reclaim();
+  // records the pending copies, has to run before anything else is recorded or submitted
+  void recordPending();
+  void submit();
+  void waitValue(uint64_t value);
+};
+
+// keeps an upload batch open for the lifetime of the scope
+class ENGINE_API UploadBatch
+{
+public:
+  explicit UploadBatch(UploadManager &uploads) : uploads(uploads)
+  {
+    uploads.beginBatch();
+  }
+  ~UploadBatch()
+  {
+    uploads.endBatch();
+  }
+
+  UploadBatch(const UploadBatch &) = delete;
+  UploadBatch &operator=(const UploadBatch &) = delete;
+
+private:
+  UploadManager &uploads;
+};
@@ -27,6 +27,8 @@ public:
   std::vector<AnimatedVertex> vertices;
   std::vector<uint32_t> indices;
   int id;
+  // drawn once the transfer queue finished this upload of its indices and textures
+  uint64_t uploadTicket = 0;
 
   std::string texPath;
 
@@ -35,6 +37,5 @@ public:
 
   AnimatedMesh(Renderer &renderer, int *nextRenderingId, MaterialData material, const std::vector<AnimatedVertex> &vertices, const std::vector<uint32_t> &indices);
   void initGraphics(Renderer &renderer, std::string texturePath);
-  void draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, glm::mat4 view, glm::mat4 projectionMatrix, std::array<glm::mat4, 100> &finalBoneMatrices, VkCommandBuffer commandBuffer, int colorStageID);
   void cleanup(VkDevice device, Renderer &renderer);
 };
\ No newline at end of file
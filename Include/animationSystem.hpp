@@ -0,0 +1,35 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "components.hpp"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+class ECSRegistry;
+class ENGINE_API AnimationSystem
+{
+public:
+  ECSRegistry &registry;
+
+  AnimationSystem(ECSRegistry &registry) : registry(registry)
+  {
+  }
+
+  // samples every animation component at its own clock and rebuilds the bone matrices of skeletons that changed,
+  // runs on the CPU only so headless simulations animate the same way as windowed ones
+  void update(float deltaTime);
+
+  static glm::mat4 getLocalTransform(SkeletonComponent &skeleton, int nodeIndex);
+  static glm::mat4 getGlobalTransform(int nodeIndex, SkeletonComponent &skeleton, glm::mat4 startMatrix = glm::mat4(1.0f));
+};
@@ -41,7 +41,7 @@ public:
   Button(Renderer &renderer, int *nextRenderingId, const std::string &label, glm::vec3 position, std::array<glm::vec2, 2> verticesOffsets, std::string texture = NO_IMAGE);
   void initGraphics(Renderer &renderer) override;
   void initGraphics(Renderer &renderer, std::string texture);
-  void draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, glm::mat4 view, glm::mat4 projectionMatrix, VkCommandBuffer commandBuffer) override;
+  void draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, VkCommandBuffer commandBuffer) override;
   void updateState(float mouseX, float mouseY, bool mousePressed, ImVec2 sceneMin, ImVec2 sceneMax, float screenW, float screenH);
   void cleanup(VkDevice device, Renderer &renderer) override;
 
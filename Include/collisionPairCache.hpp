@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <glm/glm.hpp>
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+using Entity = uint32_t;
+
+struct ENGINE_API CollisionEvent
+{
+  Entity entityA;
+  Entity entityB;
+  glm::vec3 normal = glm::vec3(0.0f); // points from B towards A, zero for exit events
+};
+
+struct ENGINE_API CollisionPair
+{
+  enum SlotState : uint8_t
+  {
+    Empty,
+    Occupied,
+    Removed,
+  };
+
+  uint64_t key = 0;
+  SlotState slotState = Empty;
+
+  Entity entityA = 0; // always the smaller entity
+  Entity entityB = 0;
+
+  uint32_t lastVisitedStep = 0;
+  bool touching = false;
+  bool isTrigger = false;
+
+  // axis that separated the pair last time SAT ran, tested first next time
+  bool hasSeparatingAxis = false;
+  glm::vec3 separatingAxis = glm::vec3(0.0f);
+  glm::vec3 normal = glm::vec3(0.0f);
+};
+
+// open addressing hash map keyed by ordered entity pairs, persists between physics steps
+class ENGINE_API CollisionPairCache
+{
+public:
+  std::vector<CollisionPair> entries;
+  uint32_t step = 0;
+
+  CollisionPairCache()
+  {
+    entries.resize(64);
+  }
+
+  static uint64_t makeKey(Entity a, Entity b)
+  {
+    if (a > b)
+      std::swap(a, b);
+    return (static_cast<uint64_t>(a) << 32) | b;
+  }
+
+  void beginStep()
+  {
+    step++;
+  }
+
+  CollisionPair *find(Entity a, Entity b);
+  CollisionPair &findOrInsert(Entity a, Entity b);
+  void erase(CollisionPair &pair);
+  void clear();
+
+  size_t size() const
+  {
+    return count;
+  }
+
+private:
+  size_t count = 0;
+  size_t removedCount = 0;
+
+  static size_t hash(uint64_t key);
+  void grow();
+};
@@ -25,6 +25,13 @@ struct ENGINE_API TransformComponent
   glm::vec3 rotationZYX;
   glm::vec3 scale = glm::vec3(1.0f);
   bool justUpdated = true;
+  uint32_t version = 1; // bumped on every change so colliders only refit when this differs from what they last saw
+
+  void markUpdated()
+  {
+    justUpdated = true;
+    version++;
+  }
 };
 
 struct ENGINE_API PointLightComponent
@@ -115,11 +122,28 @@ struct ENGINE_API BoxColliderComponent
 
   bool autoUpdate = false;
 
+  bool isTrigger = false; // reports overlaps through the trigger events but is never pushed out
+
   // serialization stuff
   glm::vec3 position;
   glm::vec3 rotationZYX;
   glm::vec3 scale;
 
+  // cached so refits don't rebuild the quaternion unless the rotation actually changed
+  glm::mat3 rotationMatrix = glm::mat3(1.0f);
+  glm::vec3 cachedRotationZYX = glm::vec3(0.0f);
+  uint32_t transformVersion = 0;
+
+  const glm::mat3 &getRotationMatrix(const glm::vec3 &rotationZYXIn)
+  {
+    if (rotationZYXIn != cachedRotationZYX)
+    {
+      cachedRotationZYX = rotationZYXIn;
+      rotationMatrix = glm::mat3_cast(glm::quat(glm::radians(rotationZYXIn)));
+    }
+    return rotationMatrix;
+  }
+
   void updateWorldAABB(const glm::vec3 &positionIn, const glm::vec3 &rotationZYXIn, const glm::vec3 &scaleIn)
   {
     position = positionIn;
@@ -127,32 +151,18 @@ struct ENGINE_API BoxColliderComponent
     scale = scaleIn;
 
     justUpdated = true;
-    glm::quat rotation = glm::quat(glm::radians(rotationZYX));
+    const glm::mat3 &rotation = getRotationMatrix(rotationZYX);
 
     glm::vec3 scaledMin = localMin * scale;
     glm::vec3 scaledMax = localMax * scale;
 
-    glm::vec3 corners[8] = {
-        glm::vec3(scaledMin.x, scaledMin.y, scaledMin.z),
-        glm::vec3(scaledMax.x, scaledMin.y, scaledMin.z),
-        glm::vec3(scaledMin.x, scaledMax.y, scaledMin.z),
-        glm::vec3(scaledMax.x, scaledMax.y, scaledMin.z),
-        glm::vec3(scaledMin.x, scaledMin.y, scaledMax.z),
-        glm::vec3(scaledMax.x, scaledMin.y, scaledMax.z),
-        glm::vec3(scaledMin.x, scaledMax.y, scaledMax.z),
-        glm::vec3(scaledMax.x, scaledMax.y, scaledMax.z)};
-
-    worldMin = glm::vec3(FLT_MAX);
-    worldMax = glm::vec3(-FLT_MAX);
-
-    for (const auto &corner : corners)
-    {
-      glm::vec3 rotatedCorner = rotation * corner;
-      glm::vec3 worldCorner = rotatedCorner + position;
+    // the world AABB of a rotated box is center +- |R| * halfExtents, same result as rotating all 8 corners
+    glm::vec3 center = rotation * ((scaledMin + scaledMax) * 0.5f) + position;
+    glm::mat3 absRotation(glm::abs(rotation[0]), glm::abs(rotation[1]), glm::abs(rotation[2]));
+    glm::vec3 extents = absRotation * glm::abs((scaledMax - scaledMin) * 0.5f);
 
-      worldMin = glm::min(worldMin, worldCorner);
-      worldMax = glm::max(worldMax, worldCorner);
-    }
+    worldMin = center - extents;
+    worldMax = center + extents;
   }
 
   std::vector<glm::vec3> getWorldCorners(const glm::vec3 &position, const glm::vec3 &rotationZYX, const glm::vec3 &scale) const
@@ -237,6 +247,6 @@ struct ENGINE_API RigidBodyComponent
     if (isStatic)
       return;
     transform.position += velocity * deltaTime;
-    transform.justUpdated = true;
+    transform.markUpdated();
   }
 };
\ No newline at end of file
@@ -2,9 +2,13 @@
 
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include "vertex.h"
-#include "textureManager.hpp"
+#include "memoryAllocator.hpp"
 
 #ifdef BUILD_ENGINE_DLL
 
@@ -20,29 +24,87 @@
 
 #endif
 
+// must match the shape branches and vertex counts in shaders/debug.vert
+enum DebugShape
+{
+  DebugLine,
+  DebugBox,
+  DebugSphere,
+};
+
+const uint32_t DEBUG_LINE_VERTICES = 2;
+const uint32_t DEBUG_BOX_VERTICES = 24;          // 12 edges
+const uint32_t DEBUG_SPHERE_VERTICES = 3 * 24 * 2; // 3 great circles of 24 segments
+
+struct ENGINE_API DebugPushConstants
+{
+  glm::mat4 viewProj;
+  int shape;
+};
+
 class Renderer;
 class ENGINE_API VulkanDebugDrawer
 {
 public:
-  std::vector<Vertex> debugLines;
   int debugMode;
   Renderer &renderer;
-  const int buffersIndex;
-  TextureManager textureManager;
 
-  VulkanDebugDrawer(Renderer &renderer, int &buffersIndex, bool debug);
+  // immediate mode, filled by the draw calls every frame and copied into the frame's instance buffer when recorded
+  std::vector<DebugInstance> lines;
+  std::vector<DebugInstance> boxes;
+  std::vector<DebugInstance> spheres;
+
+  VulkanDebugDrawer(Renderer &renderer, bool debug);
 
-  void drawDebugLines(VkCommandBuffer commandBuffer, const std::vector<Vertex> &lines, glm::mat4 viewMatrix, glm::mat4 projectionMatrix, int currentFrame);
+  void drawDebugGeometry(VkCommandBuffer commandBuffer, glm::mat4 viewMatrix, glm::mat4 projectionMatrix, int currentFrame);
+  void cleanup(VkDevice device);
 
   void drawLine(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &color)
   {
-    debugLines.push_back({from, color});
-    debugLines.push_back({to, color});
+    lines.push_back({from, packColor(color), to, 0, glm::vec4(0, 0, 0, 1)});
+  }
+
+  void drawAABB(const glm::vec3 &min, const glm::vec3 &max, const glm::vec3 &color)
+  {
+    boxes.push_back({(min + max) * 0.5f, packColor(color), (max - min) * 0.5f, 0, glm::vec4(0, 0, 0, 1)});
+  }
+
+  void drawOBB(const glm::vec3 &center, const glm::vec3 &halfExtents, const glm::quat &rotation, const glm::vec3 &color)
+  {
+    boxes.push_back({center, packColor(color), halfExtents, 0, glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w)});
+  }
+
+  void drawSphere(const glm::vec3 &center, float radius, const glm::vec3 &color)
+  {
+    spheres.push_back({center, packColor(color), glm::vec3(radius), 0, glm::vec4(0, 0, 0, 1)});
+  }
+
+  void drawArrow(const glm::vec3 &from, const glm::vec3 &to, const glm::vec3 &color)
+  {
+    glm::vec3 direction = to - from;
+    float length = glm::length(direction);
+    if (length < 1e-6f)
+      return;
+    direction /= length;
+
+    glm::vec3 up = std::abs(direction.y) < 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+    glm::vec3 side = glm::normalize(glm::cross(direction, up));
+    up = glm::cross(side, direction);
+
+    float headLength = length * 0.2f;
+    glm::vec3 headBase = to - direction * headLength;
+    float headWidth = headLength * 0.5f;
+
+    drawLine(from, to, color);
+    drawLine(to, headBase + side * headWidth, color);
+    drawLine(to, headBase - side * headWidth, color);
+    drawLine(to, headBase + up * headWidth, color);
+    drawLine(to, headBase - up * headWidth, color);
   }
 
   void drawContactPoint(const glm::vec3 &pointOnB, const glm::vec3 &normalOnB, float distance, int lifeTime, const glm::vec3 &color)
   {
-    drawLine(pointOnB, pointOnB + glm::vec3(normalOnB.x * distance * 5, normalOnB.y * distance * 5, normalOnB.z * distance * 5), color);
+    drawArrow(pointOnB, pointOnB + normalOnB * distance * 5.0f, color);
   }
 
   void reportErrorWarning(const char *warningString)
@@ -60,8 +122,28 @@ public:
     return debugMode;
   }
 
-  void clearLines()
+  void clear()
+  {
+    lines.clear();
+    boxes.clear();
+    spheres.clear();
+  }
+
+private:
+  // one persistently mapped instance buffer per frame in flight, only touched after that frame's fence was waited on
+  std::vector<VkBuffer> instanceBuffers;
+  std::vector<MemoryAllocation> instanceBuffersMemory;
+  std::vector<void *> instanceBuffersMapped;
+  std::vector<size_t> instanceCapacities;
+
+  void reserveInstances(int frame, size_t count);
+
+  static uint32_t packColor(const glm::vec3 &color)
   {
-    debugLines.clear();
+    auto channel = [](float value)
+    {
+      return static_cast<uint32_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    };
+    return channel(color.r) | (channel(color.g) << 8) | (channel(color.b) << 16) | (255u << 24);
   }
-};
\ No newline at end of file
+};
@@ -0,0 +1,162 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "mesh.hpp"
+#include "utils.h"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+enum RenderStage
+{
+  MainRender,
+  ColorID, // for clicking and color picking
+};
+
+// top of the sort key, layers are drawn in this order
+enum DrawLayer : uint8_t
+{
+  LayerOpaque,
+  LayerTransparent, // depth is the only non zero field so these stay back to front
+  LayerUI,
+  LayerParticles,
+  LayerDebug,
+};
+
+// everything set when the pipeline bits of the key change: pipeline, topology, depth write and viewport
+enum DrawPipeline : uint8_t
+{
+  PipelineMesh,
+  PipelineAnimated,
+  PipelineUI,
+  PipelineParticles,
+  PipelineDebug,
+};
+
+// 64 bit sort key, most significant first
+// layer 4 | pipeline 4 | material 16 | mesh 20 | depth 20
+// static mesh packets keep their shader permutation in the material field, see materialFeatures
+const uint32_t DRAW_KEY_LAYER_SHIFT = 60;
+const uint32_t DRAW_KEY_PIPELINE_SHIFT = 56;
+const uint32_t DRAW_KEY_MATERIAL_SHIFT = 40;
+const uint32_t DRAW_KEY_MESH_SHIFT = 20;
+const uint32_t DRAW_KEY_MESH_BITS = 20;
+const uint32_t DRAW_KEY_DEPTH_BITS = 20;
+
+// plain data, built once per frame and executed for every render stage without touching the registry
+struct ENGINE_API DrawPacket
+{
+  uint64_t key;
+  int32_t renderingId;     // vertex/index buffers, descriptor sets and uniform buffers are indexed by it
+  uint32_t indexCount;
+  uint32_t firstIndex;     // relative to the mesh's geometry range, picks the LOD level of meshes
+  uint32_t transformIndex; // into DrawPacketList::transforms
+  uint32_t materialIndex;  // into DrawPacketList::materials
+  int32_t pickingId;       // written in the ColorID stage, -1 when the packet isn't pickable
+  void *object;            // local bounds for meshes, bone matrices for animated meshes, the UI/emitter/debug drawer for packets that draw themselves
+  int32_t geometryId;      // geometry arena slot for meshes, vertex/index buffer index for animated meshes
+  uint32_t firstInstance;  // range in DrawPacketList::instances, filled in by buildInstances
+  uint32_t instanceCount;
+
+  DrawLayer layer() const
+  {
+    return static_cast<DrawLayer>(key >> DRAW_KEY_LAYER_SHIFT);
+  }
+
+  DrawPipeline pipeline() const
+  {
+    return static_cast<DrawPipeline>((key >> DRAW_KEY_PIPELINE_SHIFT) & 0xF);
+  }
+
+  // the material features static meshes are drawn with
+  uint32_t permutation() const
+  {
+    return static_cast<uint32_t>((key >> DRAW_KEY_MATERIAL_SHIFT) & 0xFFFF);
+  }
+};
+
+class ENGINE_API DrawPacketList
+{
+public:
+  std::vector<DrawPacket> packets;
+  std::vector<glm::mat4> transforms;
+  std::vector<MaterialData> materials;
+  // bindless texture slots of each material, uploaded next to it in the material buffer
+  std::vector<MaterialTextures> materialTextures;
+  // uploaded to the frame's instance buffer, indexed by gl_InstanceIndex
+  std::vector<InstanceData> instances;
+
+  // set before the packets are pushed, opaque meshes are then culled by the GPU and drawn with a single indirect call
+  bool gpuCulling = false;
+  // filled by buildInstances when gpuCulling is set, the opaque mesh packets are the batches of the indirect call
+  std::vector<CullInstanceData> cullInstances;
+  uint32_t firstGpuBatch = 0;
+  uint32_t gpuBatchCount = 0;
+  // one past the highest visibilityIndex of cullInstances, the visibility flags have to cover it
+  uint32_t visibilitySlots = 0;
+
+  glm::mat4 view = glm::mat4(1.0f);
+  glm::mat4 proj = glm::mat4(1.0f);
+  glm::mat4 ortho = glm::mat4(1.0f);
+  glm::vec3 cameraPosition = glm::vec3(0.0f);
+  float farPlane = 1.0f;
+
+  // pixels one object space unit covers at a distance of one, meshes are drawn at full detail when it is 0
+  float lodScale = 0.0f;
+  // the same scale whether LODs are on or not, for the texture resolution meshes ask the streamer for
+  float pixelScale = 0.0f;
+  // how far in pixels a mesh LOD may be off from the full mesh
+  float lodPixelError = 1.0f;
+
+  // highest upload ticket the transfer queue has finished, meshes with a later ticket are skipped this frame
+  uint64_t uploadsCompleted = 0;
+
+  // clears last frame's packets but keeps the allocations
+  void begin(const glm::mat4 &view, const glm::mat4 &proj, const glm::mat4 &ortho, const glm::vec3 &cameraPosition, float farPlane);
+  void clear();
+
+  uint32_t addTransform(const glm::mat4 &transform);
+  // identical materials share an index so the executor can skip the push constant
+  // and the material buffer holds each combination of factors and textures once
+  uint32_t addMaterial(const MaterialData &material, const MaterialTextures &textures = MaterialTextures());
+
+  void add(const DrawPacket &packet)
+  {
+    packets.push_back(packet);
+  }
+
+  // distance to the camera quantized to the depth bits, far to near when backToFront is set
+  uint32_t quantizeDepth(const glm::vec3 &position, bool backToFront) const;
+
+  static uint64_t makeKey(DrawLayer layer, DrawPipeline pipeline, uint32_t material, uint32_t mesh, uint32_t depth)
+  {
+    return (static_cast<uint64_t>(layer & 0xF) << DRAW_KEY_LAYER_SHIFT) |
+           (static_cast<uint64_t>(pipeline & 0xF) << DRAW_KEY_PIPELINE_SHIFT) |
+           (static_cast<uint64_t>(material & 0xFFFF) << DRAW_KEY_MATERIAL_SHIFT) |
+           (static_cast<uint64_t>(mesh & ((1u << DRAW_KEY_MESH_BITS) - 1)) << DRAW_KEY_MESH_SHIFT) |
+           (depth & ((1u << DRAW_KEY_DEPTH_BITS) - 1));
+  }
+
+  // LSD radix sort on the key, stable so packets with equal keys keep submission order
+  void sort();
+  // call after sort, merges neighbouring mesh packets with the same geometry and shader permutation into one instanced packet
+  // the material is read per instance, so beyond its features it doesn't have to match
+  void buildInstances();
+
+private:
+  std::vector<DrawPacket> sortScratch;
+  std::unordered_map<uint64_t, uint32_t> materialLookup;
+};
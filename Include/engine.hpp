@@ -2,7 +2,7 @@
 #include "ParticleEmitter.hpp"
 #include "UI.hpp"
 #include "ECSRegistry.hpp"
-#include "physicsSystem.hpp"
+#include "world.hpp"
 #include "noImage.hpp"
 #include <memory>
 
@@ -30,6 +30,14 @@ enum DebugMode
 };
 #endif
 
+// used by initHeadless, every tick advances the simulation by fixedDeltaTime regardless of wall time
+struct ENGINE_API HeadlessSettings
+{
+  float fixedDeltaTime = 1.0f / 60.0f;
+  float tickRate = 0.0f; // ticks per wall clock second, 0 runs as fast as possible
+  uint64_t maxTicks = 0; // 0 runs until stop() is called
+};
+
 struct ENGINE_API Input
 {
   bool keys[GLFW_KEY_LAST] = {false};
@@ -48,24 +56,40 @@ public:
   uint32_t HEIGHT;
   Input input;
 
-  ECSRegistry registry;
+  // the engine simulates a single world, registry/physics/animations are kept as shortcuts into it
+  World world;
+  ECSRegistry &registry;
   std::unordered_map<std::string, std::unique_ptr<UI>> UIElements;
   std::unordered_map<std::string, tinygltf::Model> loadedModels;
   std::unordered_map<std::string, std::shared_ptr<TextureManager>> preloadedTextures;
 
   std::string selectedUI = "";
-  PhysicsSystem physics;
+  PhysicsSystem &physics;
+  AnimationSystem &animations;
 
   DebugMode debugMode;
 
-  Engine(uint32_t width = 1600, uint32_t height = 1200, DebugMode debugMode = DebugMode::Tools) : WIDTH(width), HEIGHT(height), debugMode(debugMode), camera(), renderer(camera, WIDTH, HEIGHT), registry(), physics(registry)
+  Engine(uint32_t width = 1600, uint32_t height = 1200, DebugMode debugMode = DebugMode::Tools) : WIDTH(width), HEIGHT(height), debugMode(debugMode), camera(), renderer(camera, WIDTH, HEIGHT), world(), registry(world.registry), physics(world.physics), animations(world.animations)
   {
   }
 
   void init(std::string windowName, std::function<void(Engine *)> startFn, std::function<void(Engine *, float)> updateFn);
+  // no window, swapchain or GPU, meshes only keep their CPU data and rendering is skipped
+  void initHeadless(std::function<void(Engine *)> startFn, std::function<void(Engine *, float)> updateFn, HeadlessSettings settings = HeadlessSettings());
   void run();
+  void stop();
   void shutdown();
 
+  bool isHeadless() const
+  {
+    return headless;
+  }
+
+  uint64_t getTickCount() const
+  {
+    return tickCount;
+  }
+
   void render();
 
   void clearHierarchy();
@@ -114,8 +138,10 @@ public:
   void createAnimatedModelFromFile(std::string baseName, std::string path, std::string texturesDir);
   void addEmptyMeshComponent(Entity entity);
   void addMeshComponent(Entity entity, MaterialData material, const std::string &texturePath, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
-  void addMeshComponent(Entity entity, const std::string objPath, const std::string mtlPath);
-  void addMeshToComponent(Entity entity, MaterialData material, const std::string &texturePath, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+  // builds the LODs of every shape unless cooked ones are passed in, one chain per shape in file order
+  void addMeshComponent(Entity entity, const std::string objPath, const std::string mtlPath, const std::vector<MeshLodChain> *cookedLods = nullptr);
+  // the mesh is simplified here unless a cooked chain is passed in
+  void addMeshToComponent(Entity entity, MaterialData material, const std::string &texturePath, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, const MeshLodChain *lods = nullptr);
   void addMeshToComponent(Entity entity, std::string textureAssetName, MaterialData material, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
   void removeMeshComponent(Entity entity);
   void addEmptyAnimatedMeshComponent(Entity entity);
@@ -153,9 +179,18 @@ private:
   std::function<void(Engine *)> start;
   std::vector<ParticleEmitter> particleEmitters;
   bool autoFreeCam = false;
+  bool headless = false;
+  HeadlessSettings headlessSettings;
+  uint64_t tickCount = 0;
+
+  // free cam mouse and zoom state, kept per engine instead of in function statics
+  bool freeCamFirstMouse = true;
+  double freeCamLastX = 0.0;
+  double freeCamLastY = 0.0;
+  float freeCamZoom = 45.0f;
 
   void initWindow(std::string windowName);
-  void updateBoxColliders();
+  void runHeadless();
 
   inline void transformComponentDisableJustUpdated(Entity entity)
   {
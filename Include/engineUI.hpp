@@ -18,6 +18,7 @@
 #include <imgui.h>
 #include <imgui_impl_vulkan.h>
 #include <imgui_impl_glfw.h>
+#include "memoryAllocator.hpp"
 class Renderer;
 class Engine;
 class ENGINE_API EngineUI
@@ -28,20 +29,20 @@ public:
 
   VkImage offscreenImage;
   VkImageView offscreenImageView;
-  VkDeviceMemory offscreenImageMemory;
+  MemoryAllocation offscreenImageMemory;
 
   VkImage offscreenDepthImage;
-  VkDeviceMemory offscreenDepthImageMemory;
+  MemoryAllocation offscreenDepthImageMemory;
   VkImageView offscreenDepthImageView;
 
   VkFramebuffer offscreenFramebuffer;
 
   VkImage colorIDImage;
   VkImageView colorIDImageView;
-  VkDeviceMemory colorIDImageMemory;
+  MemoryAllocation colorIDImageMemory;
 
   VkImage colorIDDepthImage;
-  VkDeviceMemory colorIDDepthImageMemory;
+  MemoryAllocation colorIDDepthImageMemory;
   VkImageView colorIDDepthImageView;
 
   VkFramebuffer colorIDFramebuffer;
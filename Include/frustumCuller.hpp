@@ -0,0 +1,106 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <glm/glm.hpp>
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+struct Vertex;
+
+// local space bounds of a mesh, computed once from its vertices
+struct ENGINE_API BoundingVolume
+{
+  glm::vec3 min = glm::vec3(0.0f);
+  glm::vec3 max = glm::vec3(0.0f);
+  // sphere around the box center, usually tighter than the box's corners
+  float radius = 0.0f;
+
+  static BoundingVolume fromVertices(const std::vector<Vertex> &vertices);
+
+  glm::vec3 center() const
+  {
+    return (min + max) * 0.5f;
+  }
+};
+
+struct ENGINE_API FrustumCullStats
+{
+  uint32_t tested = 0;
+  uint32_t visible = 0;
+  uint32_t culled = 0;
+  uint32_t threads = 0;
+};
+
+// culls world space boxes and spheres against the six planes of a view projection matrix
+// bounds are kept as structure of arrays so four of them are tested per SIMD iteration
+// large sets are split over a pool of workers that is started the first time it is needed and kept after
+class ENGINE_API FrustumCuller
+{
+public:
+  // below this many bounds the loop runs on the calling thread, waking the workers would cost more than it saves
+  static constexpr uint32_t PARALLEL_THRESHOLD = 32 * 1024;
+
+  FrustumCuller() = default;
+  ~FrustumCuller();
+
+  FrustumCuller(const FrustumCuller &) = delete;
+  FrustumCuller &operator=(const FrustumCuller &) = delete;
+
+  // one flag per added bounds, valid after cull()
+  std::vector<uint8_t> visible;
+
+  // extracts the planes and drops last frame's bounds, keeps the allocations
+  void begin(const glm::mat4 &viewProj);
+  // transforms the local bounds into world space, returns the index of the visibility flag
+  uint32_t add(const BoundingVolume &bounds, const glm::mat4 &world);
+  void cull();
+
+  const FrustumCullStats &getStats() const
+  {
+    return stats;
+  }
+
+private:
+  // xyz is the unit normal pointing into the frustum, w the distance from the origin
+  glm::vec4 planes[6];
+  // the box center is also the sphere center
+  std::vector<float> centerX, centerY, centerZ;
+  std::vector<float> extentX, extentY, extentZ;
+  std::vector<float> radius;
+  uint32_t count = 0;
+  FrustumCullStats stats;
+
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable workReady;
+  std::condition_variable workDone;
+  uint64_t generation = 0;
+  size_t activeWorkers = 0;
+  bool quitting = false;
+
+  // chunks of the current cull, handed out to the workers and the calling thread alike
+  std::atomic<uint32_t> nextChunk{0};
+  uint32_t jobChunk = 0;
+  uint32_t jobChunkCount = 0;
+  uint32_t jobPadded = 0;
+
+  void cullRange(uint32_t first, uint32_t last);
+  void cullChunks();
+  void workerLoop();
+};
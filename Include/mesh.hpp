@@ -3,6 +3,9 @@
 #include <vector>
 #include "vertex.h"
 #include "textureManager.hpp"
+#include "descriptorManager.hpp"
+#include "frustumCuller.hpp"
+#include "meshSimplifier.hpp"
 #include "noImage.hpp"
 #include <memory>
 
@@ -40,6 +43,32 @@ struct ENGINE_API MaterialData
 
   int isParticle = 0;
   int isSkybox = 0;
+  int isInstanced = 0; // model matrix comes from the instance buffer instead of the uniform buffer
+};
+
+// what the bindless mesh shader is specialized on, the bit index is the constant_id in shaders/mesh.frag
+enum MaterialFeature : uint32_t
+{
+  FeatureAlbedoMap = 1 << 0,
+  FeatureNormalMap = 1 << 1,
+  FeatureRoughnessMap = 1 << 2,
+  FeatureMetallicMap = 1 << 3,
+  FeatureAOMap = 1 << 4,
+  FeatureEmissiveMap = 1 << 5,
+  FeatureSkybox = 1 << 6,
+};
+const uint32_t MATERIAL_FEATURE_COUNT = 7;
+const uint32_t MATERIAL_FEATURES_ALL = (1u << MATERIAL_FEATURE_COUNT) - 1;
+
+// the mesh shader permutation a material is drawn with, untextured materials get 0 and only pay for the lighting
+ENGINE_API uint32_t materialFeatures(const MaterialData &material);
+
+// one entry of the material storage buffer read by the bindless mesh shaders, laid out for std430
+struct ENGINE_API BindlessMaterial
+{
+  MaterialData factors;
+  MaterialTextures textures;
+  uint32_t padding = 0;
 };
 
 class TextureManager;
@@ -50,6 +79,18 @@ public:
   std::vector<Vertex> vertices;
   std::vector<uint32_t> indices;
   int id;
+  // slot in the geometry arena, shared with meshes that uploaded identical geometry, -1 before initGraphics
+  int geometryId;
+  // drawn once the transfer queue finished this upload of its geometry and textures
+  uint64_t uploadTicket = 0;
+  // slots of the mesh's textures in the bindless texture array
+  MaterialTextures textures;
+  // local space, computed from the vertices when the mesh is created
+  BoundingVolume bounds;
+  // simplified levels uploaded right behind indices, empty for meshes too small to simplify
+  MeshLodChain lodChain;
+  // level drawn last frame, selection only moves off it past a margin so meshes don't flicker between levels
+  uint32_t lodLevel = 0;
 
   std::string texPath;
 
@@ -61,6 +102,17 @@ public:
   Mesh(Renderer &renderer, std::shared_ptr<TextureManager> texture, int *nextRenderingId, MaterialData newMaterial, const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
   void initGraphics(Renderer &renderer, std::string texturePath, std::string normalPath = NO_IMAGE, std::string heightPath = NO_IMAGE, std::string roughnessPath = NO_IMAGE, std::string metallicPath = NO_IMAGE, std::string aoPath = NO_IMAGE, std::string emissivePath = NO_IMAGE);
   void initGraphics(Renderer &renderer);
-  void draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, glm::mat4 view, glm::mat4 projectionMatrix, VkCommandBuffer commandBuffer, int colorStageID);
+  // both have to run before initGraphics uploads the geometry
+  void buildLods();
+  // takes a cooked chain, builds a new one when it doesn't fit the vertices
+  void setLods(const MeshLodChain &chain);
+  uint32_t lodCount() const
+  {
+    return static_cast<uint32_t>(lodChain.lods.size()) + 1;
+  }
   void cleanup(VkDevice device, Renderer &renderer);
+
+private:
+  // the full index list followed by every LOD level, what initGraphics uploads to the arena
+  std::vector<uint32_t> uploadedIndices() const;
 };
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "vertex.h"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+// simplified levels a mesh can have on top of its full index list
+const uint32_t MESH_MAX_LODS = 5;
+// below this many triangles a mesh is cheap enough at any distance
+const uint32_t MESH_LOD_MIN_TRIANGLES = 256;
+
+// one simplified level of a mesh
+struct ENGINE_API MeshLod
+{
+  // into the index list uploaded for the mesh, which is the full index list followed by every level's indices
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  // object space distance the simplified surface may be away from the full one, projected to pixels to pick a level
+  float error = 0.0f;
+};
+
+// the simplified levels of a mesh from fine to coarse, built when a model is imported and cooked into scene files
+struct ENGINE_API MeshLodChain
+{
+  std::vector<MeshLod> lods;
+  std::vector<uint32_t> indices;
+};
+
+// quadric error edge collapse, every level keeps about half the triangles of the one before it
+// vertices are only ever collapsed onto each other, so every level indexes the mesh's own vertex list
+// vertices on a UV or normal seam collapse together with every copy at their position, copies on the collapsed edge
+// follow it so the seam stays a seam and the others take the closest attributes at the target, at an extra cost
+// open borders are never collapsed, which keeps silhouettes intact
+ENGINE_API MeshLodChain buildMeshLods(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices, uint32_t maxLods = MESH_MAX_LODS);
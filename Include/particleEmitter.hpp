@@ -35,5 +35,5 @@ public:
 
   ParticleEmitter(Renderer &renderer, int *nextRenderingId, int particleCount, glm::vec3 pos, glm::quat rotation = glm::quatLookAt(glm::normalize(glm::vec3(0, 0, -1)), glm::vec3(0, 1, 0)), std::string texturePath = NO_IMAGE);
   void initGraphics(Renderer &renderer, std::string texturePath);
-  void draw(Renderer *renderer, int currentFrame, glm::mat4 view, glm::mat4 projectionMatrix, VkCommandBuffer commandBuffer);
+  void draw(Renderer *renderer, int currentFrame, VkCommandBuffer commandBuffer);
 };
\ No newline at end of file
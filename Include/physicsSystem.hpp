@@ -1,7 +1,10 @@
 #pragma once
 #include <vector>
+#include <functional>
 #include <glm/glm.hpp>
 #include "components.hpp"
+#include "collisionPairCache.hpp"
+#include "scratchArena.hpp"
 
 #ifdef BUILD_ENGINE_DLL
 
@@ -18,6 +21,24 @@
 #endif
 
 using Entity = uint32_t;
+
+// accumulated until resetStats(), timings are in milliseconds
+struct ENGINE_API PhysicsStats
+{
+  uint64_t steps = 0;
+  double integrateMs = 0.0;
+  double refitMs = 0.0;
+  double narrowPhaseMs = 0.0;
+  double pairSweepMs = 0.0;
+
+  uint64_t collidersRefit = 0;
+  uint64_t pairsTested = 0;
+  uint64_t aabbOverlaps = 0;
+  uint64_t satCalls = 0;
+  uint64_t satEarlyOuts = 0;
+  uint64_t contacts = 0;
+};
+
 class ECSRegistry;
 class VulkanDebugDrawer;
 class ENGINE_API PhysicsSystem
@@ -27,13 +48,52 @@ public:
   ECSRegistry &registry;
   VulkanDebugDrawer *debugDrawer = nullptr;
   bool doDebugDraw = false;
+
+  // filled after every step, pairs involving a trigger collider go to the trigger arrays and are never resolved
+  std::vector<CollisionEvent> collisionEnterEvents;
+  std::vector<CollisionEvent> collisionStayEvents;
+  std::vector<CollisionEvent> collisionExitEvents;
+  std::vector<CollisionEvent> triggerEnterEvents;
+  std::vector<CollisionEvent> triggerStayEvents;
+  std::vector<CollisionEvent> triggerExitEvents;
+
+  std::function<void(const std::vector<CollisionEvent> &)> onCollisionEnter;
+  std::function<void(const std::vector<CollisionEvent> &)> onCollisionStay;
+  std::function<void(const std::vector<CollisionEvent> &)> onCollisionExit;
+  std::function<void(const std::vector<CollisionEvent> &)> onTriggerEnter;
+  std::function<void(const std::vector<CollisionEvent> &)> onTriggerStay;
+  std::function<void(const std::vector<CollisionEvent> &)> onTriggerExit;
+
+  CollisionPairCache pairCache;
+  PhysicsStats stats;
   PhysicsSystem(ECSRegistry &registry) : registry(registry)
   {
   }
 
-  void update(float deltaTime);
+  // per step temporaries come out of scratch, which the caller resets between steps
+  void update(float deltaTime, ScratchArena &scratch);
+
+  // refits the world AABB of every autoUpdate collider whose transform version changed since its last refit
+  void refitBoxColliders(ScratchArena &scratch);
+
+  void resetStats()
+  {
+    stats = PhysicsStats();
+  }
 
 private:
+  // SoA arrays for refitBoxColliders, carved out of the step's scratch arena
+  struct ColliderRefitBatch
+  {
+    BoxColliderComponent **colliders;
+    float *centerX, *centerY, *centerZ;
+    float *halfX, *halfY, *halfZ;
+    float *r00, *r01, *r02, *r10, *r11, *r12, *r20, *r21, *r22;
+    float *minX, *minY, *minZ, *maxX, *maxY, *maxZ;
+
+    void allocate(ScratchArena &scratch, size_t count);
+  };
+
   void handleCollisions();
 
   bool AABBOverlap(const BoxColliderComponent &a, const BoxColliderComponent &b);
@@ -44,5 +104,8 @@ private:
   glm::vec3 removeVelocityAlongAxis(const glm::vec3 &velocity, const glm::vec3 &axis);
   glm::vec3 getAABBCollisionNormal(float overlapX, float overlapY, float overlapZ, glm::vec3 centerA, glm::vec3 centerB);
 
-  bool SATCollision(Entity entityA, Entity entityB, const BoxColliderComponent &a, const BoxColliderComponent &b, glm::vec3 &mtv, glm::vec3 &collisionNormal);
+  bool SATCollision(Entity entityA, Entity entityB, const BoxColliderComponent &a, const BoxColliderComponent &b, glm::vec3 &mtv, glm::vec3 &collisionNormal, CollisionPair *pair = nullptr);
+
+  void recordPairEvent(const CollisionPair &pair, bool wasTouching);
+  void dispatchCollisionEvents();
 };
\ No newline at end of file
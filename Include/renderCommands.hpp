@@ -1,10 +1,12 @@
 #ifndef RENDER_COMMANDS_H
 #define RENDER_COMMANDS_H
 
-#include <functional>
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
 #include "ECSRegistry.hpp"
+#include "drawPackets.hpp"
+#include "frustumCuller.hpp"
+#include "commandStateCache.hpp"
 #ifndef DEBUG_MODE
 #define DEBUG_MODE
 enum DebugMode
@@ -15,9 +17,6 @@ enum DebugMode
 };
 #endif
 
-#ifndef RENDER_COMMAND
-#define RENDER_COMMAND
-
 #ifdef BUILD_ENGINE_DLL
 
 #ifndef ENGINE_API
@@ -32,28 +31,27 @@ enum DebugMode
 
 #endif
 
-enum RenderStage
-{
-  MainRender,
-  ColorID, // for clicking and color picking
-};
-
-struct ENGINE_API RenderCommand
-{
-  std::function<void(VkCommandBuffer, RenderStage)> execute;
-};
-
-#endif
 struct Vertex;
+class BufferManager;
 class VulkanDebugDrawer;
 class ParticleEmitter;
 class Renderer;
 class UI;
 
-ENGINE_API RenderCommand makeGameObjectCommand(ECSRegistry &registry, Entity e, Renderer *renderer, int currentFrame, glm::mat4 view, glm::mat4 proj, DebugMode debugMode);
-ENGINE_API RenderCommand makeAnimatedGameObjectCommand(ECSRegistry &registry, Entity e, Renderer *renderer, int currentFrame, glm::mat4 view, glm::mat4 proj, DebugMode debugMode);
-ENGINE_API RenderCommand makeUICommand(UI *ui, Renderer *renderer, int currentFrame, glm::mat4 model, glm::mat4 ortho, DebugMode debugMode);
-ENGINE_API RenderCommand makeParticleCommand(ParticleEmitter *emitter, Renderer *renderer, int currentFrame, glm::mat4 view, glm::mat4 proj, DebugMode debugMode);
-ENGINE_API RenderCommand makeDebugCommand(VulkanDebugDrawer *drawer, Renderer *renderer, const std::vector<Vertex> &lines, glm::mat4 view, glm::mat4 proj, int currentFrame, DebugMode debugMode);
+// fill the frame's packet list, nothing is recorded until executeDrawPackets
+// culls every mesh in the registry against the list's view and projection before pushing it
+ENGINE_API void pushGameObjectPackets(DrawPacketList &list, ECSRegistry &registry, FrustumCuller &culler);
+ENGINE_API void pushAnimatedGameObjectPackets(DrawPacketList &list, ECSRegistry &registry, Entity e);
+ENGINE_API void pushUIPacket(DrawPacketList &list, UI *ui, glm::mat4 model);
+ENGINE_API void pushParticlePacket(DrawPacketList &list, ParticleEmitter *emitter);
+ENGINE_API void pushDebugPacket(DrawPacketList &list, VulkanDebugDrawer *drawer);
+
+// the size of the target the stage draws the scene into
+ENGINE_API VkExtent2D getSceneExtent(Renderer *renderer, RenderStage renderStage);
+// expects a sorted list, only binds state when the part of the key it depends on changes
+// records the packets in [first, last), the state cache starts out empty so any range can go into its own command buffer
+ENGINE_API void executeDrawPackets(Renderer *renderer, CommandStateCache &state, const DrawPacketList &list, RenderStage renderStage, int currentFrame, size_t first = 0, size_t last = SIZE_MAX);
+// upper bound of what executeDrawPackets pushes into the frame uniform ring, reserved before recording since the ring can't grow mid frame
+ENGINE_API VkDeviceSize frameUniformBytes(const BufferManager &buffers, const DrawPacketList &list);
 
 #endif
\ No newline at end of file
@@ -15,7 +15,14 @@
 #include "pipelineManager.hpp"
 #include "camera.h"
 #include "bufferManager.hpp"
+#include "commandStateCache.hpp"
+#include "commandRecorder.hpp"
+#include "textureStreamer.hpp"
+#include "textureCache.hpp"
+#include "depthPyramid.hpp"
 #include "mesh.hpp"
+#include "drawPackets.hpp"
+#include "frustumCuller.hpp"
 #include "vertex.h"
 #include <ft2build.h>
 #include <functional>
@@ -57,22 +64,6 @@ enum DebugMode
 };
 #endif
 
-#ifndef RENDER_COMMAND
-#define RENDER_COMMAND
-
-enum RenderStage
-{
-  MainRender,
-  ColorID, // for clicking and color picking
-};
-
-struct ENGINE_API RenderCommand
-{
-  std::function<void(VkCommandBuffer, RenderStage)> execute;
-};
-
-#endif
-
 class ENGINE_API Renderer
 {
 public:
@@ -98,8 +89,30 @@ public:
   VkQueue graphicsQueue;
   VkQueue presentQueue;
   VkQueue computeQueue;
-
-  std::vector<RenderCommand> renderQueue;
+  // the graphics queue when the device has no separate transfer family
+  VkQueue transferQueue;
+
+  // rebuilt and sorted by Engine::render every frame
+  DrawPacketList drawPackets;
+  // meshes outside the camera frustum never become draw packets
+  FrustumCuller frustumCuller;
+  // opaque meshes are culled by a compute pass and drawn indirectly, needs drawIndirectCount
+  bool gpuCulling = false;
+  // the culling pass also tests against a depth pyramid of last frame's visible meshes
+  bool occlusionCulling = true;
+  DepthPyramid depthPyramid;
+  // indirect draws the culling pass kept and drew as occluders, read back a couple of frames late
+  uint32_t gpuCulledDraws = 0;
+  uint32_t gpuOccluderDraws = 0;
+  // meshes far enough away are drawn with one of their simplified index lists
+  bool meshLods = true;
+  // screen space error in pixels a LOD level may show before a finer one is picked
+  float lodPixelError = 1.0f;
+  // mesh textures are decoded on worker threads and their mips streamed in, otherwise they are loaded whole when the mesh is created
+  bool textureStreaming = true;
+  TextureStreamer textureStreamer;
+  // the images, samplers and default textures every mesh map shares
+  TextureCache textureCache;
 
   uint32_t &WIDTH;
   uint32_t &HEIGHT;
@@ -118,6 +131,13 @@ public:
 
   VkCommandPool commandPool;
   std::vector<VkCommandBuffer> commandBuffers;
+
+  // tracks the primary command buffer being recorded, commandStats keeps the counters of the last recorded frame
+  CommandStateCache commandState;
+  CommandStateStats commandStats;
+  // draw packets are recorded into secondary command buffers on its worker threads
+  CommandRecorder commandRecorder;
+  double recordMilliseconds = 0.0;
   std::vector<VkCommandBuffer> computeCommandBuffers;
 
   std::vector<VkSemaphore> imageAvailableSemaphores;
@@ -130,6 +150,9 @@ public:
   bool framebufferResized = true;
 
   void drawFrame();
+  // closes the holes removed meshes leave in the geometry arena once enough space is lost to them
+  // waits for the device, so it belongs where a stall goes unnoticed like a scene load, not in drawFrame
+  void compactGeometry();
 
   void cleanup();
 
@@ -148,15 +171,20 @@ private:
   void createSyncObjects();
 
   void createCommandBuffer();
+  void updateFrameUniforms();
+  // recreates the depth pyramid and grows the visibility flags, waits for the device when either is in use
+  void prepareOcclusionCulling();
+  void recordCullPass(VkCommandBuffer commandBuffer);
+  void recordOccluderPass(VkCommandBuffer commandBuffer);
   void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
   void createCommandPool();
 
   void recordComputeCommandBuffer(VkCommandBuffer commandBuffer, uint32_t currentFrame);
 
   void beginCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
-  void beginOffscreenRenderPass(VkCommandBuffer commandBuffer);
-  void beginColorIDRenderPass(VkCommandBuffer commandBuffer);
-  void beginRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+  void beginOffscreenRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+  void beginColorIDRenderPass(VkCommandBuffer commandBuffer, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+  void beginRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
   void endCommandBuffer(VkCommandBuffer commandBuffer);
   void endRenderPass(VkCommandBuffer commandBuffer);
 };
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+// bump allocator for per step temporaries, reset before every world step so nothing is freed individually
+class ENGINE_API ScratchArena
+{
+public:
+  explicit ScratchArena(size_t capacity = 1 << 20);
+
+  ScratchArena(const ScratchArena &) = delete;
+  ScratchArena &operator=(const ScratchArena &) = delete;
+  ScratchArena(ScratchArena &&) = default;
+  ScratchArena &operator=(ScratchArena &&) = default;
+
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+  template <typename T>
+  T *allocateArray(size_t count)
+  {
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  // overflow blocks from the last step are folded into one bigger buffer so the next step doesn't overflow again
+  void reset();
+
+  size_t used() const
+  {
+    return offset + overflowBytes;
+  }
+
+  size_t capacity() const
+  {
+    return bufferSize;
+  }
+
+private:
+  std::unique_ptr<unsigned char[]> buffer;
+  size_t bufferSize = 0;
+  size_t offset = 0;
+
+  std::vector<std::unique_ptr<unsigned char[]>> overflowBlocks;
+  size_t overflowBytes = 0;
+};
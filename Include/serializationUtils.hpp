@@ -52,10 +52,14 @@ ENGINE_API void readTransforms(std::ifstream &in, std::unordered_map<Entity, Tra
 ENGINE_API void writeMaterialData(std::ofstream &out, const MaterialData &mat);
 ENGINE_API void readMaterialData(std::ifstream &in, MaterialData &mat);
 
+ENGINE_API void writeMeshLods(std::ofstream &out, const MeshLodChain &chain);
+ENGINE_API void readMeshLods(std::ifstream &in, MeshLodChain &chain);
+
 ENGINE_API void writeMeshes(std::ofstream &out, const std::unordered_map<Entity, MeshComponent> &meshes);
 // engine is only used for making the mesh components with nice functions that are easy to use instead of making them elsewhere
+// version is the scene file's, LOD chains are only stored from version 2 on
 class Engine;
-ENGINE_API void readMeshes(std::ifstream &in, Engine *engine);
+ENGINE_API void readMeshes(std::ifstream &in, Engine *engine, int version);
 
 ENGINE_API void writeIdentifiers(std::ofstream &out, const std::unordered_map<std::string, Entity> &entities);
 ENGINE_API void readIdentifiers(std::ifstream &in, std::unordered_map<std::string, Entity> &entities);
@@ -28,7 +28,7 @@ public:
 
   void initGraphics(Renderer &renderer) override;
   void initGraphics(Renderer &renderer, std::string texture);
-  void draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, glm::mat4 view, glm::mat4 projectionMatrix, VkCommandBuffer commandBuffer) override;
+  void draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, VkCommandBuffer commandBuffer) override;
   void cleanup(VkDevice device, Renderer &renderer) override;
 
 private:
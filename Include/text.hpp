@@ -53,7 +53,7 @@ public:
 
   void updateText(const std::string &newText, Renderer &renderer);
 
-  void draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, glm::mat4 view, glm::mat4 projectionMatrix, VkCommandBuffer commandBuffer) override;
+  void draw(Renderer *renderer, int currentFrame, glm::mat4 transformation, VkCommandBuffer commandBuffer) override;
 
   void cleanup(VkDevice device, Renderer &renderer) override;
 
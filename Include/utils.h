@@ -5,6 +5,7 @@
 #include <optional>
 #include <glm/glm.hpp>
 #include <vector>
+#include "memoryAllocator.hpp"
 #define MAX_LIGHTS 100
 
 #ifdef BUILD_ENGINE_DLL
@@ -26,6 +27,8 @@ struct ENGINE_API QueueFamilyIndices
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
   std::optional<uint32_t> computeFamily;
+  // uploads run here, a family without graphics when the device has one, otherwise the graphics family
+  std::optional<uint32_t> transferFamily;
 
   bool isComplete()
   {
@@ -45,11 +48,85 @@ struct ENGINE_API ComputeUniformBufferObject
   alignas(16) float deltaTime;
 };
 
-struct ENGINE_API UniformBufferObject
+enum UniformCamera
+{
+  CameraScene,
+  CameraScreen, // orthographic camera of the UI
+};
+
+struct ENGINE_API CameraUniforms
 {
-  alignas(16) glm::mat4 model;
   alignas(16) glm::mat4 view;
   alignas(16) glm::mat4 proj;
+  alignas(16) glm::vec4 position;
+};
+
+// written once per frame, shared by every draw
+struct ENGINE_API GlobalUniformBufferObject
+{
+  CameraUniforms cameras[2];
+};
+
+// per-draw data, suballocated from the frame uniform buffer and bound with a dynamic offset
+struct ENGINE_API ObjectUniformBufferObject
+{
+  alignas(16) glm::mat4 model;
+  int camera;
+};
+
+// one entry of the per-frame instance storage buffer read by shader.vert with gl_InstanceIndex, std430 layout
+struct ENGINE_API InstanceData
+{
+  glm::mat4 model;
+  int32_t pickingId;
+  int32_t materialIndex; // into the frame's material buffer
+  int32_t padding[2];
+};
+
+// input of shaders/cull.comp, one per instance of the opaque mesh batches
+struct ENGINE_API CullInstanceData
+{
+  InstanceData instance;
+  glm::vec4 boundsCenter; // local space, w is the bounding sphere radius
+  glm::vec4 boundsExtent; // local half size of the box
+  uint32_t batch;         // index of the batch's draw in the batch buffer
+  uint32_t visibilityIndex; // the mesh's rendering id, its visibility flag stays with it however the instances are sorted
+  uint32_t padding[2];
+};
+
+// a batch of shaders/cull.comp, the draw starts without instances and is counted up by the pass
+struct ENGINE_API GpuBatchData
+{
+  VkDrawIndexedIndirectCommand draw;
+  uint32_t runStart; // first batch of its shader permutation run, the run's draws are compacted there and counted in drawCount[2 + runStart]
+};
+
+// dispatches of shaders/cull.comp in recording order, the occluder passes only run with occlusion culling
+enum CullPass : uint32_t
+{
+  CullPassFrustum,          // per instance, with occlusion culling only what was visible last frame
+  CullPassCompactOccluders, // per batch, writes the occluder draws and empties the batches again
+  CullPassOcclusion,        // per instance, frustum and depth pyramid test, records visibility for the next frame
+  CullPassCompact,          // per batch, compacts the batches with instances into their permutation run and counts them per run
+};
+
+// push constants of shaders/cull.comp, kept within the 128 bytes every device supports
+struct ENGINE_API CullConstants
+{
+  glm::mat4 viewProj;   // as rendered, the frustum planes are extracted from it
+  glm::uvec2 depthSize; // of the occlusion depth, the pyramid's first level is half of it
+  uint32_t pyramidLevels;
+  uint32_t occlusion;   // 0 when only frustum culling runs
+  uint32_t count;       // instances or batches, depending on the pass
+  uint32_t pass;
+  uint32_t padding[2];
+};
+
+// push constants of shaders/depthPyramid.comp
+struct ENGINE_API DepthPyramidConstants
+{
+  glm::uvec2 sourceSize;
+  glm::uvec2 destinationSize;
 };
 
 struct ENGINE_API Light
@@ -72,14 +149,15 @@ struct ENGINE_API AnimatedUniformBufferObject
 };
 
 ENGINE_API QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
-ENGINE_API VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkDevice device);
+ENGINE_API VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, VkDevice device, uint32_t mipLevels = 1);
 
 ENGINE_API uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkPhysicalDevice physicalDevice);
 
 ENGINE_API VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool);
 ENGINE_API void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue);
 ENGINE_API void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue);
-ENGINE_API void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, VkDeviceMemory &imageMemory, VkDevice device, VkPhysicalDevice physicalDevice);
+// the image is shared concurrently between queueFamilies, fewer than two keep it exclusive
+ENGINE_API void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image, MemoryAllocation &imageMemory, VkDevice device, VkPhysicalDevice physicalDevice, const std::vector<uint32_t> &queueFamilies = {}, uint32_t mipLevels = 1);
 ENGINE_API void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue);
 ENGINE_API VkFormat findSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling, VkFormatFeatureFlags features, VkPhysicalDevice physicalDevice);
 
@@ -155,4 +155,50 @@ struct ENGINE_API AnimatedVertex
   }
 };
 
+// one line, box or sphere for the debug renderer, expanded into line geometry by debug.vert
+struct ENGINE_API DebugInstance
+{
+  glm::vec3 a;        // line start or shape center
+  uint32_t color;     // RGBA8
+  glm::vec3 b;        // line end, box half extents, sphere radius in x
+  uint32_t padding;
+  glm::vec4 rotation; // quaternion xyzw
+
+  static VkVertexInputBindingDescription getBindingDescription()
+  {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(DebugInstance);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    return bindingDescription;
+  }
+
+  static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions()
+  {
+    std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].offset = offsetof(DebugInstance, a);
+
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R8G8B8A8_UNORM;
+    attributeDescriptions[1].offset = offsetof(DebugInstance, color);
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(DebugInstance, b);
+
+    attributeDescriptions[3].binding = 0;
+    attributeDescriptions[3].location = 3;
+    attributeDescriptions[3].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+    attributeDescriptions[3].offset = offsetof(DebugInstance, rotation);
+
+    return attributeDescriptions;
+  }
+};
+
 #endif
\ No newline at end of file
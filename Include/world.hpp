@@ -0,0 +1,60 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include "ECSRegistry.hpp"
+#include "physicsSystem.hpp"
+#include "animationSystem.hpp"
+#include "scratchArena.hpp"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+// one self contained simulation, everything it touches lives in the object so any number of them can step on different threads
+class ENGINE_API World
+{
+public:
+  ECSRegistry registry;
+  PhysicsSystem physics;
+  AnimationSystem animations;
+
+  // game logic run at the start of every step
+  std::function<void(World *, float)> update;
+
+  // only valid inside step(), points at the stepping thread's arena when run from a WorldBatch and at ownScratch otherwise
+  ScratchArena *scratch = nullptr;
+
+  uint64_t steps = 0;
+  double simulationTime = 0.0;
+
+  World() : registry(), physics(registry), animations(registry)
+  {
+  }
+
+  // the systems keep a reference to the registry
+  World(const World &) = delete;
+  World &operator=(const World &) = delete;
+
+  void step(float deltaTime, ScratchArena *scratchArena = nullptr);
+
+  Entity createEmptyGameObject(const std::string &name);
+  void addTransformComponent(Entity entity, glm::vec3 position, glm::vec3 rotation, glm::vec3 scale);
+  void addBoxColliderComponent(Entity entity);
+  void addRigidBodyComponent(Entity entity);
+
+private:
+  // created on the first step without an arena, batched worlds never need one
+  std::unique_ptr<ScratchArena> ownScratch;
+};
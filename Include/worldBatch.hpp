@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "world.hpp"
+
+#ifdef BUILD_ENGINE_DLL
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllexport)
+#endif
+
+#else
+
+#ifndef ENGINE_API
+#define ENGINE_API __declspec(dllimport)
+#endif
+
+#endif
+
+// accumulated until resetStats()
+struct ENGINE_API WorldBatchStats
+{
+  uint64_t batchSteps = 0; // calls to step() times stepsPerWorld
+  uint64_t worldSteps = 0; // individual World::step calls across all worlds
+  double wallSeconds = 0.0;
+
+  double stepsPerSecond() const
+  {
+    return wallSeconds > 0.0 ? worldSteps / wallSeconds : 0.0;
+  }
+};
+
+// steps many independent worlds on a fixed pool of worker threads, each worker owns a scratch arena
+class ENGINE_API WorldBatch
+{
+public:
+  WorldBatchStats stats;
+
+  // 0 uses one worker per hardware thread
+  explicit WorldBatch(size_t threadCount = 0, size_t scratchBytesPerWorker = 1 << 20);
+  ~WorldBatch();
+
+  WorldBatch(const WorldBatch &) = delete;
+  WorldBatch &operator=(const WorldBatch &) = delete;
+
+  World &addWorld();
+  void clear();
+
+  size_t size() const
+  {
+    return worlds.size();
+  }
+
+  World &operator[](size_t index)
+  {
+    return *worlds[index];
+  }
+
+  size_t threadCount() const
+  {
+    return workers.size();
+  }
+
+  // blocks until every world advanced stepsPerWorld times, worlds are handed out one at a time so uneven worlds balance out
+  void step(float deltaTime, uint32_t stepsPerWorld = 1);
+
+  void resetStats()
+  {
+    stats = WorldBatchStats();
+  }
+
+private:
+  std::vector<std::unique_ptr<World>> worlds;
+  std::vector<std::thread> workers;
+  std::vector<ScratchArena> arenas;
+
+  std::mutex mutex;
+  std::condition_variable workReady;
+  std::condition_variable workDone;
+  uint64_t generation = 0;
+  size_t activeWorkers = 0;
+  bool quitting = false;
+
+  std::atomic<size_t> nextWorld{0};
+  float jobDeltaTime = 0.0f;
+  uint32_t jobSteps = 0;
+
+  void workerLoop(size_t workerIndex);
+};
@@ -1,12 +1,21 @@
 #version 450
 
-layout(set = 0, binding = 0) uniform UniformBufferObject {
+layout(set = 1, binding = 1) uniform ObjectUniformBufferObject {
     mat4 model;
+    int camera;
+} object;
+
+struct CameraUniforms {
     mat4 view;
     mat4 proj;
-} ubo;
+    vec4 position;
+};
+
+layout(set = 1, binding = 2) uniform GlobalUniformBufferObject {
+    CameraUniforms cameras[2];
+} globals;
 
-layout(set = 1, binding = 0) uniform AnimatedUniformBufferObject {
+layout(set = 2, binding = 0) uniform AnimatedUniformBufferObject {
     mat4 boneMatrices[100];
 } animUbo;
 
@@ -52,9 +61,11 @@ void main() {
     vec4 skinnedPos = skinMatrix * vec4(inPosition, 1.0);
     vec3 skinnedNormal = mat3(skinMatrix) * inNormal;
 
-    vec4 worldPos = ubo.model * skinnedPos;
-    //vec4 worldPos = ubo.model * vec4(inPosition, 1.0);
-    gl_Position = ubo.proj * ubo.view * worldPos;
+    CameraUniforms camera = globals.cameras[object.camera];
+
+    vec4 worldPos = object.model * skinnedPos;
+    //vec4 worldPos = object.model * vec4(inPosition, 1.0);
+    gl_Position = camera.proj * camera.view * worldPos;
 
     vertexColor = vec4(material.albedoColor, 1);
     if((inColor.x > 0 || inColor.y > 0 || inColor.z > 0) && vertexColor.x == 0 && vertexColor.y == 0 && vertexColor.z == 0) {
@@ -64,9 +75,9 @@ void main() {
     if(inNormal.x < 0 && inNormal.y < 0 && inNormal.z < 0) {
         fragNormal = vec3(-1);
     } else {
-        fragNormal = mat3(transpose(inverse(ubo.model))) * skinnedNormal;
+        fragNormal = mat3(transpose(inverse(object.model))) * skinnedNormal;
     }
-    viewPos = inverse(ubo.view)[3].xyz;
+    viewPos = camera.position.xyz;
 
     fragPos = worldPos.xyz;
 }
\ No newline at end of file
@@ -1,7 +0,0 @@
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe shader.vert -o vert.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe shader.frag -o frag.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe shader.comp -o compute.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe shaderColorID.vert -o vertColorID.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe shaderColorID.frag -o fragColorID.spv
-C:/VulkanSDK/1.3.290.0/Bin/glslc.exe animShader.vert -o aminatedVert.spv
-pause
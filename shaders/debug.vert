@@ -0,0 +1,49 @@
+#version 450
+
+layout(push_constant) uniform PushConstants {
+    mat4 viewProj;
+    int shape; // 0 line, 1 box, 2 sphere
+} pc;
+
+// one DebugInstance per instance
+layout(location = 0) in vec3 inA;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec3 inB;
+layout(location = 3) in vec4 inRotation;
+
+layout(location = 0) out vec4 fragColor;
+
+// vertex counts have to match DEBUG_*_VERTICES in debugDrawer.hpp
+const int SPHERE_SEGMENTS = 24;
+
+// corner index bits are x, y, z
+const int boxEdges[24] = int[](
+    0, 1, 2, 3, 4, 5, 6, 7,
+    0, 2, 1, 3, 4, 6, 5, 7,
+    0, 4, 1, 5, 2, 6, 3, 7);
+
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() {
+    vec3 worldPos;
+
+    if (pc.shape == 0) {
+        worldPos = gl_VertexIndex == 0 ? inA : inB;
+    } else if (pc.shape == 1) {
+        int corner = boxEdges[gl_VertexIndex];
+        vec3 unitCorner = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * 2.0 - 1.0;
+        worldPos = inA + rotate(inRotation, unitCorner * inB);
+    } else {
+        int circle = gl_VertexIndex / (SPHERE_SEGMENTS * 2);
+        int segment = (gl_VertexIndex / 2) % SPHERE_SEGMENTS + (gl_VertexIndex & 1);
+        float angle = float(segment) * 6.28318530718 / float(SPHERE_SEGMENTS);
+        vec2 p = vec2(cos(angle), sin(angle));
+        vec3 unitPoint = circle == 0 ? vec3(p.x, p.y, 0.0) : (circle == 1 ? vec3(0.0, p.x, p.y) : vec3(p.x, 0.0, p.y));
+        worldPos = inA + rotate(inRotation, unitPoint * inB.x);
+    }
+
+    gl_Position = pc.viewProj * vec4(worldPos, 1.0);
+    fragColor = inColor;
+}
@@ -0,0 +1,121 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#define LIGHTS_SET 1
+#define LIGHTS_BINDING 4
+#include "pbr.glsl"
+
+layout(location = 0) in vec4 fragTexCoord;
+layout(location = 1) in vec4 vertexColor;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec3 viewPos;
+layout(location = 4) in vec3 fragPos;
+layout(location = 5) flat in int materialIndex;
+
+struct MaterialData {
+    vec3 albedoColor;
+    float metallic;
+
+    float roughness;
+    float ao;
+    float opacity;
+    float emissiveStrength;
+
+    int hasAlbedoMap;
+    int hasNormalMap;
+    int hasHeightMap;
+    int hasRoughnessMap;
+    int hasMetallicMap;
+    int hasAOMap;
+    int hasEmissiveMap;
+
+    int isParticle;
+    int isSkybox;
+    int isInstanced;
+};
+
+struct BindlessMaterial {
+    MaterialData factors;
+    uint albedo;
+    uint normal;
+    uint height;
+    uint roughness;
+    uint metallic;
+    uint ao;
+    uint emissive;
+};
+
+layout(std430, set = 1, binding = 3) readonly buffer MaterialBuffer {
+    BindlessMaterial materials[];
+};
+
+// every texture in use, materials store their slots
+layout(set = 0, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) out vec4 outColor;
+
+// the material features the pipeline was specialized on (MaterialFeature in mesh.hpp), a feature that is off removes its
+// texture fetch and math, one that is on still tests the material's flag since the permutation with every feature draws mixed materials
+layout(constant_id = 0) const bool HAS_ALBEDO_MAP = true;
+layout(constant_id = 1) const bool HAS_NORMAL_MAP = true;
+layout(constant_id = 2) const bool HAS_ROUGHNESS_MAP = true;
+layout(constant_id = 3) const bool HAS_METALLIC_MAP = true;
+layout(constant_id = 4) const bool HAS_AO_MAP = true;
+layout(constant_id = 5) const bool HAS_EMISSIVE_MAP = true;
+layout(constant_id = 6) const bool IS_SKYBOX = true;
+
+// instances of one draw can use different materials, so the index isn't uniform
+vec4 sampleMap(uint slot, vec2 texCoord) {
+    return texture(textures[nonuniformEXT(slot)], texCoord);
+}
+
+void main() {
+    BindlessMaterial entry = materials[materialIndex];
+    MaterialData material = entry.factors;
+
+    vec3 albedo = material.albedoColor;
+    float metallic = material.metallic;
+    float roughness = material.roughness;
+    float ao = material.ao;
+    vec3 emissive = vec3(0.0);
+
+    if (IS_SKYBOX && material.isSkybox == 1) {
+        if (HAS_ALBEDO_MAP && material.hasAlbedoMap == 1){
+            outColor = sampleMap(entry.albedo, fragTexCoord.xy);
+            return;
+        }
+        outColor = vec4(albedo, 1.0);
+        return;
+    }
+
+    vec4 albedoSample = vec4(1.0);
+    if (HAS_ALBEDO_MAP && material.hasAlbedoMap == 1) {
+        albedoSample = sampleMap(entry.albedo, fragTexCoord.xy);
+        albedo = albedoSample.rgb;
+    }
+
+    if (HAS_ROUGHNESS_MAP && material.hasRoughnessMap == 1)
+        roughness = sampleMap(entry.roughness, fragTexCoord.xy).r;
+
+    if (HAS_METALLIC_MAP && material.hasMetallicMap == 1)
+        metallic = sampleMap(entry.metallic, fragTexCoord.xy).r;
+
+    if (HAS_AO_MAP && material.hasAOMap == 1)
+        ao = sampleMap(entry.ao, fragTexCoord.xy).r;
+
+    if (HAS_EMISSIVE_MAP && material.hasEmissiveMap == 1)
+        emissive = sampleMap(entry.emissive, fragTexCoord.xy).rgb * material.emissiveStrength;
+
+    vec3 norm = normalize(fragNormal);
+    if (HAS_NORMAL_MAP && material.hasNormalMap == 1)
+        norm = applyNormalMap(norm, sampleMap(entry.normal, fragTexCoord.xy).xyz);
+
+    vec3 color = shadePBR(normalize(norm), fragPos, albedo, metallic, roughness, ao, emissive);
+
+    if(material.opacity < 0.1 || albedoSample.w < 0.1){
+        discard;
+    }
+
+    outColor = vec4(color, material.opacity);
+}
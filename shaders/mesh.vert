@@ -0,0 +1,93 @@
+#version 450
+
+struct InstanceData {
+    mat4 model;
+    int pickingId;
+    int materialIndex;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+struct CameraUniforms {
+    mat4 view;
+    mat4 proj;
+    vec4 position;
+};
+
+layout(set = 1, binding = 2) uniform GlobalUniformBufferObject {
+    CameraUniforms cameras[2];
+} globals;
+
+struct MaterialData {
+    vec3 albedoColor;
+    float metallic;
+
+    float roughness;
+    float ao;
+    float opacity;
+    float emissiveStrength;
+
+    int hasAlbedoMap;
+    int hasNormalMap;
+    int hasHeightMap;
+    int hasRoughnessMap;
+    int hasMetallicMap;
+    int hasAOMap;
+    int hasEmissiveMap;
+
+    int isParticle;
+    int isSkybox;
+    int isInstanced;
+};
+
+struct BindlessMaterial {
+    MaterialData factors;
+    uint albedo;
+    uint normal;
+    uint height;
+    uint roughness;
+    uint metallic;
+    uint ao;
+    uint emissive;
+};
+
+layout(std430, set = 1, binding = 3) readonly buffer MaterialBuffer {
+    BindlessMaterial materials[];
+};
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec4 inTexCoord;
+layout(location = 3) in vec3 inNormal;
+
+layout(location = 0) out vec4 fragTexCoord;
+layout(location = 1) out vec4 vertexColor;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) out vec3 viewPos;
+layout(location = 4) out vec3 fragPos;
+layout(location = 5) flat out int materialIndex;
+
+void main() {
+    InstanceData instance = instances[gl_InstanceIndex];
+    CameraUniforms camera = globals.cameras[0];
+    MaterialData material = materials[instance.materialIndex].factors;
+
+    gl_Position = camera.proj * camera.view * instance.model * vec4(inPosition, 1.0);
+    vertexColor = vec4(material.albedoColor, 1);
+    if((inColor.x > 0 || inColor.y > 0 || inColor.z > 0) && vertexColor.x == 0 && vertexColor.y == 0 && vertexColor.z == 0) {
+        vertexColor = vec4(inColor, 1);
+    }
+    fragTexCoord = inTexCoord;
+    if(inNormal.x < 0 && inNormal.y < 0 && inNormal.z < 0) {
+        fragNormal = vec3(-1);
+    } else {
+        fragNormal = mat3(transpose(inverse(instance.model))) * inNormal;
+    }
+    viewPos = camera.position.xyz;
+
+    vec4 worldPos = instance.model * vec4(inPosition, 1.0);
+    fragPos = worldPos.xyz;
+    materialIndex = instance.materialIndex;
+}
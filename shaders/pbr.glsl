@@ -0,0 +1,126 @@
+// lighting shared by shader.frag and mesh.frag
+// define LIGHTS_SET and LIGHTS_BINDING before including, the lights live in a different set for each
+
+struct Light
+{
+  vec3 position;
+  vec3 color;
+  float intensity;
+};
+
+const int MAX_LIGHTS = 100;
+
+layout(set = LIGHTS_SET, binding = LIGHTS_BINDING) uniform LightsUBO {
+  vec3 cameraPos;
+  int lightsCount;
+  Light lights[MAX_LIGHTS];
+} lightsUBO;
+
+const float PI = 3.14159265359;
+
+float DistributionGGX(vec3 N, vec3 H, float roughness) {
+    float a = roughness*roughness;
+    float a2 = a*a;
+    float NdotH = max(dot(N, H), 0.0);
+    float NdotH2 = NdotH * NdotH;
+
+    float num   = a2;
+    float denom = (NdotH2 * (a2 - 1.0) + 1.0);
+    denom = PI * denom * denom;
+
+    return num / denom;
+}
+
+float GeometrySchlickGGX(float NdotV, float roughness) {
+    float r = (roughness + 1.0);
+    float k = (r*r) / 8.0;
+
+    float num   = NdotV;
+    float denom = NdotV * (1.0 - k) + k;
+
+    return num / denom;
+}
+
+float GeometrySmith(vec3 N, vec3 V, vec3 L, float roughness) {
+    float NdotV = max(dot(N, V), 0.0);
+    float NdotL = max(dot(N, L), 0.0);
+    float ggx2 = GeometrySchlickGGX(NdotV, roughness);
+    float ggx1 = GeometrySchlickGGX(NdotL, roughness);
+
+    return ggx1 * ggx2;
+}
+
+vec3 FresnelSchlick(float cosTheta, vec3 F0) {
+    return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+// no tangents in the vertex data, so one is picked perpendicular to the normal
+vec3 applyNormalMap(vec3 norm, vec3 normalSample) {
+    vec3 tangent = normalize(abs(norm.x) < 0.99 ? vec3(1,0,0) : vec3(0,1,0));
+
+    tangent = normalize(tangent - dot(tangent, norm) * norm);
+
+    vec3 bitangent = cross(norm, tangent);
+
+    // z is rebuilt from x and y, BC5 normal maps only store those two
+    vec2 tangentXY = normalSample.xy * 2.0 - 1.0;
+    vec3 tangentNormal = vec3(tangentXY, sqrt(max(1.0 - dot(tangentXY, tangentXY), 0.0)));
+
+    mat3 TBN = mat3(normalize(tangent), normalize(bitangent), norm);
+
+    return normalize(TBN * tangentNormal);
+}
+
+vec3 radianceFromLight(vec3 N, vec3 V, vec3 L, vec3 radiance, vec3 albedo, float metallic, float roughness, vec3 F0) {
+    vec3 H = normalize(V + L);
+
+    float NDF = DistributionGGX(N, H, roughness);
+    float G   = GeometrySmith(N, V, L, roughness);
+    vec3  F   = FresnelSchlick(max(dot(H, V), 0.0), F0);
+
+    vec3 numerator    = NDF * G * F;
+    float denominator = 4.0 * max(dot(N, V), 0.0) * max(dot(N, L), 0.0) + 0.001;
+    vec3 specular = numerator / denominator;
+
+    vec3 kS = F;
+    vec3 kD = vec3(1.0) - kS;
+    kD *= 1.0 - metallic;
+
+    float NdotL = max(dot(N, L), 0.0);
+
+    return (kD * albedo / PI + specular) * radiance * NdotL;
+}
+
+// point lights from the UBO plus the fixed directional light, tone mapped and gamma corrected
+vec3 shadePBR(vec3 N, vec3 fragPos, vec3 albedo, float metallic, float roughness, float ao, vec3 emissive) {
+    vec3 V = normalize(lightsUBO.cameraPos - fragPos);
+
+    vec3 F0 = vec3(0.04);
+    F0 = mix(F0, albedo, metallic);
+
+    vec3 Lo = vec3(0.0);
+
+    for (int i = 0; i < lightsUBO.lightsCount; i++) {
+        Light light = lightsUBO.lights[i];
+
+        vec3 L = normalize(light.position - fragPos);
+        float distance = length(light.position - fragPos);
+        float attenuation = 1.0 / (distance * distance);
+        vec3 radiance = light.color * light.intensity * attenuation;
+
+        Lo += radianceFromLight(N, V, L, radiance, albedo, metallic, roughness, F0);
+    }
+
+    vec3 dirLightDir = normalize(vec3(-0.5, -1.0, -0.3));
+    vec3 dirLightColor = vec3(1.0);
+    float dirLightIntensity = 1.0;
+
+    Lo += radianceFromLight(N, V, normalize(-dirLightDir), dirLightColor * dirLightIntensity, albedo, metallic, roughness, F0);
+
+    vec3 ambient = vec3(0.03) * albedo * ao;
+
+    vec3 color = ambient + Lo + emissive;
+
+    color = color / (color + vec3(1.0));
+    return pow(color, vec3(1.0/2.2));
+}
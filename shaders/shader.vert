@@ -1,10 +1,29 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject {
+struct InstanceData {
     mat4 model;
+    int pickingId;
+    int materialIndex;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+layout(set = 1, binding = 1) uniform ObjectUniformBufferObject {
+    mat4 model;
+    int camera;
+} object;
+
+struct CameraUniforms {
     mat4 view;
     mat4 proj;
-} ubo;
+    vec4 position;
+};
+
+layout(set = 1, binding = 2) uniform GlobalUniformBufferObject {
+    CameraUniforms cameras[2];
+} globals;
 
 layout(push_constant) uniform MaterialData {
     vec3 albedoColor;
@@ -24,6 +43,8 @@ layout(push_constant) uniform MaterialData {
     int hasEmissiveMap;
 
     int isParticle;
+    int isSkybox;
+    int isInstanced;
 } material;
 
 layout(location = 0) in vec3 inPosition;
@@ -40,9 +61,11 @@ layout(location = 3) out vec3 viewPos;
 layout(location = 4) out vec3 fragPos;
 
 void main() {
+    // instanced meshes are always drawn with the scene camera
+    CameraUniforms camera = globals.cameras[material.isInstanced == 1 ? 0 : object.camera];
 
     if(material.isParticle == 1) {
-        gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPositionB, 1.0);
+        gl_Position = camera.proj * camera.view * object.model * vec4(inPositionB, 1.0);
         gl_PointSize = 7;
 
         vertexColor = vec4(material.albedoColor, 1);
@@ -52,7 +75,8 @@ void main() {
         }
         fragTexCoord = vec4(0.0);
     } else {
-        gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+        mat4 model = material.isInstanced == 1 ? instances[gl_InstanceIndex].model : object.model;
+        gl_Position = camera.proj * camera.view * model * vec4(inPosition, 1.0);
         vertexColor = vec4(material.albedoColor, 1);
         if((inColor.x > 0 || inColor.y > 0 || inColor.z > 0) && vertexColor.x == 0 && vertexColor.y == 0 && vertexColor.z == 0) {
             vertexColor = vec4(inColor, 1);
@@ -61,11 +85,11 @@ void main() {
         if(inNormal.x < 0 && inNormal.y < 0 && inNormal.z < 0) {
             fragNormal = vec3(-1);
         } else {
-            fragNormal = mat3(transpose(inverse(ubo.model))) * inNormal;
+            fragNormal = mat3(transpose(inverse(model))) * inNormal;
         }
-        viewPos = inverse(ubo.view)[3].xyz;
+        viewPos = camera.position.xyz;
 
-        vec4 worldPos = ubo.model * vec4(inPosition, 1.0);
+        vec4 worldPos = model * vec4(inPosition, 1.0);
         fragPos = worldPos.xyz;
     }
 }
\ No newline at end of file
@@ -1,13 +1,10 @@
 #version 450
 
-layout(push_constant) uniform PushConstants {
-    int id;
-} pc;
+layout(location = 0) flat in int objectID;
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
-    int objectID = pc.id;
 
     float r = float((objectID >> 0) & 0xFF) / 255.0;
     float g = float((objectID >> 8) & 0xFF) / 255.0;
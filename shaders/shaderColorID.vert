@@ -1,17 +1,30 @@
 #version 450
 
-layout(binding = 0) uniform UniformBufferObject {
+struct InstanceData {
     mat4 model;
+    int pickingId;
+    int materialIndex;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+};
+
+struct CameraUniforms {
     mat4 view;
     mat4 proj;
-} ubo;
+    vec4 position;
+};
+
+layout(set = 1, binding = 2) uniform GlobalUniformBufferObject {
+    CameraUniforms cameras[2];
+} globals;
 
 layout(location = 0) in vec3 inPosition;
 
-layout(push_constant) uniform PushConstants {
-    int id;
-} pc;
+layout(location = 0) flat out int objectID;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 1.0);
+    gl_Position = globals.cameras[0].proj * globals.cameras[0].view * instances[gl_InstanceIndex].model * vec4(inPosition, 1.0);
+    objectID = instances[gl_InstanceIndex].pickingId;
 }
\ No newline at end of file